@@ -0,0 +1,68 @@
+import argparse
+import json
+import sys
+
+## Compare Google Benchmark JSON output with stored baseline
+# Exits with code 1 if any benchmark became slower than baseline by more than threshold
+
+units = {"ns": 1e-9, "us": 1e-6, "ms": 1e-3, "s": 1.0}
+
+
+## Load results as dictionary name -> time in seconds
+# @param[in] path Path to JSON produced with --benchmark_out=<path> --benchmark_out_format=json
+# @param[in] metric real_time or cpu_time
+def load(path, metric):
+    with open(path) as file:
+        data = json.load(file)
+    results = {}
+    medians = {}
+    for benchmark in data["benchmarks"]:
+        if benchmark.get("error_occurred"):
+            continue
+        value = benchmark[metric] * units[benchmark.get("time_unit", "ns")]
+        if benchmark.get("run_type") == "aggregate":
+            # with --benchmark_repetitions median is more stable than mean
+            if benchmark.get("aggregate_name") == "median":
+                medians[benchmark["run_name"]] = value
+            continue
+        results.setdefault(benchmark.get("run_name", benchmark["name"]), []).append(value)
+    results = {name: min(values) for name, values in results.items()}
+    results.update(medians)
+    return results
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Check benchmark results for regressions against baseline")
+    parser.add_argument("baseline", help="JSON with baseline results")
+    parser.add_argument("current", help="JSON with current results")
+    parser.add_argument("--threshold", type=float, default=0.1,
+                        help="Allowed relative slowdown, 0.1 means 10 percent")
+    parser.add_argument("--metric", default="real_time", choices=["real_time", "cpu_time"],
+                        help="Which time to compare")
+    args = parser.parse_args()
+
+    baseline = load(args.baseline, args.metric)
+    current = load(args.current, args.metric)
+    regressions = 0
+    print("%-60s %12s %12s %8s" % ("Benchmark", "Baseline", "Current", "Change"))
+    for name in sorted(current):
+        if name not in baseline:
+            print("%-60s %12s %12.3e %8s" % (name, "-", current[name], "new"))
+            continue
+        change = current[name] / baseline[name] - 1 if baseline[name] > 0 else 0
+        status = ""
+        if change > args.threshold:
+            status = " REGRESSION"
+            regressions += 1
+        print("%-60s %12.3e %12.3e %+7.1f%%%s" % (name, baseline[name], current[name], change * 100, status))
+    for name in sorted(set(baseline) - set(current)):
+        print("%-60s %12.3e %12s %8s" % (name, baseline[name], "-", "missing"))
+
+    if regressions:
+        print("%d benchmark(s) regressed by more than %.1f%%" % (regressions, args.threshold * 100))
+        return 1
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
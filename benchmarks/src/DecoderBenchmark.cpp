@@ -0,0 +1,87 @@
+#include <benchmark/benchmark.h>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <atomic>
+#include "Decoder.h"
+
+/*
+Delivery of decoded frames to 1-32 consumers which wait for every new frame. Packets of file from tests resources are decoded in
+a loop by background thread as fast as possible, so frames per second of consumer show cost of contention on decoder's lock
+*/
+static const std::string inputFile = std::string(RESOURCES_PATH) + "/bbb_1080x608_420_10.h264";
+
+//shared by benchmark threads, thread 0 creates pipeline before the first iteration and destroys it after the last one
+static std::shared_ptr<Parser> parser;
+static std::shared_ptr<Decoder> decoder;
+static std::thread feeder;
+static std::atomic<bool> feeding;
+static std::atomic<uint64_t> decoded;
+
+static int startFeeder() {
+	parser = std::make_shared<Parser>();
+	ParserParameters parserArgs = { inputFile, false };
+	int sts = parser->Init(parserArgs);
+	CHECK_STATUS(sts);
+	std::vector<std::shared_ptr<AVPacket> > packets;
+	while (parser->Read() == VREADER_OK) {
+		std::shared_ptr<AVPacket> packet(av_packet_alloc(), [](AVPacket* packet) { av_packet_free(&packet); });
+		parser->Get(packet.get());
+		packets.push_back(packet);
+	}
+	std::shared_ptr<Decoder> instance = std::make_shared<Decoder>();
+	DecoderParameters decoderArgs = { parser, false, 10, CPU_BACKEND };
+	sts = instance->Init(decoderArgs);
+	CHECK_STATUS(sts);
+	//consumers start only if decoder is ready
+	decoder = instance;
+	feeding = true;
+	decoded = 0;
+	feeder = std::thread([packets]() {
+		//stream starts from IDR frame, so it can be decoded again after the last packet
+		for (size_t i = 0; feeding; i = (i + 1) % packets.size()) {
+			//decoder releases passed packet
+			AVPacket packet;
+			av_packet_ref(&packet, packets[i].get());
+			if (decoder->Decode(&packet) == VREADER_OK)
+				decoded++;
+			else
+				av_packet_unref(&packet);
+		}
+	});
+	return VREADER_OK;
+}
+
+static void stopFeeder() {
+	feeding = false;
+	if (feeder.joinable())
+		feeder.join();
+	decoder->Close();
+	parser->Close();
+	decoder = nullptr;
+	parser = nullptr;
+}
+
+static void GetFrameContention(benchmark::State& state) {
+	if (state.thread_index == 0)
+		startFeeder();
+	std::string consumerName = "consumer" + std::to_string(state.thread_index);
+	AVFrame* frame = av_frame_alloc();
+	for (auto _ : state) {
+		if (decoder == nullptr) {
+			state.SkipWithError("Can't decode input file");
+			break;
+		}
+		benchmark::DoNotOptimize(decoder->GetFrame(0, consumerName, frame));
+		av_frame_unref(frame);
+	}
+	av_frame_free(&frame);
+	state.counters["fps"] = benchmark::Counter((double)state.iterations(), benchmark::Counter::kAvgThreadsRate);
+	if (state.thread_index == 0 && decoder) {
+		state.counters["decoded"] = (double)decoded;
+		stopFeeder();
+	}
+}
+
+//consumers wait for decoder, so wall time is measured
+BENCHMARK(GetFrameContention)->ThreadRange(1, 32)->UseRealTime()->Unit(benchmark::kMicrosecond);
@@ -0,0 +1,94 @@
+#include <benchmark/benchmark.h>
+#include <memory>
+#include "Parser.h"
+#include "Decoder.h"
+#include "VideoProcessor.h"
+
+/*
+Read, analysis, software decoding and CPU conversion to RGB24 of every frame of file from tests resources without realtime delay,
+every iteration processes the whole file. Arguments are output width and height, 0 means source size
+*/
+static const std::string inputFile = std::string(RESOURCES_PATH) + "/bbb_1080x608_420_10.h264";
+//generated in process, so number of streams is limited only by machine
+static const std::string syntheticFile = "synthetic://1280x720?fps=30&gop=30&bframes=2&complexity=0.2&frames=90";
+
+static int processFile(const std::string& input, int width, int height, int& frames, int64_t& bytes) {
+	std::shared_ptr<Parser> parser = std::make_shared<Parser>();
+	ParserParameters parserArgs = { input, false };
+	int sts = parser->Init(parserArgs);
+	CHECK_STATUS(sts);
+	Decoder decoder;
+	DecoderParameters decoderArgs = { parser, false, 10, CPU_BACKEND };
+	sts = decoder.Init(decoderArgs);
+	CHECK_STATUS(sts);
+	VideoProcessor vpp;
+	sts = vpp.Init(false, CPU_BACKEND);
+	CHECK_STATUS(sts);
+	VPPParameters format = { (unsigned int)width, (unsigned int)height, RGB24 };
+	std::shared_ptr<AVPacket> packet(av_packet_alloc(), [](AVPacket* packet) { av_packet_free(&packet); });
+	std::shared_ptr<AVFrame> decoded(av_frame_alloc(), [](AVFrame* frame) { av_frame_free(&frame); });
+	std::shared_ptr<AVFrame> output(av_frame_alloc(), [](AVFrame* frame) { av_frame_free(&frame); });
+	auto convert = [&]() {
+		decoder.GetLatestFrame(decoded.get());
+		int sts = vpp.Convert(decoded.get(), output.get(), format, "benchmark");
+		av_frame_unref(decoded.get());
+		CHECK_STATUS(sts);
+		vpp.Free(output->opaque);
+		frames++;
+		return sts;
+	};
+	while (parser->Read() == VREADER_OK) {
+		parser->Get(packet.get());
+		bytes += packet->size;
+		parser->Analyze(packet.get());
+		sts = decoder.Decode(packet.get());
+		if (sts != VREADER_OK) {
+			av_packet_unref(packet.get());
+			continue;
+		}
+		sts = convert();
+		CHECK_STATUS(sts);
+	}
+	//frames kept by decoder for reordering are returned one by one at the end of file
+	while (decoder.Flush() == VREADER_OK) {
+		sts = convert();
+		CHECK_STATUS(sts);
+	}
+	vpp.Close();
+	decoder.Close();
+	parser->Close();
+	return VREADER_OK;
+}
+
+static void FileThroughput(benchmark::State& state) {
+	int frames = 0;
+	int64_t bytes = 0;
+	for (auto _ : state) {
+		if (processFile(inputFile, state.range(0), state.range(1), frames, bytes) != VREADER_OK) {
+			state.SkipWithError("Can't process input file");
+			break;
+		}
+	}
+	state.counters["fps"] = benchmark::Counter((double)frames, benchmark::Counter::kIsRate);
+	state.SetBytesProcessed(bytes);
+}
+
+BENCHMARK(FileThroughput)->Args({ 0, 0 })->Args({ 720, 480 })->Unit(benchmark::kMillisecond);
+
+/*
+Every thread processes own synthetic stream, fps is total for all streams
+*/
+static void SyntheticStreams(benchmark::State& state) {
+	int frames = 0;
+	int64_t bytes = 0;
+	for (auto _ : state) {
+		if (processFile(syntheticFile, 0, 0, frames, bytes) != VREADER_OK) {
+			state.SkipWithError("Can't process synthetic stream");
+			break;
+		}
+	}
+	state.counters["fps"] = benchmark::Counter((double)frames, benchmark::Counter::kIsRate);
+	state.SetBytesProcessed(bytes);
+}
+
+BENCHMARK(SyntheticStreams)->ThreadRange(1, 16)->UseRealTime()->Unit(benchmark::kMillisecond);
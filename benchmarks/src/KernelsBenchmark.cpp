@@ -0,0 +1,169 @@
+#include <benchmark/benchmark.h>
+#include <random>
+#include <vector>
+#include <algorithm>
+#include "KernelsCPU.h"
+#include "VPPPipeline.h"
+
+/*
+Throughput of CPU kernels for every instruction set supported by current CPU, result is reported in megapixels of output per second
+*/
+const int width = 1920;
+const int height = 1080;
+
+static std::vector<uint8_t> randomFrame(int size) {
+	std::mt19937 generator;
+	std::vector<uint8_t> frame(size);
+	for (auto& item : frame)
+		item = generator() & 0xFF;
+	return frame;
+}
+
+static void setRate(benchmark::State& state, int pixels) {
+	state.counters["Mpix/s"] = benchmark::Counter((double)pixels * state.iterations() / 1e6, benchmark::Counter::kIsRate);
+}
+
+static void NV12ToRGB24(benchmark::State& state, const CPUKernels* kernels, bool BGR) {
+	const ColorCoefficients coefficients = { 16, 9535, 13074, 6660, 3203, 16531 };
+	std::vector<uint8_t> NV12 = randomFrame(width * height * 3 / 2);
+	std::vector<uint8_t> RGB(width * height * 3);
+	auto convert = BGR ? kernels->NV12ToBGR24Row : kernels->NV12ToRGB24Row;
+	for (auto _ : state) {
+		for (int i = 0; i < height; i++)
+			convert(&NV12[i * width], &NV12[(height + i / 2) * width], &RGB[i * width * 3], width, coefficients);
+		benchmark::DoNotOptimize(RGB.data());
+	}
+	setRate(state, width * height);
+}
+
+static void resizeNearest(benchmark::State& state, const CPUKernels* kernels) {
+	int dstWidth = state.range(0);
+	int dstHeight = state.range(1);
+	std::vector<uint8_t> Y = randomFrame(width * height);
+	std::vector<uint8_t> output(dstWidth * dstHeight);
+	float xRatio = ((float)(width - 1)) / dstWidth;
+	float yRatio = ((float)(height - 1)) / dstHeight;
+	std::vector<int> xIndex(dstWidth);
+	for (int j = 0; j < dstWidth; j++)
+		xIndex[j] = (int)(xRatio * j);
+	for (auto _ : state) {
+		for (int i = 0; i < dstHeight; i++)
+			kernels->resizeNearestRow(&Y[(int)(yRatio * i) * width], &output[i * dstWidth], &xIndex[0], dstWidth, width);
+		benchmark::DoNotOptimize(output.data());
+	}
+	setRate(state, dstWidth * dstHeight);
+}
+
+static void resizeBilinear(benchmark::State& state, const CPUKernels* kernels) {
+	int dstWidth = state.range(0);
+	int dstHeight = state.range(1);
+	std::vector<uint8_t> Y = randomFrame(width * height);
+	std::vector<uint8_t> output(dstWidth * dstHeight);
+	std::vector<uint8_t> row(width);
+	float xRatio = ((float)(width - 1)) / dstWidth;
+	float yRatio = ((float)(height - 1)) / dstHeight;
+	std::vector<int> xIndex(dstWidth), xWeight(dstWidth);
+	for (int j = 0; j < dstWidth; j++) {
+		float position = xRatio * j;
+		xIndex[j] = std::min((int)position, width - 2);
+		xWeight[j] = (int)((position - (int)position) * weightOne);
+	}
+	for (auto _ : state) {
+		for (int i = 0; i < dstHeight; i++) {
+			float position = yRatio * i;
+			int y = std::min((int)position, height - 2);
+			kernels->blendRows(&Y[y * width], &Y[(y + 1) * width], &row[0], width, (int)((position - (int)position) * weightOne));
+			kernels->resizeBilinearRow(&row[0], &output[i * dstWidth], &xIndex[0], &xWeight[0], dstWidth, width);
+		}
+		benchmark::DoNotOptimize(output.data());
+	}
+	setRate(state, dstWidth * dstHeight);
+}
+
+//chroma plane of NV12, sizes are measured in UV pairs
+static void resizeNearestUV(benchmark::State& state, const CPUKernels* kernels) {
+	int dstWidth = state.range(0) / 2;
+	int dstHeight = state.range(1) / 2;
+	std::vector<uint8_t> UV = randomFrame(width * height / 2);
+	std::vector<uint8_t> output(dstWidth * dstHeight * 2);
+	float xRatio = ((float)(width - 1)) / (dstWidth * 2);
+	float yRatio = ((float)(height - 1)) / (dstHeight * 2);
+	std::vector<int> xIndex(dstWidth);
+	for (int j = 0; j < dstWidth; j++)
+		xIndex[j] = (int)(xRatio * 2 * j) / 2;
+	for (auto _ : state) {
+		for (int i = 0; i < dstHeight; i++)
+			kernels->resizeNearestRowUV(&UV[(int)(yRatio * i) * width], &output[i * dstWidth * 2], &xIndex[0], dstWidth, width / 2);
+		benchmark::DoNotOptimize(output.data());
+	}
+	setRate(state, dstWidth * dstHeight);
+}
+
+static void resizeBilinearUV(benchmark::State& state, const CPUKernels* kernels) {
+	int dstWidth = state.range(0) / 2;
+	int dstHeight = state.range(1) / 2;
+	int srcWidth = width / 2;
+	std::vector<uint8_t> UV = randomFrame(width * height / 2);
+	std::vector<uint8_t> output(dstWidth * dstHeight * 2);
+	std::vector<uint8_t> row(width);
+	float xRatio = ((float)(srcWidth - 1)) / dstWidth;
+	float yRatio = ((float)(height / 2 - 1)) / dstHeight;
+	std::vector<int> xIndex(dstWidth), xWeight(dstWidth);
+	for (int j = 0; j < dstWidth; j++) {
+		float position = xRatio * j;
+		xIndex[j] = std::min((int)position, srcWidth - 2);
+		xWeight[j] = (int)((position - (int)position) * weightOne);
+	}
+	for (auto _ : state) {
+		for (int i = 0; i < dstHeight; i++) {
+			float position = yRatio * i;
+			int y = std::min((int)position, height / 2 - 2);
+			kernels->blendRows(&UV[y * width], &UV[(y + 1) * width], &row[0], width, (int)((position - (int)position) * weightOne));
+			kernels->resizeBilinearRowUV(&row[0], &output[i * dstWidth * 2], &xIndex[0], &xWeight[0], dstWidth, srcWidth);
+		}
+		benchmark::DoNotOptimize(output.data());
+	}
+	setRate(state, dstWidth * dstHeight);
+}
+
+//separable bicubic resize of luma: horizontal pass of every source row followed by vertical pass of every output row
+static void filterBicubic(benchmark::State& state, const CPUKernels* kernels) {
+	int dstWidth = state.range(0);
+	int dstHeight = state.range(1);
+	std::shared_ptr<const ResizeFilter> filter = getResizeFilter(FILTER_BICUBIC, width, height, dstWidth, dstHeight);
+	std::vector<uint8_t> Y = randomFrame(width * height);
+	std::vector<int16_t> intermediate((size_t)dstWidth * height);
+	std::vector<uint8_t> output(dstWidth * dstHeight);
+	std::vector<const int16_t*> rows(filter->y.taps);
+	for (auto _ : state) {
+		for (int i = 0; i < height; i++)
+			kernels->filterRow(&Y[i * width], &intermediate[(size_t)i * dstWidth], &filter->x.index[0], &filter->x.weights[0], filter->x.taps,
+				dstWidth, 1);
+		for (int i = 0; i < dstHeight; i++) {
+			for (int t = 0; t < filter->y.taps; t++)
+				rows[t] = &intermediate[(size_t)(filter->y.index[i] + t) * dstWidth];
+			kernels->filterColumns(&rows[0], &filter->y.weights[(size_t)i * filter->y.taps], filter->y.taps, &output[i * dstWidth], dstWidth);
+		}
+		benchmark::DoNotOptimize(output.data());
+	}
+	setRate(state, dstWidth * dstHeight);
+}
+
+static int registerBenchmarks() {
+	for (CPUInstructionSet instructionSet : { SCALAR, SSE41, AVX2, AVX512 }) {
+		const CPUKernels* kernels = getCPUKernels(instructionSet);
+		if (kernels == nullptr)
+			continue;
+		std::string name = kernels->name;
+		benchmark::RegisterBenchmark(("NV12ToRGB24/" + name).c_str(), NV12ToRGB24, kernels, false);
+		benchmark::RegisterBenchmark(("NV12ToBGR24/" + name).c_str(), NV12ToRGB24, kernels, true);
+		benchmark::RegisterBenchmark(("ResizeNearest/" + name).c_str(), resizeNearest, kernels)->Args({ 640, 360 })->Args({ 3840, 2160 });
+		benchmark::RegisterBenchmark(("ResizeNearestUV/" + name).c_str(), resizeNearestUV, kernels)->Args({ 640, 360 })->Args({ 3840, 2160 });
+		benchmark::RegisterBenchmark(("ResizeBilinear/" + name).c_str(), resizeBilinear, kernels)->Args({ 640, 360 })->Args({ 3840, 2160 });
+		benchmark::RegisterBenchmark(("ResizeBilinearUV/" + name).c_str(), resizeBilinearUV, kernels)->Args({ 640, 360 })->Args({ 3840, 2160 });
+		benchmark::RegisterBenchmark(("FilterBicubic/" + name).c_str(), filterBicubic, kernels)->Args({ 640, 360 })->Args({ 3840, 2160 });
+	}
+	return 0;
+}
+
+static int registered = registerBenchmarks();
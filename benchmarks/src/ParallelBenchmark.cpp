@@ -0,0 +1,41 @@
+#include <benchmark/benchmark.h>
+#include <random>
+#include <vector>
+#include <thread>
+#include <algorithm>
+#include "KernelsCPU.h"
+#include "ThreadPool.h"
+
+/*
+Scaling of banded NV12 -> RGB24 conversion from 1 thread to number of hardware threads, arguments are width, height and threads
+*/
+static void NV12ToRGB24Parallel(benchmark::State& state) {
+	int width = state.range(0);
+	int height = state.range(1);
+	ThreadPool pool(state.range(2));
+	const ColorCoefficients coefficients = { 16, 9535, 13074, 6660, 3203, 16531 };
+	std::mt19937 generator;
+	std::vector<uint8_t> NV12(width * height * 3 / 2);
+	for (auto& item : NV12)
+		item = generator() & 0xFF;
+	std::vector<uint8_t> RGB(width * height * 3);
+	for (auto _ : state) {
+		NV12ToRGB24CPU(&NV12[0], &NV12[width * height], &RGB[0], width, height, width, width * 3, coefficients, &pool);
+		benchmark::DoNotOptimize(RGB.data());
+	}
+	state.counters["Mpix/s"] = benchmark::Counter((double)width * height * state.iterations() / 1e6, benchmark::Counter::kIsRate);
+	state.counters["fps"] = benchmark::Counter((double)state.iterations(), benchmark::Counter::kIsRate);
+}
+
+static void scalingArguments(benchmark::internal::Benchmark* benchmark) {
+	int threads = std::max(1u, std::thread::hardware_concurrency());
+	for (auto resolution : { std::make_pair(1920, 1080), std::make_pair(3840, 2160) }) {
+		for (int i = 1; i <= threads; i *= 2)
+			benchmark->Args({ resolution.first, resolution.second, i });
+		if ((threads & (threads - 1)) != 0)
+			benchmark->Args({ resolution.first, resolution.second, threads });
+	}
+}
+
+//wall time is measured because work is done by pool threads
+BENCHMARK(NV12ToRGB24Parallel)->Apply(scalingArguments)->UseRealTime()->Unit(benchmark::kMillisecond);
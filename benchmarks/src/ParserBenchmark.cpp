@@ -0,0 +1,97 @@
+#include <benchmark/benchmark.h>
+#include <random>
+#include <vector>
+#include <memory>
+#include <stdio.h>
+#include "Parser.h"
+
+/*
+Bitstream parsing on H.264 file from tests resources: start code scanning, Exp-Golomb reading and analysis of every packet
+*/
+static const std::string inputFile = std::string(RESOURCES_PATH) + "/bbb_1080x608_420_10.h264";
+
+static std::vector<uint8_t> readFile(const std::string& name) {
+	std::vector<uint8_t> data;
+	std::shared_ptr<FILE> file(fopen(name.c_str(), "rb"), [](FILE* file) { if (file) fclose(file); });
+	if (file == nullptr)
+		return data;
+	uint8_t buffer[1 << 16];
+	for (size_t size; (size = fread(buffer, 1, sizeof(buffer), file.get())) > 0;)
+		data.insert(data.end(), buffer, buffer + size);
+	return data;
+}
+
+static void NALScan(benchmark::State& state) {
+	std::vector<uint8_t> bitstream = readFile(inputFile);
+	if (bitstream.empty()) {
+		state.SkipWithError("Can't read input file");
+		return;
+	}
+	int units = 0;
+	for (auto _ : state) {
+		BitReader reader(&bitstream[0], bitstream.size());
+		units = 0;
+		while (!reader.FindNALType().empty())
+			units++;
+		benchmark::DoNotOptimize(units);
+	}
+	state.counters["NALs"] = units;
+	state.SetBytesProcessed((int64_t)bitstream.size() * state.iterations());
+}
+
+//unsigned Exp-Golomb values up to 255 as in slice headers
+static void ReadGolomb(benchmark::State& state) {
+	const int valuesNumber = 4096;
+	std::mt19937 generator;
+	std::vector<bool> bits;
+	for (int i = 0; i < valuesNumber; i++) {
+		uint32_t value = (generator() & 0xFF) + 1;
+		int length = 0;
+		while (value >> (length + 1))
+			length++;
+		bits.insert(bits.end(), length, false);
+		for (int bit = length; bit >= 0; bit--)
+			bits.push_back((value >> bit) & 1);
+	}
+	//padding, so the last value is never read out of buffer
+	std::vector<uint8_t> bitstream(bits.size() / 8 + 2, 0xFF);
+	for (size_t i = 0; i < bits.size(); i++) {
+		if (!bits[i])
+			bitstream[i / 8] &= ~(0x80 >> (i % 8));
+	}
+	for (auto _ : state) {
+		BitReader reader(&bitstream[0], bitstream.size());
+		int sum = 0;
+		for (int i = 0; i < valuesNumber; i++)
+			sum += reader.Convert(reader.ReadGolomb(), BitReader::Type::GOLOMB, BitReader::Base::DEC);
+		benchmark::DoNotOptimize(sum);
+	}
+	state.counters["values/s"] = benchmark::Counter((double)valuesNumber * state.iterations(), benchmark::Counter::kIsRate);
+}
+
+static void Analyze(benchmark::State& state) {
+	Parser parser;
+	ParserParameters parameters = { inputFile, false };
+	if (parser.Init(parameters) != VREADER_OK) {
+		state.SkipWithError("Can't open input file");
+		return;
+	}
+	std::vector<std::shared_ptr<AVPacket> > packets;
+	while (parser.Read() == VREADER_OK) {
+		std::shared_ptr<AVPacket> packet(av_packet_alloc(), [](AVPacket* packet) { av_packet_free(&packet); });
+		parser.Get(packet.get());
+		packets.push_back(packet);
+	}
+	size_t index = 0;
+	for (auto _ : state) {
+		benchmark::DoNotOptimize(parser.Analyze(packets[index].get()));
+		index = (index + 1) % packets.size();
+	}
+	state.counters["packets/s"] = benchmark::Counter((double)state.iterations(), benchmark::Counter::kIsRate);
+	packets.clear();
+	parser.Close();
+}
+
+BENCHMARK(NALScan)->Unit(benchmark::kMicrosecond);
+BENCHMARK(ReadGolomb)->Unit(benchmark::kMicrosecond);
+BENCHMARK(Analyze);
@@ -0,0 +1,69 @@
+#include <benchmark/benchmark.h>
+#include <random>
+#include <vector>
+#include "KernelsCPU.h"
+#include "VPPPipeline.h"
+
+/*
+1080p -> 720p RGB24: resize to intermediate NV12 frame with following conversion vs fused pipeline, single thread.
+Besides time "passes" counter shows number of frame sized buffers read or written per output frame.
+*/
+const int srcWidth = 1920;
+const int srcHeight = 1080;
+const int dstWidth = 1280;
+const int dstHeight = 720;
+const ColorCoefficients coefficients = { 16, 9535, 13074, 6660, 3203, 16531 };
+
+static std::vector<uint8_t> randomNV12() {
+	std::mt19937 generator;
+	std::vector<uint8_t> frame(srcWidth * srcHeight * 3 / 2);
+	for (auto& item : frame)
+		item = generator() & 0xFF;
+	return frame;
+}
+
+static void TwoPasses(benchmark::State& state) {
+	std::vector<uint8_t> NV12 = randomNV12();
+	std::vector<uint8_t> RGB(dstWidth * dstHeight * 3);
+	float xRatio = ((float)(srcWidth - 1)) / dstWidth;
+	float yRatio = ((float)(srcHeight - 1)) / dstHeight;
+	for (auto _ : state) {
+		//intermediate frame is allocated on every call as in previous version of VideoProcessor::Convert
+		std::vector<uint8_t> resized(dstWidth * dstHeight * 3 / 2);
+		resizeNV12NearestCPU(&NV12[0], &NV12[srcWidth * srcHeight], &resized[0], &resized[dstWidth * dstHeight],
+			srcWidth, srcHeight, srcWidth, srcWidth, dstWidth, dstHeight, xRatio, yRatio);
+		NV12ToRGB24CPU(&resized[0], &resized[dstWidth * dstHeight], &RGB[0], dstWidth, dstHeight, dstWidth, dstWidth * 3, coefficients);
+		benchmark::DoNotOptimize(RGB.data());
+	}
+	//read source, write intermediate, read intermediate, write output
+	state.counters["passes"] = 4;
+}
+
+static void Fused(benchmark::State& state) {
+	std::vector<uint8_t> NV12 = randomNV12();
+	VPPPipeline pipeline;
+	pipeline.cropX = pipeline.cropY = 0;
+	pipeline.cropWidth = srcWidth;
+	pipeline.cropHeight = srcHeight;
+	pipeline.dstWidth = pipeline.outputWidth = dstWidth;
+	pipeline.dstHeight = pipeline.outputHeight = dstHeight;
+	pipeline.channels = 3;
+	pipeline.indexR = 0;
+	pipeline.indexB = 2;
+	pipeline.coefficients = coefficients;
+	pipeline.type = PIXEL_UINT8;
+	pipeline.layout = LAYOUT_HWC;
+	pipeline.kernel = FILTER_NEAREST;
+	pipeline.imageX = pipeline.imageY = 0;
+	pipeline.initTables();
+	std::vector<uint8_t> RGB(pipeline.getOutputSize());
+	for (auto _ : state) {
+		processPipelineCPU(&NV12[0], &NV12[srcWidth * srcHeight], srcWidth, srcWidth, srcWidth, &RGB[0], pipeline);
+		benchmark::DoNotOptimize(RGB.data());
+	}
+	//read source, write output
+	state.counters["passes"] = 2;
+}
+
+BENCHMARK(TwoPasses);
+BENCHMARK(Fused);
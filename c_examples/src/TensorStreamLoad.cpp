@@ -0,0 +1,339 @@
+#include "WrapperC.h"
+#include <sstream>
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/resource.h>
+#endif
+
+/*
+Load test: every input is decoded by own pipeline and read by several consumers with own output parameters, read rate and delay
+index, so hardware can be sized against expected number of streams and consumers
+*/
+
+struct ConsumerSpec {
+	FourCC format = RGB24;
+	int width = 0;
+	int height = 0;
+	//requests per second, 0 means as fast as frames are decoded
+	float fps = 0;
+	int delay = 0;
+};
+
+struct ConsumerResult {
+	std::string stream;
+	std::string name;
+	ConsumerSpec spec;
+	uint64_t frames = 0;
+	double seconds = 0;
+	LatencyHistogram latency;
+	double skipped = 0;
+	double dropped = 0;
+	std::string error;
+	std::atomic<bool> finished{ false };
+};
+
+static std::atomic<bool> stopConsumers{ false };
+
+static const std::map<std::string, FourCC> formats = { {"Y800", Y800}, {"RGB24", RGB24}, {"BGR24", BGR24}, {"RGB_PLANAR_F32", RGB_PLANAR_F32},
+	{"BGR_PLANAR_F32", BGR_PLANAR_F32}, {"RGB_PLANAR_F16", RGB_PLANAR_F16}, {"BGR_PLANAR_F16", BGR_PLANAR_F16}, {"NV12", NV12}, {"I420", I420} };
+
+static double getCPUTime() {
+#ifdef _WIN32
+	FILETIME creation, exit, kernel, user;
+	if (!GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user))
+		return 0;
+	auto toSeconds = [](FILETIME time) { return (((uint64_t)time.dwHighDateTime << 32) | time.dwLowDateTime) / 1e7; };
+	return toSeconds(kernel) + toSeconds(user);
+#else
+	rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage))
+		return 0;
+	return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+#endif
+}
+
+//spec is comma separated list of key=value pairs: format, width, height, fps, delay
+static bool parseSpec(const std::string& text, ConsumerSpec& spec) {
+	std::stringstream stream(text);
+	std::string item;
+	while (std::getline(stream, item, ',')) {
+		size_t separator = item.find('=');
+		if (separator == std::string::npos)
+			return false;
+		std::string key = item.substr(0, separator);
+		std::string value = item.substr(separator + 1);
+		if (key == "format") {
+			auto format = formats.find(value);
+			if (format == formats.end())
+				return false;
+			spec.format = format->second;
+		}
+		else if (key == "width")
+			spec.width = std::atoi(value.c_str());
+		else if (key == "height")
+			spec.height = std::atoi(value.c_str());
+		else if (key == "fps")
+			spec.fps = (float)std::atof(value.c_str());
+		else if (key == "delay")
+			spec.delay = std::atoi(value.c_str());
+		else
+			return false;
+	}
+	return true;
+}
+
+static void consume(TensorStream* reader, ConsumerResult* result, int frames) {
+	const ConsumerSpec& spec = result->spec;
+	auto start = std::chrono::steady_clock::now();
+	auto next = start;
+	try {
+		while (!stopConsumers && (frames == 0 || result->frames < (uint64_t)frames)) {
+			if (spec.fps > 0) {
+				std::this_thread::sleep_until(next);
+				next += std::chrono::microseconds((int64_t)(1e6 / spec.fps));
+			}
+			auto requested = std::chrono::steady_clock::now();
+			auto output = reader->getFrame(result->name, spec.delay, spec.format, spec.width, spec.height);
+			result->latency.add(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - requested).count());
+			result->frames++;
+		}
+	}
+	catch (std::runtime_error& error) {
+		//stream has ended
+		result->error = error.what();
+	}
+	result->seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	result->finished = true;
+}
+
+static void usage() {
+	printf("Usage: tensorstream-load [options] input [input ...]\n"
+		"  input is path to file, stream URL or synthetic stream, e.g.\n"
+		"  synthetic://1280x720?fps=30&gop=30&bframes=2&slices=4&complexity=0.1&frames=300&seed=1\n"
+		"  --consumers M      consumers per stream (default 1)\n"
+		"  --consumer SPEC    consumer parameters, can be repeated, consumer i of stream uses SPEC i %% number of specs.\n"
+		"                     SPEC is comma separated format=RGB24,width=0,height=0,fps=0,delay=0, zero size is\n"
+		"                     size of stream, zero fps reads frames as fast as they are decoded\n"
+		"  --unpaced          decode as fast as possible instead of stream frame rate\n"
+		"  --frames N         stop consumer after N frames (default 0, till the end of stream)\n"
+		"  --duration S       stop after S seconds (default 0, till the end of streams)\n"
+		"  --backend cpu|cuda decoding and post-processing device (default cuda)\n"
+		"  --buffer N         decoded frames kept for consumers (default 10)\n"
+		"  --prefetch W       convert frames in background with W workers\n"
+		"  --write FILE       write synthetic input to FILE as H.264 instead of running load test\n"
+		"  --capture FILE     record packets of input with arrival time to FILE, index of input is appended if there are\n"
+		"                     several inputs. Capture is replayed with recorded timing by replay://FILE?speed=1 input\n"
+		"  --low-latency      live profile: no demuxer buffering, short probing, low-delay decoding without pacing\n"
+		"  --rtsp-transport T tcp (default), udp, udp_multicast or http\n"
+		"  --probesize N      read at most N bytes while stream parameters are probed (default FFmpeg 5 MB)\n"
+		"  --analyzeduration U\n"
+		"                     probe at most U microseconds of stream (default FFmpeg 5 s)\n"
+		"  --cache-parameters reuse probed parameters for repeated inputs, so only the first of them is probed\n"
+		"  Age of frames since arrival and since capture time in SEI (synthetic://...&timestamps=1) and durations of\n"
+		"  startup phases are reported per input\n");
+}
+
+int main(int argc, char** argv) {
+	std::vector<std::string> inputs;
+	std::vector<ConsumerSpec> specs;
+	int consumers = 1;
+	int frames = 0;
+	float duration = 0;
+	int buffer = 10;
+	int prefetch = 0;
+	bool realTime = true;
+	bool lowLatency = false;
+	std::string rtspTransport = "tcp";
+	int64_t probeSize = 0;
+	int64_t analyzeDuration = 0;
+	bool cacheParameters = false;
+	std::string writeName;
+	std::string captureName;
+	BackendType backend = CUDA_BACKEND;
+	for (int i = 1; i < argc; i++) {
+		std::string argument = argv[i];
+		bool hasValue = i + 1 < argc;
+		if (argument == "--consumers" && hasValue)
+			consumers = std::atoi(argv[++i]);
+		else if (argument == "--consumer" && hasValue) {
+			ConsumerSpec spec;
+			if (!parseSpec(argv[++i], spec)) {
+				printf("Wrong consumer parameters: %s\n", argv[i]);
+				return 1;
+			}
+			specs.push_back(spec);
+		}
+		else if (argument == "--unpaced")
+			realTime = false;
+		else if (argument == "--frames" && hasValue)
+			frames = std::atoi(argv[++i]);
+		else if (argument == "--duration" && hasValue)
+			duration = (float)std::atof(argv[++i]);
+		else if (argument == "--backend" && hasValue)
+			backend = std::string(argv[++i]) == "cpu" ? CPU_BACKEND : CUDA_BACKEND;
+		else if (argument == "--buffer" && hasValue)
+			buffer = std::atoi(argv[++i]);
+		else if (argument == "--prefetch" && hasValue)
+			prefetch = std::atoi(argv[++i]);
+		else if (argument == "--write" && hasValue)
+			writeName = argv[++i];
+		else if (argument == "--capture" && hasValue)
+			captureName = argv[++i];
+		else if (argument == "--low-latency")
+			lowLatency = true;
+		else if (argument == "--rtsp-transport" && hasValue)
+			rtspTransport = argv[++i];
+		else if (argument == "--probesize" && hasValue)
+			probeSize = std::atoll(argv[++i]);
+		else if (argument == "--analyzeduration" && hasValue)
+			analyzeDuration = std::atoll(argv[++i]);
+		else if (argument == "--cache-parameters")
+			cacheParameters = true;
+		else if (argument.size() > 1 && argument[0] == '-') {
+			usage();
+			return 1;
+		}
+		else
+			inputs.push_back(argument);
+	}
+	if (inputs.empty() || consumers <= 0) {
+		usage();
+		return 1;
+	}
+	if (specs.empty())
+		specs.push_back(ConsumerSpec());
+	if (!writeName.empty()) {
+		SyntheticParameters parameters;
+		SyntheticStream synthetic;
+		int sts = SyntheticStream::ParseURL(inputs[0], parameters);
+		if (sts == VREADER_OK)
+			sts = synthetic.Init(parameters);
+		if (sts == VREADER_OK)
+			sts = synthetic.Write(writeName);
+		if (sts != VREADER_OK) {
+			printf("Can't write %s, number of frames should be set, status %d\n", inputs[0].c_str(), sts);
+			return 1;
+		}
+		return 0;
+	}
+
+	std::vector<std::shared_ptr<TensorStream> > readers;
+	for (auto& input : inputs) {
+		auto reader = std::make_shared<TensorStream>();
+		reader->setLowLatency(lowLatency);
+		reader->setRTSPTransport(rtspTransport);
+		reader->setProbing(probeSize, analyzeDuration);
+		reader->setParametersCache(cacheParameters);
+		int sts = reader->initPipeline(input, (uint8_t)buffer, backend);
+		if (sts != VREADER_OK) {
+			printf("Can't initialize pipeline for %s, status %d\n", input.c_str(), sts);
+			return 1;
+		}
+		if (!captureName.empty()) {
+			std::string fileName = inputs.size() > 1 ? captureName + "." + std::to_string(readers.size()) : captureName;
+			sts = reader->startCapture(fileName);
+			if (sts != VREADER_OK) {
+				printf("Can't write capture to %s, status %d\n", fileName.c_str(), sts);
+				return 1;
+			}
+		}
+		if (prefetch > 0)
+			reader->enablePrefetch(prefetch);
+		reader->setRealTime(realTime);
+		readers.push_back(reader);
+	}
+
+	std::vector<std::shared_ptr<ConsumerResult> > results;
+	std::vector<std::thread> pipelines;
+	std::vector<std::thread> threads;
+	double cpuStart = getCPUTime();
+	auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < (int)readers.size(); i++) {
+		pipelines.push_back(std::thread(&TensorStream::startProcessing, readers[i].get()));
+		for (int j = 0; j < consumers; j++) {
+			auto result = std::make_shared<ConsumerResult>();
+			result->stream = inputs[i];
+			result->name = std::string("consumer") + std::to_string(j);
+			result->spec = specs[j % specs.size()];
+			results.push_back(result);
+			threads.push_back(std::thread(consume, readers[i].get(), result.get(), frames));
+		}
+	}
+	if (duration > 0) {
+		auto end = start + std::chrono::microseconds((int64_t)(duration * 1e6));
+		//consumers stop by themselves when streams end, so waiting is interrupted if all of them are done
+		while (std::chrono::steady_clock::now() < end) {
+			bool working = false;
+			for (auto& result : results)
+				working |= !result->finished;
+			if (!working)
+				break;
+			std::this_thread::sleep_for(std::chrono::milliseconds(10));
+		}
+		stopConsumers = true;
+	}
+	for (auto& thread : threads)
+		thread.join();
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	double cpu = getCPUTime() - cpuStart;
+
+	std::vector<std::map<std::string, double> > streamStats;
+	for (int i = 0; i < (int)readers.size(); i++) {
+		auto stats = readers[i]->getStats();
+		streamStats.push_back(stats);
+		for (int j = 0; j < consumers; j++) {
+			auto& result = results[i * consumers + j];
+			result->skipped = stats["consumer." + result->name + ".skipped"];
+			result->dropped = stats["consumer." + result->name + ".dropped"];
+		}
+		readers[i]->endProcessing(HARD);
+		pipelines[i].join();
+	}
+
+	auto name = [](FourCC format) {
+		for (auto& item : formats)
+			if (item.second == format)
+				return item.first;
+		return std::string("unknown");
+	};
+	printf("%-24s %-10s %-14s %-10s %6s %8s %8s %9s %9s %9s %8s %8s\n", "stream", "consumer", "format", "size", "delay", "frames", "fps",
+		"p50 ms", "p99 ms", "max ms", "skipped", "dropped");
+	for (auto& result : results) {
+		std::string stream = result->stream.size() > 24 ? result->stream.substr(result->stream.size() - 24) : result->stream;
+		std::string size = std::to_string(result->spec.width) + "x" + std::to_string(result->spec.height);
+		printf("%-24s %-10s %-14s %-10s %6d %8llu %8.2f %9.3f %9.3f %9.3f %8.0f %8.0f\n", stream.c_str(), result->name.c_str(),
+			name(result->spec.format).c_str(), size.c_str(), result->spec.delay, (unsigned long long)result->frames,
+			result->seconds > 0 ? result->frames / result->seconds : 0, result->latency.percentile(50) / 1e6, result->latency.percentile(99) / 1e6,
+			result->latency.getMax() / 1e6, result->skipped, result->dropped);
+	}
+	//frame age is measured from packet arrival till conversion, glass-to-tensor from capture time set by producer
+	printf("\n%-24s %12s %12s %12s %12s\n", "stream", "age p50 ms", "age p99 ms", "g2t p50 ms", "g2t p99 ms");
+	for (int i = 0; i < (int)readers.size(); i++) {
+		auto& stats = streamStats[i];
+		std::string stream = inputs[i].size() > 24 ? inputs[i].substr(inputs[i].size() - 24) : inputs[i];
+		printf("%-24s %12.3f %12.3f", stream.c_str(), stats["frame_age.p50_ms"], stats["frame_age.p99_ms"]);
+		if (stats["glass_to_tensor.count"] > 0)
+			printf(" %12.3f %12.3f\n", stats["glass_to_tensor.p50_ms"], stats["glass_to_tensor.p99_ms"]);
+		else
+			printf(" %12s %12s\n", "-", "-");
+	}
+	printf("\n%-24s %10s %10s %10s %10s %10s %7s\n", "stream", "open ms", "probe ms", "decoder ms", "vpp ms", "first ms", "cached");
+	for (int i = 0; i < (int)readers.size(); i++) {
+		auto& stats = streamStats[i];
+		std::string stream = inputs[i].size() > 24 ? inputs[i].substr(inputs[i].size() - 24) : inputs[i];
+		printf("%-24s %10.3f %10.3f %10.3f %10.3f", stream.c_str(), stats["startup.open_ms"], stats["startup.probe_ms"],
+			stats["startup.decoder_ms"], stats["startup.vpp_ms"]);
+		//stream could end or be stopped before the first frame is decoded
+		if (stats.count("startup.first_frame_ms"))
+			printf(" %10.3f", stats["startup.first_frame_ms"]);
+		else
+			printf(" %10s", "-");
+		printf(" %7s\n", stats["startup.cached"] ? "yes" : "no");
+	}
+	unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+	printf("Elapsed %.2f s, CPU time %.2f s, CPU usage %.1f%% of one core, %.1f%% of %u cores\n", seconds, cpu,
+		100 * cpu / seconds, 100 * cpu / seconds / cores, cores);
+	return 0;
+}
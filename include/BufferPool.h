@@ -0,0 +1,63 @@
+#pragma once
+#include <map>
+#include <vector>
+#include <mutex>
+#include <functional>
+#include <stdint.h>
+
+/*
+Counters of buffer pool, bytes are measured in bucket sizes
+*/
+struct BufferPoolStats {
+	//buffers requested from device and returned to device
+	uint64_t allocations = 0;
+	uint64_t releases = 0;
+	//requests served by cached buffers and by new allocations
+	uint64_t hits = 0;
+	uint64_t misses = 0;
+	size_t bytesInUse = 0;
+	size_t bytesCached = 0;
+	//high-water marks of bytes given to users and of bytes allocated from device (in use + cached)
+	size_t peakBytesInUse = 0;
+	size_t peakBytesAllocated = 0;
+};
+
+/*
+Output buffers of the same geometry are requested for every frame, so freed buffers are kept in size buckets and are given
+to the next request of the same bucket without allocation. Device memory is allocated and released via passed functions.
+Buckets are powers of two with 4 steps between them, so buffer is at most 25% bigger than requested.
+*/
+class BufferPool {
+public:
+	/*
+	limit is maximum size of cached (freed but not released) buffers in bytes, buffers which don't fit are released
+	*/
+	BufferPool(std::function<int(void**, size_t)> allocate, std::function<void(void*)> release, size_t limit = 512 << 20);
+	~BufferPool();
+	int Allocate(void** data, size_t size);
+	/*
+	Return buffer to pool, buffers which weren't allocated by pool are released directly
+	*/
+	int Free(void* data);
+	/*
+	Change limit of cached memory, cached buffers above new limit are released
+	*/
+	void setLimit(size_t limit);
+	BufferPoolStats getStats();
+	/*
+	Release all cached buffers, buffers which are in use are released when they are freed
+	*/
+	void Close();
+	static size_t getBucketSize(size_t size);
+private:
+	//should be called under sync
+	void trim();
+	std::function<int(void**, size_t)> allocate;
+	std::function<void(void*)> release;
+	size_t limit;
+	bool closed = false;
+	std::map<size_t, std::vector<void*> > cached;
+	std::map<void*, size_t> used;
+	BufferPoolStats stats;
+	std::mutex sync;
+};
@@ -8,6 +8,8 @@
 #include <fstream>
 #include <chrono>
 #include <thread>
+#include <atomic>
+#include "Trace.h"
 
 /** @addtogroup cppAPI
 @{ 
@@ -39,6 +41,32 @@ enum CloseLevel {
 	HARD = 1, /**< Close all opened handlers, free resources */
 	SOFT /**< Close all opened handlers except logs file handler, free resources */
 };
+
+/** Enum with devices which can be used for decoding and post-processing
+ @details Used in @ref TensorStream::initPipeline() function
+*/
+enum BackendType {
+	CUDA_BACKEND, /**< Hardware decoding and post-processing on GPU, output frames are placed in CUDA memory */
+	CPU_BACKEND /**< Software decoding and post-processing on CPU, output frames are placed in host memory */
+};
+
+/** Timing of frame from source to output, times are microseconds since Unix epoch (system clock), 0 means unknown
+ @details Used in @ref TensorStream::getTimestamps() function
+*/
+struct FrameTimestamps {
+	int64_t pts = 0; /**< Presentation timestamp of packet in stream time base, see @ref TensorStream::getInitializedParams(),
+		AV_NOPTS_VALUE if stream has no timestamps (e.g. raw H.264) */
+	int64_t dts = 0; /**< Decoding timestamp of packet in stream time base, AV_NOPTS_VALUE if unknown */
+	int64_t capture = 0; /**< Time frame was captured by producer, taken from H.264 SEI: user_data_unregistered with
+		@ref captureTimeUUID followed by 8 bytes of big-endian microseconds since epoch or pic_timing clock timestamp (UTC time of day) */
+	int64_t arrival = 0; /**< Time packet was read from stream */
+	int64_t decoded = 0; /**< Time frame was returned by decoder */
+	int64_t converted = 0; /**< Time conversion of frame for consumer was finished */
+};
+
+/** UUID of SEI user_data_unregistered message with capture time of frame, see @ref FrameTimestamps::capture
+*/
+const uint8_t captureTimeUUID[16] = { 0x6b, 0x4d, 0xe9, 0x4f, 0x34, 0x1d, 0x44, 0x67, 0x93, 0xc6, 0xd5, 0x4a, 0x7d, 0x57, 0x7f, 0x72 };
 /**
 @}
 */
@@ -63,59 +91,48 @@ enum CloseLevel {
 
 const std::string logFileName = "logs.txt";
 
+/*
+Microseconds since Unix epoch, the clock of FrameTimestamps, so it can be compared with capture time set by producer on other host
+*/
+int64_t wallClock();
+
 extern std::ofstream logsFile;
-extern LogsLevel logsLevel;
+extern std::atomic<LogsLevel> logsLevel;
 extern std::mutex logsMutex;
+/*
+Write message of calling thread to console (negative level) or to logs file, file is flushed when it's closed
+*/
+void writeLog(const std::string& message);
 
+/*
+Level is checked before message is built and before lock is taken, so disabled logs cost one atomic load
+*/
 #define LOG_VALUE(messageIn) \
 	{ \
-		std::unique_lock<std::mutex> locker(logsMutex); \
 		if (logsLevel) \
-		{ \
-			std::string finalMessage = messageIn + std::string("\n"); \
-			if (logsLevel < 0) \
-				std::cout << "TID: " << std::this_thread::get_id() << " " << finalMessage << std::flush; \
-			else if (logsFile.is_open()) \
-				logsFile << "TID: " << std::this_thread::get_id() << " " << finalMessage << std::flush; \
-		} \
+			writeLog(messageIn + std::string("\n")); \
 	} \
 
 #define START_LOG_FUNCTION(messageIn) \
 	{ \
 		std::chrono::high_resolution_clock::time_point startFunc; \
-		{ \
-			std::unique_lock<std::mutex> locker(logsMutex); \
-			if (logsLevel) \
-			{ \
-				std::string finalMessage = messageIn + std::string(" +\n"); \
-				if (logsLevel < 0) \
-					std::cout << "TID: " << std::this_thread::get_id() << " " << finalMessage << std::flush; \
-				else if (logsFile.is_open()) \
-					logsFile << "TID: " << std::this_thread::get_id() << " " << finalMessage << std::flush; \
-				if (std::abs(logsLevel) >= MEDIUM) \
-					startFunc = std::chrono::high_resolution_clock::now(); \
-			} \
+		if (logsLevel) { \
+			writeLog(messageIn + std::string(" +\n")); \
+			if (std::abs(logsLevel) >= MEDIUM) \
+				startFunc = std::chrono::high_resolution_clock::now(); \
 		} \
 
 #define END_LOG_FUNCTION(messageOut) \
-		{ \
-			std::unique_lock<std::mutex> locker(logsMutex); \
-			if (logsLevel) { \
-				std::string finalMessage; \
-				if (std::abs(logsLevel) >= MEDIUM) { \
-					int timeMs = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::high_resolution_clock::now() - startFunc).count(); \
-					std::string time = std::to_string(timeMs); \
-					if (timeMs > (realTimeDelay + realTimeDelay / 4)) { \
-						finalMessage = messageOut + std::string(" -\nWARNING: Function time: ") + time + std::string("ms\n\n"); \
-					} \
-					finalMessage = messageOut + std::string(" -\nFunction time: ") + time + std::string("ms\n\n"); \
-				} else { \
-					finalMessage = messageOut + std::string(" -\n\n"); \
-				} \
-				if (logsLevel < 0) \
-					std::cout << "TID: " << std::this_thread::get_id() << " " << finalMessage << std::flush; \
-				else if (logsFile.is_open()) \
-					logsFile << "TID: " << std::this_thread::get_id() << " " << finalMessage << std::flush; \
+		if (logsLevel) { \
+			if (std::abs(logsLevel) >= MEDIUM) { \
+				int timeMs = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::high_resolution_clock::now() - startFunc).count(); \
+				std::string time = std::to_string(timeMs); \
+				if (timeMs > (realTimeDelay + realTimeDelay / 4)) \
+					writeLog(messageOut + std::string(" -\nWARNING: Function time: ") + time + std::string("ms\n\n")); \
+				else \
+					writeLog(messageOut + std::string(" -\nFunction time: ") + time + std::string("ms\n\n")); \
+			} else { \
+				writeLog(messageOut + std::string(" -\n\n")); \
 			} \
 		} \
 	}
@@ -123,35 +140,35 @@ extern std::mutex logsMutex;
 #define START_LOG_BLOCK(messageIn) \
 	{ \
 		std::chrono::high_resolution_clock::time_point start; \
-		{ \
-			std::unique_lock<std::mutex> locker(logsMutex); \
-			if (std::abs(logsLevel) >= HIGH) \
-			{ \
-				std::string finalMessage = messageIn + std::string(" +\n"); \
-				if (logsLevel < 0) \
-					std::cout << "TID: " << std::this_thread::get_id() << " " << finalMessage << std::flush; \
-				else if (logsFile.is_open()) \
-					logsFile << "TID: " << std::this_thread::get_id() << " " << finalMessage << std::flush; \
-				start = std::chrono::high_resolution_clock::now(); \
-			} \
+		if (std::abs(logsLevel) >= HIGH) { \
+			writeLog(messageIn + std::string(" +\n")); \
+			start = std::chrono::high_resolution_clock::now(); \
 		} \
 
 #define END_LOG_BLOCK(messageOut) \
-		{ \
-			std::unique_lock<std::mutex> locker(logsMutex); \
-			if (std::abs(logsLevel) >= HIGH) { \
-				std::string finalMessage; \
-				std::string time = \
+		if (std::abs(logsLevel) >= HIGH) { \
+			std::string time = \
 				std::to_string(std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::high_resolution_clock::now() - start).count()); \
-				finalMessage = messageOut + std::string(" -\ntime: ") + time + std::string(" ms\n"); \
-				if (logsLevel < 0) \
-					std::cout << "TID: " << std::this_thread::get_id() << " " << finalMessage << std::flush; \
-				else if (logsFile.is_open()) \
-					logsFile << "TID: " << std::this_thread::get_id() << " " << finalMessage << std::flush; \
-			} \
+			writeLog(messageOut + std::string(" -\ntime: ") + time + std::string(" ms\n")); \
 		} \
 	}
 	
+/*
+Fixed-point coefficients of YUV -> RGB conversion for one color matrix and range, used by both backends:
+R = (Y * (Y - offsetY) + RV * (V - 128)) >> colorShift
+G = (Y * (Y - offsetY) - GV * (V - 128) - GU * (U - 128)) >> colorShift
+B = (Y * (Y - offsetY) + BU * (U - 128)) >> colorShift
+*/
+const int colorShift = 13;
+struct ColorCoefficients {
+	int offsetY;
+	int Y;
+	int RV;
+	int GV;
+	int GU;
+	int BU;
+};
+
 const int maxConsumers = 5;
 const int frameRateConstraints = 120;
 
@@ -5,25 +5,37 @@
 #include <mutex>
 #include <condition_variable>
 #include "Common.h"
+#include "DumpWriter.h"
+#include "Statistics.h"
 
 /*
 Structure with initialization/reset parameters.
 */
 struct DecoderParameters {
 	DecoderParameters(std::shared_ptr<Parser> _parser = nullptr,
-		bool _enableDumps = false, unsigned int _bufferDeep = 10) {
+		bool _enableDumps = false, unsigned int _bufferDeep = 10, BackendType _backend = CUDA_BACKEND) {
 		parser = _parser;
 		enableDumps = _enableDumps;
 		bufferDeep = _bufferDeep;
+		backend = _backend;
 	}
 
 	std::shared_ptr<Parser> parser;
 	bool enableDumps;
 	unsigned int bufferDeep;
+	/*
+	CUDA_BACKEND - hardware decoding to CUDA memory, CPU_BACKEND - software decoding to host memory
+	*/
+	BackendType backend;
+	/*
+	Frames are output as soon as they are decoded (AV_CODEC_FLAG_LOW_DELAY), decoder doesn't use frame threading which delays output
+	by number of threads. Delay needed to reorder B-frames is kept
+	*/
+	bool lowLatency = false;
 };
 
 /*
-The class takes input from reader, decode frames in NV12 format and return frames in (GPU) CUDA memory
+The class takes input from reader, decode frames in NV12 format and return frames in (GPU) CUDA memory or in host memory in case of software decoding
 */
 class Decoder {
 public:
@@ -35,16 +47,30 @@ public:
 
 	/*
 	Asynchronous call, start decoding process. Should be executed in different thread.
+	Timestamps of packet are passed to frame decoded from it, so they survive frames reordering.
+	Every frame decoder can return after the packet is put to buffer, AVERROR(EAGAIN) is returned if there is no such frame.
+	*/
+	int Decode(AVPacket* pkt, FrameTimestamps timestamps = FrameTimestamps());
+
+	/*
+	Put the next frame kept by decoder for reordering to buffer at the end of stream, one frame per call, so they can be paced as decoded ones.
+	AVERROR_EOF is returned after the last frame, decoder should be closed after it
 	*/
-	int Decode(AVPacket* pkt);
+	int Flush();
 
 	/*
 	Blocked call, returns whether already decoded frame from cache or latest decoded frame which hasn't been reported yet.
 	Arguments: 
 		int index: index of desired frame.
 			Return: bufferDepth + index - 1 index.
+		FrameTimestamps* timestamps: optional, timestamps of returned frame.
 	*/
-	int GetFrame(int index, std::string consumerName, AVFrame* outputFrame);
+	int GetFrame(int index, std::string consumerName, AVFrame* outputFrame, FrameTimestamps* timestamps = nullptr);
+
+	/*
+	Reference the latest decoded frame without changing state of consumers, returns index of frame or VREADER_REPEAT if nothing is decoded yet.
+	*/
+	int GetLatestFrame(AVFrame* outputFrame);
 
 	/*
 	Close all existing handles, deallocate recources.
@@ -53,24 +79,54 @@ public:
 	unsigned int getFrameIndex();
 	AVCodecContext* getDecoderContext();
 	int notifyConsumers();
+	/*
+	Copy of counters of every consumer which requested frames
+	*/
+	std::map<std::string, ConsumerStats> getConsumerStats();
 private:
+	/*
+	Copy decoded frame to host buffer of dump writer and queue it, frame is skipped if writer is overloaded
+	*/
+	int dumpFrame(AVFrame* frame);
+	/*
+	Receive every frame available in decoder and put them to buffer, number of frames is returned
+	*/
+	int receiveFrames();
+	/*
+	Put decoded frame to buffer and notify consumers
+	*/
+	int storeFrame(AVFrame* decodedFrame);
 	/*
 	It help understand whether allowed or not return frame. If some frame was reported to current consumer and no any new frames were decoded need to wait.
 	Parameters: Consumer's name and latest given frame number
 	*/
 	std::map<std::string, bool> consumerStatus;
 	/*
+	Counters of consumers and index of the latest decoded frame at the moment of the last request
+	*/
+	std::map<std::string, ConsumerStats> consumerStats;
+	std::map<std::string, unsigned int> consumerSeen;
+	/*
 	Buffer stores already decoded frames in CUDA memory (frame index can be found in container)
 	*/
 	std::vector<AVFrame* > framesBuffer;
 	/*
+	Timestamps of frames in buffer with the same indexes
+	*/
+	std::vector<FrameTimestamps> timestampsBuffer;
+	/*
+	Timestamps of packets sent to decoder, frames are returned in display order, so key of packet is passed through reordered_opaque
+	*/
+	std::map<int64_t, FrameTimestamps> pendingTimestamps;
+	int64_t packetNumber = 0;
+	/*
 	Index of latest decoded frame.
 	*/
 	unsigned int currentFrame = 0;
 	/*
-	The map with file descriptors for dumping intermediate frames.
+	Decoded frames are written to Decoded.y4m in background
 	*/
-	std::shared_ptr<FILE> dumpFrame;
+	std::shared_ptr<DumpWriter> dumps;
 	/*
 	Internal decoder's state
 	*/
@@ -90,4 +146,8 @@ private:
 	*/
 	bool isClosed = true;
 	bool isFinished = false;
+	/*
+	End of stream has been sent to decoder by Flush
+	*/
+	bool isDraining = false;
 };
\ No newline at end of file
@@ -0,0 +1,111 @@
+#pragma once
+#include <map>
+#include <queue>
+#include <vector>
+#include <string>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+Layout of dumped frame. Monochrome and YUV 4:2:0 frames are written as Y4M, so dumps can be played directly, chroma pairs of
+NV12 are split to U and V planes by writer. Other frames are written as raw rows
+*/
+enum DumpLayout {
+	DUMP_RAW,
+	DUMP_GRAY,
+	DUMP_NV12,
+	DUMP_I420
+};
+
+/*
+Frame in host buffer: rows of rowSize bytes are pitch bytes apart. NV12 has (height + 1) / 2 chroma rows of 2 * ((width + 1) / 2)
+bytes after luma rows, so pitch should fit them too, I420 is always dense.
+Width, height and frame rate are written to Y4M header
+*/
+struct DumpFormat {
+	DumpLayout layout = DUMP_RAW;
+	int width = 0;
+	int height = 0;
+	size_t rowSize = 0;
+	int rows = 0;
+	size_t pitch = 0;
+	int frameRateNum = 25;
+	int frameRateDen = 1;
+};
+
+/*
+Frames are copied by caller to pooled host buffers and are written to files by one background thread, so decoding and
+conversion aren't blocked by disk IO. Every file is opened by the first frame and is kept open until writer is destroyed.
+*/
+class DumpWriter {
+public:
+	/*
+	limit is maximum size of queued frames in bytes, frames which don't fit are dropped instead of blocking caller
+	*/
+	DumpWriter(size_t limit = 256 << 20);
+	/*
+	Queued frames are written before destruction
+	*/
+	~DumpWriter();
+	/*
+	Host buffer of size bytes, buffers of already written frames are reused. Empty buffer means that frame should be skipped.
+	Size of buffer is counted in queue limit from this moment, so buffer should be passed to Submit or Release and shouldn't be resized
+	*/
+	std::vector<uint8_t> Acquire(size_t size);
+	/*
+	Queue frame for writing to fileName. Y4M file keeps geometry of its first frame, frames of other geometry are dropped
+	*/
+	void Submit(const std::string& fileName, const DumpFormat& format, std::vector<uint8_t>&& buffer);
+	/*
+	Return acquired buffer which won't be submitted, e.g. if frame couldn't be copied
+	*/
+	void Release(std::vector<uint8_t>&& buffer);
+	/*
+	Wait until all queued frames are written and flushed to files
+	*/
+	void Flush();
+	uint64_t getWritten();
+	uint64_t getDropped();
+private:
+	struct Job {
+		std::string fileName;
+		DumpFormat format;
+		std::vector<uint8_t> buffer;
+	};
+	struct DumpFile {
+		std::shared_ptr<FILE> file;
+		DumpFormat format;
+	};
+	void writerLoop();
+	//is called by writer thread only
+	void write(Job& job);
+	size_t limit;
+	size_t queuedBytes = 0;
+	std::queue<Job> jobs;
+	//buffers of written frames
+	std::vector<std::vector<uint8_t> > buffers;
+	std::map<std::string, DumpFile> files;
+	//U and V planes of NV12 frame
+	std::vector<uint8_t> planesUV;
+	bool busy = false;
+	bool stop = false;
+	std::mutex sync;
+	std::condition_variable jobAdded;
+	std::condition_variable jobsDone;
+	std::atomic<uint64_t> written{ 0 };
+	std::atomic<uint64_t> dropped{ 0 };
+	/*
+	Declared last, so thread is started after other members are initialized
+	*/
+	std::thread writer;
+};
+
+/*
+Writer shared by all components which dump frames, it's created by the first user and is destroyed with the last one
+*/
+std::shared_ptr<DumpWriter> getDumpWriter();
@@ -0,0 +1,136 @@
+#pragma once
+#include <stdint.h>
+#include "Common.h"
+
+class ThreadPool;
+struct VPPPipeline;
+
+/*
+Host versions of kernels from Kernels.cu. Every function process the whole frame, allocation of output memory is done by caller.
+Color conversion uses the same fixed-point math as CUDA kernels, coefficients are passed by caller (see ColorCoefficients).
+Resize follows the same coordinates mapping as CUDA kernels. Bilinear resize is separable: at first two source rows are blended
+vertically, after that result row is interpolated horizontally. Filtered resize of pipeline goes in opposite order, so for downscale
+the vertical pass works with already narrowed rows.
+If pool is passed, frame is split to bands of rows which are processed in parallel. Band height is even, so every band
+contains whole chroma rows, and is chosen so input and output of band fit to half of L2 cache.
+*/
+void NV12ToRGB24CPU(uint8_t* Y, uint8_t* UV, uint8_t* RGB, int width, int height, int pitchNV12, int pitchRGB,
+	const ColorCoefficients& coefficients, ThreadPool* pool = nullptr);
+void NV12ToBGR24CPU(uint8_t* Y, uint8_t* UV, uint8_t* BGR, int width, int height, int pitchNV12, int pitchRGB,
+	const ColorCoefficients& coefficients, ThreadPool* pool = nullptr);
+void resizeNV12NearestCPU(uint8_t* inputY, uint8_t* inputUV, uint8_t* outputY, uint8_t* outputUV,
+	int srcWidth, int srcHeight, int srcLinesizeY, int srcLinesizeUV, int dstWidth, int dstHeight, float xRatio, float yRatio, ThreadPool* pool = nullptr);
+void resizeNV12BilinearCPU(uint8_t* inputY, uint8_t* inputUV, uint8_t* outputY, uint8_t* outputUV,
+	int srcWidth, int srcHeight, int srcLinesizeY, int srcLinesizeUV, int dstWidth, int dstHeight, float xRatio, float yRatio, ThreadPool* pool = nullptr);
+/*
+Fused crop, resize, color conversion, normalization and layout change described by pipeline, see VPPPipeline.h.
+Every band of output rows is produced from source frame directly, only a few rows of scratch memory are used.
+Output rows are outputPitch bytes apart, zero means dense rows of pipeline.getRowSize() bytes. NV12 and I420 output is always dense.
+*/
+void processPipelineCPU(const uint8_t* Y, const uint8_t* UV, int pitchY, int pitchUV, int srcWidth, void* output,
+	const VPPPipeline& pipeline, ThreadPool* pool = nullptr, size_t outputPitch = 0);
+/*
+Area downscale of converted image for pyramid levels: every output element is average of source elements covered by it with
+weights proportional to covered area. Element size is 1 (8 bit), 4 (float) or 2 (half), planar images have own plane for every
+channel. The same math as in downscaleAreaKernel.
+*/
+void downscaleAreaCPU(const void* src, int srcWidth, int srcHeight, void* dst, int dstWidth, int dstHeight, int channels, int elementSize,
+	bool planar, ThreadPool* pool = nullptr);
+/*
+Size of L2 cache in bytes reported by cpuid, 256KB if it can't be detected
+*/
+int getL2CacheSize();
+/*
+Number of rows in one band for rows of passed size (input + output), always even
+*/
+int getBandHeight(int bytesPerRow);
+
+/*
+Interpolation weights for bilinear resize are stored with 7 bits precision
+*/
+const int weightShift = 7;
+const int weightOne = 1 << weightShift;
+
+/*
+Instruction sets which have own version of row kernels
+*/
+enum CPUInstructionSet {
+	SCALAR,
+	SSE41,
+	AVX2,
+	AVX512
+};
+
+/*
+Table with row kernels for one instruction set. All versions give bit-exact output, scalar one is reference.
+Tables with source indexes and weights for resize are calculated once per frame in functions above.
+*/
+struct CPUKernels {
+	CPUInstructionSet instructionSet;
+	const char* name;
+	/*
+	Convert one row, UV contains chroma for every 2 pixels of row
+	*/
+	void(*NV12ToRGB24Row)(const uint8_t* Y, const uint8_t* UV, uint8_t* RGB, int width, const ColorCoefficients& coefficients);
+	void(*NV12ToBGR24Row)(const uint8_t* Y, const uint8_t* UV, uint8_t* BGR, int width, const ColorCoefficients& coefficients);
+	/*
+	dst[j] = src[xIndex[j]], xIndex is non-decreasing, srcWidth is used for avoiding reads out of source row
+	*/
+	void(*resizeNearestRow)(const uint8_t* src, uint8_t* dst, const int* xIndex, int dstWidth, int srcWidth);
+	/*
+	Resize of interleaved UV row, xIndex and width are measured in UV pairs
+	*/
+	void(*resizeNearestRowUV)(const uint8_t* src, uint8_t* dst, const int* xIndex, int dstWidth, int srcWidth);
+	/*
+	dst[j] = (row0[j] * (weightOne - weight) + row1[j] * weight + weightOne / 2) >> weightShift
+	*/
+	void(*blendRows)(const uint8_t* row0, const uint8_t* row1, uint8_t* dst, int width, int weight);
+	/*
+	dst[j] = (src[xIndex[j]] * (weightOne - xWeight[j]) + src[xIndex[j] + 1] * xWeight[j] + weightOne / 2) >> weightShift
+	*/
+	void(*resizeBilinearRow)(const uint8_t* src, uint8_t* dst, const int* xIndex, const int* xWeight, int dstWidth, int srcWidth);
+	void(*resizeBilinearRowUV)(const uint8_t* src, uint8_t* dst, const int* xIndex, const int* xWeight, int dstWidth, int srcWidth);
+	/*
+	Horizontal pass of separable filter (see FilterTable), channels are interleaved:
+	dst[j * channels + c] = (sum of src[(index[j] + t) * channels + c] * weights[j * taps + t] + round) >> (filterShift - intermediateShift)
+	Positions of taps are irregular, so this pass is scalar in all tables
+	*/
+	void(*filterRow)(const uint8_t* src, int16_t* dst, const int* index, const int16_t* weights, int taps, int dstWidth, int channels);
+	/*
+	Vertical pass of separable filter: dst[j] = clamp((sum of rows[t][j] * weights[t] + round) >> (filterShift + intermediateShift))
+	*/
+	void(*filterColumns)(const int16_t* const* rows, const int16_t* weights, int taps, uint8_t* dst, int width);
+};
+
+/*
+Kernels for the best instruction set supported by current CPU, detected via cpuid once at startup
+*/
+const CPUKernels& getCPUKernels();
+/*
+Kernels for requested instruction set or nullptr if it isn't supported by CPU or compiler
+*/
+const CPUKernels* getCPUKernels(CPUInstructionSet instructionSet);
+
+/*
+Scalar reference row kernels, are also used by vectorized versions for row tails
+*/
+void NV12ToRGB24RowScalar(const uint8_t* Y, const uint8_t* UV, uint8_t* RGB, int width, const ColorCoefficients& coefficients);
+void NV12ToBGR24RowScalar(const uint8_t* Y, const uint8_t* UV, uint8_t* BGR, int width, const ColorCoefficients& coefficients);
+void resizeNearestRowScalar(const uint8_t* src, uint8_t* dst, const int* xIndex, int dstWidth, int srcWidth);
+void resizeNearestRowUVScalar(const uint8_t* src, uint8_t* dst, const int* xIndex, int dstWidth, int srcWidth);
+void blendRowsScalar(const uint8_t* row0, const uint8_t* row1, uint8_t* dst, int width, int weight);
+void resizeBilinearRowScalar(const uint8_t* src, uint8_t* dst, const int* xIndex, const int* xWeight, int dstWidth, int srcWidth);
+void resizeBilinearRowUVScalar(const uint8_t* src, uint8_t* dst, const int* xIndex, const int* xWeight, int dstWidth, int srcWidth);
+void filterRowScalar(const uint8_t* src, int16_t* dst, const int* index, const int16_t* weights, int taps, int dstWidth, int channels);
+void filterColumnsScalar(const int16_t* const* rows, const int16_t* weights, int taps, uint8_t* dst, int width);
+/*
+The same as filterColumnsScalar for columns [start, end), tails of vectorized versions can't shift row pointers
+*/
+void filterColumnsRange(const int16_t* const* rows, const int16_t* weights, int taps, uint8_t* dst, int start, int end);
+
+/*
+Vectorized row kernels, defined in KernelsCPU_<instruction set>.cpp
+*/
+extern const CPUKernels kernelsSSE41;
+extern const CPUKernels kernelsAVX2;
+extern const CPUKernels kernelsAVX512;
@@ -0,0 +1,29 @@
+#pragma once
+#include <string>
+#include <thread>
+#include <atomic>
+#include <functional>
+
+/*
+Minimal HTTP server on loopback interface which answers every request with text returned by callback, so metrics can be scraped
+by Prometheus. Connections are handled one by one by background thread
+*/
+class MetricsServer {
+public:
+	MetricsServer(std::function<std::string()> render);
+	~MetricsServer();
+	/*
+	Listen on 127.0.0.1:port, port 0 means any free port, see getPort
+	*/
+	int Start(int port);
+	void Stop();
+	int getPort();
+private:
+	void serverLoop();
+	std::function<std::string()> render;
+	//socket handle, SOCKET on Windows
+	intptr_t listener = -1;
+	int port = 0;
+	std::atomic<bool> stop{ false };
+	std::thread server;
+};
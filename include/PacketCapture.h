@@ -0,0 +1,113 @@
+#pragma once
+#include "Common.h"
+#include <string>
+#include <vector>
+#include <memory>
+#include <stdio.h>
+
+extern "C"
+{
+#include <libavformat/avformat.h>
+}
+
+/*
+Capture file is header followed by records, every record is PacketRecord followed by packet data padded to 8 bytes, so file can be
+memory-mapped and walked without parsing. Packets are stored in Annex B format with parameter sets before key frames, so captured
+stream can be probed by raw H.264 demuxer. Values are stored in native byte order
+*/
+const char captureMagic[8] = { 'T', 'S', 'C', 'A', 'P', 'T', 'U', 'R' };
+const uint32_t captureVersion = 1;
+
+struct CaptureHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t headerSize;
+	/*
+	Time base of PTS, DTS and duration of packets
+	*/
+	int32_t timeBaseNum;
+	int32_t timeBaseDen;
+	/*
+	Frame rate of source stream, zero if unknown
+	*/
+	int32_t frameRateNum;
+	int32_t frameRateDen;
+};
+
+struct PacketRecord {
+	/*
+	Arrival time in nanoseconds since arrival of the first packet
+	*/
+	int64_t arrival;
+	int64_t pts;
+	int64_t dts;
+	int64_t duration;
+	uint32_t size;
+	uint32_t flags;
+};
+
+/*
+Writes packets read from stream to capture file
+*/
+class CaptureWriter {
+public:
+	~CaptureWriter();
+	/*
+	Create capture file for packets of stream, extradata of stream is used to convert length-prefixed packets to Annex B
+	*/
+	int Open(const std::string& fileName, AVStream* stream);
+	/*
+	Append packet, arrival is time in nanoseconds from any monotonic clock
+	*/
+	int Write(AVPacket* packet, int64_t arrival);
+	void Close();
+	uint64_t getPacketsWritten();
+private:
+	std::shared_ptr<FILE> file;
+	//size of NAL unit length in packets, 0 if packets are already in Annex B
+	int lengthSize = 0;
+	std::vector<uint8_t> parameterSets;
+	std::vector<uint8_t> converted;
+	int64_t firstArrival = -1;
+	uint64_t written = 0;
+};
+
+/*
+Read-only view of memory-mapped capture file
+*/
+class CaptureReader {
+public:
+	~CaptureReader();
+	int Open(const std::string& fileName);
+	void Close();
+	const CaptureHeader& getHeader();
+	/*
+	Offset of the first record
+	*/
+	size_t getFirstRecord();
+	/*
+	Get record at offset and move offset to the next record, VREADER_REPEAT is returned after the last record
+	*/
+	int Next(size_t& offset, PacketRecord& record, const uint8_t*& data);
+	/*
+	Copy packets data as continuous byte stream, used for probing of stream parameters. Returns number of copied bytes, 0 at the end
+	*/
+	int Read(uint8_t* buffer, int size);
+	/*
+	Check whether path is replay URL and parse path to capture file and replay speed from it:
+	replay://path/to/file.tscap?speed=2, speed 0 means as fast as possible
+	*/
+	static bool IsReplay(const std::string& path);
+	static int ParseURL(const std::string& url, std::string& fileName, float& speed);
+private:
+	const uint8_t* data = nullptr;
+	size_t size = 0;
+	CaptureHeader header;
+	size_t readOffset = 0;
+	const uint8_t* readData = nullptr;
+	size_t readLeft = 0;
+#ifdef _WIN32
+	void* file = nullptr;
+	void* mapping = nullptr;
+#endif
+};
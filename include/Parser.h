@@ -1,5 +1,7 @@
 #pragma once
 #include "Common.h"
+#include "SyntheticStream.h"
+#include "PacketCapture.h"
 #include <map>
 #include <vector>
 #include <memory>
@@ -19,10 +21,45 @@ struct ParserParameters {
 	}
 
 	/*
-	Path to input file, no matter where it's placed: remotely or locally.
+	Path to input file, no matter where it's placed: remotely or locally. Synthetic stream is generated in process
+	for synthetic:// URLs, see SyntheticParameters. Capture file is replayed with original packets timing for replay:// URLs,
+	see CaptureReader
 	*/
 	std::string inputFile;
 	bool enableDumps;
+	/*
+	Live profile: demuxer doesn't keep packets read while stream is probed and probing is limited to lowLatencyProbeSize bytes if probeSize
+	isn't set, so the first returned packets are the latest ones instead of probed seconds of stream
+	*/
+	bool lowLatency = false;
+	/*
+	Limits of stream probing: number of read bytes and duration of analyzed stream in microseconds, 0 means FFmpeg defaults (5 MB and 5 s)
+	*/
+	int64_t probeSize = 0;
+	int64_t analyzeDuration = 0;
+	/*
+	Codec parameters and extradata found by probing are kept in process for every input, the next opens of the same input take them
+	from cache and skip probing if demuxer has found video stream in header (raw H.264, RTSP, MP4), see Parser::ClearParametersCache
+	*/
+	bool cacheParameters = false;
+	/*
+	Lower transport of RTSP: "tcp", "udp", "udp_multicast" or "http", empty string means FFmpeg default (UDP with fallback to TCP)
+	*/
+	std::string rtspTransport = "tcp";
+};
+
+const int lowLatencyProbeSize = 32768;
+
+/*
+Durations of parser startup phases in nanoseconds: opening of input (connection and stream header) and probing of stream parameters
+*/
+struct ParserStartup {
+	int64_t open = 0;
+	int64_t probe = 0;
+	/*
+	Stream parameters were taken from cache instead of probing
+	*/
+	bool cached = false;
 };
 
 class BitReader {
@@ -91,6 +128,24 @@ public:
 	*/
 	int Analyze(AVPacket* package);
 
+	/*
+	Record every read packet with its arrival time to capture file, should be called after Init and before reading
+	*/
+	int EnableCapture(std::string fileName);
+	/*
+	Packets are released with timing of capture file, so no additional delay is needed for real-time processing
+	*/
+	bool isReplay();
+	/*
+	PTS, DTS and arrival time of the last read packet and capture time found in it by Analyze
+	*/
+	FrameTimestamps getTimestamps();
+	ParserStartup getStartup();
+	/*
+	Remove cached parameters of all inputs, should be called if stream parameters of source are changed
+	*/
+	static void ClearParametersCache();
+
 	/*
 	Soft re-init of current Parser entity with new parameters.
 	*/
@@ -153,4 +208,44 @@ private:
 	*/
 	AVBitStreamFilterContext* bitstreamFilter;
 	std::shared_ptr<AVPacket> NALu;
+	/*
+	Source of synthetic stream, it's read by FFmpeg through custom IO context instead of file
+	*/
+	std::shared_ptr<SyntheticStream> synthetic;
+	/*
+	Replayed capture, offset of the next record and time when the first packet was released
+	*/
+	std::shared_ptr<CaptureReader> replay;
+	size_t replayOffset = 0;
+	float replaySpeed = 1;
+	int64_t replayStart = -1;
+	int readReplay(AVPacket* packet);
+	std::shared_ptr<CaptureWriter> capture;
+	/*
+	Timestamps of the last read packet
+	*/
+	FrameTimestamps timestamps;
+	ParserStartup startup;
+	bool applyCachedParameters();
+	void storeParameters();
+	/*
+	Fields of SPS needed to parse pic_timing SEI with defaults used if HRD parameters aren't present and the last clock timestamp,
+	missing fields of partial timestamps are taken from it
+	*/
+	struct PictureTiming {
+		bool delaysPresent = false;
+		int cpbRemovalDelayLength = 24;
+		int dpbOutputDelayLength = 24;
+		int timeOffsetLength = 24;
+		bool picStructPresent = false;
+		uint32_t numUnitsInTick = 0;
+		uint32_t timeScale = 0;
+		int hours = 0;
+		int minutes = 0;
+		int seconds = 0;
+	} timing;
+	void parseTiming(BitReader& reader);
+	void parseHRD(BitReader& reader);
+	void parseSEI(const std::vector<uint8_t>& payload);
+	void parsePictureTiming(BitReader& reader);
 };
\ No newline at end of file
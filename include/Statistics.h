@@ -0,0 +1,181 @@
+#pragma once
+#include <vector>
+#include <map>
+#include <set>
+#include <string>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <stdint.h>
+#include "BufferPool.h"
+
+/*
+Durations of the last samples in milliseconds, percentiles are calculated on request, so adding of sample is cheap
+*/
+class LatencyWindow {
+public:
+	LatencyWindow(int size = 1000);
+	void add(float value);
+	/*
+	Value below which percent of samples fall (nearest rank), 0 if there are no samples
+	*/
+	float percentile(float percent);
+	int getSamplesNumber();
+private:
+	std::vector<float> samples;
+	int size;
+	int next = 0;
+	std::mutex sync;
+};
+
+/*
+Histogram of durations in nanoseconds for the whole session. Buckets are HDR-style: exact values below 64 ns, then 32 linear
+buckets for every power of two, so relative error is about 3%. Values above 2^36 ns (~68 s) are counted in the last bucket.
+Adding of sample is a few relaxed atomic operations without locks
+*/
+class LatencyHistogram {
+public:
+	LatencyHistogram();
+	void add(int64_t value);
+	/*
+	Upper bound of bucket which contains value below which percent of samples fall, 0 if there are no samples
+	*/
+	uint64_t percentile(float percent);
+	/*
+	Number of samples not greater than bound, bound is rounded to bucket boundary
+	*/
+	uint64_t countBelow(uint64_t bound);
+	uint64_t getCount();
+	uint64_t getSum();
+	uint64_t getMax();
+	static int getBucket(uint64_t value);
+	static uint64_t getUpperBound(int bucket);
+private:
+	static const int significantBits = 6;
+	static const int maxBits = 36;
+	static const int bucketsNumber = (1 << significantBits) + (maxBits - significantBits) * (1 << (significantBits - 1));
+	std::atomic<uint64_t> counts[bucketsNumber];
+	std::atomic<uint64_t> count{ 0 };
+	std::atomic<uint64_t> sum{ 0 };
+	std::atomic<uint64_t> max{ 0 };
+};
+
+/*
+Per-consumer counters of decoder: delivered frames, decoded frames which consumer didn't take before newer frame was decoded (skipped)
+and requests which couldn't be served because requested frame isn't in decoder's buffer (dropped)
+*/
+struct ConsumerStats {
+	uint64_t delivered = 0;
+	uint64_t skipped = 0;
+	uint64_t dropped = 0;
+	/*
+	Decoded frames which consumer hasn't seen yet
+	*/
+	uint64_t lag = 0;
+};
+
+/*
+Durations of startup phases in nanoseconds, -1 while phase isn't finished: opening of input, probing of stream parameters, initialization
+of decoder and of post-processing and time from start of initialization till the first decoded frame. Is rewritten by every initialization
+*/
+struct StartupStats {
+	std::atomic<int64_t> open{ -1 };
+	std::atomic<int64_t> probe{ -1 };
+	std::atomic<int64_t> decoder{ -1 };
+	std::atomic<int64_t> vpp{ -1 };
+	std::atomic<int64_t> firstFrame{ -1 };
+	/*
+	Stream parameters were taken from cache instead of probing
+	*/
+	std::atomic<bool> cached{ false };
+	/*
+	Clear phases, start is traceClock() value when initialization begins
+	*/
+	void reset(int64_t start);
+	/*
+	Set time of the first decoded frame, later frames are ignored
+	*/
+	void addFrame(int64_t decoded);
+	/*
+	Phase names with durations of finished phases, in order of startup
+	*/
+	std::vector<std::pair<std::string, int64_t> > getPhases();
+private:
+	std::atomic<int64_t> start{ 0 };
+};
+
+/*
+Values owned by other components, are collected on request
+*/
+struct PipelineSnapshot {
+	uint64_t decodedFrames = 0;
+	int prefetchQueue = 0;
+	std::map<std::string, ConsumerStats> consumers;
+	BufferPoolStats pool;
+};
+
+/*
+Durations of pipeline stages and amount of read data, is updated by processing thread and consumers without locks
+*/
+struct PipelineStats {
+	LatencyHistogram read;
+	LatencyHistogram analyze;
+	LatencyHistogram decode;
+	LatencyHistogram convert;
+	/*
+	Time from packet arrival and from capture by producer till frame is converted for consumer
+	*/
+	LatencyHistogram frameAge;
+	LatencyHistogram glassToTensor;
+	std::atomic<uint64_t> packets{ 0 };
+	std::atomic<uint64_t> bytes{ 0 };
+	StartupStats startup;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	/*
+	Stage names with their histograms, in order of processing
+	*/
+	std::vector<std::pair<std::string, LatencyHistogram*> > getStages();
+	/*
+	Add age of converted frame, times are microseconds since epoch, 0 means unknown
+	*/
+	void addFrame(int64_t arrival, int64_t capture, int64_t converted);
+	/*
+	Average bitrate of read packets since start in bits per second
+	*/
+	double getBitrate();
+	/*
+	Flat map with "<stage>.count", "<stage>.mean_ms", "<stage>.p50_ms", "<stage>.p90_ms", "<stage>.p99_ms", "<stage>.p999_ms",
+	"<stage>.max_ms" values of every stage and of "frame_age" and "glass_to_tensor" latencies, "packets", "bytes", "bitrate_kbps", "decoded_frames", "prefetch_queue",
+	"consumer.<name>.delivered", "consumer.<name>.skipped", "consumer.<name>.dropped", "consumer.<name>.lag", "pool.<counter>"
+	values with the same names as in pool statistics, "startup.<phase>_ms" of finished startup phases and "startup.cached"
+	*/
+	std::map<std::string, double> getValues(const PipelineSnapshot& snapshot);
+	/*
+	The same values in Prometheus text format, durations are histograms in seconds
+	*/
+	std::string getPrometheus(const PipelineSnapshot& snapshot);
+};
+
+/*
+Builder of Prometheus text exposition format (version 0.0.4). Samples of one metric should be added one after another,
+HELP and TYPE lines are written before the first sample of every metric
+*/
+class PrometheusWriter {
+public:
+	void counter(const std::string& name, const std::string& help, double value, const std::string& labels = "");
+	void gauge(const std::string& name, const std::string& help, double value, const std::string& labels = "");
+	/*
+	Histogram in seconds with fixed buckets from 100 us to 10 s
+	*/
+	void histogram(const std::string& name, const std::string& help, LatencyHistogram& histogram, const std::string& labels = "");
+	/*
+	Label pair with value escaped as required by format
+	*/
+	static std::string label(const std::string& name, const std::string& value);
+	std::string str();
+private:
+	void describe(const std::string& name, const std::string& help, const std::string& type);
+	void sample(const std::string& name, const std::string& labels, double value);
+	std::string text;
+	std::set<std::string> described;
+};
@@ -0,0 +1,124 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <deque>
+#include <stdint.h>
+
+/*
+Parameters of synthetic H.264 stream, can be passed to parser as URL:
+synthetic://1280x720?fps=30&gop=30&bframes=2&slices=4&complexity=0.1&frames=300&seed=1&timestamps=1
+*/
+struct SyntheticParameters {
+	int width = 1280;
+	int height = 720;
+	int frameRateNum = 30;
+	int frameRateDen = 1;
+	/*
+	Distance between IDR frames, 0 means that only the first frame is IDR
+	*/
+	int idrInterval = 30;
+	/*
+	Number of B-frames between reference frames, B-frames aren't used as references
+	*/
+	int bFrames = 0;
+	int slices = 1;
+	/*
+	Part of macroblocks in [0, 1] which are updated in P and B frames, other macroblocks are skipped
+	*/
+	float complexity = 0.1f;
+	/*
+	Number of frames, 0 means endless stream
+	*/
+	int frames = 0;
+	uint32_t seed = 1;
+	/*
+	Every frame starts with SEI which contains time frame was produced, see FrameTimestamps::capture
+	*/
+	bool timestamps = false;
+};
+
+/*
+Writer of RBSP bits, emulation prevention bytes are inserted when NAL unit is finished
+*/
+class BitWriter {
+public:
+	void PutBits(uint32_t value, int number);
+	void PutGolomb(uint32_t value);
+	void PutSignedGolomb(int32_t value);
+	/*
+	Pad with zero bits to byte boundary
+	*/
+	void Align();
+	void PutTrailingBits();
+	/*
+	Append bytes, writer should be byte aligned
+	*/
+	void PutBytes(const uint8_t* data, int size);
+	/*
+	Append NAL unit in Annex B format with start code to output and clear writer
+	*/
+	void WriteNAL(int refIdc, int type, std::vector<uint8_t>& output);
+	int getBitsNumber();
+private:
+	std::vector<uint8_t> bytes;
+	uint32_t current = 0;
+	int currentBits = 0;
+};
+
+/*
+Deterministic Annex B H.264 stream without encoder: intra macroblocks are coded as I_PCM and not updated macroblocks of P and B frames
+are skipped, so bitstream is produced at memory speed. Frames are produced in decoding order
+*/
+class SyntheticStream {
+public:
+	int Init(const SyntheticParameters& parameters);
+	/*
+	Append next access unit to output, returns VREADER_REPEAT after the last frame
+	*/
+	int Next(std::vector<uint8_t>& output);
+	/*
+	Copy next bytes of stream to buffer, returns number of copied bytes, 0 after the end of stream
+	*/
+	int Read(uint8_t* buffer, int size);
+	/*
+	Write the whole stream to file, stream shouldn't be endless
+	*/
+	int Write(const std::string& fileName);
+	SyntheticParameters getParameters();
+	int getFramesProduced();
+	/*
+	Check whether path is synthetic URL and parse parameters from it
+	*/
+	static bool IsSynthetic(const std::string& path);
+	static int ParseURL(const std::string& url, SyntheticParameters& parameters);
+private:
+	enum PictureType {
+		IDR,
+		P,
+		B
+	};
+	struct Picture {
+		int display;
+		PictureType type;
+	};
+	void planGroup();
+	void writeHeaders(std::vector<uint8_t>& output);
+	void writeSlice(const Picture& picture, int firstMB, int lastMB, std::vector<uint8_t>& output);
+	void writePCM(int mbX, int mbY, int display);
+	void writeTimestamp(std::vector<uint8_t>& output);
+	bool isUpdated(int mb, int display);
+	SyntheticParameters parameters;
+	int widthMBs = 0;
+	int heightMBs = 0;
+	std::deque<Picture> pending;
+	int nextDisplay = 0;
+	int lastIDR = 0;
+	int idrNumber = 0;
+	int prevRefFrameNum = 0;
+	int frameNum = 0;
+	int produced = 0;
+	BitWriter writer;
+	std::vector<uint8_t> samples;
+	std::vector<uint8_t> buffered;
+	size_t bufferedOffset = 0;
+};
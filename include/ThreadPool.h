@@ -0,0 +1,53 @@
+#pragma once
+#include <vector>
+#include <memory>
+#include <queue>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+/*
+Fixed set of worker threads shared between all consumers. Work is submitted as a number of independent tasks,
+caller is blocked until all of them are finished.
+*/
+class ThreadPool {
+public:
+	/*
+	threads = 0 means number of hardware threads
+	*/
+	ThreadPool(int threads = 0);
+	~ThreadPool();
+	/*
+	Execute task(index) for every index in [0, count), caller thread also takes part in execution
+	*/
+	void parallelFor(int count, const std::function<void(int)>& task);
+	/*
+	Queue task for execution by worker thread without waiting for it, tasks which aren't started before pool destruction are dropped.
+	If pool has no workers task is executed by caller
+	*/
+	void submit(std::function<void()> task);
+	int getThreadsNumber();
+	/*
+	Number of queued jobs, job is removed from queue when its last task is taken
+	*/
+	int getQueuedJobs();
+private:
+	struct Job {
+		const std::function<void(int)>* task;
+		//submitted tasks are owned by job, nobody waits for them
+		std::function<void(int)> ownedTask;
+		int count;
+		int next = 0;
+		int finished = 0;
+	};
+	void workerLoop();
+	//take next index of job and execute it, return false if there is no more indexes
+	bool runNext(std::shared_ptr<Job> job, std::unique_lock<std::mutex>& locker);
+	std::vector<std::thread> workers;
+	std::queue<std::shared_ptr<Job> > jobs;
+	std::mutex jobsSync;
+	std::condition_variable jobAdded;
+	std::condition_variable jobFinished;
+	bool stop = false;
+};
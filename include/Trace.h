@@ -0,0 +1,92 @@
+#pragma once
+#include <atomic>
+#include <string>
+#include <stdint.h>
+
+/*
+Spans up to this level are compiled in, levels are the same as in LogsLevel: 1 (LOW) - read, analyze, decode and frame requests,
+2 (MEDIUM) - conversions, 3 (HIGH) - internal stages. 0 removes all tracing code
+*/
+#ifndef TRACE_LEVEL
+#define TRACE_LEVEL 3
+#endif
+
+/*
+Finished span, time is measured in nanoseconds from process start. Consumer name is truncated
+*/
+struct TraceEvent {
+	const char* name;
+	int64_t start;
+	int64_t end;
+	int frame;
+	char consumer[16];
+};
+
+/*
+Spans with level above this one are skipped at runtime, 0 disables tracing
+*/
+extern std::atomic<int> traceLevel;
+
+/*
+Set runtime level, events recorded before enabling aren't exported
+*/
+void enableTracing(int level);
+int64_t traceClock();
+/*
+Store span which started at start and ends now to ring of calling thread. Every thread has own ring of the last events,
+so recording takes no locks, the oldest events are overwritten
+*/
+void traceEvent(const char* name, int64_t start, int frame, const char* consumer);
+/*
+Name of calling thread in exported trace
+*/
+void setTraceThreadName(const char* name);
+/*
+Write events of all threads as Chrome trace JSON, can be opened in chrome://tracing or ui.perfetto.dev. Can be called while
+other threads record events
+*/
+int exportTrace(const std::string& fileName);
+
+/*
+Span from construction till destruction, name should be string literal
+*/
+class TraceSpan {
+public:
+	TraceSpan(int level, const char* name, const char* consumer = "", int frame = -1) :
+		name(level <= traceLevel.load(std::memory_order_relaxed) ? name : nullptr), consumer(consumer), frame(frame) {
+		if (this->name)
+			start = traceClock();
+	}
+	TraceSpan(int level, const char* name, const std::string& consumer, int frame = -1) : TraceSpan(level, name, consumer.c_str(), frame) {
+	}
+	~TraceSpan() {
+		if (name)
+			traceEvent(name, start, frame, consumer);
+	}
+private:
+	const char* name;
+	const char* consumer;
+	int frame;
+	int64_t start = 0;
+};
+
+#define TRACE_CONCAT_IMPL(first, second) first##second
+#define TRACE_CONCAT(first, second) TRACE_CONCAT_IMPL(first, second)
+
+#if TRACE_LEVEL >= 1
+#define TRACE_SPAN_LOW(...) TraceSpan TRACE_CONCAT(traceSpan, __LINE__)(1, __VA_ARGS__)
+#else
+#define TRACE_SPAN_LOW(...)
+#endif
+
+#if TRACE_LEVEL >= 2
+#define TRACE_SPAN_MEDIUM(...) TraceSpan TRACE_CONCAT(traceSpan, __LINE__)(2, __VA_ARGS__)
+#else
+#define TRACE_SPAN_MEDIUM(...)
+#endif
+
+#if TRACE_LEVEL >= 3
+#define TRACE_SPAN_HIGH(...) TraceSpan TRACE_CONCAT(traceSpan, __LINE__)(3, __VA_ARGS__)
+#else
+#define TRACE_SPAN_HIGH(...)
+#endif
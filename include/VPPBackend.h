@@ -0,0 +1,152 @@
+#pragma once
+
+extern "C" {
+	#include <libavformat/avformat.h>
+}
+
+#include <memory>
+#include <vector>
+#include <string>
+#include <mutex>
+#include <map>
+#include <cuda_runtime.h>
+#include "Common.h"
+#include "VPPPipeline.h"
+#include "ThreadPool.h"
+#include "BufferPool.h"
+
+/*
+Copy of filter tables in device memory, order of tables is x, y, xUV, yUV as in ResizeFilter
+*/
+struct DeviceFilter {
+	int taps[4];
+	int* index[4];
+	int16_t* weights[4];
+};
+
+/*
+Device memory which is reused between frames, grows if bigger size is requested
+*/
+struct DeviceBuffer {
+	void* data;
+	size_t size;
+};
+
+/*
+Interface for device specific part of post-processing. Backend works only with frames placed in own memory (CUDA or host),
+output buffers are allocated by backend from its buffer pool and should be released via Free() of the same backend, so buffers
+are reused by next frames instead of allocation.
+Result of color conversion is stored to dst->opaque, result of resize is stored to dst->data[0] (Y) and dst->data[1] (UV).
+*/
+class VPPBackend {
+public:
+	virtual ~VPPBackend() {}
+	virtual int Init() = 0;
+	virtual int Allocate(void** data, size_t size) = 0;
+	virtual int Free(void* data) = 0;
+	BufferPoolStats getPoolStats() {
+		return buffers->getStats();
+	}
+	/*
+	Maximum size of freed buffers kept for reuse in bytes
+	*/
+	void setPoolLimit(size_t limit) {
+		buffers->setLimit(limit);
+	}
+	/*
+	Copy 2D region between two buffers placed in backend's memory
+	*/
+	virtual int Copy2D(void* dst, size_t dstPitch, void* src, size_t srcPitch, size_t width, size_t height) = 0;
+	/*
+	Copy buffer placed in backend's memory to host memory
+	*/
+	virtual int CopyToHost(void* dst, void* src, size_t size) = 0;
+	virtual int NV12ToRGB24(AVFrame* src, AVFrame* dst, const ColorCoefficients& coefficients, std::string consumerName) = 0;
+	virtual int NV12ToBGR24(AVFrame* src, AVFrame* dst, const ColorCoefficients& coefficients, std::string consumerName) = 0;
+	virtual int resizeNV12Nearest(AVFrame* src, AVFrame* dst, std::string consumerName) = 0;
+	virtual int resizeNV12Bilinear(AVFrame* src, AVFrame* dst, std::string consumerName) = 0;
+	/*
+	Execute all stages of compiled pipeline in one pass, result is stored to dst->opaque
+	*/
+	virtual int Process(AVFrame* src, AVFrame* dst, const VPPPipeline& pipeline, std::string consumerName) = 0;
+	/*
+	The same as Process but result is stored to memory owned by caller (backend's device memory or memory accessible by device)
+	with output rows pitch bytes apart. Output is ready when call returns
+	*/
+	virtual int ProcessInto(AVFrame* src, void* dst, size_t pitch, const VPPPipeline& pipeline, std::string consumerName) = 0;
+	/*
+	Area downscale of converted frame src->opaque to dst->width x dst->height for pyramid levels, result is stored to dst->opaque.
+	Layout and number of bytes per pixel (channels field) are kept
+	*/
+	virtual int Downscale(AVFrame* src, AVFrame* dst, int elementSize, bool planar, std::string consumerName) = 0;
+	virtual void Close() = 0;
+protected:
+	std::shared_ptr<BufferPool> buffers;
+};
+
+/*
+Backend executes kernels from Kernels.cu, every consumer has own CUDA stream.
+*/
+class VPPBackendCUDA : public VPPBackend {
+public:
+	int Init();
+	int Allocate(void** data, size_t size);
+	int Free(void* data);
+	int Copy2D(void* dst, size_t dstPitch, void* src, size_t srcPitch, size_t width, size_t height);
+	int CopyToHost(void* dst, void* src, size_t size);
+	int NV12ToRGB24(AVFrame* src, AVFrame* dst, const ColorCoefficients& coefficients, std::string consumerName);
+	int NV12ToBGR24(AVFrame* src, AVFrame* dst, const ColorCoefficients& coefficients, std::string consumerName);
+	int resizeNV12Nearest(AVFrame* src, AVFrame* dst, std::string consumerName);
+	int resizeNV12Bilinear(AVFrame* src, AVFrame* dst, std::string consumerName);
+	int Process(AVFrame* src, AVFrame* dst, const VPPPipeline& pipeline, std::string consumerName);
+	int ProcessInto(AVFrame* src, void* dst, size_t pitch, const VPPPipeline& pipeline, std::string consumerName);
+	int Downscale(AVFrame* src, AVFrame* dst, int elementSize, bool planar, std::string consumerName);
+	void Close();
+private:
+	cudaStream_t getStream(std::string consumerName);
+	int launchPipeline(AVFrame* src, void* output, size_t pitch, const VPPPipeline& pipeline, cudaStream_t stream, std::string consumerName);
+	/*
+	Tables of filter are uploaded once and are kept while filter is used by some pipeline
+	*/
+	int getFilter(std::shared_ptr<const ResizeFilter> filter, DeviceFilter& device);
+	cudaDeviceProp prop;
+	/*
+	Event recorded when buffer is returned to pool, buffer is given to next request only after all work queued before is finished
+	*/
+	std::map<void*, cudaEvent_t> fenceArr;
+	std::mutex fenceSync;
+	//own stream and buffer for intermediate rows of filtered resize for every consumer
+	std::vector<std::pair<std::string, cudaStream_t> > streamArr;
+	std::vector<std::pair<std::string, std::shared_ptr<DeviceBuffer> > > scratchArr;
+	std::mutex streamSync;
+	std::vector<std::pair<std::shared_ptr<const ResizeFilter>, DeviceFilter> > filterArr;
+	std::mutex filterSync;
+};
+
+/*
+Backend executes host versions of kernels from KernelsCPU.cpp, GPU isn't needed.
+Frames are split to bands of rows which are processed by thread pool shared between all consumers.
+*/
+class VPPBackendCPU : public VPPBackend {
+public:
+	/*
+	threads = 0 means number of hardware threads, threads = 1 disables parallel processing
+	*/
+	VPPBackendCPU(int _threads = 0);
+	int Init();
+	int Allocate(void** data, size_t size);
+	int Free(void* data);
+	int Copy2D(void* dst, size_t dstPitch, void* src, size_t srcPitch, size_t width, size_t height);
+	int CopyToHost(void* dst, void* src, size_t size);
+	int NV12ToRGB24(AVFrame* src, AVFrame* dst, const ColorCoefficients& coefficients, std::string consumerName);
+	int NV12ToBGR24(AVFrame* src, AVFrame* dst, const ColorCoefficients& coefficients, std::string consumerName);
+	int resizeNV12Nearest(AVFrame* src, AVFrame* dst, std::string consumerName);
+	int resizeNV12Bilinear(AVFrame* src, AVFrame* dst, std::string consumerName);
+	int Process(AVFrame* src, AVFrame* dst, const VPPPipeline& pipeline, std::string consumerName);
+	int ProcessInto(AVFrame* src, void* dst, size_t pitch, const VPPPipeline& pipeline, std::string consumerName);
+	int Downscale(AVFrame* src, AVFrame* dst, int elementSize, bool planar, std::string consumerName);
+	void Close();
+private:
+	int threads;
+	std::shared_ptr<ThreadPool> pool;
+};
@@ -0,0 +1,166 @@
+#pragma once
+#include <vector>
+#include <memory>
+#include <stdint.h>
+#include "Common.h"
+
+/*
+Type of output elements
+*/
+enum PixelType {
+	PIXEL_UINT8,
+	PIXEL_FLOAT32,
+	PIXEL_FLOAT16
+};
+
+/*
+HWC - channels of pixel are packed together, CHW - every channel is stored in own plane.
+NV12 and I420 - source YUV is only cropped and resized, chroma plane(s) follow luma plane
+*/
+enum PixelLayout {
+	LAYOUT_HWC,
+	LAYOUT_CHW,
+	LAYOUT_NV12,
+	LAYOUT_I420
+};
+
+/*
+Resize filters, nearest one uses index tables from pipeline, others are separable and use FilterTable for every axis
+*/
+enum FilterKernel {
+	FILTER_NEAREST,
+	FILTER_BILINEAR,
+	FILTER_AREA,
+	FILTER_BICUBIC
+};
+
+/*
+Filter weights are stored with 14 bits precision, horizontal pass keeps 6 fractional bits in int16 intermediate rows,
+vertical pass rounds result to 8 bits
+*/
+const int filterShift = 14;
+const int filterOne = 1 << filterShift;
+const int intermediateShift = 6;
+
+/*
+Coefficients of separable filter for one axis. Output element j is sum of weights[j * taps + t] * source[index[j] + t] for t in [0, taps),
+index is relative to start of crop rectangle and all taps are inside of source, so no border checks are needed during filtering.
+Source positions are measured from pixel centers: (j + 0.5) * srcSize / dstSize - 0.5.
+*/
+struct FilterTable {
+	int taps;
+	std::vector<int> index;
+	std::vector<int16_t> weights;
+
+	void init(FilterKernel kernel, int srcSize, int dstSize);
+};
+
+/*
+Tables for luma and chroma planes, chroma sizes are measured in UV pairs and chroma rows
+*/
+struct ResizeFilter {
+	FilterTable x;
+	FilterTable y;
+	FilterTable xUV;
+	FilterTable yUV;
+};
+
+/*
+Filter for resize of srcWidth x srcHeight crop to dstWidth x dstHeight, tables are built once for every combination of
+kernel and sizes and are shared between all consumers and frames
+*/
+std::shared_ptr<const ResizeFilter> getResizeFilter(FilterKernel kernel, int srcWidth, int srcHeight, int dstWidth, int dstHeight);
+
+/*
+Compiled description of all post-processing stages requested by one consumer:
+	crop -> resize -> color conversion -> type cast -> normalization -> layout
+Backends execute the whole chain in a single pass: every output pixel is read from source NV12 frame via resize tables,
+converted and written in final type and layout, so no intermediate frames are allocated.
+Pipeline is compiled by VideoProcessor once per consumer and is rebuilt only if parameters or source frame are changed.
+*/
+struct VPPPipeline {
+	/*
+	Crop rectangle in source frame, left and top are even so chroma pairs aren't split
+	*/
+	int cropX;
+	int cropY;
+	int cropWidth;
+	int cropHeight;
+	int dstWidth;
+	int dstHeight;
+	/*
+	Size of output frame, is bigger than dstWidth x dstHeight if letterbox or padding is requested. Image is placed at
+	(imageX, imageY), the rest of output is filled with padValue
+	*/
+	int outputWidth;
+	int outputHeight;
+	int imageX;
+	int imageY;
+	/*
+	Value of every channel in padded area, is already converted to output type and normalized
+	*/
+	float padValue[3];
+	/*
+	1 for monochrome output, 3 for RGB, positions of R and B inside of pixel are used only for 3 channels
+	*/
+	int channels;
+	int indexR;
+	int indexB;
+	ColorCoefficients coefficients;
+	PixelType type;
+	PixelLayout layout;
+	/*
+	Float output is value * scale[c] + offset[c], where value is 8 bit result of color conversion
+	*/
+	float scale[3];
+	float offset[3];
+	FilterKernel kernel;
+	/*
+	If output size is equal to crop size, source rows are read directly without resize tables
+	*/
+	bool resize;
+	float xRatio;
+	float yRatio;
+	/*
+	Absolute source coordinates for every output column and row, chroma coordinates are measured in UV pairs and chroma rows.
+	Coordinates are calculated the same way as in resize kernels, so output is bit-exact with resize + conversion.
+	*/
+	std::vector<int> xIndex;
+	std::vector<int> xIndexUV;
+	std::vector<int> yIndex;
+	std::vector<int> yIndexUV;
+	/*
+	Separable filter for all kernels except nearest, is set only if resize is needed
+	*/
+	std::shared_ptr<const ResizeFilter> filter;
+	/*
+	Normalized values for all 256 results of color conversion, table for every channel
+	*/
+	std::vector<float> normalizationTable;
+	/*
+	The same table converted to IEEE half precision bits
+	*/
+	std::vector<uint16_t> halfTable;
+
+	/*
+	Fill ratios and tables from crop, output size, resize kernel and normalization parameters
+	*/
+	void initTables();
+	int getElementSize() const;
+	/*
+	Bytes of one dense output row, every channel of CHW layout is stored as outputHeight such rows
+	*/
+	size_t getRowSize() const;
+	int getPlanes() const;
+	size_t getOutputSize() const;
+	/*
+	Size of horizontally filtered luma and chroma rows of the whole crop in bytes, is used by backends which filter frame at once
+	*/
+	size_t getIntermediateSize() const;
+};
+
+/*
+IEEE 754 half precision bits of value, rounding to nearest even as in __float2half_rn
+*/
+uint16_t floatToHalf(float value);
+float halfToFloat(uint16_t value);
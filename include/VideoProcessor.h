@@ -8,6 +8,13 @@ extern "C" {
 #include <vector>
 #include <cuda_runtime.h>
 #include <mutex>
+#include <atomic>
+#include <map>
+#include "Common.h"
+#include "VPPBackend.h"
+#include "VPPPipeline.h"
+#include "ThreadPool.h"
+#include "DumpWriter.h"
 
 /** @addtogroup cppAPI
 @{
@@ -19,7 +26,52 @@ extern "C" {
 enum FourCC {
 	Y800, /**< Monochrome format, 8 bit for pixel */
 	RGB24, /**< RGB format, 24 bit for pixel, color plane order: R, G, B */
-	BGR24 /**< RGB format, 24 bit for pixel, color plane order: B, G, R */
+	BGR24, /**< RGB format, 24 bit for pixel, color plane order: B, G, R */
+	RGB_PLANAR_F32, /**< Planar RGB format (CHW), 32 bit float for every value normalized with mean and std, plane order: R, G, B */
+	BGR_PLANAR_F32, /**< Planar RGB format (CHW), 32 bit float for every value normalized with mean and std, plane order: B, G, R */
+	RGB_PLANAR_F16, /**< Planar RGB format (CHW), 16 bit float for every value normalized with mean and std, plane order: R, G, B */
+	BGR_PLANAR_F16, /**< Planar RGB format (CHW), 16 bit float for every value normalized with mean and std, plane order: B, G, R */
+	NV12, /**< YUV 4:2:0, luma plane is followed by plane of interleaved U, V pairs, height * 3 / 2 rows of width bytes */
+	I420 /**< YUV 4:2:0, luma plane is followed by U and V planes of (width / 2) x (height / 2) bytes each */
+};
+
+/** Class with supported YUV to RGB conversion matrices
+ @details Used in @ref TensorStream::getFrame() function
+*/
+enum ColorMatrix {
+	MATRIX_AUTO, /**< Matrix is taken from decoded frame, BT.601 if frame doesn't specify it */
+	BT601, /**< ITU-R BT.601, SD content */
+	BT709, /**< ITU-R BT.709, HD content */
+	BT2020 /**< ITU-R BT.2020, UHD content */
+};
+
+/** Class with supported ranges of YUV values
+ @details Used in @ref TensorStream::getFrame() function
+*/
+enum ColorRange {
+	RANGE_AUTO, /**< Range is taken from decoded frame, limited if frame doesn't specify it */
+	LIMITED_RANGE, /**< Y in [16, 235], UV in [16, 240] */
+	FULL_RANGE /**< Y, UV in [0, 255] */
+};
+
+/** Class with supported resize algorithms
+ @details Used in @ref TensorStream::getFrame() function
+*/
+enum Interpolation {
+	NEAREST, /**< Nearest neighbour, the fastest one */
+	BILINEAR, /**< Bilinear interpolation of 2x2 source pixels */
+	AREA, /**< Average of source pixels covered by output pixel, recommended for big downscale, the same as bilinear for upscale */
+	BICUBIC /**< Bicubic interpolation of 4x4 source pixels */
+};
+
+/** Mapping from source frame coordinates to coordinates in output frame: output = source * scale + offset
+ @details Returned from @ref TensorStream::getFrame() function, so boxes found in output frame can be mapped back to source frame
+*/
+struct FrameTransform {
+	float scaleX; /**< Horizontal scale of resize */
+	float scaleY; /**< Vertical scale of resize */
+	float offsetX; /**< Horizontal shift, includes crop and letterbox offsets */
+	float offsetY; /**< Vertical shift, includes crop and letterbox offsets */
 };
 
 /**
@@ -33,35 +85,240 @@ struct VPPParameters {
 	unsigned int width;
 	unsigned int height;
 	FourCC dstFourCC;
+	//AUTO values are zero, so omitted fields in aggregate initialization mean "take from frame"
+	ColorMatrix matrix;
+	ColorRange range;
+	/*
+	Only for float formats: value = (8 bit value / 255 - mean[c]) / std[c], c is index of channel in output order.
+	Zero std is treated as 1, so by default values are in [0, 1]
+	*/
+	float mean[3];
+	float std[3];
+	/*
+	If more than 1, width and height of output are rounded up to multiple of this value, padded area is filled with zeros
+	*/
+	unsigned int padMultiple;
+	Interpolation interpolation;
+	/*
+	Region of source frame which is converted, zero width or height means up to right or bottom edge of frame.
+	Left and top are rounded down to even values, so chroma pairs aren't split
+	*/
+	unsigned int cropX;
+	unsigned int cropY;
+	unsigned int cropWidth;
+	unsigned int cropHeight;
+	/*
+	Keep aspect ratio of crop: image is resized to fit width x height and is centered, area around is filled with padColor.
+	Pad color is 8 bit value in output channels order, it's normalized in the same way as image for float formats
+	*/
+	bool letterbox;
+	unsigned char padColor[3];
+	/*
+	Y800 and NV12 output which doesn't need resize or padding can be returned as read-only view of decoded frame instead of copy.
+	View has row pitch (output linesize[0]) bigger than width and keeps decoded frame referenced until it's freed
+	*/
+	bool zeroCopy;
 };
 
-int NV12ToRGB24(AVFrame* src, AVFrame* dst, int maxThreadsPerBlock, cudaStream_t* stream);
-int NV12ToBGR24(AVFrame* src, AVFrame* dst, int maxThreadsPerBlock, cudaStream_t* stream);
+/*
+Size of output element and number of channels for supported formats, 0 for unsupported ones
+*/
+int getElementSize(FourCC format);
+int getChannels(FourCC format);
+
+/*
+Fixed-point multipliers for matrix and range, AUTO values should be resolved before.
+*/
+ColorCoefficients getColorCoefficients(ColorMatrix matrix, ColorRange range);
+
+/*
+Compile parameters requested by consumer for passed source frame to fused pipeline, AUTO values are resolved from frame.
+*/
+int compilePipeline(AVFrame* input, const VPPParameters& format, VPPPipeline& pipeline);
+/*
+Coordinates mapping done by compiled pipeline
+*/
+FrameTransform getTransform(const VPPPipeline& pipeline);
+
+/*
+Output memory is allocated by caller: output with rows outputPitch bytes apart for pipeline, dst->opaque for other conversions,
+dst->data[0] (Y) and dst->data[1] (UV) for resize.
+Filter and scratch buffer of getIntermediateSize() bytes are needed only if pipeline.filter is set
+*/
+int processPipeline(AVFrame* src, void* output, size_t outputPitch, const VPPPipeline& pipeline, const DeviceFilter* filter, void* scratch,
+	int maxThreadsPerBlock, cudaStream_t* stream);
+int uploadFilter(const ResizeFilter& filter, DeviceFilter& device);
+int downscaleArea(AVFrame* src, AVFrame* dst, int elementSize, bool planar, int maxThreadsPerBlock, cudaStream_t* stream);
+void freeFilter(DeviceFilter& device);
+int NV12ToRGB24(AVFrame* src, AVFrame* dst, const ColorCoefficients& coefficients, int maxThreadsPerBlock, cudaStream_t* stream);
+int NV12ToBGR24(AVFrame* src, AVFrame* dst, const ColorCoefficients& coefficients, int maxThreadsPerBlock, cudaStream_t* stream);
 int resizeNV12Nearest(AVFrame* src, AVFrame* dst, int maxThreadsPerBlock, cudaStream_t * stream);
 int resizeNV12Bilinear(AVFrame* src, AVFrame* dst, int maxThreadsPerBlock, cudaStream_t * stream);
 
 class VideoProcessor {
 public:
-	int Init(bool _enableDumps = false);
+	/*
+	Initialize VPP with corresponding backend, all conversions will be performed on backend's device.
+	*/
+	int Init(bool _enableDumps = false, BackendType _backend = CUDA_BACKEND);
 	/*
 	Check if VPP conversion for input package is needed and perform conversion.
-	Notice: VPP doesn't allocate memory for output frame, so correctly allocated Tensor with correct FourCC and resolution
-	should be passed via Python API	and this allocated CUDA memory will be filled.
+	All requested stages are executed by backend as one fused pass over output frame: source frame is read once and output
+	is written once. Output memory is allocated by backend and is stored to output->opaque.
+	If transform is passed, mapping from source to output coordinates is stored there.
+	Requests of several consumers for the same decoded frame with the same parameters are converted once and get the same
+	output memory, so output should be treated as read-only.
+	If format.zeroCopy is set and Y800 or NV12 output doesn't need resize or padding, output->opaque points to the decoded
+	frame itself with rows output->linesize[0] bytes apart (0 means dense output), the frame is leased until output is freed.
+	*/
+	int Convert(AVFrame* input, AVFrame* output, VPPParameters& format, std::string consumerName, FrameTransform* transform = nullptr);
+	/*
+	Convert frame to pyramid of outputs: outputs[0] is converted from source with format, every next level i is downscaled from
+	output of previous level to levels[i - 1] (width, height) with area averaging, so source frame is read once. Zero size means
+	half of previous level. All levels have the same pixel format, the whole previous output including letterbox and padding
+	is downscaled, so transforms of levels differ only by scale.
+	*/
+	int ConvertPyramid(AVFrame* input, std::vector<AVFrame*>& outputs, VPPParameters& format, const std::vector<std::pair<int, int> >& levels,
+		std::string consumerName, std::vector<FrameTransform>* transforms = nullptr);
+	/*
+	Convert frame to memory owned by caller: dst should be memory of backend's device (or accessible by it) with at least capacity
+	bytes, output rows are pitch bytes apart and every plane of planar formats has output height rows. Output is ready when call
+	returns. Output already converted for other consumer is copied, otherwise frame is converted to dst directly.
+	*/
+	int ConvertInto(AVFrame* input, void* dst, size_t pitch, size_t capacity, VPPParameters& format, std::string consumerName,
+		FrameTransform* transform = nullptr);
+	/*
+	Write output to dumpFile synchronously, dumps enabled in Init are written in background instead
 	*/
-	int Convert(AVFrame* input, AVFrame* output, VPPParameters& format, std::string consumerName);
 	int DumpFrame(AVFrame* output, std::shared_ptr<FILE> dumpFile);
+	/*
+	Release memory of converted frame, memory is placed on backend's device so should be released by the same backend.
+	Shared output is released after all consumers have freed it.
+	*/
+	int Free(void* data);
+	BackendType getBackendType();
+	/*
+	Number of Convert calls served from conversion cache and number of cacheable calls converted by backend
+	*/
+	uint64_t getCacheHits();
+	uint64_t getCacheMisses();
+	/*
+	Number of outputs returned as views of decoded frames
+	*/
+	uint64_t getViews();
+	/*
+	Start workers which convert decoded frames ahead of consumer requests with the last parameters used by every consumer.
+	Should be called before processing start
+	*/
+	int EnablePrefetch(int workers = 1);
+	/*
+	Queue conversion of just decoded frame for every consumer, results are stored to conversion cache so Convert of this frame
+	returns already converted output. Input frame isn't changed, consumer whose previous prefetch isn't finished yet is skipped
+	*/
+	int Prefetch(AVFrame* input);
+	/*
+	Number of conversions done ahead of consumer requests
+	*/
+	uint64_t getPrefetched();
+	/*
+	Number of prefetch conversions which are queued or running
+	*/
+	int getPrefetchQueue();
+	/*
+	Statistics of backend's output buffer pool and limit of memory kept for reuse in bytes
+	*/
+	BufferPoolStats getPoolStats();
+	void setPoolLimit(size_t limit);
 	void Close();
 private:
+	/*
+	If buffer is passed, output is stored there with rows pitch bytes apart instead of memory allocated by backend
+	*/
+	int ConvertFrame(AVFrame* input, AVFrame* output, VPPParameters& format, std::string consumerName, FrameTransform& transform,
+		void* buffer = nullptr, size_t pitch = 0, size_t capacity = 0);
+	/*
+	Point output to crop of input if no conversion is needed, reference to input is moved to lease
+	*/
+	bool createView(AVFrame* input, AVFrame* output, const VPPParameters& format, FrameTransform& transform);
+	/*
+	Drop entries whose source frame has left decoder's buffer, should be called under cacheSync
+	*/
+	void evictConversions();
+	/*
+	Copy output to host buffer of dump writer and queue it to Processed_<consumer> file, frame is skipped if writer is overloaded
+	*/
+	void dumpOutput(AVFrame* output, const std::string& consumerName);
 	bool enableDumps;
-	cudaDeviceProp prop;
-	//own stream for every consumer
-	std::vector<std::pair<std::string, cudaStream_t> > streamArr;
-	std::mutex streamSync;
-	//own dump file for every consumer
-	std::vector<std::pair<std::string, std::shared_ptr<FILE> > > dumpArr;
-	std::mutex dumpSync;
+	BackendType backendType;
+	std::shared_ptr<VPPBackend> backend;
+	std::shared_ptr<DumpWriter> dumps;
+	/*
+	Compiled pipeline for every consumer and the key it was compiled for
+	*/
+	struct ConsumerPipeline {
+		//consumer and its prefetch worker can use pipeline at the same time
+		std::mutex sync;
+		bool compiled = false;
+		VPPParameters format;
+		int srcWidth;
+		int srcHeight;
+		AVColorSpace colorspace;
+		AVColorRange colorRange;
+		VPPPipeline pipeline;
+	};
+	std::vector<std::pair<std::string, std::shared_ptr<ConsumerPipeline> > > pipelineArr;
+	std::mutex pipelineSync;
+	/*
+	Conversion of decoded frame with index frameIndex (stored by decoder to display_picture_number) shared between consumers.
+	Entry keeps reference to source frame, so it lives while the frame is in decoder's buffer. Output memory is released
+	when entry is evicted and all consumers have freed it.
+	*/
+	struct CachedConversion {
+		int frameIndex;
+		VPPParameters format;
+		AVFrame* source = nullptr;
+		//VREADER_REPEAT while conversion is in progress, sync is locked by converting consumer
+		int status = VREADER_REPEAT;
+		void* data = nullptr;
+		int width;
+		int height;
+		int channels;
+		int pixelFormat;
+		FrameTransform transform;
+		int references = 0;
+		bool evicted = false;
+		std::mutex sync;
+	};
+	std::vector<std::shared_ptr<CachedConversion> > cache;
+	std::mutex cacheSync;
+	std::atomic<uint64_t> cacheHits{ 0 };
+	std::atomic<uint64_t> cacheMisses{ 0 };
+	/*
+	Entry for frame and parameters which is converted or is being converted, should be called under cacheSync
+	*/
+	std::shared_ptr<CachedConversion> findConversion(int frameIndex, const VPPParameters& format);
+	/*
+	The last parameters of every consumer and whether its prefetch is in progress
+	*/
+	struct PrefetchRequest {
+		VPPParameters format;
+		bool pending = false;
+	};
+	std::map<std::string, PrefetchRequest> prefetchArr;
+	std::mutex prefetchSync;
+	std::atomic<uint64_t> prefetched{ 0 };
+	/*
+	Decoded frames returned as views, by output memory. Frame stays out of decoder's reuse until view is freed
+	*/
+	std::vector<std::pair<void*, AVFrame*> > leaseArr;
+	std::mutex leaseSync;
+	std::atomic<uint64_t> views{ 0 };
 	/*
 	State of component
 	*/
 	bool isClosed = true;
+	/*
+	Declared last, so workers are stopped before other members are destroyed
+	*/
+	std::shared_ptr<ThreadPool> prefetchPool;
 };
\ No newline at end of file
@@ -3,6 +3,8 @@
 #include "Parser.h"
 #include "Decoder.h"
 #include "VideoProcessor.h"
+#include "Statistics.h"
+#include "MetricsServer.h"
 /** @defgroup cppAPI C++ API
 @brief The list of TensorStream components can be used via C++ interface
 @details Here are all the classes, enums, functions described which can be used via C++ to do RTMP/local stream converting to CUDA memory with additional post-processing conversions
@@ -19,15 +21,107 @@ public:
  @anchor decoderBuffer
  @param[in] decoderBuffer How many decoded frames should be stored in internal buffer
  @warning decodedBuffer should be less than DPB
+ @param[in] backend Device used for decoding and post-processing, see @ref ::BackendType for supported values
  @return Status of execution, one of @ref ::Internal values
 */
-	int initPipeline(std::string inputFile, uint8_t decoderBuffer = 10);
+	int initPipeline(std::string inputFile, uint8_t decoderBuffer = 10, BackendType backend = CUDA_BACKEND);
 
 /** Get parameters from bitstream
- @return Map with "framerate_num", "framerate_den", "width", "height" values
+ @return Map with "framerate_num", "framerate_den", "width", "height", "timebase_num" and "timebase_den" (time base of PTS and DTS)
+ values
 */
 	std::map<std::string, int> getInitializedParams();
 
+/** Get counters of conversion cache, consumers which request the same frame with the same parameters share one read-only output
+ @return Map with "hits" (outputs shared with previous consumers), "misses" (conversions done by VPP), "prefetched" (conversions done
+ ahead of requests) and "views" (outputs returned as views of decoded frames) values
+*/
+	std::map<std::string, uint64_t> getCacheCounters();
+
+/** Convert every decoded frame in background as soon as it's decoded with the last parameters used by every consumer, so frame
+ requested by consumer is usually already converted. Should be called after @ref initPipeline and before @ref startProcessing
+ @param[in] workers Number of background threads used for conversions
+ @return Status of execution, one of @ref ::Internal values
+ @note Converted frames are kept while source frame is in decoder's buffer, so memory usage is up to @ref decoderBuffer outputs per consumer
+*/
+	int enablePrefetch(int workers = 1);
+
+/** Get latency of the last 1000 frame requests measured from the moment decoded frame is taken till output is ready
+ @return Map with "p50" and "p99" values in milliseconds and "samples" number
+*/
+	std::map<std::string, float> getLatency();
+
+/** Get statistics of output buffer pool, buffers freed by consumers are reused by next frames, so allocations stop growing in steady state
+ @return Map with "allocations" and "releases" (device memory calls), "hits" and "misses" (requests served from pool and by allocation),
+ "bytes_in_use", "bytes_cached", "peak_bytes_in_use" and "peak_bytes_allocated" values
+*/
+	std::map<std::string, uint64_t> getPoolStats();
+
+/** Get metrics of pipeline since initialization, durations are measured with lock-free HDR-style histograms (about 3% precision)
+ @return Map with "count", "mean_ms", "p50_ms", "p90_ms", "p99_ms", "p999_ms" and "max_ms" values of "read", "analyze", "decode" and
+ "convert" stages (keys like "decode.p99_ms"), "packets", "bytes" and "bitrate_kbps" of read stream, "decoded_frames", "prefetch_queue"
+ (queued background conversions), "consumer.<name>.delivered", "consumer.<name>.skipped" (decoded frames consumer didn't take before
+ newer frame was decoded), "consumer.<name>.dropped" (requests of frames which aren't in decoder's buffer), "consumer.<name>.lag"
+ (decoded frames consumer hasn't seen yet), "pool.<name>" values with the same names as in @ref getPoolStats, "startup.open_ms",
+ "startup.probe_ms", "startup.decoder_ms", "startup.vpp_ms", "startup.first_frame_ms" (from start of @ref initPipeline till the first
+ decoded frame) and "startup.cached" (1 if probing was skipped, see @ref setParametersCache)
+*/
+	std::map<std::string, double> getStats();
+/** Get the same metrics as @ref getStats in Prometheus text format
+*/
+	std::string getPrometheusStats();
+/** Serve metrics in Prometheus text format over HTTP on 127.0.0.1, server is stopped by @ref endProcessing
+ @param[in] port TCP port, 0 means any free port
+ @return Port number on success, status of execution from @ref ::Internal otherwise
+*/
+	int startMetricsServer(int port);
+
+/** Set maximum size of freed output buffers kept for reuse, buffers above limit are released
+ @param[in] bytes Limit in bytes, 512 MB by default
+*/
+	void setPoolLimit(uint64_t bytes);
+
+/** Enable or disable pacing of decoding to stream frame rate, local files are decoded as fast as possible if pacing is disabled
+ @param[in] enabled Pacing is enabled by default
+*/
+	void setRealTime(bool enabled);
+
+/** Enable low-latency profile for live streams: demuxer doesn't buffer packets read while stream is probed, probing is limited to
+ first 32 KB, decoder outputs frames as soon as they are decoded and decoding isn't paced to frame rate because live stream is paced
+ by its source. Should be called before @ref initPipeline
+ @param[in] enabled Profile is disabled by default
+ @note The first frames of stream can be lost because probed packets are dropped, decoding starts from the next key frame
+*/
+	void setLowLatency(bool enabled);
+
+/** Set lower transport of RTSP streams. Should be called before @ref initPipeline
+ @param[in] transport "tcp" (default), "udp", "udp_multicast" or "http", empty string means FFmpeg default (UDP with fallback to TCP)
+*/
+	void setRTSPTransport(std::string transport);
+
+/** Limit probing of stream parameters, which is the longest part of startup for many sources. Should be called before @ref initPipeline
+ @param[in] probeSize Maximum number of bytes read while stream is probed, 0 means FFmpeg default (5 MB)
+ @param[in] analyzeDuration Maximum duration of probed stream in microseconds, 0 means FFmpeg default (5 s)
+ @note Too small limits can leave frame rate or size of stream unknown
+*/
+	void setProbing(int64_t probeSize, int64_t analyzeDuration);
+
+/** Keep codec parameters and extradata found by probing in process memory for every input, so next initializations with the same
+ input (e.g. reconnects) skip probing. Should be called before @ref initPipeline
+ @param[in] enabled Cache is disabled by default
+ @note Probing is still done if demuxer doesn't find video stream in stream header (e.g. FLV over RTMP), cached entries are removed
+ by Parser::ClearParametersCache
+*/
+	void setParametersCache(bool enabled);
+
+/** Record every packet read from stream with its arrival time to capture file, which can be replayed later with the same timing by
+ passing "replay://path?speed=1" as input to @ref initPipeline. Should be called after @ref initPipeline and before @ref startProcessing
+ @param[in] fileName Path to capture file, existing file is overwritten
+ @return Status of execution, one of @ref ::Internal values
+ @note Pacing to stream frame rate isn't applied to replayed capture, packets are released at recorded arrival times divided by speed
+*/
+	int startCapture(std::string fileName);
+
 /** Start decoding of bitstream in separate thread
  @return Status of execution, one of @ref ::Internal values
 */
@@ -39,9 +133,53 @@ public:
  @param[in] pixelFormat Output FourCC of frame stored in tensor, see @ref ::FourCC for supported values
  @param[in] dstWidth Specify the width of decoded frame
  @param[in] dstHeight Specify the height of decoded frame
- @return Decoded frame in CUDA memory and index of decoded frame
+ @param[in] matrix YUV to RGB conversion matrix, see @ref ::ColorMatrix for supported values
+ @param[in] range Range of YUV values in decoded frame, see @ref ::ColorRange for supported values
+ @return Decoded frame in CUDA or host memory (depends on backend) and index of decoded frame
+*/
+	std::tuple<std::shared_ptr<uint8_t>, int> getFrame(std::string consumerName, int index, FourCC pixelFormat, int dstWidth = 0, int dstHeight = 0,
+		ColorMatrix matrix = MATRIX_AUTO, ColorRange range = RANGE_AUTO);
+/** Get decoded and post-processed frame with full set of post-processing options
+ @param[in] consumerName Consumer unique ID
+ @param[in] index Specify which frame should be read from decoded buffer. Can take values in range [-@ref decoderBuffer, 0]
+ @param[in] parameters Output format, size, crop, color conversion and normalization options, see @ref ::VPPParameters
+ @param[out] transform If passed, mapping from source frame to output frame coordinates is stored here, see @ref ::FrameTransform
+ @param[out] pitch If passed, number of bytes between starts of output rows is stored here, 0 means dense rows. Output can be
+ a view of decoded frame (see @ref VPPParameters::zeroCopy) only if pitch is passed
+ @return Decoded frame in CUDA or host memory (depends on backend) and index of decoded frame
 */
-	std::tuple<std::shared_ptr<uint8_t>, int> getFrame(std::string consumerName, int index, FourCC pixelFormat, int dstWidth = 0, int dstHeight = 0);
+	std::tuple<std::shared_ptr<uint8_t>, int> getFrame(std::string consumerName, int index, VPPParameters parameters, FrameTransform* transform = nullptr,
+		int* pitch = nullptr);
+/** Get decoded frame post-processed to pyramid of outputs, source frame is read once
+ @param[in] consumerName Consumer unique ID
+ @param[in] index Specify which frame should be read from decoded buffer. Can take values in range [-@ref decoderBuffer, 0]
+ @param[in] parameters Output format, size, crop, color conversion and normalization options of the first level, see @ref ::VPPParameters
+ @param[in] levels Width and height of next levels, every level is downscaled from the previous one with area averaging, zero size means half of previous level
+ @param[out] transforms If passed, mapping from source frame to output coordinates is stored here for every level, see @ref ::FrameTransform
+ @param[out] pitch If passed, row pitch of the first level in bytes is stored here, see @ref getFrame
+ @return Frames of all levels in CUDA or host memory (depends on backend) and index of decoded frame
+*/
+	std::tuple<std::vector<std::shared_ptr<uint8_t> >, int> getPyramid(std::string consumerName, int index, VPPParameters parameters,
+		std::vector<std::pair<int, int> > levels, std::vector<FrameTransform>* transforms = nullptr, int* pitch = nullptr);
+/** Get decoded frame post-processed straight to memory owned by caller, e.g. pinned staging area or input binding of inference engine
+ @param[in] consumerName Consumer unique ID
+ @param[in] dst CUDA memory (or host memory mapped to device) for CUDA backend, host memory for CPU backend
+ @param[in] pitch Number of bytes between starts of output rows, should be multiple of element size. Every plane of planar formats
+ has output height rows
+ @param[in] capacity Size of dst in bytes, output which doesn't fit isn't written
+ @param[in] parameters Output format, size, crop, color conversion and normalization options, see @ref ::VPPParameters
+ @param[in] index Specify which frame should be read from decoded buffer. Can take values in range [-@ref decoderBuffer, 0]
+ @param[out] transform If passed, mapping from source frame to output frame coordinates is stored here, see @ref ::FrameTransform
+ @return Index of decoded frame, output is ready in dst when function returns
+*/
+	int getFrameInto(std::string consumerName, void* dst, size_t pitch, size_t capacity, VPPParameters parameters, int index = 0,
+		FrameTransform* transform = nullptr);
+/** Get timing of the last frame returned to consumer by @ref getFrame, @ref getPyramid or @ref getFrameInto, so age of output and
+ glass-to-tensor latency can be measured. Distributions of both are also reported by @ref getStats as "frame_age" and "glass_to_tensor"
+ @param[in] consumerName Consumer unique ID
+ @return PTS and DTS of source packet, capture time set by producer, times of arrival, decoding and conversion, see @ref ::FrameTimestamps
+*/
+	FrameTimestamps getTimestamps(std::string consumerName);
 /** Close TensorStream session
  @param[in] mode Value from @ref ::CloseLevel
 */
@@ -50,12 +188,23 @@ public:
  @param[in] level Specify output level of logs, see @ref ::LogsLevel for supported values
 */
 	void enableLogs(int level);
+/** Start recording trace spans of reading, decoding and conversions, spans are kept in per-thread ring buffers without locks
+ @param[in] level Spans up to this level are recorded, see @ref ::LogsLevel, 0 stops recording. Spans above TRACE_LEVEL set at
+ build time are compiled out
+*/
+	void enableTracing(int level);
+/** Write spans recorded since @ref enableTracing call as Chrome trace JSON, can be opened in chrome://tracing or ui.perfetto.dev
+ @param[in] fileName Path to output file
+ @return Status of operation, see @ref ::Internal
+*/
+	int dumpTrace(std::string fileName);
 /** Dump the frame in CUDA memory to hard driver
- @param[in] frame CUDA memory should be dumped
+ @param[in] frame CUDA or host memory (depends on backend) should be dumped
  @param[in] width Width of frame
  @param[in] height Height of frame
  @param[in] format FourCC of frame, see @ref ::FourCC for supported values
  @param[in] dumpFile File handler
+ @note Width and height of padded frame should be passed for formats with padding, float formats are written as raw values
  */
 	int dumpFrame(std::shared_ptr<uint8_t> frame, int width, int height, FourCC format, std::shared_ptr<FILE> dumpFile);
 	int getDelay();
@@ -68,6 +217,23 @@ private:
 	std::shared_ptr<VideoProcessor> vpp;
 	AVPacket* parsed;
 	int realTimeDelay = 0;
+	std::atomic<bool> realTime{ true };
+	bool lowLatency = false;
+	std::string rtspTransport = "tcp";
+	int64_t probeSize = 0;
+	int64_t analyzeDuration = 0;
+	bool cacheParameters = false;
+	bool prefetch = false;
+	LatencyWindow latency;
+	PipelineStats stats;
+	PipelineSnapshot getSnapshot();
+	std::shared_ptr<MetricsServer> metricsServer;
+	/*
+	Timestamps of the last frame returned to every consumer
+	*/
+	std::map<std::string, FrameTimestamps> consumerTimestamps;
+	std::mutex timestampsSync;
+	void setTimestamps(std::string consumerName, FrameTimestamps timestamps);
 	std::pair<int, int> frameRate;
 	bool shouldWork;
 	std::vector<std::pair<std::string, AVFrame*> > decodedArr;
@@ -0,0 +1,83 @@
+#pragma once
+#include <stddef.h>
+
+/** @defgroup cABI C API
+@brief Plain C interface to TensorStream for callers which can't use C++ classes (C, Rust, Go, ctypes and so on)
+@details Every function returns status from @ref ::Internal (0 means success), enums are passed as their integer values
+@{
+*/
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+Opaque TensorStream session
+*/
+typedef struct TensorStreamSession TensorStreamSession;
+
+/**
+The same fields as in VPPParameters, zero initialized structure means frame in source size and color properties
+*/
+typedef struct TensorStreamParameters {
+	unsigned int width;
+	unsigned int height;
+	int fourCC; /**< Value of ::FourCC */
+	int matrix; /**< Value of ::ColorMatrix */
+	int range; /**< Value of ::ColorRange */
+	float mean[3];
+	float std[3];
+	unsigned int padMultiple;
+	int interpolation; /**< Value of ::Interpolation */
+	unsigned int cropX;
+	unsigned int cropY;
+	unsigned int cropWidth;
+	unsigned int cropHeight;
+	int letterbox;
+	unsigned char padColor[3];
+} TensorStreamParameters;
+
+/**
+The same fields as in FrameTimestamps, times are microseconds since Unix epoch, 0 means unknown
+*/
+typedef struct TensorStreamTimestamps {
+	long long pts;
+	long long dts;
+	long long capture;
+	long long arrival;
+	long long decoded;
+	long long converted;
+} TensorStreamTimestamps;
+
+/** Create session and initialize pipeline
+ @param[out] session Created session, should be released by @ref tensorStreamClose
+ @param[in] inputFile Path to stream should be decoded
+ @param[in] decoderBuffer How many decoded frames should be stored in internal buffer
+ @param[in] backend Value of ::BackendType
+*/
+int tensorStreamCreate(TensorStreamSession** session, const char* inputFile, int decoderBuffer, int backend);
+/** Get width, height and frame rate of stream, any pointer can be NULL
+*/
+int tensorStreamGetParams(TensorStreamSession* session, int* width, int* height, int* frameRateNum, int* frameRateDen);
+/** Start decoding in background thread of session
+*/
+int tensorStreamStart(TensorStreamSession* session);
+/** Convert decoded frame straight to memory owned by caller, see @ref TensorStream::getFrameInto
+ @param[out] frameIndex Index of decoded frame, can be NULL
+*/
+int tensorStreamGetFrameInto(TensorStreamSession* session, const char* consumerName, void* dst, size_t pitch, size_t capacity,
+	const TensorStreamParameters* parameters, int index, int* frameIndex);
+/** Get timing of the last frame returned to consumer, see @ref TensorStream::getTimestamps
+*/
+int tensorStreamGetTimestamps(TensorStreamSession* session, const char* consumerName, TensorStreamTimestamps* timestamps);
+/** Stop decoding and release session
+*/
+void tensorStreamClose(TensorStreamSession* session);
+
+#ifdef __cplusplus
+}
+#endif
+
+/**
+@}
+*/
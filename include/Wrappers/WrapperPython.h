@@ -4,6 +4,7 @@
 #include <torch/extension.h>
 #include <THC/THC.h>
 #include <ATen/ATen.h>
+#include <ATen/DLConvertor.h>
 #if (__linux__)
 #include <pybind11/pybind11.h>
 #include <torch/csrc/utils/pybind.h>
@@ -13,6 +14,7 @@
 #include <torch/extension.h>
 #include <THC/THC.h>
 #include <ATen/ATen.h>
+#include <ATen/DLConvertor.h>
 #if (__linux__)
 #include <pybind11/pybind11.h>
 #include <torch/csrc/utils/pybind.h>
@@ -23,18 +25,71 @@
 #include "Parser.h"
 #include "Decoder.h"
 #include "VideoProcessor.h"
+#include "Statistics.h"
+#include "MetricsServer.h"
 
 class TensorStream {
 public:
-	int initPipeline(std::string inputFile);
+	int initPipeline(std::string inputFile, BackendType backend = CUDA_BACKEND);
 	std::map<std::string, int> getInitializedParams();
+	std::map<std::string, uint64_t> getCacheCounters();
+	int enablePrefetch(int workers = 1);
+	/*
+	Low-latency profile and RTSP transport, see TensorStream::setLowLatency and TensorStream::setRTSPTransport of C++ API, should be
+	called before initPipeline
+	*/
+	void setLowLatency(bool enabled);
+	void setRTSPTransport(std::string transport);
+	/*
+	Probing limits and cache of stream parameters, see TensorStream::setProbing and TensorStream::setParametersCache of C++ API, should be
+	called before initPipeline
+	*/
+	void setProbing(int64_t probeSize, int64_t analyzeDuration);
+	void setParametersCache(bool enabled);
+	/*
+	Record read packets with arrival time to capture file which can be replayed by replay:// input, see TensorStream::startCapture of C++ API
+	*/
+	int startCapture(std::string fileName);
+	/*
+	p50 and p99 of the last frame requests in milliseconds, measured from the moment decoded frame is taken till tensors are ready
+	*/
+	std::map<std::string, float> getLatency();
+	std::map<std::string, uint64_t> getPoolStats();
+	void setPoolLimit(uint64_t bytes);
+	/*
+	Stage histograms, stream, consumer and pool counters, see TensorStream::getStats of C++ API
+	*/
+	std::map<std::string, double> getStats();
+	/*
+	Serve metrics in Prometheus text format on 127.0.0.1:port, returns port or negative status
+	*/
+	int startMetricsServer(int port);
 	int startProcessing();
-	std::tuple<at::Tensor, int> getFrame(std::string consumerName, int index, int pixelFormat, int dstWidth = 0, int dstHeight = 0);
+	/*
+	Returns tensors of frame and pyramid levels (if levels are requested), index of decoded frame, transforms from source to
+	output coordinates for every tensor: scaleX, scaleY, offsetX, offsetY and timestamps of frame with the same names as fields
+	of FrameTimestamps
+	*/
+	std::tuple<std::vector<at::Tensor>, int, std::vector<std::vector<float> >, std::map<std::string, int64_t> > getFrame(std::string consumerName, int index, int pixelFormat,
+		int dstWidth = 0, int dstHeight = 0, int matrix = MATRIX_AUTO, int range = RANGE_AUTO, std::vector<float> mean = {},
+		std::vector<float> stdDev = {}, int padMultiple = 0, int interpolation = NEAREST, std::vector<int> crop = {}, bool letterbox = false,
+		std::vector<int> padColor = {}, std::vector<std::pair<int, int> > levels = {});
+	/*
+	The same as getFrame but frame and levels are exported as DLPack tensors, deleter of every tensor returns memory to VPP,
+	so caller owns them and has to call deleter or pass them to a framework which does it
+	*/
+	std::tuple<std::vector<DLManagedTensor*>, int, std::vector<std::vector<float> >, std::map<std::string, int64_t> > exportFrame(std::string consumerName, int index,
+		int pixelFormat, int dstWidth = 0, int dstHeight = 0, int matrix = MATRIX_AUTO, int range = RANGE_AUTO, std::vector<float> mean = {},
+		std::vector<float> stdDev = {}, int padMultiple = 0, int interpolation = NEAREST, std::vector<int> crop = {}, bool letterbox = false,
+		std::vector<int> padColor = {}, std::vector<std::pair<int, int> > levels = {});
 	void endProcessing(int mode = HARD);
 	void enableLogs(int _logsLevel);
+	void enableTracing(int level);
+	int dumpTrace(std::string fileName);
 	int dumpFrame(AVFrame* output, std::shared_ptr<FILE> dumpFile);
 private:
 	int processingLoop();
+	DLManagedTensor* exportOutput(AVFrame* output, FourCC format);
 	std::mutex syncDecoded;
 	std::mutex syncRGB;
 	std::shared_ptr<Parser> parser;
@@ -42,12 +97,21 @@ private:
 	std::shared_ptr<VideoProcessor> vpp;
 	AVPacket* parsed;
 	int realTimeDelay = 0;
+	bool lowLatency = false;
+	std::string rtspTransport = "tcp";
+	int64_t probeSize = 0;
+	int64_t analyzeDuration = 0;
+	bool cacheParameters = false;
+	BackendType backendType = CUDA_BACKEND;
+	bool prefetch = false;
+	LatencyWindow latency;
+	PipelineStats stats;
+	PipelineSnapshot getSnapshot();
+	std::shared_ptr<MetricsServer> metricsServer;
 	std::pair<int, int> frameRate;
 	bool shouldWork;
 	std::vector<std::pair<std::string, AVFrame*> > decodedArr;
 	std::vector<std::pair<std::string, AVFrame*> > processedArr;
-	std::vector<at::Tensor> tensors;
 	std::vector<std::shared_ptr<uint8_t> > processedFrames;
-	std::mutex freeSync;
 	std::mutex closeSync;
 };
\ No newline at end of file
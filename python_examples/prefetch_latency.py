@@ -0,0 +1,56 @@
+from tensor_stream import TensorStreamConverter, FourCC, Backend
+
+import argparse
+
+
+def parse_arguments():
+    parser = argparse.ArgumentParser(add_help=False,
+                                     description="Latency of read() with and without background conversion")
+    parser.add_argument('--help', action='help')
+    parser.add_argument("-i", "--input",
+                        default="rtmp://184.72.239.149/vod/mp4:bigbuckbunny_1500.mp4",
+                        help="Path to bitstream: RTMP, local file")
+    parser.add_argument("-w", "--width",
+                        help="Output width (default: input bitstream width)",
+                        type=int, default=0)
+    parser.add_argument("-h", "--height",
+                        help="Output height (default: input bitstream height)",
+                        type=int, default=0)
+    parser.add_argument("-b", "--backend", default="CUDA",
+                        choices=["CUDA", "CPU"],
+                        help="Device used for decoding and post-processing (default: CUDA)")
+    parser.add_argument("-p", "--prefetch",
+                        help="Number of background conversion workers, 0 disables prefetch (default: 0)",
+                        type=int, default=0)
+    parser.add_argument("-n", "--number",
+                        help="Number of frames to read (default: 500)",
+                        type=int, default=500)
+    return parser.parse_args()
+
+
+if __name__ == '__main__':
+    args = parse_arguments()
+
+    reader = TensorStreamConverter(args.input, repeat_number=20, backend=Backend[args.backend])
+    reader.initialize()
+    if args.prefetch:
+        reader.enable_prefetch(args.prefetch)
+
+    reader.start()
+
+    try:
+        for i in range(args.number):
+            tensor = reader.read(pixel_format=FourCC.RGB_PLANAR_F32,
+                                 width=args.width,
+                                 height=args.height,
+                                 mean=[0.485, 0.456, 0.406],
+                                 std=[0.229, 0.224, 0.225])
+    except RuntimeError as e:
+        print(f"Bad things happened: {e}")
+    finally:
+        latency = reader.latency()
+        print("Prefetch workers:", args.prefetch)
+        print("Samples:", int(latency['samples']))
+        print("read() latency p50: %.3f ms, p99: %.3f ms" % (latency['p50'], latency['p99']))
+        print("Cache counters:", reader.cache_counters())
+        reader.stop()
@@ -60,13 +60,28 @@ if (platform.system() == 'Windows'):
     library += ["caffe2_gpu"]
     library += ["c10"]
     library += ["_C"]
+    library += ["ws2_32"]
 
 app_src_path = []
+app_src_path += ["src/BufferPool.cpp"]
 app_src_path += ["src/Decoder.cpp"]
+app_src_path += ["src/DumpWriter.cpp"]
 app_src_path += ["src/General.cpp"]
 app_src_path += ["src/Kernels.cu"]
+app_src_path += ["src/KernelsCPU.cpp"]
+app_src_path += ["src/KernelsCPU_AVX2.cpp"]
+app_src_path += ["src/KernelsCPU_AVX512.cpp"]
+app_src_path += ["src/KernelsCPU_SSE41.cpp"]
+app_src_path += ["src/MetricsServer.cpp"]
+app_src_path += ["src/PacketCapture.cpp"]
 app_src_path += ["src/Parser.cpp"]
+app_src_path += ["src/SyntheticStream.cpp"]
+app_src_path += ["src/Statistics.cpp"]
+app_src_path += ["src/ThreadPool.cpp"]
+app_src_path += ["src/Trace.cpp"]
 app_src_path += ["src/VideoProcessor.cpp"]
+app_src_path += ["src/VPPBackend.cpp"]
+app_src_path += ["src/VPPPipeline.cpp"]
 app_src_path += ["src/Wrappers/WrapperPython.cpp"]
 
 setup(
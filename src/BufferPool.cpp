@@ -0,0 +1,106 @@
+#include "BufferPool.h"
+#include "Common.h"
+#include <algorithm>
+
+BufferPool::BufferPool(std::function<int(void**, size_t)> allocate, std::function<void(void*)> release, size_t limit) :
+	allocate(allocate), release(release), limit(limit) {
+}
+
+BufferPool::~BufferPool() {
+	Close();
+}
+
+size_t BufferPool::getBucketSize(size_t size) {
+	const size_t minBucket = 256;
+	if (size <= minBucket)
+		return minBucket;
+	size_t power = minBucket;
+	while (power <= size / 2)
+		power *= 2;
+	//size is in [power, 2 * power), round up to quarter of power
+	size_t step = power / 4;
+	return (size + step - 1) / step * step;
+}
+
+int BufferPool::Allocate(void** data, size_t size) {
+	size_t bucket = getBucketSize(size);
+	std::unique_lock<std::mutex> locker(sync);
+	auto item = cached.find(bucket);
+	if (item != cached.end() && !item->second.empty()) {
+		*data = item->second.back();
+		item->second.pop_back();
+		stats.bytesCached -= bucket;
+		stats.hits++;
+	}
+	else {
+		//allocation can take time, other buckets can be used meanwhile
+		locker.unlock();
+		int sts = allocate(data, bucket);
+		CHECK_STATUS(sts);
+		locker.lock();
+		stats.allocations++;
+		stats.misses++;
+		stats.peakBytesAllocated = std::max(stats.peakBytesAllocated, stats.bytesInUse + stats.bytesCached + bucket);
+	}
+	used[*data] = bucket;
+	stats.bytesInUse += bucket;
+	stats.peakBytesInUse = std::max(stats.peakBytesInUse, stats.bytesInUse);
+	return VREADER_OK;
+}
+
+int BufferPool::Free(void* data) {
+	if (data == nullptr)
+		return VREADER_OK;
+	std::unique_lock<std::mutex> locker(sync);
+	auto item = used.find(data);
+	if (item == used.end()) {
+		locker.unlock();
+		release(data);
+		return VREADER_OK;
+	}
+	size_t bucket = item->second;
+	used.erase(item);
+	stats.bytesInUse -= bucket;
+	if (closed || stats.bytesCached + bucket > limit) {
+		stats.releases++;
+		locker.unlock();
+		release(data);
+		return VREADER_OK;
+	}
+	cached[bucket].push_back(data);
+	stats.bytesCached += bucket;
+	return VREADER_OK;
+}
+
+void BufferPool::trim() {
+	//the biggest buckets are released first
+	for (auto item = cached.rbegin(); item != cached.rend() && stats.bytesCached > limit; item++) {
+		while (!item->second.empty() && stats.bytesCached > limit) {
+			release(item->second.back());
+			item->second.pop_back();
+			stats.bytesCached -= item->first;
+			stats.releases++;
+		}
+	}
+}
+
+void BufferPool::setLimit(size_t limit) {
+	std::unique_lock<std::mutex> locker(sync);
+	this->limit = limit;
+	trim();
+}
+
+BufferPoolStats BufferPool::getStats() {
+	std::unique_lock<std::mutex> locker(sync);
+	return stats;
+}
+
+void BufferPool::Close() {
+	std::unique_lock<std::mutex> locker(sync);
+	closed = true;
+	size_t previous = limit;
+	limit = 0;
+	trim();
+	limit = previous;
+	cached.clear();
+}
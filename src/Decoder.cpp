@@ -16,29 +16,35 @@ int Decoder::Init(DecoderParameters& input) {
 	decoderContext = avcodec_alloc_context3(state.parser->getStreamHandle()->codec->codec);
 	sts = avcodec_parameters_to_context(decoderContext, state.parser->getStreamHandle()->codecpar);
 	CHECK_STATUS(sts);
-	sts = cudaFree(0);
-	CHECK_STATUS(sts);
-	//CUDA device initialization
-	deviceReference = av_hwdevice_ctx_alloc(av_hwdevice_find_type_by_name("cuda"));
-	AVHWDeviceContext* deviceContext = (AVHWDeviceContext*) deviceReference->data;
-	AVCUDADeviceContext *CUDAContext = (AVCUDADeviceContext*) deviceContext->hwctx;
-
-	//Assign runtime CUDA context to ffmpeg decoder
-	sts = cuCtxGetCurrent(&CUDAContext->cuda_ctx);
-	CHECK_STATUS(CUDAContext->cuda_ctx == nullptr);
-	CHECK_STATUS(sts);
-	sts = av_hwdevice_ctx_init(deviceReference);
-	CHECK_STATUS(sts);
-	decoderContext->hw_device_ctx = av_buffer_ref(deviceReference);
+	//in case of software decoding no any GPU initialization is needed
+	if (state.backend == CUDA_BACKEND) {
+		sts = cudaFree(0);
+		CHECK_STATUS(sts);
+		//CUDA device initialization
+		deviceReference = av_hwdevice_ctx_alloc(av_hwdevice_find_type_by_name("cuda"));
+		AVHWDeviceContext* deviceContext = (AVHWDeviceContext*) deviceReference->data;
+		AVCUDADeviceContext *CUDAContext = (AVCUDADeviceContext*) deviceContext->hwctx;
+
+		//Assign runtime CUDA context to ffmpeg decoder
+		sts = cuCtxGetCurrent(&CUDAContext->cuda_ctx);
+		CHECK_STATUS(CUDAContext->cuda_ctx == nullptr);
+		CHECK_STATUS(sts);
+		sts = av_hwdevice_ctx_init(deviceReference);
+		CHECK_STATUS(sts);
+		decoderContext->hw_device_ctx = av_buffer_ref(deviceReference);
+	}
+	if (state.lowLatency)
+		decoderContext->flags |= AV_CODEC_FLAG_LOW_DELAY;
 	sts = avcodec_open2(decoderContext, state.parser->getStreamHandle()->codec->codec, NULL);
 	CHECK_STATUS(sts);
 
 	framesBuffer.resize(state.bufferDeep);
+	timestampsBuffer.resize(state.bufferDeep);
 
-	if (state.enableDumps) {
-		dumpFrame = std::shared_ptr<FILE>(fopen("NV12.yuv", "wb+"), std::fclose);
-	}
+	if (state.enableDumps)
+		dumps = getDumpWriter();
 
+	isDraining = false;
 	isClosed = false;
 	return sts;
 }
@@ -53,102 +59,202 @@ void Decoder::Close() {
 			av_frame_free(&item);
 	}
 	framesBuffer.clear();
+	timestampsBuffer.clear();
+	pendingTimestamps.clear();
+	dumps = nullptr;
 	isClosed = true;
 }
 
-void saveNV12(AVFrame *avFrame, FILE* dump)
-{
-	uint32_t pitchY = avFrame->linesize[0];
-	uint32_t pitchUV = avFrame->linesize[1];
-
-	uint8_t *avY = avFrame->data[0];
-	uint8_t *avUV = avFrame->data[1];
-
-	for (uint32_t i = 0; i < avFrame->height; i++) {
-		fwrite(avY, avFrame->width, 1, dump);
-		avY += pitchY;
+/*
+Software decoder returns planar YUV 4:2:0 but VPP expects NV12, so need to interleave chroma planes
+*/
+int softwareToNV12(AVFrame* src, AVFrame* dst) {
+	if (src->format != AV_PIX_FMT_YUV420P && src->format != AV_PIX_FMT_YUVJ420P)
+		return VREADER_UNSUPPORTED;
+	dst->format = AV_PIX_FMT_NV12;
+	dst->width = src->width;
+	dst->height = src->height;
+	int sts = av_frame_get_buffer(dst, 32);
+	CHECK_STATUS(sts);
+	sts = av_frame_copy_props(dst, src);
+	CHECK_STATUS(sts);
+	for (int i = 0; i < src->height; i++) {
+		memcpy(dst->data[0] + i * dst->linesize[0], src->data[0] + i * src->linesize[0], src->width);
 	}
 
-	for (uint32_t i = 0; i < avFrame->height / 2; i++) {
-		fwrite(avUV, avFrame->width, 1, dump);
-		avUV += pitchUV;
+	for (int i = 0; i < (src->height + 1) / 2; i++) {
+		uint8_t* U = src->data[1] + i * src->linesize[1];
+		uint8_t* V = src->data[2] + i * src->linesize[2];
+		uint8_t* UV = dst->data[1] + i * dst->linesize[1];
+		for (int j = 0; j < (src->width + 1) / 2; j++) {
+			UV[2 * j] = U[j];
+			UV[2 * j + 1] = V[j];
+		}
 	}
-	fflush(dump);
+	return VREADER_OK;
 }
 
 int Decoder::notifyConsumers() {
 	{
 		std::unique_lock<std::mutex> locker(sync);
-		for (auto &item : consumerStatus) {
-			item.second = true;
-		}
 		isFinished = true;
 		consumerSync.notify_all();
 	}
 	return VREADER_OK;
 }
 
+std::map<std::string, ConsumerStats> Decoder::getConsumerStats() {
+	std::unique_lock<std::mutex> locker(sync);
+	std::map<std::string, ConsumerStats> stats = consumerStats;
+	for (auto& item : stats)
+		item.second.lag = currentFrame - consumerSeen[item.first];
+	return stats;
+}
+
 AVCodecContext* Decoder::getDecoderContext() {
 	return decoderContext;
 }
 
-int Decoder::GetFrame(int index, std::string consumerName, AVFrame* outputFrame) {
-	//element in map will be created after trying to call it
-	if (!consumerStatus[consumerName]) {
-		consumerStatus[consumerName] = false;
-	}
-	
+int Decoder::GetFrame(int index, std::string consumerName, AVFrame* outputFrame, FrameTimestamps* timestamps) {
 	{
 		std::unique_lock<std::mutex> locker(sync);
-		if (isFinished == false)
-			while (!consumerStatus[consumerName]) 
-				consumerSync.wait(locker);
+		//element in map is created by the first request of consumer under lock, so consumers can start concurrently
+		while (!consumerStatus[consumerName] && !isFinished)
+			consumerSync.wait(locker);
 
-		if (isFinished)
+		//frames published before the end are still given to consumers which haven't taken them
+		if (!consumerStatus[consumerName])
 			throw std::runtime_error("Decoding finished");
 
 		if (consumerStatus[consumerName] == true) {
 			consumerStatus[consumerName] = false;
+			//frames decoded after the previous request except the latest one won't be seen by consumer
+			ConsumerStats& stats = consumerStats[consumerName];
+			auto seen = consumerSeen.find(consumerName);
+			if (seen != consumerSeen.end() && currentFrame > seen->second + 1)
+				stats.skipped += currentFrame - seen->second - 1;
+			consumerSeen[consumerName] = currentFrame;
 			if (index > 0) {
 				LOG_VALUE(std::string("WARNING: Frame number is greater than zero: ") + std::to_string(index));
 				index = 0;
 			}
 			int allignedIndex = (currentFrame - 1) % state.bufferDeep + index;
 			if (allignedIndex < 0 || !framesBuffer[allignedIndex]) {
+				stats.dropped++;
 				return VREADER_REPEAT;
 			}
+			stats.delivered++;
 			//can decoder overrun us and start using the same frame? Need sync
 			av_frame_ref(outputFrame, framesBuffer[allignedIndex]);
+			if (timestamps)
+				*timestamps = timestampsBuffer[allignedIndex];
 		}
 	}
 	return currentFrame;
 }
 
-int Decoder::Decode(AVPacket* pkt) {
+int Decoder::GetLatestFrame(AVFrame* outputFrame) {
+	std::unique_lock<std::mutex> locker(sync);
+	if (currentFrame == 0 || !framesBuffer[(currentFrame - 1) % state.bufferDeep])
+		return VREADER_REPEAT;
+	av_frame_ref(outputFrame, framesBuffer[(currentFrame - 1) % state.bufferDeep]);
+	return currentFrame;
+}
+
+int Decoder::Decode(AVPacket* pkt, FrameTimestamps timestamps) {
+	TRACE_SPAN_LOW("decode", "", (int)currentFrame);
 	int sts = VREADER_OK;
-	clock_t start = clock();
+	//decoder copies reordered_opaque of context to frame decoded from this packet
+	const size_t maxPending = 64;
+	decoderContext->reordered_opaque = packetNumber;
+	pendingTimestamps[packetNumber++] = timestamps;
+	//entries of packets which didn't produce frames are removed
+	if (pendingTimestamps.size() > maxPending)
+		pendingTimestamps.erase(pendingTimestamps.begin());
 	sts = avcodec_send_packet(decoderContext, pkt);
-	if (sts < 0 || sts == AVERROR(EAGAIN) || sts == AVERROR_EOF) {
+	//deallocate copy(!) of packet from Reader, decoder keeps own reference
+	av_packet_unref(pkt);
+	if (sts < 0) {
 		return sts;
 	}
+	//decoder can return several frames per packet (e.g. after B-frames or in the end of frame threads pipeline), all of them are taken
+	//so output doesn't fall behind input
+	int frames = receiveFrames();
+	if (frames < 0)
+		return frames;
+	return frames > 0 ? VREADER_OK : AVERROR(EAGAIN);
+}
+
+int Decoder::Flush() {
+	TRACE_SPAN_LOW("flush", "", (int)currentFrame);
+	//empty packet switches decoder to draining mode, it's sent only once
+	if (!isDraining) {
+		int sts = avcodec_send_packet(decoderContext, nullptr);
+		if (sts < 0 && sts != AVERROR_EOF)
+			return sts;
+		isDraining = true;
+	}
 	AVFrame* decodedFrame = av_frame_alloc();
-	sts = avcodec_receive_frame(decoderContext, decodedFrame);
+	//decoder in draining mode returns frame or AVERROR_EOF after the last one
+	int sts = avcodec_receive_frame(decoderContext, decodedFrame);
+	if (sts < 0) {
+		av_frame_free(&decodedFrame);
+		return sts;
+	}
+	return storeFrame(decodedFrame);
+}
+
+int Decoder::receiveFrames() {
+	int frames = 0;
+	while (true) {
+		AVFrame* decodedFrame = av_frame_alloc();
+		int sts = avcodec_receive_frame(decoderContext, decodedFrame);
+		if (sts == AVERROR(EAGAIN) || sts == AVERROR_EOF) {
+			av_frame_free(&decodedFrame);
+			return frames;
+		}
+		if (sts < 0) {
+			av_frame_free(&decodedFrame);
+			return sts;
+		}
+		sts = storeFrame(decodedFrame);
+		CHECK_STATUS(sts);
+		frames++;
+	}
+}
+
+int Decoder::storeFrame(AVFrame* decodedFrame) {
+	int sts = VREADER_OK;
 	//TensorStream parses only video and not audio so let's use audio variable for video frame channels number
 	//Number of channels for NV12 = 1
 	decodedFrame->channels = 1;
-
-	if (sts == AVERROR(EAGAIN) || sts == AVERROR_EOF) {
+	FrameTimestamps decodedTimestamps;
+	auto pending = pendingTimestamps.find(decodedFrame->reordered_opaque);
+	if (pending != pendingTimestamps.end()) {
+		decodedTimestamps = pending->second;
+		pendingTimestamps.erase(pending);
+	}
+	decodedTimestamps.decoded = wallClock();
+	if (state.backend == CPU_BACKEND && decodedFrame->format != AV_PIX_FMT_NV12) {
+		AVFrame* NV12Frame = av_frame_alloc();
+		sts = softwareToNV12(decodedFrame, NV12Frame);
 		av_frame_free(&decodedFrame);
-		return sts;
+		if (sts < 0) {
+			av_frame_free(&NV12Frame);
+			return sts;
+		}
+		decodedFrame = NV12Frame;
+		decodedFrame->channels = 1;
 	}
-	//deallocate copy(!) of packet from Reader
-	av_packet_unref(pkt);
 	{
 		std::unique_lock<std::mutex> locker(sync);
 		if (framesBuffer[(currentFrame) % state.bufferDeep]) {
 			av_frame_unref(framesBuffer[(currentFrame) % state.bufferDeep]);
 		}
+		//index of frame is used by VPP to share conversions of the same frame between consumers
+		decodedFrame->display_picture_number = currentFrame;
 		framesBuffer[(currentFrame) % state.bufferDeep] = decodedFrame;
+		timestampsBuffer[(currentFrame) % state.bufferDeep] = decodedTimestamps;
 		//Frame changed, consumers can take it
 		currentFrame++;
 
@@ -158,26 +264,49 @@ int Decoder::Decode(AVPacket* pkt) {
 		consumerSync.notify_all();
 	}
 	if (state.enableDumps) {
-		AVFrame* NV12Frame = av_frame_alloc();
-		NV12Frame->format = AV_PIX_FMT_NV12;
-
-		if (decodedFrame->format == AV_PIX_FMT_CUDA) {
-			sts = av_hwframe_transfer_data(NV12Frame, decodedFrame, 0);
-			if (sts < 0) {
-				av_frame_unref(NV12Frame);
-				return sts;
-			}
-		}
+		sts = dumpFrame(decodedFrame);
+		CHECK_STATUS(sts);
+	}
+	return sts;
+}
 
-		sts = av_frame_copy_props(NV12Frame, decodedFrame);
-		if (sts < 0) {
-			av_frame_unref(NV12Frame);
-			return sts;
+int Decoder::dumpFrame(AVFrame* frame) {
+	//frames in CUDA memory are NV12 too
+	if (frame->format != AV_PIX_FMT_NV12 && frame->format != AV_PIX_FMT_CUDA)
+		return VREADER_OK;
+	DumpFormat format;
+	format.layout = DUMP_NV12;
+	format.width = frame->width;
+	format.height = frame->height;
+	if (decoderContext->framerate.num > 0 && decoderContext->framerate.den > 0) {
+		format.frameRateNum = decoderContext->framerate.num;
+		format.frameRateDen = decoderContext->framerate.den;
+	}
+	//chroma row of odd width has pair for the last pixel
+	format.rowSize = format.pitch = 2 * ((frame->width + 1) / 2);
+	format.rows = frame->height + (frame->height + 1) / 2;
+	std::vector<uint8_t> buffer = dumps->Acquire(format.pitch * format.rows);
+	if (buffer.empty())
+		return VREADER_OK;
+	uint8_t* chroma = &buffer[0] + format.pitch * frame->height;
+	if (frame->format == AV_PIX_FMT_CUDA) {
+		int sts = cudaMemcpy2D(&buffer[0], format.pitch, frame->data[0], frame->linesize[0], frame->width, frame->height, cudaMemcpyDeviceToHost);
+		if (sts == VREADER_OK)
+			sts = cudaMemcpy2D(chroma, format.pitch, frame->data[1], frame->linesize[1], format.pitch, (frame->height + 1) / 2,
+				cudaMemcpyDeviceToHost);
+		if (sts != VREADER_OK) {
+			dumps->Release(std::move(buffer));
+			CHECK_STATUS(sts);
 		}
-		saveNV12(NV12Frame, dumpFrame.get());
-		av_frame_unref(NV12Frame);
 	}
-	return sts;
+	else {
+		for (int i = 0; i < frame->height; i++)
+			memcpy(&buffer[i * format.pitch], frame->data[0] + i * frame->linesize[0], frame->width);
+		for (int i = 0; i < (frame->height + 1) / 2; i++)
+			memcpy(chroma + i * format.pitch, frame->data[1] + i * frame->linesize[1], format.pitch);
+	}
+	dumps->Submit("Decoded.y4m", format, std::move(buffer));
+	return VREADER_OK;
 }
 
 unsigned int Decoder::getFrameIndex() {
@@ -0,0 +1,161 @@
+#include "DumpWriter.h"
+
+//buffers kept for reuse, dumps have a few geometries, so a few buffers are enough
+const int maxPooledBuffers = 8;
+
+DumpWriter::DumpWriter(size_t limit) : limit(limit) {
+	writer = std::thread(&DumpWriter::writerLoop, this);
+}
+
+DumpWriter::~DumpWriter() {
+	{
+		std::unique_lock<std::mutex> locker(sync);
+		stop = true;
+	}
+	jobAdded.notify_all();
+	writer.join();
+}
+
+std::vector<uint8_t> DumpWriter::Acquire(size_t size) {
+	std::vector<uint8_t> buffer;
+	{
+		std::unique_lock<std::mutex> locker(sync);
+		if (queuedBytes + size > limit) {
+			dropped++;
+			return buffer;
+		}
+		//space is reserved till buffer is written or released, so concurrent callers can't exceed limit
+		queuedBytes += size;
+		if (buffers.size()) {
+			buffer = std::move(buffers.back());
+			buffers.pop_back();
+		}
+	}
+	buffer.resize(size);
+	return buffer;
+}
+
+void DumpWriter::Submit(const std::string& fileName, const DumpFormat& format, std::vector<uint8_t>&& buffer) {
+	{
+		std::unique_lock<std::mutex> locker(sync);
+		jobs.push(Job{ fileName, format, std::move(buffer) });
+	}
+	jobAdded.notify_one();
+}
+
+void DumpWriter::Release(std::vector<uint8_t>&& buffer) {
+	std::unique_lock<std::mutex> locker(sync);
+	queuedBytes -= buffer.size();
+	if (buffers.size() < maxPooledBuffers)
+		buffers.push_back(std::move(buffer));
+}
+
+void DumpWriter::Flush() {
+	std::unique_lock<std::mutex> locker(sync);
+	jobsDone.wait(locker, [this] { return jobs.empty() && !busy; });
+}
+
+uint64_t DumpWriter::getWritten() {
+	return written;
+}
+
+uint64_t DumpWriter::getDropped() {
+	return dropped;
+}
+
+void DumpWriter::writerLoop() {
+	std::unique_lock<std::mutex> locker(sync);
+	while (true) {
+		jobAdded.wait(locker, [this] { return stop || !jobs.empty(); });
+		//queued frames are written before stop
+		if (jobs.empty())
+			break;
+		Job job = std::move(jobs.front());
+		jobs.pop();
+		busy = true;
+		locker.unlock();
+		write(job);
+		//data is flushed once queue is drained, so files are complete while writer is idle
+		locker.lock();
+		if (jobs.empty()) {
+			locker.unlock();
+			for (auto& item : files)
+				fflush(item.second.file.get());
+			locker.lock();
+		}
+		queuedBytes -= job.buffer.size();
+		if (buffers.size() < maxPooledBuffers)
+			buffers.push_back(std::move(job.buffer));
+		busy = false;
+		if (jobs.empty())
+			jobsDone.notify_all();
+	}
+}
+
+void DumpWriter::write(Job& job) {
+	const DumpFormat& format = job.format;
+	auto item = files.find(job.fileName);
+	if (item == files.end()) {
+		FILE* file = fopen(job.fileName.c_str(), "wb");
+		if (file == nullptr) {
+			dropped++;
+			return;
+		}
+		item = files.insert(std::make_pair(job.fileName, DumpFile{ std::shared_ptr<FILE>(file, std::fclose), format })).first;
+		//decoded frames have chroma sited as in MPEG-2
+		if (format.layout != DUMP_RAW)
+			fprintf(file, "YUV4MPEG2 W%d H%d F%d:%d Ip A1:1 %s\n", format.width, format.height, format.frameRateNum, format.frameRateDen,
+				format.layout == DUMP_GRAY ? "Cmono" : "C420mpeg2");
+	}
+	const DumpFormat& header = item->second.format;
+	bool y4m = header.layout != DUMP_RAW;
+	if (y4m && ((format.layout == DUMP_GRAY) != (header.layout == DUMP_GRAY) || format.width != header.width ||
+		format.height != header.height)) {
+		dropped++;
+		return;
+	}
+	FILE* file = item->second.file.get();
+	const uint8_t* data = job.buffer.data();
+	if (y4m)
+		fputs("FRAME\n", file);
+	int pairs = (format.width + 1) / 2;
+	int rowsUV = (format.height + 1) / 2;
+	if (format.layout == DUMP_NV12) {
+		for (int i = 0; i < format.height; i++)
+			fwrite(data + i * format.pitch, format.width, 1, file);
+		planesUV.resize((size_t)pairs * rowsUV * 2);
+		uint8_t* U = &planesUV[0];
+		uint8_t* V = U + (size_t)pairs * rowsUV;
+		for (int i = 0; i < rowsUV; i++) {
+			const uint8_t* UV = data + (format.height + i) * format.pitch;
+			for (int j = 0; j < pairs; j++) {
+				U[i * pairs + j] = UV[2 * j];
+				V[i * pairs + j] = UV[2 * j + 1];
+			}
+		}
+		fwrite(&planesUV[0], planesUV.size(), 1, file);
+	}
+	else if (format.layout == DUMP_I420) {
+		fwrite(data, (size_t)format.width * format.height + (size_t)pairs * rowsUV * 2, 1, file);
+	}
+	else if (format.pitch == format.rowSize) {
+		fwrite(data, format.rowSize * format.rows, 1, file);
+	}
+	else {
+		for (int i = 0; i < format.rows; i++)
+			fwrite(data + i * format.pitch, format.rowSize, 1, file);
+	}
+	written++;
+}
+
+std::shared_ptr<DumpWriter> getDumpWriter() {
+	static std::mutex writerSync;
+	static std::weak_ptr<DumpWriter> shared;
+	std::unique_lock<std::mutex> locker(writerSync);
+	std::shared_ptr<DumpWriter> writer = shared.lock();
+	if (writer == nullptr) {
+		writer = std::make_shared<DumpWriter>();
+		shared = writer;
+	}
+	return writer;
+}
@@ -7,6 +7,18 @@ void printContext() {
 	printf("Context %x\n", test_cu);
 }
 
+int64_t wallClock() {
+	return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
 std::ofstream logsFile;
-LogsLevel logsLevel;
+std::atomic<LogsLevel> logsLevel{ NONE };
 std::mutex logsMutex;
+
+void writeLog(const std::string& message) {
+	std::unique_lock<std::mutex> locker(logsMutex);
+	if (logsLevel < 0)
+		std::cout << "TID: " << std::this_thread::get_id() << " " << message << std::flush;
+	else if (logsFile.is_open())
+		logsFile << "TID: " << std::this_thread::get_id() << " " << message;
+}
@@ -1,54 +1,16 @@
 #include <libavutil/frame.h>
 #include "cuda.h"
+#include <cuda_fp16.h>
 #include "VideoProcessor.h"
 
-__global__ void NV12ToRGB32Kernel(unsigned char* Y, unsigned char* UV, unsigned char* RGB, int width, int height, int pitchNV12, int pitchRGB) {
-	/*
-		R = 1.164(Y - 16) + 1.596(V - 128)
-		B = 1.164(Y - 16)                   + 2.018(U - 128)
-		G = 1.164(Y - 16) - 0.813(V - 128)  - 0.391(U - 128)
-	*/
-	/*
-	in case of NV12 we have Y component for every pixel and UV for every 2x2 Y
-	*/
-	unsigned int i = blockIdx.y*blockDim.y + threadIdx.y;
-	unsigned int j = blockIdx.x*blockDim.x + threadIdx.x;
-	if (i < height && j < width) {
-		int UVRow = i / 2;
-		int UVCol = j % 2 == 0 ? j : j - 1;
-		int UIndex = UVRow * pitchNV12 /*pitch?*/ + UVCol;
-		int VIndex = UVRow * pitchNV12 /*pitch?*/ + UVCol + 1;
-		unsigned char U = UV[UIndex];
-		unsigned char V = UV[VIndex];
-		int indexNV12 = j + i * pitchNV12; /*indexNV12 and indexRGB with/without pitch*/
-		unsigned char YVal = Y[indexNV12];
-		int RVal = 1.164f*(YVal - 16) + 1.596f*(V - 128);
-		if (RVal > 255)
-			RVal = 255;
-		if (RVal < 0)
-			RVal = 0;
-		int BVal = 1.164f*(YVal - 16) + 2.018f*(U - 128);
-		if (BVal > 255)
-			BVal = 255;
-		if (BVal < 0)
-			BVal = 0;
-		int GVal = 1.164f*(YVal - 16) - 0.813f*(V - 128) - 0.391f*(U - 128);
-		if (GVal > 255)
-			GVal = 255;
-		if (GVal < 0)
-			GVal = 0;
-		RGB[j * 3 + i * pitchRGB + 0/*R*/] = (unsigned char)RVal;
-		RGB[j * 3 + i * pitchRGB + 1 /*G*/] = (unsigned char)GVal;
-		RGB[j * 3 + i * pitchRGB + 2/*B*/] = (unsigned char)BVal;
-	}
-}
-
-__global__ void NV12ToBGR32Kernel(unsigned char* Y, unsigned char* UV, unsigned char* BGR, int width, int height, int pitchNV12, int pitchRGB) {
-	/*
-		R = 1.164(Y - 16) + 1.596(V - 128)
-		B = 1.164(Y - 16)                   + 2.018(U - 128)
-		G = 1.164(Y - 16) - 0.813(V - 128)  - 0.391(U - 128)
-	*/
+/*
+	R = (Y' + RV * V) >> colorShift
+	G = (Y' - GV * V - GU * U) >> colorShift
+	B = (Y' + BU * U) >> colorShift
+	where Y' = coefficient Y * (Y - offsetY), U and V are shifted by 128, the same math as in CPU kernels
+*/
+__device__ void NV12ToPacked(unsigned char* Y, unsigned char* UV, unsigned char* output, int width, int height, int pitchNV12, int pitchRGB,
+	ColorCoefficients coefficients, int indexR, int indexB) {
 	/*
 	in case of NV12 we have Y component for every pixel and UV for every 2x2 Y
 	*/
@@ -59,31 +21,29 @@ __global__ void NV12ToBGR32Kernel(unsigned char* Y, unsigned char* UV, unsigned
 		int UVCol = j % 2 == 0 ? j : j - 1;
 		int UIndex = UVRow * pitchNV12 /*pitch?*/ + UVCol;
 		int VIndex = UVRow * pitchNV12 /*pitch?*/ + UVCol + 1;
-		unsigned char U = UV[UIndex];
-		unsigned char V = UV[VIndex];
+		int U = UV[UIndex] - 128;
+		int V = UV[VIndex] - 128;
 		int indexNV12 = j + i * pitchNV12; /*indexNV12 and indexRGB with/without pitch*/
-		unsigned char YVal = Y[indexNV12];
-		int RVal = 1.164f*(YVal - 16) + 1.596f*(V - 128);
-		if (RVal > 255)
-			RVal = 255;
-		if (RVal < 0)
-			RVal = 0;
-		int BVal = 1.164f*(YVal - 16) + 2.018f*(U - 128);
-		if (BVal > 255)
-			BVal = 255;
-		if (BVal < 0)
-			BVal = 0;
-		int GVal = 1.164f*(YVal - 16) - 0.813f*(V - 128) - 0.391f*(U - 128);
-		if (GVal > 255)
-			GVal = 255;
-		if (GVal < 0)
-			GVal = 0;
-		BGR[j * 3 + i * pitchRGB + 0/*B*/] = (unsigned char)BVal;
-		BGR[j * 3 + i * pitchRGB + 1 /*G*/] = (unsigned char)GVal;
-		BGR[j * 3 + i * pitchRGB + 2/*R*/] = (unsigned char)RVal;
+		int YVal = coefficients.Y * (Y[indexNV12] - coefficients.offsetY);
+		int RVal = min(max((YVal + coefficients.RV * V) >> colorShift, 0), 255);
+		int GVal = min(max((YVal - coefficients.GV * V - coefficients.GU * U) >> colorShift, 0), 255);
+		int BVal = min(max((YVal + coefficients.BU * U) >> colorShift, 0), 255);
+		output[j * 3 + i * pitchRGB + indexR] = (unsigned char)RVal;
+		output[j * 3 + i * pitchRGB + 1 /*G*/] = (unsigned char)GVal;
+		output[j * 3 + i * pitchRGB + indexB] = (unsigned char)BVal;
 	}
 }
 
+__global__ void NV12ToRGB32Kernel(unsigned char* Y, unsigned char* UV, unsigned char* RGB, int width, int height, int pitchNV12, int pitchRGB,
+	ColorCoefficients coefficients) {
+	NV12ToPacked(Y, UV, RGB, width, height, pitchNV12, pitchRGB, coefficients, 0, 2);
+}
+
+__global__ void NV12ToBGR32Kernel(unsigned char* Y, unsigned char* UV, unsigned char* BGR, int width, int height, int pitchNV12, int pitchRGB,
+	ColorCoefficients coefficients) {
+	NV12ToPacked(Y, UV, BGR, width, height, pitchNV12, pitchRGB, coefficients, 2, 0);
+}
+
 __global__ void resizeNV12NearestKernel(unsigned char* inputY, unsigned char* inputUV, unsigned char* outputY, unsigned char* outputUV,
 	                             int srcWidth, int srcHeight, int srcLinesizeY, int srcLinesizeUV, int dstWidth, int dstHeight, float xRatio, float yRatio) {
 	
@@ -114,21 +74,32 @@ __global__ void resizeNV12NearestKernel(unsigned char* inputY, unsigned char* in
 	}
 }
 
-__device__ int calculateBillinearInterpolation(unsigned char* data, int startIndex, int xDiff, int yDiff, int linesize, int weightX, int weightY) {
-	// range is 0 to 255 thus bitwise AND with 0xff
-	int A = data[startIndex] & 0xff;
-	int B = data[startIndex + xDiff] & 0xff;
-	int C = data[startIndex + linesize] & 0xff;
-	int D = data[startIndex + linesize + yDiff] & 0xff;
+/*
+Integer weights with 7 bits precision, the same math as in KernelsCPU.cpp so both backends give bit-exact result
+*/
+#define WEIGHT_SHIFT 7
+#define WEIGHT_ONE (1 << WEIGHT_SHIFT)
+
+//source index and weight of the next pixel, the last source pixel is taken with full weight
+__device__ void calculateBillinearCoordinate(float ratio, int dstIndex, int srcSize, int* index, int* weight) {
+	float position = __fmul_rn(ratio, dstIndex);
+	*index = (int)position;
+	*weight = (int)((position - *index) * WEIGHT_ONE);
+	if (*index >= srcSize - 1) {
+		*index = srcSize - 2;
+		*weight = WEIGHT_ONE;
+	}
+}
+
+__device__ int interpolate(int first, int second, int weight) {
+	return (first * (WEIGHT_ONE - weight) + second * weight + WEIGHT_ONE / 2) >> WEIGHT_SHIFT;
+}
 
-	// value = A(1-w)(1-h) + B(w)(1-h) + C(h)(1-w) + Dwh
-	int value = (int)(
-		A * (1 - weightX) * (1 - weightY) +
-		B * (weightX) * (1 - weightY) +
-		C * (weightY) * (1 - weightX) +
-		D * (weightX  *      weightY)
-		);
-	return value;
+//at first rows are blended vertically, after that result is interpolated horizontally, xDiff is distance between neighbour pixels
+__device__ int calculateBillinearInterpolation(unsigned char* data, int startIndex, int xDiff, int linesize, int weightX, int weightY) {
+	int left = interpolate(data[startIndex], data[startIndex + linesize], weightY);
+	int right = interpolate(data[startIndex + xDiff], data[startIndex + xDiff + linesize], weightY);
+	return interpolate(left, right, weightX);
 }
 
 __global__ void resizeNV12BilinearKernel(unsigned char* inputY, unsigned char* inputUV, unsigned char* outputY, unsigned char* outputUV,
@@ -138,36 +109,381 @@ __global__ void resizeNV12BilinearKernel(unsigned char* inputY, unsigned char* i
 	unsigned int j = blockIdx.x * blockDim.x + threadIdx.x; //coordinate of pixel (x) in destination image
 
 	if (i < dstHeight && j < dstWidth) {
-		int y = (int)(yRatio * i); //it's coordinate of pixel in source image
-		int x = (int)(xRatio * j); //it's coordinate of pixel in source image
-		float xFloat = (xRatio * j) - x;
-		float yFloat = (yRatio * i) - y;
-		int index = y * srcLinesizeY + x; //index in source image
-		outputY[i * dstWidth + j] = calculateBillinearInterpolation(inputY, index, 1, 1, srcLinesizeY, xFloat, yFloat);
+		int x, y, weightX, weightY;
+		calculateBillinearCoordinate(xRatio, j, srcWidth, &x, &weightX);
+		calculateBillinearCoordinate(yRatio, i, srcHeight, &y, &weightY);
+		outputY[i * dstWidth + j] = calculateBillinearInterpolation(inputY, y * srcLinesizeY + x, 1, srcLinesizeY, weightX, weightY);
 		//we should take chroma for every 2 luma, also height of data[1] is twice less than data[0]
-		//there are no difference between x_ratio for Y and UV also as for y_ratio because (src_height / 2) / (dst_height / 2) = src_height / dst_height
+		//chroma coordinates are calculated in UV pairs, so neighbour U (V) is placed 2 bytes further
 		if (j % 2 == 0 && i < dstHeight / 2) {
-			index = y * srcLinesizeUV + x; //index in source image
-			int indexU, indexV;
-			if (index % 2 == 0) {
-				indexU = index;
-				indexV = index + 1;
-			}
-			else {
-				indexU = index - 1;
-				indexV = index;
+			int pair = j / 2;
+			calculateBillinearCoordinate(xRatio, pair, srcWidth / 2, &x, &weightX);
+			calculateBillinearCoordinate(yRatio, i, srcHeight / 2, &y, &weightY);
+			int indexU = y * srcLinesizeUV + 2 * x;
+			outputUV[i * dstWidth + j] = calculateBillinearInterpolation(inputUV, indexU, 2, srcLinesizeUV, weightX, weightY);
+			outputUV[i * dstWidth + j + 1] = calculateBillinearInterpolation(inputUV, indexU + 1, 2, srcLinesizeUV, weightX, weightY);
+		}
+	}
+}
+
+/*
+Part of VPPPipeline which is passed to fused kernel by value, tables are replaced by the same calculations on device
+*/
+struct FusedParameters {
+	int cropX;
+	int cropY;
+	int dstWidth;
+	int dstHeight;
+	int outputWidth;
+	int outputHeight;
+	//bytes between output rows, planes of CHW layout are outputHeight rows each
+	int outputPitch;
+	int elementSize;
+	int imageX;
+	int imageY;
+	float padValue[3];
+	int channels;
+	int indexR;
+	int indexB;
+	ColorCoefficients coefficients;
+	PixelType type;
+	PixelLayout layout;
+	float scale[3];
+	float offset[3];
+	bool resize;
+	float xRatio;
+	float yRatio;
+	/*
+	Vertical pass of separable filter, rows are results of horizontal pass for the whole crop
+	*/
+	bool filtered;
+	const short* filteredY;
+	const short* filteredUV;
+	int pairs;
+	const int* yIndex;
+	const short* yWeights;
+	int yTaps;
+	const int* yIndexUV;
+	const short* yWeightsUV;
+	int yTapsUV;
+};
+
+/*
+Horizontal pass of separable filter for rows of crop, the same math as in filterRowScalar. Every thread produces one element
+of interleaved row.
+*/
+__global__ void filterRowsKernel(unsigned char* src, int pitch, const int* index, const short* weights, int taps, int width, int channels,
+	int rows, short* dst) {
+	unsigned int i = blockIdx.y * blockDim.y + threadIdx.y;
+	unsigned int j = blockIdx.x * blockDim.x + threadIdx.x;
+	if (i >= rows || j >= width * channels)
+		return;
+	int pixel = j / channels;
+	const unsigned char* pixels = src + i * pitch + index[pixel] * channels + j % channels;
+	const short* weight = weights + pixel * taps;
+	const int shift = filterShift - intermediateShift;
+	int sum = 1 << (shift - 1);
+	for (int t = 0; t < taps; t++)
+		sum += pixels[t * channels] * weight[t];
+	dst[i * width * channels + j] = sum >> shift;
+}
+
+/*
+Vertical pass of separable filter for one element, the same math as in filterColumnsScalar
+*/
+__device__ int filterColumn(const short* rows, int pitch, const int* index, const short* weights, int taps, int row, int column) {
+	const short* pixels = rows + index[row] * pitch + column;
+	const short* weight = weights + row * taps;
+	const int shift = filterShift + intermediateShift;
+	int sum = 1 << (shift - 1);
+	for (int t = 0; t < taps; t++)
+		sum += pixels[t * pitch] * weight[t];
+	return min(max(sum >> shift, 0), 255);
+}
+
+/*
+Every thread produces one output pixel from source NV12 frame: crop, nearest resize, color conversion, normalization and
+layout change are done without intermediate frames. Coordinates and math are the same as in processPipelineCPU.
+Filtered resize reads rows prepared by filterRowsKernel instead of source frame.
+Threads outside of image placed at (imageX, imageY) write pad value to letterbox and padded area.
+*/
+__device__ void* getOutputElement(void* output, const FusedParameters& parameters, int i, int j, int c) {
+	size_t offset = parameters.layout == LAYOUT_CHW ? ((size_t)c * parameters.outputHeight + i) * parameters.outputPitch + j * parameters.elementSize :
+		(size_t)i * parameters.outputPitch + (j * parameters.channels + c) * parameters.elementSize;
+	return (unsigned char*)output + offset;
+}
+
+__global__ void fusedKernel(unsigned char* Y, unsigned char* UV, int pitchY, int pitchUV, void* output, FusedParameters parameters) {
+	unsigned int i = blockIdx.y * blockDim.y + threadIdx.y;
+	unsigned int j = blockIdx.x * blockDim.x + threadIdx.x;
+	if (i >= parameters.outputHeight || j >= parameters.outputWidth)
+		return;
+	//coordinates inside of image
+	int row = (int)i - parameters.imageY;
+	int column = (int)j - parameters.imageX;
+	if (row < 0 || row >= parameters.dstHeight || column < 0 || column >= parameters.dstWidth) {
+		for (int c = 0; c < parameters.channels; c++) {
+			void* element = getOutputElement(output, parameters, i, j, c);
+			if (parameters.type == PIXEL_FLOAT32)
+				*(float*)element = parameters.padValue[c];
+			else if (parameters.type == PIXEL_FLOAT16)
+				*(__half*)element = __float2half_rn(parameters.padValue[c]);
+			else
+				*(unsigned char*)element = (unsigned char)parameters.padValue[c];
+		}
+		return;
+	}
+	int luma, U = 0, V = 0;
+	if (parameters.filtered) {
+		luma = filterColumn(parameters.filteredY, parameters.dstWidth, parameters.yIndex, parameters.yWeights, parameters.yTaps, row, column);
+		if (parameters.channels == 3) {
+			int pitch = 2 * parameters.pairs;
+			U = filterColumn(parameters.filteredUV, pitch, parameters.yIndexUV, parameters.yWeightsUV, parameters.yTapsUV, row / 2, column & ~1) - 128;
+			V = filterColumn(parameters.filteredUV, pitch, parameters.yIndexUV, parameters.yWeightsUV, parameters.yTapsUV, row / 2, (column & ~1) + 1) - 128;
+		}
+	}
+	else {
+		int x, y, pair, rowUV;
+		int even = column & ~1;
+		if (parameters.resize) {
+			x = parameters.cropX + (int)(parameters.xRatio * column);
+			y = parameters.cropY + (int)(parameters.yRatio * row);
+			pair = (parameters.cropX + (int)(parameters.xRatio * even)) / 2;
+			rowUV = parameters.cropY / 2 + (int)(parameters.yRatio * (row / 2));
+		}
+		else {
+			x = parameters.cropX + column;
+			y = parameters.cropY + row;
+			pair = (parameters.cropX + even) / 2;
+			rowUV = y / 2;
+		}
+		luma = Y[y * pitchY + x];
+		if (parameters.channels == 3) {
+			U = UV[rowUV * pitchUV + 2 * pair] - 128;
+			V = UV[rowUV * pitchUV + 2 * pair + 1] - 128;
+		}
+	}
+	int values[3];
+	if (parameters.channels == 1) {
+		values[0] = luma;
+	}
+	else {
+		ColorCoefficients coefficients = parameters.coefficients;
+		int YVal = coefficients.Y * (luma - coefficients.offsetY);
+		values[parameters.indexR] = min(max((YVal + coefficients.RV * V) >> colorShift, 0), 255);
+		values[1] = min(max((YVal - coefficients.GV * V - coefficients.GU * U) >> colorShift, 0), 255);
+		values[parameters.indexB] = min(max((YVal + coefficients.BU * U) >> colorShift, 0), 255);
+	}
+	for (int c = 0; c < parameters.channels; c++) {
+		void* element = getOutputElement(output, parameters, i, j, c);
+		//separate rounding of multiplication and addition as in normalization table on host
+		if (parameters.type == PIXEL_FLOAT32)
+			*(float*)element = __fadd_rn(__fmul_rn((float)values[c], parameters.scale[c]), parameters.offset[c]);
+		else if (parameters.type == PIXEL_FLOAT16)
+			*(__half*)element = __float2half_rn(__fadd_rn(__fmul_rn((float)values[c], parameters.scale[c]), parameters.offset[c]));
+		else
+			*(unsigned char*)element = (unsigned char)values[c];
+	}
+}
+
+/*
+Crop and nearest resize to dense NV12 or I420 output, coordinates are the same as in fusedKernel. Every thread produces one
+luma pixel, threads of even pixels in even rows produce chroma pair too.
+*/
+__global__ void yuvKernel(unsigned char* Y, unsigned char* UV, int pitchY, int pitchUV, unsigned char* output, FusedParameters parameters) {
+	unsigned int i = blockIdx.y * blockDim.y + threadIdx.y;
+	unsigned int j = blockIdx.x * blockDim.x + threadIdx.x;
+	int width = parameters.dstWidth;
+	int height = parameters.dstHeight;
+	if (i >= height || j >= width)
+		return;
+	int x = parameters.cropX + (parameters.resize ? (int)(parameters.xRatio * j) : (int)j);
+	int y = parameters.cropY + (parameters.resize ? (int)(parameters.yRatio * i) : (int)i);
+	output[(size_t)i * width + j] = Y[y * pitchY + x];
+	if (i % 2 || j % 2)
+		return;
+	int row = i / 2;
+	int rowUV = parameters.cropY / 2 + (parameters.resize ? (int)(parameters.yRatio * row) : row);
+	const unsigned char* pair = UV + rowUV * pitchUV + 2 * (x / 2);
+	unsigned char* chroma = output + (size_t)width * height;
+	if (parameters.layout == LAYOUT_NV12) {
+		chroma[(size_t)row * width + j] = pair[0];
+		chroma[(size_t)row * width + j + 1] = pair[1];
+	}
+	else {
+		int pairs = width / 2;
+		chroma[(size_t)row * pairs + j / 2] = pair[0];
+		chroma[(size_t)(height / 2 + row) * pairs + j / 2] = pair[1];
+	}
+}
+
+__device__ float loadElement(const void* src, int index, int elementSize) {
+	if (elementSize == 4)
+		return ((const float*)src)[index];
+	if (elementSize == 2)
+		return __half2float(((const __half*)src)[index]);
+	return ((const unsigned char*)src)[index];
+}
+
+/*
+Every thread produces one output pixel of pyramid level, the same math as in downscaleAreaCPU
+*/
+__global__ void downscaleAreaKernel(const void* src, int srcWidth, int srcHeight, void* dst, int dstWidth, int dstHeight, int channels,
+	int elementSize, bool planar) {
+	int i = blockIdx.y * blockDim.y + threadIdx.y;
+	int j = blockIdx.x * blockDim.x + threadIdx.x;
+	if (i >= dstHeight || j >= dstWidth)
+		return;
+	float scaleX = (float)srcWidth / dstWidth;
+	float scaleY = (float)srcHeight / dstHeight;
+	int srcPlane = srcWidth * srcHeight;
+	int dstPlane = dstWidth * dstHeight;
+	int firstY = (int)(i * scaleY);
+	int lastY = min((int)ceilf((i + 1) * scaleY), srcHeight);
+	int firstX = (int)(j * scaleX);
+	int lastX = min((int)ceilf((j + 1) * scaleX), srcWidth);
+	for (int c = 0; c < channels; c++) {
+		float sum = 0, total = 0;
+		for (int y = firstY; y < lastY; y++) {
+			float weightY = fminf((i + 1) * scaleY, y + 1.f) - fmaxf(i * scaleY, (float)y);
+			float row = 0, rowTotal = 0;
+			for (int x = firstX; x < lastX; x++) {
+				float weightX = fminf((j + 1) * scaleX, x + 1.f) - fmaxf(j * scaleX, (float)x);
+				int index = planar ? c * srcPlane + y * srcWidth + x : (y * srcWidth + x) * channels + c;
+				row = __fadd_rn(row, __fmul_rn(weightX, loadElement(src, index, elementSize)));
+				rowTotal += weightX;
 			}
-			outputUV[i * dstWidth + j] = calculateBillinearInterpolation(inputUV, indexU, 2, 2, srcLinesizeUV, xFloat, yFloat);
-			outputUV[i * dstWidth + j + 1] = calculateBillinearInterpolation(inputUV, indexV, 2, 2, srcLinesizeUV, xFloat, yFloat);
+			sum = __fadd_rn(sum, __fmul_rn(weightY, row));
+			total = __fadd_rn(total, __fmul_rn(weightY, rowTotal));
+		}
+		float value = __fdiv_rn(sum, total);
+		int index = planar ? c * dstPlane + i * dstWidth + j : (i * dstWidth + j) * channels + c;
+		if (elementSize == 4)
+			((float*)dst)[index] = value;
+		else if (elementSize == 2)
+			((__half*)dst)[index] = __float2half_rn(value);
+		else
+			((unsigned char*)dst)[index] = (unsigned char)fminf(fmaxf(value + 0.5f, 0.f), 255.f);
+	}
+}
+
+int downscaleArea(AVFrame* src, AVFrame* dst, int elementSize, bool planar, int maxThreadsPerBlock, cudaStream_t* stream) {
+	dim3 threadsPerBlock(64, maxThreadsPerBlock / 64);
+	dim3 numBlocks(std::ceil(dst->width / (float)threadsPerBlock.x), std::ceil(dst->height / (float)threadsPerBlock.y));
+	downscaleAreaKernel << <numBlocks, threadsPerBlock, 0, *stream >> > (src->opaque, src->width, src->height, dst->opaque, dst->width, dst->height,
+		src->channels / elementSize, elementSize, planar);
+	dst->channels = src->channels;
+	dst->format = src->format;
+	return cudaGetLastError();
+}
+
+int uploadFilter(const ResizeFilter& filter, DeviceFilter& device) {
+	const FilterTable* tables[] = { &filter.x, &filter.y, &filter.xUV, &filter.yUV };
+	for (int i = 0; i < 4; i++) {
+		device.taps[i] = tables[i]->taps;
+		device.index[i] = nullptr;
+		device.weights[i] = nullptr;
+	}
+	for (int i = 0; i < 4; i++) {
+		size_t indexSize = tables[i]->index.size() * sizeof(int);
+		size_t weightsSize = tables[i]->weights.size() * sizeof(int16_t);
+		cudaError err = cudaMalloc(&device.index[i], indexSize);
+		if (err == cudaSuccess)
+			err = cudaMalloc(&device.weights[i], weightsSize);
+		if (err == cudaSuccess)
+			err = cudaMemcpy(device.index[i], &tables[i]->index[0], indexSize, cudaMemcpyHostToDevice);
+		if (err == cudaSuccess)
+			err = cudaMemcpy(device.weights[i], &tables[i]->weights[0], weightsSize, cudaMemcpyHostToDevice);
+		if (err != cudaSuccess) {
+			freeFilter(device);
+			return err;
 		}
 	}
+	return cudaSuccess;
+}
+
+void freeFilter(DeviceFilter& device) {
+	for (int i = 0; i < 4; i++) {
+		cudaFree(device.index[i]);
+		cudaFree(device.weights[i]);
+		device.index[i] = nullptr;
+		device.weights[i] = nullptr;
+	}
+}
+
+int processPipeline(AVFrame* src, void* output, size_t outputPitch, const VPPPipeline& pipeline, const DeviceFilter* filter, void* scratch,
+	int maxThreadsPerBlock, cudaStream_t * stream) {
+	int pitchY = src->linesize[0] ? src->linesize[0] : src->width;
+	int pitchUV = src->linesize[1] ? src->linesize[1] : src->width;
+	dim3 threadsPerBlock(64, maxThreadsPerBlock / 64);
+	FusedParameters parameters;
+	parameters.cropX = pipeline.cropX;
+	parameters.cropY = pipeline.cropY;
+	parameters.dstWidth = pipeline.dstWidth;
+	parameters.dstHeight = pipeline.dstHeight;
+	parameters.outputWidth = pipeline.outputWidth;
+	parameters.outputHeight = pipeline.outputHeight;
+	parameters.outputPitch = (int)outputPitch;
+	parameters.elementSize = pipeline.getElementSize();
+	parameters.imageX = pipeline.imageX;
+	parameters.imageY = pipeline.imageY;
+	for (int c = 0; c < 3; c++)
+		parameters.padValue[c] = pipeline.padValue[c];
+	parameters.channels = pipeline.channels;
+	parameters.indexR = pipeline.indexR;
+	parameters.indexB = pipeline.indexB;
+	parameters.coefficients = pipeline.coefficients;
+	parameters.type = pipeline.type;
+	parameters.layout = pipeline.layout;
+	for (int c = 0; c < 3; c++) {
+		parameters.scale[c] = pipeline.scale[c];
+		parameters.offset[c] = pipeline.offset[c];
+	}
+	parameters.resize = pipeline.resize;
+	parameters.xRatio = pipeline.xRatio;
+	parameters.yRatio = pipeline.yRatio;
+	if (pipeline.layout == LAYOUT_NV12 || pipeline.layout == LAYOUT_I420) {
+		dim3 blocks(std::ceil(pipeline.dstWidth / (float)threadsPerBlock.x), std::ceil(pipeline.dstHeight / (float)threadsPerBlock.y));
+		yuvKernel << <blocks, threadsPerBlock, 0, *stream >> > (src->data[0], src->data[1], pitchY, pitchUV, (unsigned char*)output, parameters);
+		return cudaGetLastError();
+	}
+	parameters.filtered = filter != nullptr;
+	if (filter) {
+		//horizontal pass for all rows of crop, luma rows are followed by chroma rows in scratch buffer
+		int pairs = (pipeline.dstWidth + 1) / 2;
+		int rowsUV = (pipeline.cropHeight + 1) / 2;
+		short* filteredY = (short*)scratch;
+		short* filteredUV = filteredY + (size_t)pipeline.cropHeight * pipeline.dstWidth;
+		unsigned char* cropY = src->data[0] + pipeline.cropY * pitchY + pipeline.cropX;
+		dim3 blocksY(std::ceil(pipeline.dstWidth / (float)threadsPerBlock.x), std::ceil(pipeline.cropHeight / (float)threadsPerBlock.y));
+		filterRowsKernel << <blocksY, threadsPerBlock, 0, *stream >> > (cropY, pitchY, filter->index[0], filter->weights[0], filter->taps[0],
+			pipeline.dstWidth, 1, pipeline.cropHeight, filteredY);
+		if (pipeline.channels == 3) {
+			unsigned char* cropUV = src->data[1] + (pipeline.cropY / 2) * pitchUV + pipeline.cropX;
+			dim3 blocksUV(std::ceil(2 * pairs / (float)threadsPerBlock.x), std::ceil(rowsUV / (float)threadsPerBlock.y));
+			filterRowsKernel << <blocksUV, threadsPerBlock, 0, *stream >> > (cropUV, pitchUV, filter->index[2], filter->weights[2], filter->taps[2],
+				pairs, 2, rowsUV, filteredUV);
+		}
+		parameters.filteredY = filteredY;
+		parameters.filteredUV = filteredUV;
+		parameters.pairs = pairs;
+		parameters.yIndex = filter->index[1];
+		parameters.yWeights = filter->weights[1];
+		parameters.yTaps = filter->taps[1];
+		parameters.yIndexUV = filter->index[3];
+		parameters.yWeightsUV = filter->weights[3];
+		parameters.yTapsUV = filter->taps[3];
+	}
+	int blockX = std::ceil(pipeline.outputWidth / (float)threadsPerBlock.x);
+	int blockY = std::ceil(pipeline.outputHeight / (float)threadsPerBlock.y);
+	dim3 numBlocks(blockX, blockY);
+	fusedKernel << <numBlocks, threadsPerBlock, 0, *stream >> > (src->data[0], src->data[1], pitchY, pitchUV, output, parameters);
+	return cudaGetLastError();
 }
 
 int resizeNV12Nearest(AVFrame* src, AVFrame* dst, int maxThreadsPerBlock, cudaStream_t * stream) {
-	unsigned char* outputY = nullptr;
-	unsigned char* outputUV = nullptr;
-	cudaError err = cudaMalloc(&outputY, dst->width * dst->height * sizeof(unsigned char)); //in resize we don't change color format
-	err = cudaMalloc(&outputUV, dst->width * (dst->height / 2) * sizeof(unsigned char));
+	unsigned char* outputY = dst->data[0];
+	unsigned char* outputUV = dst->data[1];
 	//need to execute for width and height
 	dim3 threadsPerBlock(64, maxThreadsPerBlock / 64);
 	int blockX = std::ceil(dst->width / (float)threadsPerBlock.x);
@@ -178,16 +494,15 @@ int resizeNV12Nearest(AVFrame* src, AVFrame* dst, int maxThreadsPerBlock, cudaSt
 	resizeNV12NearestKernel << <numBlocks, threadsPerBlock, 0, *stream >> > (src->data[0], src->data[1], outputY, outputUV,
 		                                                              src->width, src->height, src->linesize[0], src->linesize[1], 
 		                                                              dst->width, dst->height, xRatio, yRatio);
-	dst->data[0] = outputY;
-	dst->data[1] = outputUV;
-	return err;
+	return cudaGetLastError();
 }
 
 int resizeNV12Bilinear(AVFrame* src, AVFrame* dst, int maxThreadsPerBlock, cudaStream_t * stream) {
-	unsigned char* outputY = nullptr;
-	unsigned char* outputUV = nullptr;
-	cudaError err = cudaMalloc(&outputY, dst->width * dst->height * sizeof(unsigned char)); //in resize we don't change color format
-	err = cudaMalloc(&outputUV, dst->width * (dst->height / 2) * sizeof(unsigned char));
+	//chroma plane should contain at least 2x2 pairs for interpolation
+	if (src->width < 4 || src->height < 4)
+		return resizeNV12Nearest(src, dst, maxThreadsPerBlock, stream);
+	unsigned char* outputY = dst->data[0];
+	unsigned char* outputUV = dst->data[1];
 	//need to execute for width and height
 	dim3 threadsPerBlock(64, maxThreadsPerBlock / 64);
 	int blockX = std::ceil(dst->width / (float)threadsPerBlock.x);
@@ -198,50 +513,43 @@ int resizeNV12Bilinear(AVFrame* src, AVFrame* dst, int maxThreadsPerBlock, cudaS
 	resizeNV12BilinearKernel << <numBlocks, threadsPerBlock, 0, *stream >> > (src->data[0], src->data[1], outputY, outputUV,
 		src->width, src->height, src->linesize[0], src->linesize[1],
 		dst->width, dst->height, xRatio, yRatio);
-	dst->data[0] = outputY;
-	dst->data[1] = outputUV;
-	return err;
+	return cudaGetLastError();
 }
 
-int NV12ToRGB24(AVFrame* src, AVFrame* dst, int maxThreadsPerBlock, cudaStream_t * stream) {
+int NV12ToRGB24(AVFrame* src, AVFrame* dst, const ColorCoefficients& coefficients, int maxThreadsPerBlock, cudaStream_t * stream) {
 	/*
 	src in GPU nv12, dst in CPU rgb (packed)
 	*/
 	int width = src->width;
 	int height = src->height;
-	unsigned char* RGB = nullptr;
-	clock_t tStart = clock();
-	cudaError err = cudaMalloc(&RGB, dst->channels * width * height * sizeof(unsigned char));
+	unsigned char* RGB = (unsigned char*)dst->opaque;
 	//need to execute for width and height
 	dim3 threadsPerBlock(64, maxThreadsPerBlock / 64);
 	int blockX = std::ceil(dst->channels * width / (float)threadsPerBlock.x);
 	int blockY = std::ceil(dst->height / (float)threadsPerBlock.y);
 	dim3 numBlocks(blockX, blockY);
 	if (src->linesize[0])
-		NV12ToRGB32Kernel << <numBlocks, threadsPerBlock, 0, *stream >> > (src->data[0], src->data[1], RGB, width, height, src->linesize[0], dst->channels * width);
+		NV12ToRGB32Kernel << <numBlocks, threadsPerBlock, 0, *stream >> > (src->data[0], src->data[1], RGB, width, height, src->linesize[0], dst->channels * width, coefficients);
 	else
-		NV12ToRGB32Kernel << <numBlocks, threadsPerBlock, 0, *stream >> > (src->data[0], src->data[1], RGB, width, height, width, dst->channels * width);
-	dst->opaque = RGB;
-	return err;
+		NV12ToRGB32Kernel << <numBlocks, threadsPerBlock, 0, *stream >> > (src->data[0], src->data[1], RGB, width, height, width, dst->channels * width, coefficients);
+	return cudaGetLastError();
 }
 
-int NV12ToBGR24(AVFrame* src, AVFrame* dst, int maxThreadsPerBlock, cudaStream_t * stream) {
+int NV12ToBGR24(AVFrame* src, AVFrame* dst, const ColorCoefficients& coefficients, int maxThreadsPerBlock, cudaStream_t * stream) {
 	/*
 	src in GPU nv12, dst in CPU rgb (packed)
 	*/
 	int width = src->width;
 	int height = src->height;
-	unsigned char* BGR = nullptr;
-	cudaError err = cudaMalloc(&BGR, dst->channels * width * height * sizeof(unsigned char));
+	unsigned char* BGR = (unsigned char*)dst->opaque;
 	//need to execute for width and height
 	dim3 threadsPerBlock(64, maxThreadsPerBlock / 64);
 	int blockX = std::ceil(dst->channels * width / (float)threadsPerBlock.x);
 	int blockY = std::ceil(dst->height / (float)threadsPerBlock.y);
 	dim3 numBlocks(blockX, blockY);
 	if (src->linesize[0])
-		NV12ToBGR32Kernel << <numBlocks, threadsPerBlock, 0, *stream >> > (src->data[0], src->data[1], BGR, width, height, src->linesize[0], dst->channels * width);
+		NV12ToBGR32Kernel << <numBlocks, threadsPerBlock, 0, *stream >> > (src->data[0], src->data[1], BGR, width, height, src->linesize[0], dst->channels * width, coefficients);
 	else
-		NV12ToBGR32Kernel << <numBlocks, threadsPerBlock, 0, *stream >> > (src->data[0], src->data[1], BGR, width, height, width, dst->channels * width);
-	dst->opaque = BGR;
-	return err;
+		NV12ToBGR32Kernel << <numBlocks, threadsPerBlock, 0, *stream >> > (src->data[0], src->data[1], BGR, width, height, width, dst->channels * width, coefficients);
+	return cudaGetLastError();
 }
\ No newline at end of file
@@ -0,0 +1,639 @@
+#include "KernelsCPU.h"
+#include "ThreadPool.h"
+#include "VPPPipeline.h"
+#include <vector>
+#include <algorithm>
+#include <cstring>
+#include <cmath>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#elif defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#endif
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define X86_KERNELS
+#endif
+
+static inline uint8_t clampPixel(int value) {
+	return value < 0 ? 0 : (value > 255 ? 255 : value);
+}
+
+static inline void NV12ToPackedRowScalar(const uint8_t* Y, const uint8_t* UV, uint8_t* output, int width, const ColorCoefficients& coefficients,
+	int indexR, int indexB) {
+	for (int j = 0; j < width; j++) {
+		int YVal = coefficients.Y * (Y[j] - coefficients.offsetY);
+		int U = UV[j & ~1] - 128;
+		int V = UV[(j & ~1) + 1] - 128;
+		output[j * 3 + indexR] = clampPixel((YVal + coefficients.RV * V) >> colorShift);
+		output[j * 3 + 1] = clampPixel((YVal - coefficients.GV * V - coefficients.GU * U) >> colorShift);
+		output[j * 3 + indexB] = clampPixel((YVal + coefficients.BU * U) >> colorShift);
+	}
+}
+
+void NV12ToRGB24RowScalar(const uint8_t* Y, const uint8_t* UV, uint8_t* RGB, int width, const ColorCoefficients& coefficients) {
+	NV12ToPackedRowScalar(Y, UV, RGB, width, coefficients, 0, 2);
+}
+
+void NV12ToBGR24RowScalar(const uint8_t* Y, const uint8_t* UV, uint8_t* BGR, int width, const ColorCoefficients& coefficients) {
+	NV12ToPackedRowScalar(Y, UV, BGR, width, coefficients, 2, 0);
+}
+
+void resizeNearestRowScalar(const uint8_t* src, uint8_t* dst, const int* xIndex, int dstWidth, int srcWidth) {
+	for (int j = 0; j < dstWidth; j++)
+		dst[j] = src[xIndex[j]];
+}
+
+void resizeNearestRowUVScalar(const uint8_t* src, uint8_t* dst, const int* xIndex, int dstWidth, int srcWidth) {
+	for (int j = 0; j < dstWidth; j++) {
+		dst[2 * j] = src[2 * xIndex[j]];
+		dst[2 * j + 1] = src[2 * xIndex[j] + 1];
+	}
+}
+
+void blendRowsScalar(const uint8_t* row0, const uint8_t* row1, uint8_t* dst, int width, int weight) {
+	for (int j = 0; j < width; j++)
+		dst[j] = (row0[j] * (weightOne - weight) + row1[j] * weight + weightOne / 2) >> weightShift;
+}
+
+void resizeBilinearRowScalar(const uint8_t* src, uint8_t* dst, const int* xIndex, const int* xWeight, int dstWidth, int srcWidth) {
+	for (int j = 0; j < dstWidth; j++) {
+		const uint8_t* pixel = src + xIndex[j];
+		dst[j] = (pixel[0] * (weightOne - xWeight[j]) + pixel[1] * xWeight[j] + weightOne / 2) >> weightShift;
+	}
+}
+
+void resizeBilinearRowUVScalar(const uint8_t* src, uint8_t* dst, const int* xIndex, const int* xWeight, int dstWidth, int srcWidth) {
+	for (int j = 0; j < dstWidth; j++) {
+		const uint8_t* pair = src + 2 * xIndex[j];
+		dst[2 * j] = (pair[0] * (weightOne - xWeight[j]) + pair[2] * xWeight[j] + weightOne / 2) >> weightShift;
+		dst[2 * j + 1] = (pair[1] * (weightOne - xWeight[j]) + pair[3] * xWeight[j] + weightOne / 2) >> weightShift;
+	}
+}
+
+void filterRowScalar(const uint8_t* src, int16_t* dst, const int* index, const int16_t* weights, int taps, int dstWidth, int channels) {
+	const int shift = filterShift - intermediateShift;
+	for (int j = 0; j < dstWidth; j++) {
+		const int16_t* weight = weights + j * taps;
+		for (int c = 0; c < channels; c++) {
+			const uint8_t* pixel = src + index[j] * channels + c;
+			int sum = 1 << (shift - 1);
+			for (int t = 0; t < taps; t++)
+				sum += pixel[t * channels] * weight[t];
+			dst[j * channels + c] = (int16_t)(sum >> shift);
+		}
+	}
+}
+
+void filterColumnsRange(const int16_t* const* rows, const int16_t* weights, int taps, uint8_t* dst, int start, int end) {
+	const int shift = filterShift + intermediateShift;
+	for (int j = start; j < end; j++) {
+		int sum = 1 << (shift - 1);
+		for (int t = 0; t < taps; t++)
+			sum += rows[t][j] * weights[t];
+		dst[j] = clampPixel(sum >> shift);
+	}
+}
+
+void filterColumnsScalar(const int16_t* const* rows, const int16_t* weights, int taps, uint8_t* dst, int width) {
+	filterColumnsRange(rows, weights, taps, dst, 0, width);
+}
+
+static const CPUKernels kernelsScalar = {
+	SCALAR,
+	"Scalar",
+	NV12ToRGB24RowScalar,
+	NV12ToBGR24RowScalar,
+	resizeNearestRowScalar,
+	resizeNearestRowUVScalar,
+	blendRowsScalar,
+	resizeBilinearRowScalar,
+	resizeBilinearRowUVScalar,
+	filterRowScalar,
+	filterColumnsScalar
+};
+
+#ifdef X86_KERNELS
+static void cpuid(int output[4], int function) {
+#if defined(_MSC_VER)
+	__cpuidex(output, function, 0);
+#else
+	unsigned int a, b, c, d;
+	__cpuid_count(function, 0, a, b, c, d);
+	output[0] = a;
+	output[1] = b;
+	output[2] = c;
+	output[3] = d;
+#endif
+}
+
+//state of registers enabled by OS, needed for AVX and AVX-512
+static uint64_t xgetbv() {
+#if defined(_MSC_VER)
+	return _xgetbv(0);
+#else
+	unsigned int eax, edx;
+	__asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+	return ((uint64_t)edx << 32) | eax;
+#endif
+}
+
+static CPUInstructionSet detectInstructionSet() {
+	int info[4];
+	cpuid(info, 0);
+	int maxFunction = info[0];
+	if (maxFunction < 1)
+		return SCALAR;
+	cpuid(info, 1);
+	bool sse41 = (info[2] & (1 << 19)) != 0;
+	bool osxsave = (info[2] & (1 << 27)) != 0;
+	bool avx = (info[2] & (1 << 28)) != 0;
+	if (!sse41)
+		return SCALAR;
+	if (!osxsave || !avx || maxFunction < 7)
+		return SSE41;
+	uint64_t xcr0 = xgetbv();
+	//XMM and YMM state
+	if ((xcr0 & 0x6) != 0x6)
+		return SSE41;
+	cpuid(info, 7);
+	bool avx2 = (info[1] & (1 << 5)) != 0;
+	bool avx512f = (info[1] & (1 << 16)) != 0;
+	bool avx512bw = (info[1] & (1 << 30)) != 0;
+	if (!avx2)
+		return SSE41;
+	//opmask, ZMM0-15 upper halves and ZMM16-31 state
+	if (avx512f && avx512bw && (xcr0 & 0xE0) == 0xE0)
+		return AVX512;
+	return AVX2;
+}
+
+static int detectL2CacheSize() {
+	int info[4];
+	cpuid(info, 0x80000000);
+	if ((unsigned int)info[0] < 0x80000006)
+		return 0;
+	//size in KB is stored in bits 31-16 of ECX
+	cpuid(info, 0x80000006);
+	return (((unsigned int)info[2]) >> 16) * 1024;
+}
+#else
+static CPUInstructionSet detectInstructionSet() {
+	return SCALAR;
+}
+
+static int detectL2CacheSize() {
+	return 0;
+}
+#endif
+
+int getL2CacheSize() {
+	static int size = detectL2CacheSize();
+	return size > 0 ? size : 256 * 1024;
+}
+
+int getBandHeight(int bytesPerRow) {
+	//the second half of cache is left for tables and other threads on the same core
+	int rows = getL2CacheSize() / 2 / std::max(bytesPerRow, 1);
+	return std::max(2, rows & ~1);
+}
+
+/*
+Split rows [0, height) to bands and execute function(start, end) for every band, in parallel if pool is set
+*/
+static void processBands(int height, int bytesPerRow, ThreadPool* pool, const std::function<void(int, int)>& function) {
+	int bandHeight = getBandHeight(bytesPerRow);
+	int bands = (height + bandHeight - 1) / bandHeight;
+	if (pool == nullptr || bands <= 1) {
+		function(0, height);
+		return;
+	}
+	pool->parallelFor(bands, [&](int band) {
+		function(band * bandHeight, std::min(height, (band + 1) * bandHeight));
+	});
+}
+
+const CPUKernels* getCPUKernels(CPUInstructionSet instructionSet) {
+	static CPUInstructionSet supported = detectInstructionSet();
+	if (instructionSet > supported)
+		return nullptr;
+	switch (instructionSet) {
+#ifdef X86_KERNELS
+	case SSE41:
+		return &kernelsSSE41;
+	case AVX2:
+		return &kernelsAVX2;
+	case AVX512:
+		return &kernelsAVX512;
+#endif
+	case SCALAR:
+		return &kernelsScalar;
+	default:
+		return nullptr;
+	}
+}
+
+const CPUKernels& getCPUKernels() {
+	static const CPUKernels* best = getCPUKernels(detectInstructionSet());
+	return best ? *best : kernelsScalar;
+}
+
+void NV12ToRGB24CPU(uint8_t* Y, uint8_t* UV, uint8_t* RGB, int width, int height, int pitchNV12, int pitchRGB,
+	const ColorCoefficients& coefficients, ThreadPool* pool) {
+	const CPUKernels& kernels = getCPUKernels();
+	processBands(height, width * 3 / 2 + width * 3, pool, [&](int start, int end) {
+		for (int i = start; i < end; i++)
+			kernels.NV12ToRGB24Row(Y + i * pitchNV12, UV + (i / 2) * pitchNV12, RGB + i * pitchRGB, width, coefficients);
+	});
+}
+
+void NV12ToBGR24CPU(uint8_t* Y, uint8_t* UV, uint8_t* BGR, int width, int height, int pitchNV12, int pitchRGB,
+	const ColorCoefficients& coefficients, ThreadPool* pool) {
+	const CPUKernels& kernels = getCPUKernels();
+	processBands(height, width * 3 / 2 + width * 3, pool, [&](int start, int end) {
+		for (int i = start; i < end; i++)
+			kernels.NV12ToBGR24Row(Y + i * pitchNV12, UV + (i / 2) * pitchNV12, BGR + i * pitchRGB, width, coefficients);
+	});
+}
+
+void resizeNV12NearestCPU(uint8_t* inputY, uint8_t* inputUV, uint8_t* outputY, uint8_t* outputUV,
+	int srcWidth, int srcHeight, int srcLinesizeY, int srcLinesizeUV, int dstWidth, int dstHeight, float xRatio, float yRatio, ThreadPool* pool) {
+	const CPUKernels& kernels = getCPUKernels();
+	//coordinates are calculated the same way as in CUDA kernel, chroma is taken from pair which contains luma coordinate
+	std::vector<int> xIndex(dstWidth);
+	std::vector<int> xIndexUV(dstWidth / 2);
+	for (int j = 0; j < dstWidth; j++)
+		xIndex[j] = (int)(xRatio * j);
+	for (int j = 0; j < dstWidth / 2; j++)
+		xIndexUV[j] = xIndex[2 * j] / 2;
+
+	//band of luma rows [start, end) contains chroma rows [start / 2, end / 2)
+	processBands(dstHeight, dstWidth * 3 / 2 + srcWidth * 3 / 2, pool, [&](int start, int end) {
+		for (int i = start; i < end; i++) {
+			int y = (int)(yRatio * i);
+			kernels.resizeNearestRow(inputY + y * srcLinesizeY, outputY + i * dstWidth, &xIndex[0], dstWidth, srcWidth);
+		}
+		for (int i = start / 2; i < end / 2; i++) {
+			int y = (int)(yRatio * i);
+			kernels.resizeNearestRowUV(inputUV + y * srcLinesizeUV, outputUV + i * dstWidth, &xIndexUV[0], dstWidth / 2, srcWidth / 2);
+		}
+	});
+}
+
+/*
+Source position is ratio * dst index, the second pixel for interpolation is the next one in source
+*/
+static void bilinearTable(float ratio, int dstSize, int srcSize, std::vector<int>& index, std::vector<int>& weight) {
+	index.resize(dstSize);
+	weight.resize(dstSize);
+	for (int j = 0; j < dstSize; j++) {
+		float position = ratio * j;
+		index[j] = (int)position;
+		weight[j] = (int)((position - index[j]) * weightOne);
+		if (index[j] >= srcSize - 1) {
+			index[j] = srcSize - 2;
+			weight[j] = weightOne;
+		}
+	}
+}
+
+void resizeNV12BilinearCPU(uint8_t* inputY, uint8_t* inputUV, uint8_t* outputY, uint8_t* outputUV,
+	int srcWidth, int srcHeight, int srcLinesizeY, int srcLinesizeUV, int dstWidth, int dstHeight, float xRatio, float yRatio, ThreadPool* pool) {
+	//chroma plane should contain at least 2x2 pairs for interpolation
+	if (srcWidth < 4 || srcHeight < 4) {
+		resizeNV12NearestCPU(inputY, inputUV, outputY, outputUV, srcWidth, srcHeight, srcLinesizeY, srcLinesizeUV, dstWidth, dstHeight, xRatio, yRatio, pool);
+		return;
+	}
+	const CPUKernels& kernels = getCPUKernels();
+	std::vector<int> xIndex, xWeight, yIndex, yWeight;
+	std::vector<int> xIndexUV, xWeightUV, yIndexUV, yWeightUV;
+	bilinearTable(xRatio, dstWidth, srcWidth, xIndex, xWeight);
+	bilinearTable(yRatio, dstHeight, srcHeight, yIndex, yWeight);
+	bilinearTable(xRatio, dstWidth / 2, srcWidth / 2, xIndexUV, xWeightUV);
+	bilinearTable(yRatio, dstHeight / 2, srcHeight / 2, yIndexUV, yWeightUV);
+	//every dst row reads 2 source rows
+	processBands(dstHeight, dstWidth * 3 / 2 + srcWidth * 3, pool, [&](int start, int end) {
+		//vertically interpolated source row, own for every band
+		std::vector<uint8_t> row(srcWidth);
+		for (int i = start; i < end; i++) {
+			uint8_t* top = inputY + yIndex[i] * srcLinesizeY;
+			kernels.blendRows(top, top + srcLinesizeY, &row[0], srcWidth, yWeight[i]);
+			kernels.resizeBilinearRow(&row[0], outputY + i * dstWidth, &xIndex[0], &xWeight[0], dstWidth, srcWidth);
+		}
+		for (int i = start / 2; i < end / 2; i++) {
+			uint8_t* top = inputUV + yIndexUV[i] * srcLinesizeUV;
+			kernels.blendRows(top, top + srcLinesizeUV, &row[0], srcWidth / 2 * 2, yWeightUV[i]);
+			kernels.resizeBilinearRowUV(&row[0], outputUV + i * dstWidth, &xIndexUV[0], &xWeightUV[0], dstWidth / 2, srcWidth / 2);
+		}
+	});
+}
+
+/*
+Fill count elements of channel c starting from output with pad value, step is distance between neighbour elements of channel
+*/
+static void fillChannel(uint8_t* output, int count, int step, int c, const VPPPipeline& pipeline) {
+	switch (pipeline.type) {
+	case PIXEL_FLOAT32: {
+		float* dst = (float*)output;
+		for (int j = 0; j < count; j++)
+			dst[j * step] = pipeline.padValue[c];
+		break;
+	}
+	case PIXEL_FLOAT16: {
+		uint16_t value = floatToHalf(pipeline.padValue[c]);
+		uint16_t* dst = (uint16_t*)output;
+		for (int j = 0; j < count; j++)
+			dst[j * step] = value;
+		break;
+	}
+	default: {
+		uint8_t value = (uint8_t)pipeline.padValue[c];
+		uint8_t* dst = output;
+		for (int j = 0; j < count; j++)
+			dst[j * step] = value;
+	}
+	}
+}
+
+/*
+The first element of channel c in output row, rows are pitch bytes apart and planes of CHW layout follow each other
+*/
+static uint8_t* getChannelRow(void* output, size_t pitch, int row, int c, const VPPPipeline& pipeline) {
+	if (pipeline.layout == LAYOUT_CHW)
+		return (uint8_t*)output + (c * (size_t)pipeline.outputHeight + row) * pitch;
+	return (uint8_t*)output + (size_t)row * pitch + c * pipeline.getElementSize();
+}
+
+/*
+Write row of 8 bit pixels packed as in HWC to output row in pipeline's type and layout, image is placed at imageX and
+the rest of row is filled with pad value
+*/
+static void storeRow(const uint8_t* packed, void* output, size_t pitch, int row, const VPPPipeline& pipeline) {
+	int width = pipeline.dstWidth;
+	int channels = pipeline.channels;
+	int elementSize = pipeline.getElementSize();
+	bool planar = pipeline.layout == LAYOUT_CHW;
+	int right = pipeline.outputWidth - pipeline.imageX - width;
+	for (int c = 0; c < channels; c++) {
+		//distance between neighbour elements of channel and position of the first one in output row
+		int step = planar ? 1 : channels;
+		uint8_t* first = getChannelRow(output, pitch, row, c, pipeline);
+		uint8_t* start = first + (size_t)pipeline.imageX * step * elementSize;
+		switch (pipeline.type) {
+		case PIXEL_FLOAT32: {
+			const float* table = &pipeline.normalizationTable[c * 256];
+			float* dst = (float*)start;
+			for (int j = 0; j < width; j++)
+				dst[j * step] = table[packed[j * channels + c]];
+			break;
+		}
+		case PIXEL_FLOAT16: {
+			const uint16_t* table = &pipeline.halfTable[c * 256];
+			uint16_t* dst = (uint16_t*)start;
+			for (int j = 0; j < width; j++)
+				dst[j * step] = table[packed[j * channels + c]];
+			break;
+		}
+		default: {
+			uint8_t* dst = start;
+			for (int j = 0; j < width; j++)
+				dst[j * step] = packed[j * channels + c];
+		}
+		}
+		fillChannel(first, pipeline.imageX, step, c, pipeline);
+		fillChannel(start + (size_t)width * step * elementSize, right, step, c, pipeline);
+	}
+}
+
+/*
+Fill output row above or below image with pad value
+*/
+static void clearRow(void* output, size_t pitch, int row, const VPPPipeline& pipeline) {
+	int step = pipeline.layout == LAYOUT_CHW ? 1 : pipeline.channels;
+	for (int c = 0; c < pipeline.channels; c++)
+		fillChannel(getChannelRow(output, pitch, row, c, pipeline), pipeline.outputWidth, step, c, pipeline);
+}
+
+static inline float loadElement(const uint8_t* src, size_t index) {
+	return src[index];
+}
+
+static inline float loadElement(const float* src, size_t index) {
+	return src[index];
+}
+
+static inline float loadElement(const uint16_t* src, size_t index) {
+	return halfToFloat(src[index]);
+}
+
+static inline void storeElement(uint8_t* dst, size_t index, float value) {
+	dst[index] = (uint8_t)std::min(std::max(value + 0.5f, 0.f), 255.f);
+}
+
+static inline void storeElement(float* dst, size_t index, float value) {
+	dst[index] = value;
+}
+
+static inline void storeElement(uint16_t* dst, size_t index, float value) {
+	dst[index] = floatToHalf(value);
+}
+
+template <class T>
+static void downscaleArea(const T* src, int srcWidth, int srcHeight, T* dst, int dstWidth, int dstHeight, int channels, bool planar,
+	ThreadPool* pool) {
+	float scaleX = (float)srcWidth / dstWidth;
+	float scaleY = (float)srcHeight / dstHeight;
+	size_t srcPlane = (size_t)srcWidth * srcHeight;
+	size_t dstPlane = (size_t)dstWidth * dstHeight;
+	int elementSize = sizeof(T);
+	processBands(dstHeight, (int)((srcWidth * scaleY + dstWidth) * channels * elementSize), pool, [&](int start, int end) {
+		for (int i = start; i < end; i++) {
+			//source rows [i * scaleY, (i + 1) * scaleY) are covered by output row
+			int firstY = (int)(i * scaleY);
+			int lastY = std::min((int)std::ceil((i + 1) * scaleY), srcHeight);
+			for (int j = 0; j < dstWidth; j++) {
+				int firstX = (int)(j * scaleX);
+				int lastX = std::min((int)std::ceil((j + 1) * scaleX), srcWidth);
+				for (int c = 0; c < channels; c++) {
+					float sum = 0, total = 0;
+					for (int y = firstY; y < lastY; y++) {
+						float weightY = std::min((i + 1) * scaleY, y + 1.f) - std::max(i * scaleY, (float)y);
+						float row = 0, rowTotal = 0;
+						for (int x = firstX; x < lastX; x++) {
+							float weightX = std::min((j + 1) * scaleX, x + 1.f) - std::max(j * scaleX, (float)x);
+							size_t index = planar ? c * srcPlane + (size_t)y * srcWidth + x : ((size_t)y * srcWidth + x) * channels + c;
+							row += weightX * loadElement(src, index);
+							rowTotal += weightX;
+						}
+						sum += weightY * row;
+						total += weightY * rowTotal;
+					}
+					size_t index = planar ? c * dstPlane + (size_t)i * dstWidth + j : ((size_t)i * dstWidth + j) * channels + c;
+					storeElement(dst, index, sum / total);
+				}
+			}
+		}
+	});
+}
+
+void downscaleAreaCPU(const void* src, int srcWidth, int srcHeight, void* dst, int dstWidth, int dstHeight, int channels, int elementSize,
+	bool planar, ThreadPool* pool) {
+	switch (elementSize) {
+	case 4:
+		downscaleArea((const float*)src, srcWidth, srcHeight, (float*)dst, dstWidth, dstHeight, channels, planar, pool);
+		break;
+	case 2:
+		downscaleArea((const uint16_t*)src, srcWidth, srcHeight, (uint16_t*)dst, dstWidth, dstHeight, channels, planar, pool);
+		break;
+	default:
+		downscaleArea((const uint8_t*)src, srcWidth, srcHeight, (uint8_t*)dst, dstWidth, dstHeight, channels, planar, pool);
+	}
+}
+
+/*
+Horizontal pass of filter for source rows [first, last) of plane, every result row has x.index.size() * channels elements
+*/
+static void filterRows(const CPUKernels& kernels, const uint8_t* plane, int pitch, int offsetX, int offsetY, const FilterTable& x, int channels,
+	int first, int last, std::vector<int16_t>& rows) {
+	int width = (int)x.index.size();
+	rows.resize((size_t)(last - first) * width * channels);
+	for (int r = first; r < last; r++)
+		kernels.filterRow(plane + (size_t)(offsetY + r) * pitch + offsetX * channels, &rows[(size_t)(r - first) * width * channels],
+			&x.index[0], &x.weights[0], x.taps, width, channels);
+}
+
+/*
+Vertical pass of filter for one output row, rows contain result of horizontal pass starting from source row first
+*/
+static void filterColumns(const CPUKernels& kernels, const std::vector<int16_t>& rows, int first, const FilterTable& y, int row, int width,
+	std::vector<const int16_t*>& pointers, uint8_t* dst) {
+	pointers.resize(y.taps);
+	for (int t = 0; t < y.taps; t++)
+		pointers[t] = &rows[(size_t)(y.index[row] + t - first) * width];
+	kernels.filterColumns(&pointers[0], &y.weights[(size_t)row * y.taps], y.taps, dst, width);
+}
+
+/*
+Crop and nearest resize of source to dense NV12 or I420 output, sizes are even. Band of chroma rows [start, end) contains
+luma rows [2 * start, 2 * end)
+*/
+static void processYUV(const CPUKernels& kernels, const uint8_t* Y, const uint8_t* UV, int pitchY, int pitchUV, int srcWidth, uint8_t* output,
+	const VPPPipeline& pipeline, ThreadPool* pool) {
+	int width = pipeline.dstWidth;
+	int height = pipeline.dstHeight;
+	int pairs = width / 2;
+	uint8_t* outputUV = output + (size_t)width * height;
+	uint8_t* outputV = outputUV + (size_t)pairs * (height / 2);
+	processBands(height / 2, width * 3 + (pipeline.resize ? srcWidth * 3 : 0), pool, [&](int start, int end) {
+		std::vector<uint8_t> rowUV(pipeline.layout == LAYOUT_I420 ? width : 0);
+		for (int i = 2 * start; i < 2 * end; i++) {
+			const uint8_t* srcY = Y + (size_t)pipeline.yIndex[i] * pitchY;
+			if (pipeline.resize)
+				kernels.resizeNearestRow(srcY, output + (size_t)i * width, &pipeline.xIndex[0], width, srcWidth);
+			else
+				memcpy(output + (size_t)i * width, srcY + pipeline.cropX, width);
+		}
+		for (int r = start; r < end; r++) {
+			const uint8_t* srcUV = UV + (size_t)pipeline.yIndexUV[r] * pitchUV;
+			uint8_t* dst = pipeline.layout == LAYOUT_I420 ? &rowUV[0] : outputUV + (size_t)r * width;
+			if (pipeline.resize)
+				kernels.resizeNearestRowUV(srcUV, dst, &pipeline.xIndexUV[0], pairs, srcWidth / 2);
+			else
+				memcpy(dst, srcUV + pipeline.cropX, width);
+			//I420 keeps U and V in own planes
+			if (pipeline.layout == LAYOUT_I420) {
+				for (int j = 0; j < pairs; j++) {
+					outputUV[(size_t)r * pairs + j] = rowUV[2 * j];
+					outputV[(size_t)r * pairs + j] = rowUV[2 * j + 1];
+				}
+			}
+		}
+	});
+}
+
+void processPipelineCPU(const uint8_t* Y, const uint8_t* UV, int pitchY, int pitchUV, int srcWidth, void* output,
+	const VPPPipeline& pipeline, ThreadPool* pool, size_t outputPitch) {
+	const CPUKernels& kernels = getCPUKernels();
+	if (pipeline.layout == LAYOUT_NV12 || pipeline.layout == LAYOUT_I420) {
+		processYUV(kernels, Y, UV, pitchY, pitchUV, srcWidth, (uint8_t*)output, pipeline, pool);
+		return;
+	}
+	if (outputPitch == 0)
+		outputPitch = pipeline.getRowSize();
+	const ResizeFilter* filter = pipeline.filter.get();
+	int width = pipeline.dstWidth;
+	int channels = pipeline.channels;
+	int pairs = (width + 1) / 2;
+	//8 bit packed output without padding is written without scratch row, image starts at column 0 then
+	bool direct = pipeline.type == PIXEL_UINT8 && (pipeline.layout == LAYOUT_HWC || channels == 1) && pipeline.outputWidth == width;
+	int bytesPerRow = pipeline.outputWidth * channels * pipeline.getElementSize() + width * 3;
+	//filter reads all source rows covered by output row and keeps them after horizontal pass
+	if (filter)
+		bytesPerRow += (pipeline.cropHeight / pipeline.dstHeight + 1) * (srcWidth + width * 2) * 3 / 2;
+	else if (pipeline.resize)
+		bytesPerRow += srcWidth * 3 / 2;
+	processBands(pipeline.outputHeight, bytesPerRow, pool, [&](int start, int end) {
+		//resized source rows and result of color conversion, own for every band
+		std::vector<uint8_t> rowY(width), rowUV(2 * pairs), packed(direct ? 0 : width * channels);
+		//horizontally filtered source rows of band, the first source row of luma and chroma
+		std::vector<int16_t> filteredY, filteredUV;
+		std::vector<const int16_t*> pointers;
+		int firstY = 0, firstUV = 0;
+		//image rows which are written by band
+		int first = std::max(start - pipeline.imageY, 0);
+		int last = std::min(end - pipeline.imageY, pipeline.dstHeight);
+		if (filter && first < last) {
+			firstY = filter->y.index[first];
+			filterRows(kernels, Y, pitchY, pipeline.cropX, pipeline.cropY, filter->x, 1, firstY, filter->y.index[last - 1] + filter->y.taps, filteredY);
+			if (channels == 3) {
+				firstUV = filter->yUV.index[first / 2];
+				filterRows(kernels, UV, pitchUV, pipeline.cropX / 2, pipeline.cropY / 2, filter->xUV, 2, firstUV,
+					filter->yUV.index[(last - 1) / 2] + filter->yUV.taps, filteredUV);
+			}
+		}
+		for (int i = start; i < end; i++) {
+			//row of image, output rows out of image are letterbox or padding
+			int r = i - pipeline.imageY;
+			if (r < 0 || r >= pipeline.dstHeight) {
+				clearRow(output, outputPitch, i, pipeline);
+				continue;
+			}
+			const uint8_t* srcY = Y + (size_t)pipeline.yIndex[r] * pitchY;
+			const uint8_t* srcUV = UV + (size_t)pipeline.yIndexUV[r / 2] * pitchUV;
+			uint8_t* dst = direct ? (uint8_t*)output + (size_t)i * outputPitch : &packed[0];
+			if (channels == 1) {
+				if (filter)
+					filterColumns(kernels, filteredY, firstY, filter->y, r, width, pointers, dst);
+				else if (pipeline.resize)
+					kernels.resizeNearestRow(srcY, dst, &pipeline.xIndex[0], width, srcWidth);
+				else
+					memcpy(dst, srcY + pipeline.cropX, width);
+			}
+			else {
+				const uint8_t* pixelsY = srcY + pipeline.cropX;
+				const uint8_t* pixelsUV = srcUV + pipeline.cropX;
+				if (filter) {
+					filterColumns(kernels, filteredY, firstY, filter->y, r, width, pointers, &rowY[0]);
+					//chroma row is shared by pair of luma rows
+					if (r == first || r % 2 == 0)
+						filterColumns(kernels, filteredUV, firstUV, filter->yUV, r / 2, 2 * pairs, pointers, &rowUV[0]);
+					pixelsY = &rowY[0];
+					pixelsUV = &rowUV[0];
+				}
+				else if (pipeline.resize) {
+					kernels.resizeNearestRow(srcY, &rowY[0], &pipeline.xIndex[0], width, srcWidth);
+					kernels.resizeNearestRowUV(srcUV, &rowUV[0], &pipeline.xIndexUV[0], pairs, srcWidth / 2);
+					pixelsY = &rowY[0];
+					pixelsUV = &rowUV[0];
+				}
+				if (pipeline.indexR == 0)
+					kernels.NV12ToRGB24Row(pixelsY, pixelsUV, dst, width, pipeline.coefficients);
+				else
+					kernels.NV12ToBGR24Row(pixelsY, pixelsUV, dst, width, pipeline.coefficients);
+			}
+			if (!direct)
+				storeRow(dst, output, outputPitch, i, pipeline);
+		}
+	});
+}
@@ -0,0 +1,221 @@
+#include "KernelsCPU.h"
+#include "VPPPipeline.h"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#include <immintrin.h>
+
+//instruction set is enabled per function, so the whole library can be built without -mavx2
+#if defined(__GNUC__)
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define TARGET_AVX2
+#endif
+
+TARGET_AVX2 static inline __m256i pairCoefficients(int low, int high) {
+	return _mm256_set1_epi32((int)((uint32_t)(uint16_t)low | ((uint32_t)(uint16_t)high << 16)));
+}
+
+TARGET_AVX2 static inline __m256i madd16(__m256i a, __m256i b, __m256i coefficients) {
+	__m256i low = _mm256_madd_epi16(_mm256_unpacklo_epi16(a, b), coefficients);
+	__m256i high = _mm256_madd_epi16(_mm256_unpackhi_epi16(a, b), coefficients);
+	//unpack and pack work inside 128 bit lanes, so order of pixels is restored here
+	return _mm256_packs_epi32(_mm256_srai_epi32(low, colorShift), _mm256_srai_epi32(high, colorShift));
+}
+
+TARGET_AVX2 static void NV12ToPackedRowAVX2(const uint8_t* Y, const uint8_t* UV, uint8_t* output, int width, const ColorCoefficients& coefficients,
+	int indexR, int indexB) {
+	int8_t rgMask[32], bMask[32];
+	for (int p = 0; p < 24; p++) {
+		int pixel = p / 3;
+		int component = p % 3;
+		rgMask[p] = component == indexR ? pixel : (component == 1 ? 8 + pixel : -128);
+		bMask[p] = component == indexB ? pixel : -128;
+	}
+	const __m128i rgLow = _mm_loadu_si128((__m128i*)rgMask);
+	const __m128i bLow = _mm_loadu_si128((__m128i*)bMask);
+	const __m128i rgHigh = _mm_loadl_epi64((__m128i*)(rgMask + 16));
+	const __m128i bHigh = _mm_loadl_epi64((__m128i*)(bMask + 16));
+	const __m256i duplicateU = _mm256_setr_epi8(0, 1, 0, 1, 4, 5, 4, 5, 8, 9, 8, 9, 12, 13, 12, 13,
+		0, 1, 0, 1, 4, 5, 4, 5, 8, 9, 8, 9, 12, 13, 12, 13);
+	const __m256i duplicateV = _mm256_setr_epi8(2, 3, 2, 3, 6, 7, 6, 7, 10, 11, 10, 11, 14, 15, 14, 15,
+		2, 3, 2, 3, 6, 7, 6, 7, 10, 11, 10, 11, 14, 15, 14, 15);
+	const __m256i coefficientsR = pairCoefficients(coefficients.Y, coefficients.RV);
+	const __m256i coefficientsGV = pairCoefficients(coefficients.Y, -coefficients.GV);
+	const __m256i coefficientsGU = pairCoefficients(-coefficients.GU, 0);
+	const __m256i coefficientsB = pairCoefficients(coefficients.Y, coefficients.BU);
+	const __m256i offsetY = _mm256_set1_epi16(coefficients.offsetY);
+	const __m256i offsetUV = _mm256_set1_epi16(128);
+	const __m256i zero = _mm256_setzero_si256();
+	int j = 0;
+	for (; j + 16 <= width; j += 16) {
+		__m256i y = _mm256_sub_epi16(_mm256_cvtepu8_epi16(_mm_loadu_si128((__m128i*)(Y + j))), offsetY);
+		__m256i uv = _mm256_sub_epi16(_mm256_cvtepu8_epi16(_mm_loadu_si128((__m128i*)(UV + j))), offsetUV);
+		__m256i u = _mm256_shuffle_epi8(uv, duplicateU);
+		__m256i v = _mm256_shuffle_epi8(uv, duplicateV);
+
+		__m256i r = madd16(y, v, coefficientsR);
+		__m256i gLow = _mm256_add_epi32(_mm256_madd_epi16(_mm256_unpacklo_epi16(y, v), coefficientsGV),
+			_mm256_madd_epi16(_mm256_unpacklo_epi16(u, zero), coefficientsGU));
+		__m256i gHigh = _mm256_add_epi32(_mm256_madd_epi16(_mm256_unpackhi_epi16(y, v), coefficientsGV),
+			_mm256_madd_epi16(_mm256_unpackhi_epi16(u, zero), coefficientsGU));
+		__m256i g = _mm256_packs_epi32(_mm256_srai_epi32(gLow, colorShift), _mm256_srai_epi32(gHigh, colorShift));
+		__m256i b = madd16(y, u, coefficientsB);
+
+		//every 128 bit lane contains R and G for 8 pixels
+		__m256i rg = _mm256_packus_epi16(r, g);
+		__m256i bb = _mm256_packus_epi16(b, b);
+		for (int lane = 0; lane < 2; lane++) {
+			__m128i rgLane = lane ? _mm256_extracti128_si256(rg, 1) : _mm256_castsi256_si128(rg);
+			__m128i bLane = lane ? _mm256_extracti128_si256(bb, 1) : _mm256_castsi256_si128(bb);
+			uint8_t* packed = output + 3 * (j + 8 * lane);
+			_mm_storeu_si128((__m128i*)packed, _mm_or_si128(_mm_shuffle_epi8(rgLane, rgLow), _mm_shuffle_epi8(bLane, bLow)));
+			_mm_storel_epi64((__m128i*)(packed + 16), _mm_or_si128(_mm_shuffle_epi8(rgLane, rgHigh), _mm_shuffle_epi8(bLane, bHigh)));
+		}
+	}
+	if (j < width) {
+		if (indexR == 0)
+			NV12ToRGB24RowScalar(Y + j, UV + j, output + 3 * j, width - j, coefficients);
+		else
+			NV12ToBGR24RowScalar(Y + j, UV + j, output + 3 * j, width - j, coefficients);
+	}
+}
+
+TARGET_AVX2 static void NV12ToRGB24RowAVX2(const uint8_t* Y, const uint8_t* UV, uint8_t* RGB, int width, const ColorCoefficients& coefficients) {
+	NV12ToPackedRowAVX2(Y, UV, RGB, width, coefficients, 0, 2);
+}
+
+TARGET_AVX2 static void NV12ToBGR24RowAVX2(const uint8_t* Y, const uint8_t* UV, uint8_t* BGR, int width, const ColorCoefficients& coefficients) {
+	NV12ToPackedRowAVX2(Y, UV, BGR, width, coefficients, 2, 0);
+}
+
+//pack two vectors with 8 int32 values to 16 int16 values in the original order
+TARGET_AVX2 static inline __m256i packOrdered(__m256i low, __m256i high) {
+	return _mm256_permute4x64_epi64(_mm256_packus_epi32(low, high), 0xD8);
+}
+
+/*
+Gather reads 4 bytes for every index, so vectorized part stops when it can read out of source row
+*/
+TARGET_AVX2 static void resizeNearestRowAVX2(const uint8_t* src, uint8_t* dst, const int* xIndex, int dstWidth, int srcWidth) {
+	const __m256i mask = _mm256_set1_epi32(0xFF);
+	int j = 0;
+	for (; j + 16 <= dstWidth && xIndex[j + 15] + 4 <= srcWidth; j += 16) {
+		__m256i low = _mm256_and_si256(_mm256_i32gather_epi32((const int*)src, _mm256_loadu_si256((__m256i*)(xIndex + j)), 1), mask);
+		__m256i high = _mm256_and_si256(_mm256_i32gather_epi32((const int*)src, _mm256_loadu_si256((__m256i*)(xIndex + j + 8)), 1), mask);
+		__m256i packed = packOrdered(low, high);
+		_mm_storeu_si128((__m128i*)(dst + j), _mm_packus_epi16(_mm256_castsi256_si128(packed), _mm256_extracti128_si256(packed, 1)));
+	}
+	resizeNearestRowScalar(src, dst + j, xIndex + j, dstWidth - j, srcWidth);
+}
+
+TARGET_AVX2 static void resizeNearestRowUVAVX2(const uint8_t* src, uint8_t* dst, const int* xIndex, int dstWidth, int srcWidth) {
+	const __m256i mask = _mm256_set1_epi32(0xFFFF);
+	int j = 0;
+	for (; j + 16 <= dstWidth && xIndex[j + 15] + 2 <= srcWidth; j += 16) {
+		__m256i low = _mm256_and_si256(_mm256_i32gather_epi32((const int*)src, _mm256_loadu_si256((__m256i*)(xIndex + j)), 2), mask);
+		__m256i high = _mm256_and_si256(_mm256_i32gather_epi32((const int*)src, _mm256_loadu_si256((__m256i*)(xIndex + j + 8)), 2), mask);
+		_mm256_storeu_si256((__m256i*)(dst + 2 * j), packOrdered(low, high));
+	}
+	resizeNearestRowUVScalar(src, dst + 2 * j, xIndex + j, dstWidth - j, srcWidth);
+}
+
+TARGET_AVX2 static void blendRowsAVX2(const uint8_t* row0, const uint8_t* row1, uint8_t* dst, int width, int weight) {
+	const __m256i weight0 = _mm256_set1_epi16(weightOne - weight);
+	const __m256i weight1 = _mm256_set1_epi16(weight);
+	const __m256i round = _mm256_set1_epi16(weightOne / 2);
+	int j = 0;
+	for (; j + 32 <= width; j += 32) {
+		__m256i result[2];
+		for (int half = 0; half < 2; half++) {
+			__m256i top = _mm256_cvtepu8_epi16(_mm_loadu_si128((__m128i*)(row0 + j + 16 * half)));
+			__m256i bottom = _mm256_cvtepu8_epi16(_mm_loadu_si128((__m128i*)(row1 + j + 16 * half)));
+			__m256i sum = _mm256_add_epi16(_mm256_mullo_epi16(top, weight0), _mm256_mullo_epi16(bottom, weight1));
+			result[half] = _mm256_srli_epi16(_mm256_add_epi16(sum, round), weightShift);
+		}
+		_mm256_storeu_si256((__m256i*)(dst + j), _mm256_permute4x64_epi64(_mm256_packus_epi16(result[0], result[1]), 0xD8));
+	}
+	blendRowsScalar(row0 + j, row1 + j, dst + j, width - j, weight);
+}
+
+TARGET_AVX2 static inline __m256i pairWeights(const int* xWeight) {
+	__m256i weight = _mm256_loadu_si256((__m256i*)xWeight);
+	return _mm256_or_si256(_mm256_sub_epi32(_mm256_set1_epi32(weightOne), weight), _mm256_slli_epi32(weight, 16));
+}
+
+TARGET_AVX2 static void resizeBilinearRowAVX2(const uint8_t* src, uint8_t* dst, const int* xIndex, const int* xWeight, int dstWidth, int srcWidth) {
+	//first 2 of 4 gathered bytes -> int16 pair
+	const __m256i split = _mm256_setr_epi8(0, -128, 1, -128, 4, -128, 5, -128, 8, -128, 9, -128, 12, -128, 13, -128,
+		0, -128, 1, -128, 4, -128, 5, -128, 8, -128, 9, -128, 12, -128, 13, -128);
+	const __m256i round = _mm256_set1_epi32(weightOne / 2);
+	int j = 0;
+	for (; j + 16 <= dstWidth && xIndex[j + 15] + 4 <= srcWidth; j += 16) {
+		__m256i result[2];
+		for (int half = 0; half < 2; half++) {
+			__m256i pixels = _mm256_i32gather_epi32((const int*)src, _mm256_loadu_si256((__m256i*)(xIndex + j + 8 * half)), 1);
+			__m256i sum = _mm256_madd_epi16(_mm256_shuffle_epi8(pixels, split), pairWeights(xWeight + j + 8 * half));
+			result[half] = _mm256_srli_epi32(_mm256_add_epi32(sum, round), weightShift);
+		}
+		__m256i packed = packOrdered(result[0], result[1]);
+		_mm_storeu_si128((__m128i*)(dst + j), _mm_packus_epi16(_mm256_castsi256_si128(packed), _mm256_extracti128_si256(packed, 1)));
+	}
+	resizeBilinearRowScalar(src, dst + j, xIndex + j, xWeight + j, dstWidth - j, srcWidth);
+}
+
+TARGET_AVX2 static void resizeBilinearRowUVAVX2(const uint8_t* src, uint8_t* dst, const int* xIndex, const int* xWeight, int dstWidth, int srcWidth) {
+	//U0 V0 U1 V1 -> (U0, U1) (V0, V1) as int16 pairs
+	const __m256i splitLow = _mm256_setr_epi8(0, -128, 2, -128, 1, -128, 3, -128, 4, -128, 6, -128, 5, -128, 7, -128,
+		0, -128, 2, -128, 1, -128, 3, -128, 4, -128, 6, -128, 5, -128, 7, -128);
+	const __m256i splitHigh = _mm256_setr_epi8(8, -128, 10, -128, 9, -128, 11, -128, 12, -128, 14, -128, 13, -128, 15, -128,
+		8, -128, 10, -128, 9, -128, 11, -128, 12, -128, 14, -128, 13, -128, 15, -128);
+	const __m256i round = _mm256_set1_epi32(weightOne / 2);
+	int j = 0;
+	for (; j + 8 <= dstWidth && xIndex[j + 7] + 2 <= srcWidth; j += 8) {
+		__m256i pixels = _mm256_i32gather_epi32((const int*)src, _mm256_loadu_si256((__m256i*)(xIndex + j)), 2);
+		__m256i weights = pairWeights(xWeight + j);
+		__m256i low = _mm256_madd_epi16(_mm256_shuffle_epi8(pixels, splitLow), _mm256_unpacklo_epi32(weights, weights));
+		__m256i high = _mm256_madd_epi16(_mm256_shuffle_epi8(pixels, splitHigh), _mm256_unpackhi_epi32(weights, weights));
+		low = _mm256_srli_epi32(_mm256_add_epi32(low, round), weightShift);
+		high = _mm256_srli_epi32(_mm256_add_epi32(high, round), weightShift);
+		//pack inside lanes keeps pairs order: lane 0 contains pairs 0-3, lane 1 contains pairs 4-7
+		__m256i packed = _mm256_packs_epi32(low, high);
+		_mm_storeu_si128((__m128i*)(dst + 2 * j), _mm_packus_epi16(_mm256_castsi256_si128(packed), _mm256_extracti128_si256(packed, 1)));
+	}
+	resizeBilinearRowUVScalar(src, dst + 2 * j, xIndex + j, xWeight + j, dstWidth - j, srcWidth);
+}
+
+TARGET_AVX2 static void filterColumnsAVX2(const int16_t* const* rows, const int16_t* weights, int taps, uint8_t* dst, int width) {
+	const int shift = filterShift + intermediateShift;
+	const __m256i round = _mm256_set1_epi32(1 << (shift - 1));
+	int j = 0;
+	for (; j + 16 <= width; j += 16) {
+		__m256i low = round;
+		__m256i high = round;
+		for (int t = 0; t < taps; t += 2) {
+			__m256i row0 = _mm256_loadu_si256((__m256i*)(rows[t] + j));
+			__m256i row1 = t + 1 < taps ? _mm256_loadu_si256((__m256i*)(rows[t + 1] + j)) : _mm256_setzero_si256();
+			__m256i weight = pairCoefficients(weights[t], t + 1 < taps ? weights[t + 1] : 0);
+			low = _mm256_add_epi32(low, _mm256_madd_epi16(_mm256_unpacklo_epi16(row0, row1), weight));
+			high = _mm256_add_epi32(high, _mm256_madd_epi16(_mm256_unpackhi_epi16(row0, row1), weight));
+		}
+		//unpack and pack work inside 128 bit lanes, so the first pack restores order of pixels, the second one duplicates lanes
+		__m256i result = _mm256_packs_epi32(_mm256_srai_epi32(low, shift), _mm256_srai_epi32(high, shift));
+		result = _mm256_permute4x64_epi64(_mm256_packus_epi16(result, result), 0x08);
+		_mm_storeu_si128((__m128i*)(dst + j), _mm256_castsi256_si128(result));
+	}
+	filterColumnsRange(rows, weights, taps, dst, j, width);
+}
+
+const CPUKernels kernelsAVX2 = {
+	AVX2,
+	"AVX2",
+	NV12ToRGB24RowAVX2,
+	NV12ToBGR24RowAVX2,
+	resizeNearestRowAVX2,
+	resizeNearestRowUVAVX2,
+	blendRowsAVX2,
+	resizeBilinearRowAVX2,
+	resizeBilinearRowUVAVX2,
+	filterRowScalar,
+	filterColumnsAVX2
+};
+#endif
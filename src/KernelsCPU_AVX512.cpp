@@ -0,0 +1,208 @@
+#include "KernelsCPU.h"
+#include "VPPPipeline.h"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#include <immintrin.h>
+
+//instruction set is enabled per function, so the whole library can be built without -mavx512bw
+#if defined(__GNUC__)
+#define TARGET_AVX512 __attribute__((target("avx512f,avx512bw")))
+#else
+#define TARGET_AVX512
+#endif
+
+TARGET_AVX512 static inline __m512i pairCoefficients(int low, int high) {
+	return _mm512_set1_epi32((int)((uint32_t)(uint16_t)low | ((uint32_t)(uint16_t)high << 16)));
+}
+
+TARGET_AVX512 static inline __m512i madd32(__m512i a, __m512i b, __m512i coefficients) {
+	__m512i low = _mm512_madd_epi16(_mm512_unpacklo_epi16(a, b), coefficients);
+	__m512i high = _mm512_madd_epi16(_mm512_unpackhi_epi16(a, b), coefficients);
+	return _mm512_packs_epi32(_mm512_srai_epi32(low, colorShift), _mm512_srai_epi32(high, colorShift));
+}
+
+//the same mask in every 128 bit lane
+TARGET_AVX512 static inline __m512i laneMask(const int8_t* mask) {
+	return _mm512_broadcast_i32x4(_mm_loadu_si128((__m128i*)mask));
+}
+
+TARGET_AVX512 static void NV12ToPackedRowAVX512(const uint8_t* Y, const uint8_t* UV, uint8_t* output, int width, const ColorCoefficients& coefficients,
+	int indexR, int indexB) {
+	int8_t rgMask[32], bMask[32];
+	for (int p = 0; p < 24; p++) {
+		int pixel = p / 3;
+		int component = p % 3;
+		rgMask[p] = component == indexR ? pixel : (component == 1 ? 8 + pixel : -128);
+		bMask[p] = component == indexB ? pixel : -128;
+	}
+	const __m128i rgLow = _mm_loadu_si128((__m128i*)rgMask);
+	const __m128i bLow = _mm_loadu_si128((__m128i*)bMask);
+	const __m128i rgHigh = _mm_loadl_epi64((__m128i*)(rgMask + 16));
+	const __m128i bHigh = _mm_loadl_epi64((__m128i*)(bMask + 16));
+	const int8_t duplicateUMask[16] = { 0, 1, 0, 1, 4, 5, 4, 5, 8, 9, 8, 9, 12, 13, 12, 13 };
+	const int8_t duplicateVMask[16] = { 2, 3, 2, 3, 6, 7, 6, 7, 10, 11, 10, 11, 14, 15, 14, 15 };
+	const __m512i duplicateU = laneMask(duplicateUMask);
+	const __m512i duplicateV = laneMask(duplicateVMask);
+	const __m512i coefficientsR = pairCoefficients(coefficients.Y, coefficients.RV);
+	const __m512i coefficientsGV = pairCoefficients(coefficients.Y, -coefficients.GV);
+	const __m512i coefficientsGU = pairCoefficients(-coefficients.GU, 0);
+	const __m512i coefficientsB = pairCoefficients(coefficients.Y, coefficients.BU);
+	const __m512i offsetY = _mm512_set1_epi16(coefficients.offsetY);
+	const __m512i offsetUV = _mm512_set1_epi16(128);
+	const __m512i zero = _mm512_setzero_si512();
+	int j = 0;
+	for (; j + 32 <= width; j += 32) {
+		__m512i y = _mm512_sub_epi16(_mm512_cvtepu8_epi16(_mm256_loadu_si256((__m256i*)(Y + j))), offsetY);
+		__m512i uv = _mm512_sub_epi16(_mm512_cvtepu8_epi16(_mm256_loadu_si256((__m256i*)(UV + j))), offsetUV);
+		__m512i u = _mm512_shuffle_epi8(uv, duplicateU);
+		__m512i v = _mm512_shuffle_epi8(uv, duplicateV);
+
+		__m512i r = madd32(y, v, coefficientsR);
+		__m512i gLow = _mm512_add_epi32(_mm512_madd_epi16(_mm512_unpacklo_epi16(y, v), coefficientsGV),
+			_mm512_madd_epi16(_mm512_unpacklo_epi16(u, zero), coefficientsGU));
+		__m512i gHigh = _mm512_add_epi32(_mm512_madd_epi16(_mm512_unpackhi_epi16(y, v), coefficientsGV),
+			_mm512_madd_epi16(_mm512_unpackhi_epi16(u, zero), coefficientsGU));
+		__m512i g = _mm512_packs_epi32(_mm512_srai_epi32(gLow, colorShift), _mm512_srai_epi32(gHigh, colorShift));
+		__m512i b = madd32(y, u, coefficientsB);
+
+		//every 128 bit lane contains R and G for 8 pixels
+		__m512i rg = _mm512_packus_epi16(r, g);
+		__m512i bb = _mm512_packus_epi16(b, b);
+		__m128i rgLanes[4] = { _mm512_extracti32x4_epi32(rg, 0), _mm512_extracti32x4_epi32(rg, 1), _mm512_extracti32x4_epi32(rg, 2), _mm512_extracti32x4_epi32(rg, 3) };
+		__m128i bLanes[4] = { _mm512_extracti32x4_epi32(bb, 0), _mm512_extracti32x4_epi32(bb, 1), _mm512_extracti32x4_epi32(bb, 2), _mm512_extracti32x4_epi32(bb, 3) };
+		for (int lane = 0; lane < 4; lane++) {
+			uint8_t* packed = output + 3 * (j + 8 * lane);
+			_mm_storeu_si128((__m128i*)packed, _mm_or_si128(_mm_shuffle_epi8(rgLanes[lane], rgLow), _mm_shuffle_epi8(bLanes[lane], bLow)));
+			_mm_storel_epi64((__m128i*)(packed + 16), _mm_or_si128(_mm_shuffle_epi8(rgLanes[lane], rgHigh), _mm_shuffle_epi8(bLanes[lane], bHigh)));
+		}
+	}
+	if (j < width) {
+		if (indexR == 0)
+			NV12ToRGB24RowScalar(Y + j, UV + j, output + 3 * j, width - j, coefficients);
+		else
+			NV12ToBGR24RowScalar(Y + j, UV + j, output + 3 * j, width - j, coefficients);
+	}
+}
+
+TARGET_AVX512 static void NV12ToRGB24RowAVX512(const uint8_t* Y, const uint8_t* UV, uint8_t* RGB, int width, const ColorCoefficients& coefficients) {
+	NV12ToPackedRowAVX512(Y, UV, RGB, width, coefficients, 0, 2);
+}
+
+TARGET_AVX512 static void NV12ToBGR24RowAVX512(const uint8_t* Y, const uint8_t* UV, uint8_t* BGR, int width, const ColorCoefficients& coefficients) {
+	NV12ToPackedRowAVX512(Y, UV, BGR, width, coefficients, 2, 0);
+}
+
+/*
+Gather reads 4 bytes for every index, so vectorized part stops when it can read out of source row
+*/
+TARGET_AVX512 static void resizeNearestRowAVX512(const uint8_t* src, uint8_t* dst, const int* xIndex, int dstWidth, int srcWidth) {
+	int j = 0;
+	for (; j + 16 <= dstWidth && xIndex[j + 15] + 4 <= srcWidth; j += 16) {
+		__m512i pixels = _mm512_i32gather_epi32(_mm512_loadu_si512(xIndex + j), src, 1);
+		//truncation keeps only the first byte
+		_mm_storeu_si128((__m128i*)(dst + j), _mm512_cvtepi32_epi8(pixels));
+	}
+	resizeNearestRowScalar(src, dst + j, xIndex + j, dstWidth - j, srcWidth);
+}
+
+TARGET_AVX512 static void resizeNearestRowUVAVX512(const uint8_t* src, uint8_t* dst, const int* xIndex, int dstWidth, int srcWidth) {
+	int j = 0;
+	for (; j + 16 <= dstWidth && xIndex[j + 15] + 2 <= srcWidth; j += 16) {
+		__m512i pixels = _mm512_i32gather_epi32(_mm512_loadu_si512(xIndex + j), src, 2);
+		_mm256_storeu_si256((__m256i*)(dst + 2 * j), _mm512_cvtepi32_epi16(pixels));
+	}
+	resizeNearestRowUVScalar(src, dst + 2 * j, xIndex + j, dstWidth - j, srcWidth);
+}
+
+TARGET_AVX512 static void blendRowsAVX512(const uint8_t* row0, const uint8_t* row1, uint8_t* dst, int width, int weight) {
+	const __m512i weight0 = _mm512_set1_epi16(weightOne - weight);
+	const __m512i weight1 = _mm512_set1_epi16(weight);
+	const __m512i round = _mm512_set1_epi16(weightOne / 2);
+	int j = 0;
+	for (; j + 32 <= width; j += 32) {
+		__m512i top = _mm512_cvtepu8_epi16(_mm256_loadu_si256((__m256i*)(row0 + j)));
+		__m512i bottom = _mm512_cvtepu8_epi16(_mm256_loadu_si256((__m256i*)(row1 + j)));
+		__m512i sum = _mm512_add_epi16(_mm512_mullo_epi16(top, weight0), _mm512_mullo_epi16(bottom, weight1));
+		sum = _mm512_srli_epi16(_mm512_add_epi16(sum, round), weightShift);
+		_mm256_storeu_si256((__m256i*)(dst + j), _mm512_cvtepi16_epi8(sum));
+	}
+	blendRowsScalar(row0 + j, row1 + j, dst + j, width - j, weight);
+}
+
+TARGET_AVX512 static inline __m512i pairWeights(const int* xWeight) {
+	__m512i weight = _mm512_loadu_si512(xWeight);
+	return _mm512_or_si512(_mm512_sub_epi32(_mm512_set1_epi32(weightOne), weight), _mm512_slli_epi32(weight, 16));
+}
+
+TARGET_AVX512 static void resizeBilinearRowAVX512(const uint8_t* src, uint8_t* dst, const int* xIndex, const int* xWeight, int dstWidth, int srcWidth) {
+	//first 2 of 4 gathered bytes -> int16 pair
+	const int8_t splitMask[16] = { 0, -128, 1, -128, 4, -128, 5, -128, 8, -128, 9, -128, 12, -128, 13, -128 };
+	const __m512i split = laneMask(splitMask);
+	const __m512i round = _mm512_set1_epi32(weightOne / 2);
+	int j = 0;
+	for (; j + 16 <= dstWidth && xIndex[j + 15] + 4 <= srcWidth; j += 16) {
+		__m512i pixels = _mm512_i32gather_epi32(_mm512_loadu_si512(xIndex + j), src, 1);
+		__m512i sum = _mm512_madd_epi16(_mm512_shuffle_epi8(pixels, split), pairWeights(xWeight + j));
+		sum = _mm512_srli_epi32(_mm512_add_epi32(sum, round), weightShift);
+		_mm_storeu_si128((__m128i*)(dst + j), _mm512_cvtepi32_epi8(sum));
+	}
+	resizeBilinearRowScalar(src, dst + j, xIndex + j, xWeight + j, dstWidth - j, srcWidth);
+}
+
+TARGET_AVX512 static void resizeBilinearRowUVAVX512(const uint8_t* src, uint8_t* dst, const int* xIndex, const int* xWeight, int dstWidth, int srcWidth) {
+	//U0 V0 U1 V1 -> (U0, U1) (V0, V1) as int16 pairs
+	const int8_t splitLowMask[16] = { 0, -128, 2, -128, 1, -128, 3, -128, 4, -128, 6, -128, 5, -128, 7, -128 };
+	const int8_t splitHighMask[16] = { 8, -128, 10, -128, 9, -128, 11, -128, 12, -128, 14, -128, 13, -128, 15, -128 };
+	const __m512i splitLow = laneMask(splitLowMask);
+	const __m512i splitHigh = laneMask(splitHighMask);
+	const __m512i round = _mm512_set1_epi32(weightOne / 2);
+	int j = 0;
+	for (; j + 16 <= dstWidth && xIndex[j + 15] + 2 <= srcWidth; j += 16) {
+		__m512i pixels = _mm512_i32gather_epi32(_mm512_loadu_si512(xIndex + j), src, 2);
+		__m512i weights = pairWeights(xWeight + j);
+		__m512i low = _mm512_madd_epi16(_mm512_shuffle_epi8(pixels, splitLow), _mm512_unpacklo_epi32(weights, weights));
+		__m512i high = _mm512_madd_epi16(_mm512_shuffle_epi8(pixels, splitHigh), _mm512_unpackhi_epi32(weights, weights));
+		low = _mm512_srli_epi32(_mm512_add_epi32(low, round), weightShift);
+		high = _mm512_srli_epi32(_mm512_add_epi32(high, round), weightShift);
+		//pack inside lanes keeps pairs order, every lane contains 4 pairs
+		_mm256_storeu_si256((__m256i*)(dst + 2 * j), _mm512_cvtepi16_epi8(_mm512_packs_epi32(low, high)));
+	}
+	resizeBilinearRowUVScalar(src, dst + 2 * j, xIndex + j, xWeight + j, dstWidth - j, srcWidth);
+}
+
+TARGET_AVX512 static void filterColumnsAVX512(const int16_t* const* rows, const int16_t* weights, int taps, uint8_t* dst, int width) {
+	const int shift = filterShift + intermediateShift;
+	const __m512i round = _mm512_set1_epi32(1 << (shift - 1));
+	int j = 0;
+	for (; j + 32 <= width; j += 32) {
+		__m512i low = round;
+		__m512i high = round;
+		for (int t = 0; t < taps; t += 2) {
+			__m512i row0 = _mm512_loadu_si512(rows[t] + j);
+			__m512i row1 = t + 1 < taps ? _mm512_loadu_si512(rows[t + 1] + j) : _mm512_setzero_si512();
+			__m512i weight = pairCoefficients(weights[t], t + 1 < taps ? weights[t + 1] : 0);
+			low = _mm512_add_epi32(low, _mm512_madd_epi16(_mm512_unpacklo_epi16(row0, row1), weight));
+			high = _mm512_add_epi32(high, _mm512_madd_epi16(_mm512_unpackhi_epi16(row0, row1), weight));
+		}
+		//pack inside lanes restores order of pixels, negative values are clamped before unsigned saturation
+		__m512i result = _mm512_packs_epi32(_mm512_srai_epi32(low, shift), _mm512_srai_epi32(high, shift));
+		result = _mm512_max_epi16(result, _mm512_setzero_si512());
+		_mm256_storeu_si256((__m256i*)(dst + j), _mm512_cvtusepi16_epi8(result));
+	}
+	filterColumnsRange(rows, weights, taps, dst, j, width);
+}
+
+const CPUKernels kernelsAVX512 = {
+	AVX512,
+	"AVX-512",
+	NV12ToRGB24RowAVX512,
+	NV12ToBGR24RowAVX512,
+	resizeNearestRowAVX512,
+	resizeNearestRowUVAVX512,
+	blendRowsAVX512,
+	resizeBilinearRowAVX512,
+	resizeBilinearRowUVAVX512,
+	filterRowScalar,
+	filterColumnsAVX512
+};
+#endif
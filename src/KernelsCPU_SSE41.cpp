@@ -0,0 +1,248 @@
+#include "KernelsCPU.h"
+#include "VPPPipeline.h"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#include <immintrin.h>
+#include <cstring>
+
+//instruction set is enabled per function, so the whole library can be built without -msse4.1
+#if defined(__GNUC__)
+#define TARGET_SSE41 __attribute__((target("sse4.1")))
+#else
+#define TARGET_SSE41
+#endif
+
+/*
+Masks for shuffling 8 R, G, B values to 24 packed bytes, rg contains R in low half and G in high half, bb contains B in low half
+*/
+struct PackedMasks {
+	__m128i rgLow;
+	__m128i bLow;
+	__m128i rgHigh;
+	__m128i bHigh;
+};
+
+TARGET_SSE41 static PackedMasks packedMasks(int indexR, int indexB) {
+	int8_t rg[24], b[24];
+	for (int p = 0; p < 24; p++) {
+		int pixel = p / 3;
+		int component = p % 3;
+		rg[p] = component == indexR ? pixel : (component == 1 ? 8 + pixel : -128);
+		b[p] = component == indexB ? pixel : -128;
+	}
+	PackedMasks masks;
+	masks.rgLow = _mm_loadu_si128((__m128i*)rg);
+	masks.bLow = _mm_loadu_si128((__m128i*)b);
+	masks.rgHigh = _mm_loadl_epi64((__m128i*)(rg + 16));
+	masks.bHigh = _mm_loadl_epi64((__m128i*)(b + 16));
+	return masks;
+}
+
+TARGET_SSE41 static inline __m128i pairCoefficients(int low, int high) {
+	return _mm_set1_epi32((int)((uint32_t)(uint16_t)low | ((uint32_t)(uint16_t)high << 16)));
+}
+
+//(a * coefficient + b * coefficient) >> colorShift for 8 pixels, result is int16
+TARGET_SSE41 static inline __m128i madd8(__m128i a, __m128i b, __m128i coefficients) {
+	__m128i low = _mm_madd_epi16(_mm_unpacklo_epi16(a, b), coefficients);
+	__m128i high = _mm_madd_epi16(_mm_unpackhi_epi16(a, b), coefficients);
+	return _mm_packs_epi32(_mm_srai_epi32(low, colorShift), _mm_srai_epi32(high, colorShift));
+}
+
+TARGET_SSE41 static void NV12ToPackedRowSSE41(const uint8_t* Y, const uint8_t* UV, uint8_t* output, int width, const ColorCoefficients& coefficients,
+	int indexR, int indexB) {
+	PackedMasks masks = packedMasks(indexR, indexB);
+	const __m128i duplicateU = _mm_setr_epi8(0, 1, 0, 1, 4, 5, 4, 5, 8, 9, 8, 9, 12, 13, 12, 13);
+	const __m128i duplicateV = _mm_setr_epi8(2, 3, 2, 3, 6, 7, 6, 7, 10, 11, 10, 11, 14, 15, 14, 15);
+	const __m128i coefficientsR = pairCoefficients(coefficients.Y, coefficients.RV);
+	const __m128i coefficientsGV = pairCoefficients(coefficients.Y, -coefficients.GV);
+	const __m128i coefficientsGU = pairCoefficients(-coefficients.GU, 0);
+	const __m128i coefficientsB = pairCoefficients(coefficients.Y, coefficients.BU);
+	const __m128i offsetY = _mm_set1_epi16(coefficients.offsetY);
+	const __m128i offsetUV = _mm_set1_epi16(128);
+	const __m128i zero = _mm_setzero_si128();
+	int j = 0;
+	for (; j + 8 <= width; j += 8) {
+		__m128i y = _mm_sub_epi16(_mm_cvtepu8_epi16(_mm_loadl_epi64((__m128i*)(Y + j))), offsetY);
+		__m128i uv = _mm_sub_epi16(_mm_cvtepu8_epi16(_mm_loadl_epi64((__m128i*)(UV + j))), offsetUV);
+		__m128i u = _mm_shuffle_epi8(uv, duplicateU);
+		__m128i v = _mm_shuffle_epi8(uv, duplicateV);
+
+		__m128i r = madd8(y, v, coefficientsR);
+		//G has 3 terms, so sum is calculated before shift
+		__m128i gLow = _mm_add_epi32(_mm_madd_epi16(_mm_unpacklo_epi16(y, v), coefficientsGV), _mm_madd_epi16(_mm_unpacklo_epi16(u, zero), coefficientsGU));
+		__m128i gHigh = _mm_add_epi32(_mm_madd_epi16(_mm_unpackhi_epi16(y, v), coefficientsGV), _mm_madd_epi16(_mm_unpackhi_epi16(u, zero), coefficientsGU));
+		__m128i g = _mm_packs_epi32(_mm_srai_epi32(gLow, colorShift), _mm_srai_epi32(gHigh, colorShift));
+		__m128i b = madd8(y, u, coefficientsB);
+
+		__m128i rg = _mm_packus_epi16(r, g);
+		__m128i bb = _mm_packus_epi16(b, b);
+		__m128i low = _mm_or_si128(_mm_shuffle_epi8(rg, masks.rgLow), _mm_shuffle_epi8(bb, masks.bLow));
+		__m128i high = _mm_or_si128(_mm_shuffle_epi8(rg, masks.rgHigh), _mm_shuffle_epi8(bb, masks.bHigh));
+		_mm_storeu_si128((__m128i*)(output + 3 * j), low);
+		_mm_storel_epi64((__m128i*)(output + 3 * j + 16), high);
+	}
+	if (j < width) {
+		if (indexR == 0)
+			NV12ToRGB24RowScalar(Y + j, UV + j, output + 3 * j, width - j, coefficients);
+		else
+			NV12ToBGR24RowScalar(Y + j, UV + j, output + 3 * j, width - j, coefficients);
+	}
+}
+
+TARGET_SSE41 static void NV12ToRGB24RowSSE41(const uint8_t* Y, const uint8_t* UV, uint8_t* RGB, int width, const ColorCoefficients& coefficients) {
+	NV12ToPackedRowSSE41(Y, UV, RGB, width, coefficients, 0, 2);
+}
+
+TARGET_SSE41 static void NV12ToBGR24RowSSE41(const uint8_t* Y, const uint8_t* UV, uint8_t* BGR, int width, const ColorCoefficients& coefficients) {
+	NV12ToPackedRowSSE41(Y, UV, BGR, width, coefficients, 2, 0);
+}
+
+//there is no gather in SSE, so pixels are inserted one by one
+TARGET_SSE41 static void resizeNearestRowSSE41(const uint8_t* src, uint8_t* dst, const int* xIndex, int dstWidth, int srcWidth) {
+	int j = 0;
+	for (; j + 16 <= dstWidth; j += 16) {
+		const int* index = xIndex + j;
+		__m128i result = _mm_cvtsi32_si128(src[index[0]]);
+		result = _mm_insert_epi8(result, src[index[1]], 1);
+		result = _mm_insert_epi8(result, src[index[2]], 2);
+		result = _mm_insert_epi8(result, src[index[3]], 3);
+		result = _mm_insert_epi8(result, src[index[4]], 4);
+		result = _mm_insert_epi8(result, src[index[5]], 5);
+		result = _mm_insert_epi8(result, src[index[6]], 6);
+		result = _mm_insert_epi8(result, src[index[7]], 7);
+		result = _mm_insert_epi8(result, src[index[8]], 8);
+		result = _mm_insert_epi8(result, src[index[9]], 9);
+		result = _mm_insert_epi8(result, src[index[10]], 10);
+		result = _mm_insert_epi8(result, src[index[11]], 11);
+		result = _mm_insert_epi8(result, src[index[12]], 12);
+		result = _mm_insert_epi8(result, src[index[13]], 13);
+		result = _mm_insert_epi8(result, src[index[14]], 14);
+		result = _mm_insert_epi8(result, src[index[15]], 15);
+		_mm_storeu_si128((__m128i*)(dst + j), result);
+	}
+	resizeNearestRowScalar(src, dst + j, xIndex + j, dstWidth - j, srcWidth);
+}
+
+TARGET_SSE41 static inline int loadPair(const uint8_t* src) {
+	uint16_t pair;
+	memcpy(&pair, src, sizeof(pair));
+	return pair;
+}
+
+TARGET_SSE41 static void resizeNearestRowUVSSE41(const uint8_t* src, uint8_t* dst, const int* xIndex, int dstWidth, int srcWidth) {
+	int j = 0;
+	for (; j + 8 <= dstWidth; j += 8) {
+		const int* index = xIndex + j;
+		__m128i result = _mm_cvtsi32_si128(loadPair(src + 2 * index[0]));
+		result = _mm_insert_epi16(result, loadPair(src + 2 * index[1]), 1);
+		result = _mm_insert_epi16(result, loadPair(src + 2 * index[2]), 2);
+		result = _mm_insert_epi16(result, loadPair(src + 2 * index[3]), 3);
+		result = _mm_insert_epi16(result, loadPair(src + 2 * index[4]), 4);
+		result = _mm_insert_epi16(result, loadPair(src + 2 * index[5]), 5);
+		result = _mm_insert_epi16(result, loadPair(src + 2 * index[6]), 6);
+		result = _mm_insert_epi16(result, loadPair(src + 2 * index[7]), 7);
+		_mm_storeu_si128((__m128i*)(dst + 2 * j), result);
+	}
+	resizeNearestRowUVScalar(src, dst + 2 * j, xIndex + j, dstWidth - j, srcWidth);
+}
+
+TARGET_SSE41 static void blendRowsSSE41(const uint8_t* row0, const uint8_t* row1, uint8_t* dst, int width, int weight) {
+	//max value is 255 * weightOne + weightOne / 2, so int16 is enough
+	const __m128i weight0 = _mm_set1_epi16(weightOne - weight);
+	const __m128i weight1 = _mm_set1_epi16(weight);
+	const __m128i round = _mm_set1_epi16(weightOne / 2);
+	int j = 0;
+	for (; j + 16 <= width; j += 16) {
+		__m128i top = _mm_loadu_si128((__m128i*)(row0 + j));
+		__m128i bottom = _mm_loadu_si128((__m128i*)(row1 + j));
+		__m128i low = _mm_add_epi16(_mm_mullo_epi16(_mm_cvtepu8_epi16(top), weight0), _mm_mullo_epi16(_mm_cvtepu8_epi16(bottom), weight1));
+		__m128i high = _mm_add_epi16(_mm_mullo_epi16(_mm_cvtepu8_epi16(_mm_srli_si128(top, 8)), weight0),
+			_mm_mullo_epi16(_mm_cvtepu8_epi16(_mm_srli_si128(bottom, 8)), weight1));
+		low = _mm_srli_epi16(_mm_add_epi16(low, round), weightShift);
+		high = _mm_srli_epi16(_mm_add_epi16(high, round), weightShift);
+		_mm_storeu_si128((__m128i*)(dst + j), _mm_packus_epi16(low, high));
+	}
+	blendRowsScalar(row0 + j, row1 + j, dst + j, width - j, weight);
+}
+
+//pairs of weights (weightOne - weight, weight) for madd
+TARGET_SSE41 static inline __m128i pairWeights(const int* xWeight) {
+	__m128i weight = _mm_loadu_si128((__m128i*)xWeight);
+	return _mm_or_si128(_mm_sub_epi32(_mm_set1_epi32(weightOne), weight), _mm_slli_epi32(weight, 16));
+}
+
+TARGET_SSE41 static void resizeBilinearRowSSE41(const uint8_t* src, uint8_t* dst, const int* xIndex, const int* xWeight, int dstWidth, int srcWidth) {
+	const __m128i round = _mm_set1_epi32(weightOne / 2);
+	int j = 0;
+	for (; j + 8 <= dstWidth; j += 8) {
+		const int* index = xIndex + j;
+		//every 32 bits contains neighbour pixels as int16 pair
+		__m128i low = _mm_cvtepu8_epi16(_mm_setr_epi16(loadPair(src + index[0]), loadPair(src + index[1]), loadPair(src + index[2]), loadPair(src + index[3]), 0, 0, 0, 0));
+		__m128i high = _mm_cvtepu8_epi16(_mm_setr_epi16(loadPair(src + index[4]), loadPair(src + index[5]), loadPair(src + index[6]), loadPair(src + index[7]), 0, 0, 0, 0));
+		low = _mm_srli_epi32(_mm_add_epi32(_mm_madd_epi16(low, pairWeights(xWeight + j)), round), weightShift);
+		high = _mm_srli_epi32(_mm_add_epi32(_mm_madd_epi16(high, pairWeights(xWeight + j + 4)), round), weightShift);
+		__m128i result = _mm_packs_epi32(low, high);
+		_mm_storel_epi64((__m128i*)(dst + j), _mm_packus_epi16(result, result));
+	}
+	resizeBilinearRowScalar(src, dst + j, xIndex + j, xWeight + j, dstWidth - j, srcWidth);
+}
+
+TARGET_SSE41 static void resizeBilinearRowUVSSE41(const uint8_t* src, uint8_t* dst, const int* xIndex, const int* xWeight, int dstWidth, int srcWidth) {
+	//U0 V0 U1 V1 -> (U0, U1) (V0, V1) as int16 pairs
+	const __m128i splitLow = _mm_setr_epi8(0, -128, 2, -128, 1, -128, 3, -128, 4, -128, 6, -128, 5, -128, 7, -128);
+	const __m128i splitHigh = _mm_setr_epi8(8, -128, 10, -128, 9, -128, 11, -128, 12, -128, 14, -128, 13, -128, 15, -128);
+	const __m128i round = _mm_set1_epi32(weightOne / 2);
+	int j = 0;
+	for (; j + 4 <= dstWidth; j += 4) {
+		const int* index = xIndex + j;
+		int quads[4];
+		for (int k = 0; k < 4; k++)
+			memcpy(&quads[k], src + 2 * index[k], sizeof(int));
+		__m128i pixels = _mm_loadu_si128((__m128i*)quads);
+		__m128i weights = pairWeights(xWeight + j);
+		__m128i low = _mm_madd_epi16(_mm_shuffle_epi8(pixels, splitLow), _mm_unpacklo_epi32(weights, weights));
+		__m128i high = _mm_madd_epi16(_mm_shuffle_epi8(pixels, splitHigh), _mm_unpackhi_epi32(weights, weights));
+		low = _mm_srli_epi32(_mm_add_epi32(low, round), weightShift);
+		high = _mm_srli_epi32(_mm_add_epi32(high, round), weightShift);
+		__m128i result = _mm_packs_epi32(low, high);
+		_mm_storel_epi64((__m128i*)(dst + 2 * j), _mm_packus_epi16(result, result));
+	}
+	resizeBilinearRowUVScalar(src, dst + 2 * j, xIndex + j, xWeight + j, dstWidth - j, srcWidth);
+}
+
+TARGET_SSE41 static void filterColumnsSSE41(const int16_t* const* rows, const int16_t* weights, int taps, uint8_t* dst, int width) {
+	const int shift = filterShift + intermediateShift;
+	const __m128i round = _mm_set1_epi32(1 << (shift - 1));
+	int j = 0;
+	for (; j + 8 <= width; j += 8) {
+		__m128i low = round;
+		__m128i high = round;
+		//two rows are multiplied by one madd, odd tap is paired with zero weight
+		for (int t = 0; t < taps; t += 2) {
+			__m128i row0 = _mm_loadu_si128((__m128i*)(rows[t] + j));
+			__m128i row1 = t + 1 < taps ? _mm_loadu_si128((__m128i*)(rows[t + 1] + j)) : _mm_setzero_si128();
+			__m128i weight = pairCoefficients(weights[t], t + 1 < taps ? weights[t + 1] : 0);
+			low = _mm_add_epi32(low, _mm_madd_epi16(_mm_unpacklo_epi16(row0, row1), weight));
+			high = _mm_add_epi32(high, _mm_madd_epi16(_mm_unpackhi_epi16(row0, row1), weight));
+		}
+		__m128i result = _mm_packs_epi32(_mm_srai_epi32(low, shift), _mm_srai_epi32(high, shift));
+		_mm_storel_epi64((__m128i*)(dst + j), _mm_packus_epi16(result, result));
+	}
+	filterColumnsRange(rows, weights, taps, dst, j, width);
+}
+
+const CPUKernels kernelsSSE41 = {
+	SSE41,
+	"SSE4.1",
+	NV12ToRGB24RowSSE41,
+	NV12ToBGR24RowSSE41,
+	resizeNearestRowSSE41,
+	resizeNearestRowUVSSE41,
+	blendRowsSSE41,
+	resizeBilinearRowSSE41,
+	resizeBilinearRowUVSSE41,
+	filterRowScalar,
+	filterColumnsSSE41
+};
+#endif
@@ -0,0 +1,111 @@
+#include "MetricsServer.h"
+#include "Common.h"
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+typedef int socklen_t;
+#define closeSocket closesocket
+#define MSG_NOSIGNAL 0
+#else
+#include <sys/socket.h>
+#include <sys/select.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#define closeSocket close
+#endif
+
+//server checks stop flag at least this often
+const int pollIntervalMs = 100;
+
+MetricsServer::MetricsServer(std::function<std::string()> render) : render(render) {
+}
+
+MetricsServer::~MetricsServer() {
+	Stop();
+}
+
+int MetricsServer::Start(int port) {
+	if (listener != -1)
+		return VREADER_ERROR;
+#ifdef _WIN32
+	WSADATA data;
+	if (WSAStartup(MAKEWORD(2, 2), &data))
+		return VREADER_ERROR;
+#endif
+	listener = socket(AF_INET, SOCK_STREAM, 0);
+	if (listener == -1)
+		return VREADER_ERROR;
+	int reuse = 1;
+	setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, (const char*)&reuse, sizeof(reuse));
+	sockaddr_in address = {};
+	address.sin_family = AF_INET;
+	address.sin_port = htons(port);
+	//metrics aren't exposed outside of host
+	address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	socklen_t length = sizeof(address);
+	if (bind(listener, (sockaddr*)&address, sizeof(address)) || listen(listener, 4) ||
+		getsockname(listener, (sockaddr*)&address, &length)) {
+		closeSocket(listener);
+		listener = -1;
+		return VREADER_ERROR;
+	}
+	this->port = ntohs(address.sin_port);
+	stop = false;
+	server = std::thread(&MetricsServer::serverLoop, this);
+	return VREADER_OK;
+}
+
+void MetricsServer::Stop() {
+	if (listener == -1)
+		return;
+	stop = true;
+	server.join();
+	closeSocket(listener);
+	listener = -1;
+#ifdef _WIN32
+	WSACleanup();
+#endif
+}
+
+int MetricsServer::getPort() {
+	return port;
+}
+
+void MetricsServer::serverLoop() {
+	while (!stop) {
+		fd_set sockets;
+		FD_ZERO(&sockets);
+		FD_SET(listener, &sockets);
+		timeval timeout = { 0, pollIntervalMs * 1000 };
+		if (select((int)listener + 1, &sockets, nullptr, nullptr, &timeout) <= 0)
+			continue;
+		intptr_t client = accept(listener, nullptr, nullptr);
+		if (client == -1)
+			continue;
+		//request isn't parsed, every path returns metrics, so it's enough to wait for the first part of request
+		char request[1024];
+		//one thread serves all clients, so neither a silent client nor a client which doesn't read response can block it
+#ifdef _WIN32
+		DWORD socketTimeout = 1000;
+#else
+		timeval socketTimeout = { 1, 0 };
+#endif
+		setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, (const char*)&socketTimeout, sizeof(socketTimeout));
+		setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, (const char*)&socketTimeout, sizeof(socketTimeout));
+		if (recv(client, request, sizeof(request), 0) <= 0) {
+			closeSocket(client);
+			continue;
+		}
+		std::string body = render();
+		std::string response = std::string("HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: ") +
+			std::to_string(body.size()) + "\r\nConnection: close\r\n\r\n" + body;
+		for (size_t sent = 0; sent < response.size();) {
+			int result = send(client, response.data() + sent, (int)(response.size() - sent), MSG_NOSIGNAL);
+			if (result <= 0)
+				break;
+			sent += result;
+		}
+		closeSocket(client);
+	}
+}
@@ -0,0 +1,241 @@
+#include "PacketCapture.h"
+#include <algorithm>
+#include <cstring>
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+const std::string replayScheme = "replay://";
+const uint8_t startCode[] = { 0, 0, 0, 1 };
+
+static size_t alignRecord(size_t size) {
+	return (size + 7) & ~(size_t)7;
+}
+
+CaptureWriter::~CaptureWriter() {
+	Close();
+}
+
+int CaptureWriter::Open(const std::string& fileName, AVStream* stream) {
+	Close();
+	written = 0;
+	AVCodecParameters* codec = stream->codecpar;
+	//avcC extradata starts with version 1, Annex B extradata starts with start code
+	if (codec->extradata_size >= 7 && codec->extradata[0] == 1) {
+		const uint8_t* extradata = codec->extradata;
+		const uint8_t* end = extradata + codec->extradata_size;
+		lengthSize = (extradata[4] & 3) + 1;
+		const uint8_t* position = extradata + 5;
+		//SPS are followed by PPS, every list starts with number of units
+		for (int list = 0; list < 2; list++) {
+			if (position >= end)
+				return VREADER_ERROR;
+			int number = list == 0 ? (*position & 0x1F) : *position;
+			position++;
+			for (int i = 0; i < number; i++) {
+				if (end - position < 2)
+					return VREADER_ERROR;
+				int unitSize = (position[0] << 8) | position[1];
+				position += 2;
+				if (end - position < unitSize)
+					return VREADER_ERROR;
+				parameterSets.insert(parameterSets.end(), startCode, startCode + sizeof(startCode));
+				parameterSets.insert(parameterSets.end(), position, position + unitSize);
+				position += unitSize;
+			}
+		}
+	}
+	file = std::shared_ptr<FILE>(fopen(fileName.c_str(), "wb"), [](FILE* file) { if (file) fclose(file); });
+	if (file == nullptr)
+		return VREADER_ERROR;
+	CaptureHeader header = {};
+	memcpy(header.magic, captureMagic, sizeof(captureMagic));
+	header.version = captureVersion;
+	header.headerSize = sizeof(CaptureHeader);
+	header.timeBaseNum = stream->time_base.num;
+	header.timeBaseDen = stream->time_base.den;
+	header.frameRateNum = stream->r_frame_rate.num;
+	header.frameRateDen = stream->r_frame_rate.den;
+	if (fwrite(&header, sizeof(header), 1, file.get()) != 1)
+		return VREADER_ERROR;
+	return VREADER_OK;
+}
+
+int CaptureWriter::Write(AVPacket* packet, int64_t arrival) {
+	if (file == nullptr)
+		return VREADER_ERROR;
+	const uint8_t* data = packet->data;
+	size_t size = packet->size;
+	if (lengthSize) {
+		//length prefixes are replaced with start codes, parameter sets from extradata are repeated before every key frame
+		converted.clear();
+		if (packet->flags & AV_PKT_FLAG_KEY)
+			converted.insert(converted.end(), parameterSets.begin(), parameterSets.end());
+		size_t position = 0;
+		while (position + lengthSize <= size) {
+			size_t unitSize = 0;
+			for (int i = 0; i < lengthSize; i++)
+				unitSize = (unitSize << 8) | data[position + i];
+			position += lengthSize;
+			if (unitSize > size - position)
+				return VREADER_ERROR;
+			converted.insert(converted.end(), startCode, startCode + sizeof(startCode));
+			converted.insert(converted.end(), data + position, data + position + unitSize);
+			position += unitSize;
+		}
+		data = converted.data();
+		size = converted.size();
+	}
+	if (firstArrival < 0)
+		firstArrival = arrival;
+	PacketRecord record = { arrival - firstArrival, packet->pts, packet->dts, packet->duration, (uint32_t)size, (uint32_t)packet->flags };
+	const uint8_t padding[8] = {};
+	if (fwrite(&record, sizeof(record), 1, file.get()) != 1 || (size && fwrite(data, size, 1, file.get()) != 1))
+		return VREADER_ERROR;
+	if (alignRecord(size) != size && fwrite(padding, alignRecord(size) - size, 1, file.get()) != 1)
+		return VREADER_ERROR;
+	written++;
+	return VREADER_OK;
+}
+
+void CaptureWriter::Close() {
+	file = nullptr;
+	lengthSize = 0;
+	parameterSets.clear();
+	firstArrival = -1;
+}
+
+uint64_t CaptureWriter::getPacketsWritten() {
+	return written;
+}
+
+CaptureReader::~CaptureReader() {
+	Close();
+}
+
+int CaptureReader::Open(const std::string& fileName) {
+	Close();
+#ifdef _WIN32
+	HANDLE handle = CreateFileA(fileName.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (handle == INVALID_HANDLE_VALUE)
+		return VREADER_ERROR;
+	file = handle;
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(handle, &fileSize) || fileSize.QuadPart < (LONGLONG)sizeof(CaptureHeader)) {
+		Close();
+		return VREADER_ERROR;
+	}
+	size = (size_t)fileSize.QuadPart;
+	mapping = CreateFileMappingA(handle, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (mapping)
+		data = (const uint8_t*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+#else
+	int descriptor = open(fileName.c_str(), O_RDONLY);
+	if (descriptor < 0)
+		return VREADER_ERROR;
+	struct stat status;
+	if (fstat(descriptor, &status) == 0 && status.st_size >= (off_t)sizeof(CaptureHeader)) {
+		size = (size_t)status.st_size;
+		void* mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+		if (mapped != MAP_FAILED)
+			data = (const uint8_t*)mapped;
+	}
+	//mapping stays valid after descriptor is closed
+	close(descriptor);
+#endif
+	if (data == nullptr) {
+		Close();
+		return VREADER_ERROR;
+	}
+	memcpy(&header, data, sizeof(header));
+	if (memcmp(header.magic, captureMagic, sizeof(captureMagic)) || header.version != captureVersion ||
+		header.headerSize < sizeof(CaptureHeader) || header.headerSize > size) {
+		Close();
+		return VREADER_UNSUPPORTED;
+	}
+	readOffset = getFirstRecord();
+	readLeft = 0;
+	return VREADER_OK;
+}
+
+void CaptureReader::Close() {
+#ifdef _WIN32
+	if (data)
+		UnmapViewOfFile(data);
+	if (mapping)
+		CloseHandle(mapping);
+	if (file)
+		CloseHandle(file);
+	mapping = nullptr;
+	file = nullptr;
+#else
+	if (data)
+		munmap((void*)data, size);
+#endif
+	data = nullptr;
+	size = 0;
+}
+
+const CaptureHeader& CaptureReader::getHeader() {
+	return header;
+}
+
+size_t CaptureReader::getFirstRecord() {
+	return alignRecord(header.headerSize);
+}
+
+int CaptureReader::Next(size_t& offset, PacketRecord& record, const uint8_t*& packet) {
+	//file which is still written or was truncated ends with incomplete record
+	if (data == nullptr || offset + sizeof(PacketRecord) > size)
+		return VREADER_REPEAT;
+	memcpy(&record, data + offset, sizeof(record));
+	if (record.size > size - offset - sizeof(PacketRecord))
+		return VREADER_REPEAT;
+	packet = data + offset + sizeof(PacketRecord);
+	offset += sizeof(PacketRecord) + alignRecord(record.size);
+	return VREADER_OK;
+}
+
+int CaptureReader::Read(uint8_t* buffer, int bufferSize) {
+	int copied = 0;
+	while (copied < bufferSize) {
+		if (readLeft == 0) {
+			PacketRecord record;
+			if (Next(readOffset, record, readData) != VREADER_OK)
+				break;
+			readLeft = record.size;
+			continue;
+		}
+		int chunk = (int)std::min((size_t)(bufferSize - copied), readLeft);
+		memcpy(buffer + copied, readData, chunk);
+		readData += chunk;
+		readLeft -= chunk;
+		copied += chunk;
+	}
+	return copied;
+}
+
+bool CaptureReader::IsReplay(const std::string& path) {
+	return path.compare(0, replayScheme.size(), replayScheme) == 0;
+}
+
+int CaptureReader::ParseURL(const std::string& url, std::string& fileName, float& speed) {
+	if (!IsReplay(url))
+		return VREADER_UNSUPPORTED;
+	fileName = url.substr(replayScheme.size());
+	speed = 1;
+	size_t separator = fileName.rfind('?');
+	if (separator != std::string::npos) {
+		std::string query = fileName.substr(separator + 1);
+		fileName = fileName.substr(0, separator);
+		if (query.compare(0, 6, "speed=") != 0 || sscanf(query.c_str() + 6, "%f", &speed) != 1 || speed < 0)
+			return VREADER_UNSUPPORTED;
+	}
+	return fileName.empty() ? VREADER_UNSUPPORTED : VREADER_OK;
+}
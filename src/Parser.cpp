@@ -2,6 +2,8 @@
 #include <thread>
 #include <bitset>
 #include <numeric>
+#include <algorithm>
+#include <cstring>
 
 BitReader::BitReader(uint8_t* _byteData, int _dataSize) {
 	byteData = _byteData;
@@ -72,13 +74,14 @@ std::vector<bool> BitReader::ReadBits(int number) {
 	int endIndex   = shiftInBits + number;
 	//getVector returns vector where most significant bit is placed to zero index (just read from memory bits and push back to vector), next cycle 
 	//re-order vector as it should be (the less significant bit is placed to zero index)
-	std::vector<bool> value = getVector(byteData[byteIndex]);
+	//bits after the end of data are read as zeros
+	std::vector<bool> value = getVector(byteIndex < dataSize ? byteData[byteIndex] : 0);
 	for (int i = startIndex; i < endIndex; i++) {
 		//we read we last bit, need to take next byte
 		if (i && i % 8 == 0) {
 			shiftInBits = 0;
 			byteIndex++;
-			value = getVector(byteData[byteIndex]);
+			value = getVector(byteIndex < dataSize ? byteData[byteIndex] : 0);
 		}
 		result.insert(result.begin(), value[i % 8]);
 		shiftInBits++;
@@ -126,9 +129,10 @@ int BitReader::getShiftInBits() {
 	return shiftInBits;
 }
 
+//Exp-Golomb values are up to 32 bits, so longer sequence of zeros means broken data
 std::vector<bool> BitReader::ReadGolomb() {
 	int zerosNumber = 0;
-	while (Convert(ReadBits(1), Type::RAW, Base::DEC) == 0) {
+	while (zerosNumber < 32 && Convert(ReadBits(1), Type::RAW, Base::DEC) == 0) {
 		zerosNumber++;
 	}
 	return ReadBits(zerosNumber);
@@ -137,13 +141,247 @@ std::vector<bool> BitReader::ReadGolomb() {
 
 bool BitReader::SkipGolomb() {
 	int zerosNumber = 0;
-	while (Convert(ReadBits(1), Type::RAW, Base::DEC) == 0) {
+	while (zerosNumber < 32 && Convert(ReadBits(1), Type::RAW, Base::DEC) == 0) {
 		zerosNumber++;
 	}
 	return SkipBits(zerosNumber);
 }
 
+//Convert returns int, so long values are read by parts
+static uint32_t readValue(BitReader& reader, int bits) {
+	uint32_t value = 0;
+	while (bits > 0) {
+		int part = std::min(bits, 16);
+		value = (value << part) | reader.Convert(reader.ReadBits(part), BitReader::Type::RAW, BitReader::Base::DEC);
+		bits -= part;
+	}
+	return value;
+}
+
+static int readGolomb(BitReader& reader) {
+	return reader.Convert(reader.ReadGolomb(), BitReader::Type::GOLOMB, BitReader::Base::DEC);
+}
+
+static void skipScalingList(BitReader& reader, int size) {
+	int last = 8, next = 8;
+	for (int i = 0; i < size && next != 0; i++) {
+		int code = readGolomb(reader);
+		int delta = code % 2 ? (code + 1) / 2 : -(code / 2);
+		next = (last + delta + 256) % 256;
+		last = next ? next : last;
+	}
+}
+
+/*
+Payload of NAL unit which starts at offset without emulation prevention bytes and trailing zeros, unit ends at the next start code
+*/
+static std::vector<uint8_t> extractRBSP(const uint8_t* data, int size, int offset) {
+	std::vector<uint8_t> payload;
+	int zeros = 0;
+	for (int i = offset; i < size; i++) {
+		if (zeros >= 2 && data[i] <= 3) {
+			if (data[i] != 3)
+				break;
+			zeros = 0;
+			continue;
+		}
+		zeros = data[i] == 0 ? zeros + 1 : 0;
+		payload.push_back(data[i]);
+	}
+	while (!payload.empty() && payload.back() == 0)
+		payload.pop_back();
+	return payload;
+}
+
+void Parser::parseHRD(BitReader& reader) {
+	int count = readGolomb(reader) + 1; //cpb_cnt_minus1
+	readValue(reader, 8); //bit_rate_scale, cpb_size_scale
+	for (int i = 0; i < count; i++) {
+		readGolomb(reader); //bit_rate_value_minus1
+		readGolomb(reader); //cpb_size_value_minus1
+		readValue(reader, 1); //cbr_flag
+	}
+	readValue(reader, 5); //initial_cpb_removal_delay_length_minus1
+	timing.cpbRemovalDelayLength = readValue(reader, 5) + 1;
+	timing.dpbOutputDelayLength = readValue(reader, 5) + 1;
+	timing.timeOffsetLength = readValue(reader, 5);
+}
+
+void Parser::parseTiming(BitReader& reader) {
+	timing = PictureTiming();
+	int profile_idc = readValue(reader, 8);
+	readValue(reader, 16); //constraint flags, level_idc
+	readGolomb(reader); //seq_parameter_set_id
+	if (profile_idc == 100 || profile_idc == 110 || profile_idc == 122 || profile_idc == 244 || profile_idc == 44 ||
+		profile_idc == 83 || profile_idc == 86 || profile_idc == 118 || profile_idc == 128 || profile_idc == 138 ||
+		profile_idc == 139 || profile_idc == 134 || profile_idc == 135) {
+		int chroma_format_idc = readGolomb(reader);
+		if (chroma_format_idc == 3)
+			readValue(reader, 1); //separate_colour_plane_flag
+		readGolomb(reader); //bit_depth_luma_minus8
+		readGolomb(reader); //bit_depth_chroma_minus8
+		readValue(reader, 1); //qpprime_y_zero_transform_bypass_flag
+		if (readValue(reader, 1)) { //seq_scaling_matrix_present_flag
+			for (int i = 0; i < ((chroma_format_idc != 3) ? 8 : 12); i++)
+				if (readValue(reader, 1)) //seq_scaling_list_present_flag
+					skipScalingList(reader, i < 6 ? 16 : 64);
+		}
+	}
+	readGolomb(reader); //log2_max_frame_num_minus4
+	int pic_order_cnt_type = readGolomb(reader);
+	if (pic_order_cnt_type == 0) {
+		readGolomb(reader); //log2_max_pic_order_cnt_lsb_minus4
+	}
+	else if (pic_order_cnt_type == 1) {
+		readValue(reader, 1); //delta_pic_order_always_zero_flag
+		readGolomb(reader); //offset_for_non_ref_pic
+		readGolomb(reader); //offset_for_top_to_bottom_field
+		int num_ref_frames_in_pic_order_cnt_cycle = readGolomb(reader);
+		for (int i = 0; i < num_ref_frames_in_pic_order_cnt_cycle; i++)
+			readGolomb(reader); //offset_for_ref_frame
+	}
+	readGolomb(reader); //max_num_ref_frames
+	readValue(reader, 1); //gaps_in_frame_num_value_allowed_flag
+	readGolomb(reader); //pic_width_in_mbs_minus1
+	readGolomb(reader); //pic_height_in_map_units_minus1
+	if (!readValue(reader, 1)) //frame_mbs_only_flag
+		readValue(reader, 1); //mb_adaptive_frame_field_flag
+	readValue(reader, 1); //direct_8x8_inference_flag
+	if (readValue(reader, 1)) { //frame_cropping_flag
+		for (int i = 0; i < 4; i++)
+			readGolomb(reader);
+	}
+	if (!readValue(reader, 1)) //vui_parameters_present_flag
+		return;
+	if (readValue(reader, 1)) { //aspect_ratio_info_present_flag
+		if (readValue(reader, 8) == 255) //Extended_SAR
+			readValue(reader, 32); //sar_width, sar_height
+	}
+	if (readValue(reader, 1)) //overscan_info_present_flag
+		readValue(reader, 1); //overscan_appropriate_flag
+	if (readValue(reader, 1)) { //video_signal_type_present_flag
+		readValue(reader, 4); //video_format, video_full_range_flag
+		if (readValue(reader, 1)) //colour_description_present_flag
+			readValue(reader, 24); //colour_primaries, transfer_characteristics, matrix_coefficients
+	}
+	if (readValue(reader, 1)) { //chroma_loc_info_present_flag
+		readGolomb(reader); //chroma_sample_loc_type_top_field
+		readGolomb(reader); //chroma_sample_loc_type_bottom_field
+	}
+	if (readValue(reader, 1)) { //timing_info_present_flag
+		timing.numUnitsInTick = readValue(reader, 32);
+		timing.timeScale = readValue(reader, 32);
+		readValue(reader, 1); //fixed_frame_rate_flag
+	}
+	int nal_hrd_parameters_present_flag = readValue(reader, 1);
+	if (nal_hrd_parameters_present_flag)
+		parseHRD(reader);
+	int vcl_hrd_parameters_present_flag = readValue(reader, 1);
+	if (vcl_hrd_parameters_present_flag)
+		parseHRD(reader);
+	if (nal_hrd_parameters_present_flag || vcl_hrd_parameters_present_flag) {
+		timing.delaysPresent = true;
+		readValue(reader, 1); //low_delay_hrd_flag
+	}
+	timing.picStructPresent = readValue(reader, 1);
+}
+
+void Parser::parsePictureTiming(BitReader& reader) {
+	if (timing.delaysPresent) {
+		readValue(reader, timing.cpbRemovalDelayLength); //cpb_removal_delay
+		readValue(reader, timing.dpbOutputDelayLength); //dpb_output_delay
+	}
+	if (!timing.picStructPresent)
+		return;
+	const int clockTimestamps[] = { 1, 1, 1, 2, 2, 3, 3, 2, 3 };
+	uint32_t pic_struct = readValue(reader, 4);
+	if (pic_struct >= sizeof(clockTimestamps) / sizeof(clockTimestamps[0]))
+		return;
+	for (int i = 0; i < clockTimestamps[pic_struct]; i++) {
+		if (!readValue(reader, 1)) //clock_timestamp_flag
+			continue;
+		readValue(reader, 2); //ct_type
+		int nuit_field_based_flag = readValue(reader, 1);
+		readValue(reader, 5); //counting_type
+		int full_timestamp_flag = readValue(reader, 1);
+		readValue(reader, 2); //discontinuity_flag, cnt_dropped_flag
+		int n_frames = readValue(reader, 8);
+		//fields which aren't present in partial timestamp keep values of previous one
+		if (full_timestamp_flag) {
+			timing.seconds = readValue(reader, 6);
+			timing.minutes = readValue(reader, 6);
+			timing.hours = readValue(reader, 5);
+		}
+		else if (readValue(reader, 1)) { //seconds_flag
+			timing.seconds = readValue(reader, 6);
+			if (readValue(reader, 1)) { //minutes_flag
+				timing.minutes = readValue(reader, 6);
+				if (readValue(reader, 1)) //hours_flag
+					timing.hours = readValue(reader, 5);
+			}
+		}
+		int64_t time_offset = 0;
+		if (timing.timeOffsetLength) {
+			time_offset = readValue(reader, timing.timeOffsetLength);
+			if (time_offset >= (int64_t)1 << (timing.timeOffsetLength - 1))
+				time_offset -= (int64_t)1 << timing.timeOffsetLength;
+		}
+		if (timing.timeScale == 0)
+			return;
+		//clock timestamp is time of day, it's taken as UTC and the day closest to arrival is chosen
+		const int64_t day = 86400000000LL;
+		int64_t time = ((timing.hours * 60 + timing.minutes) * 60 + timing.seconds) * 1000000LL +
+			(int64_t)(n_frames * (nuit_field_based_flag + 1) * (double)timing.numUnitsInTick + time_offset) * 1000000 / timing.timeScale;
+		int64_t reference = timestamps.arrival ? timestamps.arrival : wallClock();
+		int64_t capture = reference - reference % day + time;
+		if (capture - reference > day / 2)
+			capture -= day;
+		else if (reference - capture > day / 2)
+			capture += day;
+		timestamps.capture = capture;
+		//the first clock timestamp of picture is enough
+		return;
+	}
+}
+
+void Parser::parseSEI(const std::vector<uint8_t>& payload) {
+	const int picTiming = 1;
+	const int userDataUnregistered = 5;
+	size_t position = 0;
+	//every message is type and size coded as sequence of 0xFF bytes and the last byte, the last byte of unit is trailing bits
+	while (position + 1 < payload.size()) {
+		int type = 0;
+		size_t size = 0;
+		while (position < payload.size() && payload[position] == 0xFF)
+			type += payload[position++];
+		if (position == payload.size())
+			return;
+		type += payload[position++];
+		while (position < payload.size() && payload[position] == 0xFF)
+			size += payload[position++];
+		if (position == payload.size())
+			return;
+		size += payload[position++];
+		if (size > payload.size() - position)
+			return;
+		const uint8_t* message = &payload[position];
+		if (type == userDataUnregistered && size >= 24 && memcmp(message, captureTimeUUID, sizeof(captureTimeUUID)) == 0) {
+			int64_t capture = 0;
+			for (int i = 0; i < 8; i++)
+				capture = (capture << 8) | message[sizeof(captureTimeUUID) + i];
+			timestamps.capture = capture;
+		}
+		else if (type == picTiming) {
+			std::vector<uint8_t> bits(message, message + size);
+			BitReader reader(bits.data(), (int)size);
+			parsePictureTiming(reader);
+		}
+		position += size;
+	}
+}
+
 int Parser::Analyze(AVPacket* package) {
+	TRACE_SPAN_LOW("analyze");
 	enum NALTypes {
 		UNKNOWN = 0,
 		SPS = 7,
@@ -172,6 +410,17 @@ int Parser::Analyze(AVPacket* package) {
 		NALType = static_cast<NALTypes>(bitReader.Convert(bitReader.FindNALType(), BitReader::Type::RAW, BitReader::Base::DEC));
 		if (NALType == UNKNOWN)
 			return VREADER_REPEAT;
+		//capture time is taken from SEI, fields of SPS needed to parse pic_timing are parsed from unit without emulation prevention bytes
+		if (NALType == SEI || NALType == SPS) {
+			std::vector<uint8_t> payload = extractRBSP(NALu->data, NALu->size, bitReader.getByteIndex());
+			if (NALType == SEI) {
+				parseSEI(payload);
+			}
+			else {
+				BitReader unitReader(payload.data(), (int)payload.size());
+				parseTiming(unitReader);
+			}
+		}
 		//we have to find log2_max_frame_num_minus4
 		if (NALType == SPS) {
 			int profile_idc = bitReader.Convert(bitReader.ReadBits(8), BitReader::Type::RAW, BitReader::Base::DEC);
@@ -275,20 +524,146 @@ int Parser::Analyze(AVPacket* package) {
 	return errorBitstream;
 }
 
+//size of buffer FFmpeg reads synthetic and replayed streams with
+const int customBufferSize = 1 << 16;
+
+static int readSynthetic(void* opaque, uint8_t* buffer, int size) {
+	int read = static_cast<SyntheticStream*>(opaque)->Read(buffer, size);
+	return read > 0 ? read : AVERROR_EOF;
+}
+
+static int readCapture(void* opaque, uint8_t* buffer, int size) {
+	int read = static_cast<CaptureReader*>(opaque)->Read(buffer, size);
+	return read > 0 ? read : AVERROR_EOF;
+}
+
+/*
+Parameters of video stream found by probing, kept for every input while process is running
+*/
+struct CachedParameters {
+	std::shared_ptr<AVCodecParameters> codec;
+	AVRational frameRate;
+	AVRational averageFrameRate;
+	AVRational codecFrameRate;
+};
+
+static std::map<std::string, CachedParameters> parametersCache;
+static std::mutex parametersCacheSync;
+
+bool Parser::applyCachedParameters() {
+	std::unique_lock<std::mutex> locker(parametersCacheSync);
+	auto cached = parametersCache.find(state.inputFile);
+	if (cached == parametersCache.end())
+		return false;
+	//demuxers without header (e.g. FLV) create streams from packets, so there is nothing to describe before probing
+	for (unsigned int i = 0; i < formatContext->nb_streams; i++) {
+		AVStream* stream = formatContext->streams[i];
+		if (stream->codecpar->codec_type != AVMEDIA_TYPE_VIDEO || stream->codecpar->codec_id != cached->second.codec->codec_id)
+			continue;
+		if (avcodec_parameters_copy(stream->codecpar, cached->second.codec.get()) < 0)
+			return false;
+		//codec context of stream is filled by avformat_find_stream_info and is used by decoder and dumps
+		if (avcodec_parameters_to_context(stream->codec, stream->codecpar) < 0)
+			return false;
+		stream->codec->framerate = cached->second.codecFrameRate;
+		stream->r_frame_rate = cached->second.frameRate;
+		stream->avg_frame_rate = cached->second.averageFrameRate;
+		return true;
+	}
+	return false;
+}
+
+void Parser::storeParameters() {
+	//too short probing could leave stream without size
+	if (videoStream->codecpar->width <= 0 || videoStream->codecpar->height <= 0)
+		return;
+	CachedParameters cached;
+	cached.codec = std::shared_ptr<AVCodecParameters>(avcodec_parameters_alloc(), [](AVCodecParameters* codec) { avcodec_parameters_free(&codec); });
+	if (avcodec_parameters_copy(cached.codec.get(), videoStream->codecpar) < 0)
+		return;
+	cached.frameRate = videoStream->r_frame_rate;
+	cached.averageFrameRate = videoStream->avg_frame_rate;
+	cached.codecFrameRate = videoStream->codec->framerate;
+	std::unique_lock<std::mutex> locker(parametersCacheSync);
+	parametersCache[state.inputFile] = cached;
+}
+
+void Parser::ClearParametersCache() {
+	std::unique_lock<std::mutex> locker(parametersCacheSync);
+	parametersCache.clear();
+}
+
 int Parser::Init(ParserParameters& input) {
 	state = input;
 	int sts = VREADER_OK;
 	//packet_buffer - isn't empty
 	AVDictionary *opts = 0;
-	av_dict_set(&opts, "rtsp_transport", "tcp", 0);
-	sts = avformat_open_input(&formatContext, state.inputFile.c_str(), 0, &opts);
-	CHECK_STATUS(sts);
-	sts = avformat_find_stream_info(formatContext, 0);
+	if (!state.rtspTransport.empty())
+		av_dict_set(&opts, "rtsp_transport", state.rtspTransport.c_str(), 0);
+	if (state.lowLatency)
+		av_dict_set(&opts, "fflags", "nobuffer", 0);
+	if (state.probeSize > 0 || state.lowLatency)
+		av_dict_set_int(&opts, "probesize", state.probeSize > 0 ? state.probeSize : lowLatencyProbeSize, 0);
+	if (state.analyzeDuration > 0)
+		av_dict_set_int(&opts, "analyzeduration", state.analyzeDuration, 0);
+	AVInputFormat* inputFormat = nullptr;
+	void* customInput = nullptr;
+	int (*customRead)(void*, uint8_t*, int) = nullptr;
+	std::string frameRate;
+	if (SyntheticStream::IsSynthetic(state.inputFile)) {
+		SyntheticParameters parameters;
+		sts = SyntheticStream::ParseURL(state.inputFile, parameters);
+		CHECK_STATUS(sts);
+		synthetic = std::make_shared<SyntheticStream>();
+		sts = synthetic->Init(parameters);
+		CHECK_STATUS(sts);
+		customInput = synthetic.get();
+		customRead = readSynthetic;
+		frameRate = std::to_string(parameters.frameRateNum) + "/" + std::to_string(parameters.frameRateDen);
+	}
+	else if (CaptureReader::IsReplay(state.inputFile)) {
+		std::string fileName;
+		sts = CaptureReader::ParseURL(state.inputFile, fileName, replaySpeed);
+		CHECK_STATUS(sts);
+		replay = std::make_shared<CaptureReader>();
+		sts = replay->Open(fileName);
+		CHECK_STATUS(sts);
+		//demuxer only probes stream parameters, packets are taken from capture with their timing by Read()
+		customInput = replay.get();
+		customRead = readCapture;
+		replayOffset = replay->getFirstRecord();
+		replayStart = -1;
+		const CaptureHeader& header = replay->getHeader();
+		if (header.frameRateNum > 0 && header.frameRateDen > 0)
+			frameRate = std::to_string(header.frameRateNum) + "/" + std::to_string(header.frameRateDen);
+	}
+	if (customInput) {
+		formatContext = avformat_alloc_context();
+		uint8_t* buffer = (uint8_t*)av_malloc(customBufferSize);
+		formatContext->pb = avio_alloc_context(buffer, customBufferSize, 0, customInput, customRead, nullptr, nullptr);
+		inputFormat = av_find_input_format("h264");
+		if (!frameRate.empty())
+			av_dict_set(&opts, "framerate", frameRate.c_str(), 0);
+	}
+	startup = ParserStartup();
+	int64_t phaseStart = traceClock();
+	sts = avformat_open_input(&formatContext, state.inputFile.c_str(), inputFormat, &opts);
+	av_dict_free(&opts);
 	CHECK_STATUS(sts);
+	startup.open = traceClock() - phaseStart;
+	phaseStart = traceClock();
+	startup.cached = state.cacheParameters && applyCachedParameters();
+	if (!startup.cached) {
+		sts = avformat_find_stream_info(formatContext, 0);
+		CHECK_STATUS(sts);
+	}
 	AVCodec* codec;
 	videoIndex = av_find_best_stream(formatContext, AVMEDIA_TYPE_VIDEO, -1, -1, &codec, 0);
 	videoStream = formatContext->streams[videoIndex];
 	videoStream->codec->codec = codec;
+	if (state.cacheParameters && !startup.cached)
+		storeParameters();
+	startup.probe = traceClock() - phaseStart;
 	if (state.enableDumps) {
 		std::string dumpName = "bitstream.h264";
 		sts = avformat_alloc_output_context2(&dumpContext, NULL, NULL, dumpName.c_str());
@@ -329,11 +704,16 @@ Parser::Parser() {
 
 //no need any sync due to executing in 1 thread only
 int Parser::Read() {
+	TRACE_SPAN_LOW("read");
 	int sts = VREADER_OK;
 	bool videoFrame = false;
 	while (videoFrame == false) {
-		sts = av_read_frame(formatContext, lastFrame.first);
+		if (replay)
+			sts = readReplay(lastFrame.first);
+		else
+			sts = av_read_frame(formatContext, lastFrame.first);
 		CHECK_STATUS(sts);
+		int64_t arrival = traceClock();
 		if ((lastFrame.first)->stream_index != videoIndex)
 			continue;
 
@@ -349,11 +729,70 @@ int Parser::Read() {
 			CHECK_STATUS(sts);
 			lastFrame.first->stream_index = videoIndex;
 		}
-		
+
+		if (capture) {
+			sts = capture->Write(lastFrame.first, arrival);
+			CHECK_STATUS(sts);
+		}
+		//capture time is set by Analyze if it's found in packet
+		timestamps = FrameTimestamps();
+		timestamps.pts = lastFrame.first->pts;
+		timestamps.dts = lastFrame.first->dts;
+		timestamps.arrival = wallClock();
+	}
+	return sts;
+}
+
+int Parser::readReplay(AVPacket* packet) {
+	PacketRecord record;
+	const uint8_t* data;
+	if (replay->Next(replayOffset, record, data) != VREADER_OK)
+		return AVERROR_EOF;
+	//packets are released at their arrival time divided by speed, time is counted from the first packet
+	int64_t now = traceClock();
+	if (replayStart < 0)
+		replayStart = now;
+	if (replaySpeed > 0) {
+		int64_t release = replayStart + (int64_t)(record.arrival / replaySpeed);
+		if (release > now)
+			std::this_thread::sleep_for(std::chrono::nanoseconds(release - now));
+	}
+	av_packet_unref(packet);
+	int sts = av_new_packet(packet, record.size);
+	CHECK_STATUS(sts);
+	memcpy(packet->data, data, record.size);
+	//demuxer of captured stream has own time base
+	AVRational timeBase = { replay->getHeader().timeBaseNum, replay->getHeader().timeBaseDen };
+	packet->pts = record.pts == AV_NOPTS_VALUE ? record.pts : av_rescale_q(record.pts, timeBase, videoStream->time_base);
+	packet->dts = record.dts == AV_NOPTS_VALUE ? record.dts : av_rescale_q(record.dts, timeBase, videoStream->time_base);
+	packet->duration = av_rescale_q(record.duration, timeBase, videoStream->time_base);
+	packet->flags = record.flags;
+	packet->stream_index = videoIndex;
+	return VREADER_OK;
+}
+
+int Parser::EnableCapture(std::string fileName) {
+	capture = std::make_shared<CaptureWriter>();
+	int sts = capture->Open(fileName, videoStream);
+	if (sts != VREADER_OK) {
+		capture = nullptr;
+		CHECK_STATUS(sts);
 	}
 	return sts;
 }
 
+bool Parser::isReplay() {
+	return replay != nullptr;
+}
+
+FrameTimestamps Parser::getTimestamps() {
+	return timestamps;
+}
+
+ParserStartup Parser::getStartup() {
+	return startup;
+}
+
 //no need any sync due to executing in 1 thread only
 int Parser::Get(AVPacket* output) {
 	if (lastFrame.second == false && lastFrame.first->stream_index == videoIndex) {
@@ -382,7 +821,18 @@ void Parser::Close() {
 	if (isClosed)
 		return;
 	av_bitstream_filter_close(bitstreamFilter);
+	//custom IO context isn't freed by FFmpeg
+	AVIOContext* customIO = synthetic || replay ? formatContext->pb : nullptr;
 	avformat_close_input(&formatContext);
+	if (customIO) {
+		av_freep(&customIO->buffer);
+		avio_context_free(&customIO);
+	}
+	synthetic = nullptr;
+	replay = nullptr;
+	capture = nullptr;
+	timestamps = FrameTimestamps();
+	timing = PictureTiming();
 	
 	if (state.enableDumps) {
 		if (dumpContext && !(dumpContext->oformat->flags & AVFMT_NOFILE))
@@ -0,0 +1,307 @@
+#include "Statistics.h"
+#include <algorithm>
+#include <cmath>
+#include <stdio.h>
+
+LatencyWindow::LatencyWindow(int size) : size(std::max(size, 1)) {
+	samples.reserve(this->size);
+}
+
+void LatencyWindow::add(float value) {
+	std::unique_lock<std::mutex> locker(sync);
+	//the oldest sample is replaced after window is filled
+	if ((int)samples.size() < size)
+		samples.push_back(value);
+	else
+		samples[next] = value;
+	next = (next + 1) % size;
+}
+
+float LatencyWindow::percentile(float percent) {
+	std::vector<float> sorted;
+	{
+		std::unique_lock<std::mutex> locker(sync);
+		sorted = samples;
+	}
+	if (sorted.empty())
+		return 0;
+	int rank = (int)std::ceil(std::min(std::max(percent, 0.f), 100.f) / 100 * sorted.size());
+	auto item = sorted.begin() + std::max(rank - 1, 0);
+	std::nth_element(sorted.begin(), item, sorted.end());
+	return *item;
+}
+
+int LatencyWindow::getSamplesNumber() {
+	std::unique_lock<std::mutex> locker(sync);
+	return samples.size();
+}
+
+LatencyHistogram::LatencyHistogram() {
+	for (auto& item : counts)
+		item.store(0, std::memory_order_relaxed);
+}
+
+static int highestBit(uint64_t value) {
+#if defined(__GNUC__)
+	return 63 - __builtin_clzll(value);
+#else
+	int bit = 0;
+	while (value >>= 1)
+		bit++;
+	return bit;
+#endif
+}
+
+int LatencyHistogram::getBucket(uint64_t value) {
+	if (value < (1 << significantBits))
+		return (int)value;
+	int bit = highestBit(value);
+	if (bit >= maxBits)
+		return bucketsNumber - 1;
+	//value is rounded down to significantBits - 1 bits after the highest one
+	int shift = bit - (significantBits - 1);
+	int subBucket = (int)(value >> shift) - (1 << (significantBits - 1));
+	return (1 << significantBits) + (bit - significantBits) * (1 << (significantBits - 1)) + subBucket;
+}
+
+uint64_t LatencyHistogram::getUpperBound(int bucket) {
+	if (bucket < (1 << significantBits))
+		return bucket;
+	int index = bucket - (1 << significantBits);
+	int bit = significantBits + index / (1 << (significantBits - 1));
+	uint64_t top = (1 << (significantBits - 1)) + index % (1 << (significantBits - 1));
+	int shift = bit - (significantBits - 1);
+	return ((top + 1) << shift) - 1;
+}
+
+void LatencyHistogram::add(int64_t value) {
+	uint64_t sample = value > 0 ? value : 0;
+	counts[getBucket(sample)].fetch_add(1, std::memory_order_relaxed);
+	count.fetch_add(1, std::memory_order_relaxed);
+	sum.fetch_add(sample, std::memory_order_relaxed);
+	uint64_t current = max.load(std::memory_order_relaxed);
+	while (sample > current && !max.compare_exchange_weak(current, sample, std::memory_order_relaxed)) {
+	}
+}
+
+uint64_t LatencyHistogram::percentile(float percent) {
+	//counters are read one by one, so total is taken from the same snapshot of buckets
+	std::vector<uint64_t> snapshot(bucketsNumber);
+	uint64_t total = 0;
+	for (int i = 0; i < bucketsNumber; i++) {
+		snapshot[i] = counts[i].load(std::memory_order_relaxed);
+		total += snapshot[i];
+	}
+	if (total == 0)
+		return 0;
+	uint64_t rank = std::max((uint64_t)std::ceil(std::min(std::max(percent, 0.f), 100.f) / 100 * total), (uint64_t)1);
+	uint64_t accumulated = 0;
+	int bucket = 0;
+	for (; bucket < bucketsNumber - 1; bucket++) {
+		accumulated += snapshot[bucket];
+		if (accumulated >= rank)
+			break;
+	}
+	//the last bucket has no upper bound
+	return std::min(getUpperBound(bucket), getMax());
+}
+
+uint64_t LatencyHistogram::countBelow(uint64_t bound) {
+	uint64_t accumulated = 0;
+	for (int i = 0; i < bucketsNumber - 1 && getUpperBound(i) <= bound; i++)
+		accumulated += counts[i].load(std::memory_order_relaxed);
+	return accumulated;
+}
+
+uint64_t LatencyHistogram::getCount() {
+	return count.load(std::memory_order_relaxed);
+}
+
+uint64_t LatencyHistogram::getSum() {
+	return sum.load(std::memory_order_relaxed);
+}
+
+uint64_t LatencyHistogram::getMax() {
+	return max.load(std::memory_order_relaxed);
+}
+
+std::vector<std::pair<std::string, LatencyHistogram*> > PipelineStats::getStages() {
+	return { {"read", &read}, {"analyze", &analyze}, {"decode", &decode}, {"convert", &convert} };
+}
+
+void PipelineStats::addFrame(int64_t arrival, int64_t capture, int64_t converted) {
+	const int64_t nsInUs = 1000;
+	if (arrival)
+		frameAge.add((converted - arrival) * nsInUs);
+	if (capture)
+		glassToTensor.add((converted - capture) * nsInUs);
+}
+
+void StartupStats::reset(int64_t start) {
+	for (auto phase : { &open, &probe, &decoder, &vpp, &firstFrame })
+		phase->store(-1);
+	cached = false;
+	this->start = start;
+}
+
+void StartupStats::addFrame(int64_t decoded) {
+	int64_t unset = -1;
+	firstFrame.compare_exchange_strong(unset, decoded - start.load());
+}
+
+std::vector<std::pair<std::string, int64_t> > StartupStats::getPhases() {
+	std::vector<std::pair<std::string, int64_t> > phases = { { "open", open.load() }, { "probe", probe.load() }, { "decoder", decoder.load() },
+		{ "vpp", vpp.load() }, { "first_frame", firstFrame.load() } };
+	phases.erase(std::remove_if(phases.begin(), phases.end(), [](const std::pair<std::string, int64_t>& phase) { return phase.second < 0; }),
+		phases.end());
+	return phases;
+}
+
+double PipelineStats::getBitrate() {
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	return seconds > 0 ? bytes.load(std::memory_order_relaxed) * 8 / seconds : 0;
+}
+
+//count, mean, p50, p90, p99, p99.9 and max of histogram in milliseconds
+static void addHistogram(std::map<std::string, double>& stats, const std::string& prefix, LatencyHistogram& histogram) {
+	const double nsInMs = 1e6;
+	uint64_t count = histogram.getCount();
+	stats[prefix + ".count"] = (double)count;
+	stats[prefix + ".mean_ms"] = count ? histogram.getSum() / nsInMs / count : 0;
+	stats[prefix + ".p50_ms"] = histogram.percentile(50) / nsInMs;
+	stats[prefix + ".p90_ms"] = histogram.percentile(90) / nsInMs;
+	stats[prefix + ".p99_ms"] = histogram.percentile(99) / nsInMs;
+	stats[prefix + ".p999_ms"] = histogram.percentile(99.9f) / nsInMs;
+	stats[prefix + ".max_ms"] = histogram.getMax() / nsInMs;
+}
+
+static std::string formatValue(double value) {
+	char buffer[32];
+	snprintf(buffer, sizeof(buffer), "%.10g", value);
+	return buffer;
+}
+
+void PrometheusWriter::describe(const std::string& name, const std::string& help, const std::string& type) {
+	if (!described.insert(name).second)
+		return;
+	text += "# HELP " + name + " " + help + "\n";
+	text += "# TYPE " + name + " " + type + "\n";
+}
+
+void PrometheusWriter::sample(const std::string& name, const std::string& labels, double value) {
+	text += name + (labels.empty() ? "" : "{" + labels + "}") + " " + formatValue(value) + "\n";
+}
+
+void PrometheusWriter::counter(const std::string& name, const std::string& help, double value, const std::string& labels) {
+	describe(name, help, "counter");
+	sample(name, labels, value);
+}
+
+void PrometheusWriter::gauge(const std::string& name, const std::string& help, double value, const std::string& labels) {
+	describe(name, help, "gauge");
+	sample(name, labels, value);
+}
+
+void PrometheusWriter::histogram(const std::string& name, const std::string& help, LatencyHistogram& histogram, const std::string& labels) {
+	const double bounds[] = { 0.0001, 0.00025, 0.0005, 0.001, 0.0025, 0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1, 2.5, 5, 10 };
+	describe(name, help, "histogram");
+	std::string separator = labels.empty() ? "" : ",";
+	uint64_t below = 0;
+	for (double bound : bounds) {
+		below = histogram.countBelow((uint64_t)(bound * 1e9));
+		sample(name + "_bucket", labels + separator + label("le", formatValue(bound)), (double)below);
+	}
+	//samples are added concurrently, so +Inf bucket is kept not less than finite ones
+	uint64_t count = std::max(histogram.getCount(), below);
+	sample(name + "_bucket", labels + separator + label("le", "+Inf"), (double)count);
+	sample(name + "_sum", labels, histogram.getSum() / 1e9);
+	sample(name + "_count", labels, (double)count);
+}
+
+std::string PrometheusWriter::label(const std::string& name, const std::string& value) {
+	std::string escaped;
+	for (char symbol : value) {
+		if (symbol == '\\' || symbol == '"')
+			escaped += std::string("\\") + symbol;
+		else if (symbol == '\n')
+			escaped += "\\n";
+		else
+			escaped += symbol;
+	}
+	return name + "=\"" + escaped + "\"";
+}
+
+std::string PrometheusWriter::str() {
+	return text;
+}
+
+static std::vector<std::pair<std::string, uint64_t> > getPoolValues(const BufferPoolStats& pool) {
+	return { {"allocations", pool.allocations}, {"releases", pool.releases}, {"hits", pool.hits}, {"misses", pool.misses},
+		{"bytes_in_use", pool.bytesInUse}, {"bytes_cached", pool.bytesCached}, {"peak_bytes_in_use", pool.peakBytesInUse},
+		{"peak_bytes_allocated", pool.peakBytesAllocated} };
+}
+
+std::map<std::string, double> PipelineStats::getValues(const PipelineSnapshot& snapshot) {
+	std::map<std::string, double> values;
+	for (auto& stage : getStages())
+		addHistogram(values, stage.first, *stage.second);
+	addHistogram(values, "frame_age", frameAge);
+	addHistogram(values, "glass_to_tensor", glassToTensor);
+	values["packets"] = (double)packets.load(std::memory_order_relaxed);
+	values["bytes"] = (double)bytes.load(std::memory_order_relaxed);
+	values["bitrate_kbps"] = getBitrate() / 1000;
+	values["decoded_frames"] = (double)snapshot.decodedFrames;
+	values["prefetch_queue"] = snapshot.prefetchQueue;
+	for (auto& item : snapshot.consumers) {
+		std::string prefix = "consumer." + item.first + ".";
+		values[prefix + "delivered"] = (double)item.second.delivered;
+		values[prefix + "skipped"] = (double)item.second.skipped;
+		values[prefix + "dropped"] = (double)item.second.dropped;
+		values[prefix + "lag"] = (double)item.second.lag;
+	}
+	for (auto& item : getPoolValues(snapshot.pool))
+		values["pool." + item.first] = (double)item.second;
+	for (auto& phase : startup.getPhases())
+		values["startup." + phase.first + "_ms"] = phase.second / 1e6;
+	values["startup.cached"] = startup.cached;
+	return values;
+}
+
+std::string PipelineStats::getPrometheus(const PipelineSnapshot& snapshot) {
+	PrometheusWriter writer;
+	for (auto& stage : getStages())
+		writer.histogram("tensorstream_stage_duration_seconds", "Duration of pipeline stage", *stage.second, PrometheusWriter::label("stage", stage.first));
+	writer.histogram("tensorstream_frame_age_seconds", "Time from packet arrival till frame is converted for consumer", frameAge);
+	writer.histogram("tensorstream_glass_to_tensor_seconds", "Time from capture by producer till frame is converted for consumer", glassToTensor);
+	writer.counter("tensorstream_packets_total", "Packets read from stream", (double)packets.load(std::memory_order_relaxed));
+	writer.counter("tensorstream_read_bytes_total", "Bytes of packets read from stream", (double)bytes.load(std::memory_order_relaxed));
+	writer.gauge("tensorstream_bitrate_bits_per_second", "Average bitrate since start", getBitrate());
+	writer.counter("tensorstream_decoded_frames_total", "Decoded frames", (double)snapshot.decodedFrames);
+	writer.gauge("tensorstream_prefetch_queue_jobs", "Queued prefetch conversions", snapshot.prefetchQueue);
+	//samples of one metric should be adjacent, so every counter is written for all consumers at once
+	for (auto& item : snapshot.consumers)
+		writer.counter("tensorstream_consumer_frames_total", "Frames delivered to consumer", (double)item.second.delivered,
+			PrometheusWriter::label("consumer", item.first));
+	for (auto& item : snapshot.consumers)
+		writer.counter("tensorstream_consumer_skipped_frames_total", "Decoded frames consumer didn't take before newer frame was decoded",
+			(double)item.second.skipped, PrometheusWriter::label("consumer", item.first));
+	for (auto& item : snapshot.consumers)
+		writer.counter("tensorstream_consumer_dropped_frames_total", "Requests of frames which aren't in decoder's buffer",
+			(double)item.second.dropped, PrometheusWriter::label("consumer", item.first));
+	for (auto& item : snapshot.consumers)
+		writer.gauge("tensorstream_consumer_lag_frames", "Decoded frames consumer hasn't seen yet", (double)item.second.lag,
+			PrometheusWriter::label("consumer", item.first));
+	for (auto& item : getPoolValues(snapshot.pool)) {
+		//byte values are current levels, call numbers only grow
+		bool level = item.first.find("bytes") != std::string::npos;
+		std::string name = "tensorstream_pool_" + item.first + (level ? "" : "_total");
+		if (level)
+			writer.gauge(name, "Output buffer pool " + item.first, (double)item.second);
+		else
+			writer.counter(name, "Output buffer pool " + item.first, (double)item.second);
+	}
+	for (auto& phase : startup.getPhases())
+		writer.gauge("tensorstream_startup_seconds", "Duration of startup phase", phase.second / 1e9, PrometheusWriter::label("phase", phase.first));
+	writer.gauge("tensorstream_startup_cached", "Stream parameters were taken from cache instead of probing", startup.cached);
+	return writer.str();
+}
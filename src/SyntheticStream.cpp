@@ -0,0 +1,397 @@
+#include "SyntheticStream.h"
+#include "Common.h"
+#include <algorithm>
+#include <limits>
+#include <memory>
+#include <cstring>
+#include <stdio.h>
+
+const std::string syntheticScheme = "synthetic://";
+//frame_num and pic_order_cnt_lsb are 16 bit, so they wrap rarely even in endless streams with B-frames
+const int log2MaxFrameNum = 16;
+const int log2MaxPOC = 16;
+//mb_type of I_PCM in I, P and B slices
+const int pcmTypeI = 25;
+const int pcmTypeP = 5 + pcmTypeI;
+const int pcmTypeB = 23 + pcmTypeI;
+const int mbSize = 16;
+const int pcmSize = mbSize * mbSize + 2 * (mbSize / 2) * (mbSize / 2);
+
+void BitWriter::PutBits(uint32_t value, int number) {
+	for (int i = number - 1; i >= 0; i--) {
+		current = (current << 1) | ((value >> i) & 1);
+		if (++currentBits == 8) {
+			bytes.push_back((uint8_t)current);
+			current = 0;
+			currentBits = 0;
+		}
+	}
+}
+
+void BitWriter::PutGolomb(uint32_t value) {
+	uint64_t coded = (uint64_t)value + 1;
+	int length = 0;
+	while ((coded >> length) > 1)
+		length++;
+	PutBits(0, length);
+	PutBits((uint32_t)(coded >> 32), length >= 32 ? length - 31 : 0);
+	PutBits((uint32_t)coded, std::min(length + 1, 32));
+}
+
+void BitWriter::PutSignedGolomb(int32_t value) {
+	PutGolomb(value > 0 ? 2 * (uint32_t)value - 1 : 2 * (uint32_t)(-(int64_t)value));
+}
+
+void BitWriter::Align() {
+	if (currentBits)
+		PutBits(0, 8 - currentBits);
+}
+
+void BitWriter::PutTrailingBits() {
+	PutBits(1, 1);
+	Align();
+}
+
+void BitWriter::PutBytes(const uint8_t* data, int size) {
+	bytes.insert(bytes.end(), data, data + size);
+}
+
+void BitWriter::WriteNAL(int refIdc, int type, std::vector<uint8_t>& output) {
+	const uint8_t startCode[] = { 0, 0, 0, 1 };
+	output.insert(output.end(), startCode, startCode + sizeof(startCode));
+	output.push_back((uint8_t)((refIdc << 5) | type));
+	//emulation prevention: 0x000000 - 0x000003 inside NAL unit are escaped with 0x03
+	int zeros = 0;
+	for (uint8_t value : bytes) {
+		if (zeros == 2 && value <= 3) {
+			output.push_back(3);
+			zeros = 0;
+		}
+		output.push_back(value);
+		zeros = value ? 0 : zeros + 1;
+	}
+	bytes.clear();
+	current = 0;
+	currentBits = 0;
+}
+
+int BitWriter::getBitsNumber() {
+	return (int)bytes.size() * 8 + currentBits;
+}
+
+int SyntheticStream::Init(const SyntheticParameters& parameters) {
+	if (parameters.width < mbSize || parameters.height < mbSize || parameters.width > 8192 || parameters.height > 8192 ||
+		parameters.width % 2 || parameters.height % 2)
+		return VREADER_UNSUPPORTED;
+	if (parameters.frameRateNum <= 0 || parameters.frameRateDen <= 0 || parameters.idrInterval < 0 || parameters.bFrames < 0 ||
+		parameters.bFrames > 16 || parameters.slices < 1 || parameters.complexity < 0 || parameters.complexity > 1 || parameters.frames < 0)
+		return VREADER_UNSUPPORTED;
+	this->parameters = parameters;
+	widthMBs = (parameters.width + mbSize - 1) / mbSize;
+	heightMBs = (parameters.height + mbSize - 1) / mbSize;
+	this->parameters.slices = std::min(parameters.slices, widthMBs * heightMBs);
+	samples.resize(pcmSize);
+	pending.clear();
+	buffered.clear();
+	bufferedOffset = 0;
+	nextDisplay = 0;
+	idrNumber = 0;
+	produced = 0;
+	return VREADER_OK;
+}
+
+void SyntheticStream::planGroup() {
+	int display = nextDisplay;
+	if (parameters.frames > 0 && display >= parameters.frames)
+		return;
+	if (display == 0 || (parameters.idrInterval > 0 && display % parameters.idrInterval == 0)) {
+		pending.push_back(Picture{ display, IDR });
+		nextDisplay++;
+		return;
+	}
+	//reference frame is coded before B-frames which precede it, group is shortened at the end of GOP or stream
+	int limit = std::numeric_limits<int>::max();
+	if (parameters.idrInterval > 0)
+		limit = (display / parameters.idrInterval + 1) * parameters.idrInterval;
+	if (parameters.frames > 0)
+		limit = std::min(limit, parameters.frames);
+	int number = std::min(parameters.bFrames + 1, limit - display);
+	pending.push_back(Picture{ display + number - 1, P });
+	for (int i = 0; i < number - 1; i++)
+		pending.push_back(Picture{ display + i, B });
+	nextDisplay += number;
+}
+
+void SyntheticStream::writeHeaders(std::vector<uint8_t>& output) {
+	int macroblocks = widthMBs * heightMBs;
+	//levels 4.0, 5.1 and 6.2 cover DPB of 2 frames up to 1080p, 4K and 8K
+	int level = macroblocks <= 8192 ? 40 : macroblocks <= 36864 ? 51 : 62;
+	//SPS, Main profile
+	writer.PutBits(77, 8);
+	writer.PutBits(0, 8);
+	writer.PutBits(level, 8);
+	writer.PutGolomb(0); //seq_parameter_set_id
+	writer.PutGolomb(log2MaxFrameNum - 4);
+	writer.PutGolomb(0); //pic_order_cnt_type
+	writer.PutGolomb(log2MaxPOC - 4);
+	writer.PutGolomb(parameters.bFrames ? 2 : 1); //max_num_ref_frames
+	writer.PutBits(0, 1); //gaps_in_frame_num_value_allowed_flag
+	writer.PutGolomb(widthMBs - 1);
+	writer.PutGolomb(heightMBs - 1);
+	writer.PutBits(1, 1); //frame_mbs_only_flag
+	writer.PutBits(1, 1); //direct_8x8_inference_flag
+	bool cropping = widthMBs * mbSize != parameters.width || heightMBs * mbSize != parameters.height;
+	writer.PutBits(cropping, 1);
+	if (cropping) {
+		//crop unit is 2 pixels for 4:2:0
+		writer.PutGolomb(0);
+		writer.PutGolomb((widthMBs * mbSize - parameters.width) / 2);
+		writer.PutGolomb(0);
+		writer.PutGolomb((heightMBs * mbSize - parameters.height) / 2);
+	}
+	writer.PutBits(1, 1); //vui_parameters_present_flag
+	writer.PutBits(0, 4); //aspect_ratio, overscan, video_signal_type, chroma_loc
+	writer.PutBits(1, 1); //timing_info_present_flag
+	writer.PutBits(parameters.frameRateDen, 32);
+	writer.PutBits(2 * parameters.frameRateNum, 32);
+	writer.PutBits(1, 1); //fixed_frame_rate_flag
+	writer.PutBits(0, 3); //nal_hrd, vcl_hrd, pic_struct_present
+	writer.PutBits(1, 1); //bitstream_restriction_flag
+	writer.PutBits(1, 1); //motion_vectors_over_pic_boundaries_flag
+	writer.PutGolomb(0); //max_bytes_per_pic_denom
+	writer.PutGolomb(0); //max_bits_per_mb_denom
+	writer.PutGolomb(16); //log2_max_mv_length_horizontal
+	writer.PutGolomb(16); //log2_max_mv_length_vertical
+	writer.PutGolomb(parameters.bFrames ? 1 : 0); //max_num_reorder_frames
+	writer.PutGolomb(parameters.bFrames ? 2 : 1); //max_dec_frame_buffering
+	writer.PutTrailingBits();
+	writer.WriteNAL(3, 7, output);
+	//PPS, CAVLC
+	writer.PutGolomb(0); //pic_parameter_set_id
+	writer.PutGolomb(0); //seq_parameter_set_id
+	writer.PutBits(0, 1); //entropy_coding_mode_flag
+	writer.PutBits(0, 1); //bottom_field_pic_order_in_frame_present_flag
+	writer.PutGolomb(0); //num_slice_groups_minus1
+	writer.PutGolomb(0); //num_ref_idx_l0_default_active_minus1
+	writer.PutGolomb(0); //num_ref_idx_l1_default_active_minus1
+	writer.PutBits(0, 3); //weighted_pred_flag, weighted_bipred_idc
+	writer.PutSignedGolomb(0); //pic_init_qp_minus26
+	writer.PutSignedGolomb(0); //pic_init_qs_minus26
+	writer.PutSignedGolomb(0); //chroma_qp_index_offset
+	writer.PutBits(1, 1); //deblocking_filter_control_present_flag
+	writer.PutBits(0, 2); //constrained_intra_pred_flag, redundant_pic_cnt_present_flag
+	writer.PutTrailingBits();
+	writer.WriteNAL(3, 8, output);
+}
+
+bool SyntheticStream::isUpdated(int mb, int display) {
+	//hash of macroblock and frame, so the same macroblocks are updated in every run
+	uint32_t hash = (uint32_t)mb * 0x9E3779B1u ^ (uint32_t)display * 0x85EBCA77u ^ parameters.seed * 0xC2B2AE3Du;
+	hash ^= hash >> 16;
+	hash *= 0x7FEB352Du;
+	hash ^= hash >> 15;
+	hash *= 0x846CA68Bu;
+	hash ^= hash >> 16;
+	return (hash >> 8) < (uint32_t)(parameters.complexity * (1 << 24));
+}
+
+void SyntheticStream::writePCM(int mbX, int mbY, int display) {
+	//moving pattern, samples are kept in limited range
+	uint8_t* sample = &samples[0];
+	for (int y = mbY * mbSize; y < (mbY + 1) * mbSize; y++) {
+		for (int x = mbX * mbSize; x < (mbX + 1) * mbSize; x++) {
+			int value = ((x + 2 * display) ^ (y + display + (int)parameters.seed)) & 0xFF;
+			*sample++ = (uint8_t)(16 + value * 219 / 255);
+		}
+	}
+	int chromaSize = mbSize / 2;
+	for (int y = mbY * chromaSize; y < (mbY + 1) * chromaSize; y++)
+		for (int x = mbX * chromaSize; x < (mbX + 1) * chromaSize; x++)
+			*sample++ = (uint8_t)(96 + ((x + display) & 63));
+	for (int y = mbY * chromaSize; y < (mbY + 1) * chromaSize; y++)
+		for (int x = mbX * chromaSize; x < (mbX + 1) * chromaSize; x++)
+			*sample++ = (uint8_t)(96 + ((y - display) & 63));
+	writer.PutBytes(&samples[0], pcmSize);
+}
+
+void SyntheticStream::writeSlice(const Picture& picture, int firstMB, int lastMB, std::vector<uint8_t>& output) {
+	writer.PutGolomb(firstMB);
+	writer.PutGolomb(picture.type == P ? 0 : picture.type == B ? 1 : 2); //slice_type
+	writer.PutGolomb(0); //pic_parameter_set_id
+	writer.PutBits(frameNum, log2MaxFrameNum);
+	if (picture.type == IDR)
+		writer.PutGolomb(idrNumber & 1); //idr_pic_id
+	writer.PutBits((2 * (picture.display - lastIDR)) & ((1 << log2MaxPOC) - 1), log2MaxPOC);
+	if (picture.type == B)
+		writer.PutBits(1, 1); //direct_spatial_mv_pred_flag
+	if (picture.type != IDR) {
+		writer.PutBits(0, 1); //num_ref_idx_active_override_flag
+		writer.PutBits(0, 1); //ref_pic_list_modification_flag_l0
+	}
+	if (picture.type == B)
+		writer.PutBits(0, 1); //ref_pic_list_modification_flag_l1
+	if (picture.type == IDR)
+		writer.PutBits(0, 2); //no_output_of_prior_pics_flag, long_term_reference_flag
+	else if (picture.type == P)
+		writer.PutBits(0, 1); //adaptive_ref_pic_marking_mode_flag
+	writer.PutSignedGolomb(0); //slice_qp_delta
+	writer.PutGolomb(1); //disable_deblocking_filter_idc
+	int skipped = 0;
+	for (int mb = firstMB; mb < lastMB; mb++) {
+		if (picture.type != IDR && !isUpdated(mb, picture.display)) {
+			skipped++;
+			continue;
+		}
+		if (picture.type != IDR) {
+			writer.PutGolomb(skipped); //mb_skip_run
+			skipped = 0;
+		}
+		writer.PutGolomb(picture.type == IDR ? pcmTypeI : picture.type == P ? pcmTypeP : pcmTypeB);
+		writer.Align();
+		writePCM(mb % widthMBs, mb / widthMBs, picture.display);
+	}
+	if (skipped)
+		writer.PutGolomb(skipped);
+	writer.PutTrailingBits();
+	writer.WriteNAL(picture.type == IDR ? 3 : picture.type == P ? 2 : 0, picture.type == IDR ? 5 : 1, output);
+}
+
+void SyntheticStream::writeTimestamp(std::vector<uint8_t>& output) {
+	//user_data_unregistered: UUID and big-endian microseconds since epoch
+	const int userDataUnregistered = 5;
+	int64_t time = wallClock();
+	writer.PutBits(userDataUnregistered, 8);
+	writer.PutBits(sizeof(captureTimeUUID) + sizeof(time), 8);
+	writer.PutBytes(captureTimeUUID, sizeof(captureTimeUUID));
+	for (int i = 7; i >= 0; i--)
+		writer.PutBits((time >> (8 * i)) & 0xFF, 8);
+	writer.PutTrailingBits();
+	writer.WriteNAL(0, 6, output);
+}
+
+int SyntheticStream::Next(std::vector<uint8_t>& output) {
+	if (pending.empty())
+		planGroup();
+	if (pending.empty())
+		return VREADER_REPEAT;
+	Picture picture = pending.front();
+	pending.pop_front();
+	//frame_num is incremented after every reference frame, B-frames aren't references
+	if (picture.type == IDR) {
+		lastIDR = picture.display;
+		frameNum = 0;
+		writeHeaders(output);
+	}
+	else {
+		frameNum = (prevRefFrameNum + 1) & ((1 << log2MaxFrameNum) - 1);
+	}
+	if (picture.type != B)
+		prevRefFrameNum = frameNum;
+	if (parameters.timestamps)
+		writeTimestamp(output);
+	int macroblocks = widthMBs * heightMBs;
+	for (int i = 0; i < parameters.slices; i++)
+		writeSlice(picture, macroblocks * i / parameters.slices, macroblocks * (i + 1) / parameters.slices, output);
+	if (picture.type == IDR)
+		idrNumber++;
+	produced++;
+	return VREADER_OK;
+}
+
+int SyntheticStream::Read(uint8_t* buffer, int size) {
+	int copied = 0;
+	while (copied < size) {
+		if (bufferedOffset == buffered.size()) {
+			buffered.clear();
+			bufferedOffset = 0;
+			if (Next(buffered) != VREADER_OK)
+				break;
+		}
+		int chunk = (int)std::min((size_t)(size - copied), buffered.size() - bufferedOffset);
+		memcpy(buffer + copied, &buffered[bufferedOffset], chunk);
+		bufferedOffset += chunk;
+		copied += chunk;
+	}
+	return copied;
+}
+
+int SyntheticStream::Write(const std::string& fileName) {
+	if (parameters.frames == 0)
+		return VREADER_UNSUPPORTED;
+	std::shared_ptr<FILE> file(fopen(fileName.c_str(), "wb"), [](FILE* file) { if (file) fclose(file); });
+	if (file == nullptr)
+		return VREADER_ERROR;
+	std::vector<uint8_t> output;
+	while (Next(output) == VREADER_OK) {
+		if (fwrite(&output[0], output.size(), 1, file.get()) != 1)
+			return VREADER_ERROR;
+		output.clear();
+	}
+	return VREADER_OK;
+}
+
+SyntheticParameters SyntheticStream::getParameters() {
+	return parameters;
+}
+
+int SyntheticStream::getFramesProduced() {
+	return produced;
+}
+
+bool SyntheticStream::IsSynthetic(const std::string& path) {
+	return path.compare(0, syntheticScheme.size(), syntheticScheme) == 0;
+}
+
+int SyntheticStream::ParseURL(const std::string& url, SyntheticParameters& parameters) {
+	if (!IsSynthetic(url))
+		return VREADER_UNSUPPORTED;
+	std::string value = url.substr(syntheticScheme.size());
+	std::string query;
+	size_t separator = value.find('?');
+	if (separator != std::string::npos) {
+		query = value.substr(separator + 1);
+		value = value.substr(0, separator);
+	}
+	if (!value.empty() && sscanf(value.c_str(), "%dx%d", &parameters.width, &parameters.height) != 2)
+		return VREADER_UNSUPPORTED;
+	size_t start = 0;
+	while (start < query.size()) {
+		size_t end = query.find('&', start);
+		if (end == std::string::npos)
+			end = query.size();
+		std::string item = query.substr(start, end - start);
+		start = end + 1;
+		separator = item.find('=');
+		if (separator == std::string::npos)
+			return VREADER_UNSUPPORTED;
+		std::string key = item.substr(0, separator);
+		const char* argument = item.c_str() + separator + 1;
+		int parsed = 1;
+		if (key == "fps") {
+			parameters.frameRateDen = 1;
+			parsed = sscanf(argument, "%d/%d", &parameters.frameRateNum, &parameters.frameRateDen);
+		}
+		else if (key == "gop")
+			parsed = sscanf(argument, "%d", &parameters.idrInterval);
+		else if (key == "bframes")
+			parsed = sscanf(argument, "%d", &parameters.bFrames);
+		else if (key == "slices")
+			parsed = sscanf(argument, "%d", &parameters.slices);
+		else if (key == "complexity")
+			parsed = sscanf(argument, "%f", &parameters.complexity);
+		else if (key == "frames")
+			parsed = sscanf(argument, "%d", &parameters.frames);
+		else if (key == "seed")
+			parsed = sscanf(argument, "%u", &parameters.seed);
+		else if (key == "timestamps") {
+			int enabled = 0;
+			parsed = sscanf(argument, "%d", &enabled);
+			parameters.timestamps = enabled != 0;
+		}
+		else
+			return VREADER_UNSUPPORTED;
+		if (parsed < 1)
+			return VREADER_UNSUPPORTED;
+	}
+	return VREADER_OK;
+}
@@ -0,0 +1,88 @@
+#include "ThreadPool.h"
+#include <algorithm>
+
+ThreadPool::ThreadPool(int threads) {
+	if (threads <= 0)
+		threads = std::max(1u, std::thread::hardware_concurrency());
+	//caller thread is also used for execution
+	for (int i = 0; i < threads - 1; i++)
+		workers.push_back(std::thread(&ThreadPool::workerLoop, this));
+}
+
+ThreadPool::~ThreadPool() {
+	{
+		std::unique_lock<std::mutex> locker(jobsSync);
+		stop = true;
+	}
+	jobAdded.notify_all();
+	for (auto& worker : workers)
+		worker.join();
+}
+
+int ThreadPool::getThreadsNumber() {
+	return workers.size() + 1;
+}
+
+int ThreadPool::getQueuedJobs() {
+	std::unique_lock<std::mutex> locker(jobsSync);
+	return jobs.size();
+}
+
+bool ThreadPool::runNext(std::shared_ptr<Job> job, std::unique_lock<std::mutex>& locker) {
+	//all indexes are taken, so other threads shouldn't see this job anymore
+	if (job->next >= job->count) {
+		if (!jobs.empty() && jobs.front() == job)
+			jobs.pop();
+		return false;
+	}
+	int index = job->next++;
+	locker.unlock();
+	(*job->task)(index);
+	locker.lock();
+	if (++job->finished == job->count)
+		jobFinished.notify_all();
+	return true;
+}
+
+void ThreadPool::workerLoop() {
+	std::unique_lock<std::mutex> locker(jobsSync);
+	while (true) {
+		jobAdded.wait(locker, [this] { return stop || !jobs.empty(); });
+		if (stop)
+			return;
+		std::shared_ptr<Job> job = jobs.front();
+		runNext(job, locker);
+	}
+}
+
+void ThreadPool::parallelFor(int count, const std::function<void(int)>& task) {
+	if (count <= 0)
+		return;
+	if (workers.empty() || count == 1) {
+		for (int i = 0; i < count; i++)
+			task(i);
+		return;
+	}
+	std::shared_ptr<Job> job = std::make_shared<Job>();
+	job->task = &task;
+	job->count = count;
+	std::unique_lock<std::mutex> locker(jobsSync);
+	jobs.push(job);
+	jobAdded.notify_all();
+	while (runNext(job, locker));
+	jobFinished.wait(locker, [&job] { return job->finished == job->count; });
+}
+
+void ThreadPool::submit(std::function<void()> task) {
+	if (workers.empty()) {
+		task();
+		return;
+	}
+	std::shared_ptr<Job> job = std::make_shared<Job>();
+	job->ownedTask = [task](int) { task(); };
+	job->task = &job->ownedTask;
+	job->count = 1;
+	std::unique_lock<std::mutex> locker(jobsSync);
+	jobs.push(job);
+	jobAdded.notify_one();
+}
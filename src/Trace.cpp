@@ -0,0 +1,121 @@
+#include "Trace.h"
+#include "Common.h"
+#include <chrono>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <cstring>
+#include <stdio.h>
+
+std::atomic<int> traceLevel{ 0 };
+static std::atomic<int64_t> traceStart{ 0 };
+
+//events kept for every thread
+const int traceCapacity = 1 << 13;
+
+/*
+Single writer ring: sequence of slot is odd while event is written and is 2 * (index + 1) after it, so reader can detect events
+overwritten during copy
+*/
+struct TraceSlot {
+	std::atomic<uint64_t> sequence{ 0 };
+	TraceEvent event;
+};
+
+struct TraceRing {
+	TraceRing(int id) : id(id), slots(traceCapacity) {
+	}
+	int id;
+	std::string name;
+	std::vector<TraceSlot> slots;
+	std::atomic<uint64_t> head{ 0 };
+};
+
+//rings outlive their threads, so events of finished threads are exported too
+static std::mutex ringsSync;
+static std::vector<std::shared_ptr<TraceRing> > rings;
+
+static TraceRing& getRing() {
+	thread_local std::shared_ptr<TraceRing> ring;
+	if (ring == nullptr) {
+		std::unique_lock<std::mutex> locker(ringsSync);
+		ring = std::make_shared<TraceRing>((int)rings.size() + 1);
+		rings.push_back(ring);
+	}
+	return *ring;
+}
+
+int64_t traceClock() {
+	static const std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch).count();
+}
+
+void enableTracing(int level) {
+	traceStart = traceClock();
+	traceLevel = level;
+}
+
+void traceEvent(const char* name, int64_t start, int frame, const char* consumer) {
+	TraceRing& ring = getRing();
+	uint64_t index = ring.head.load(std::memory_order_relaxed);
+	TraceSlot& slot = ring.slots[index % traceCapacity];
+	slot.sequence.store(2 * index + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	slot.event.name = name;
+	slot.event.start = start;
+	slot.event.end = traceClock();
+	slot.event.frame = frame;
+	strncpy(slot.event.consumer, consumer, sizeof(slot.event.consumer) - 1);
+	slot.event.consumer[sizeof(slot.event.consumer) - 1] = 0;
+	slot.sequence.store(2 * index + 2, std::memory_order_release);
+	ring.head.store(index + 1, std::memory_order_release);
+}
+
+void setTraceThreadName(const char* name) {
+	TraceRing& ring = getRing();
+	std::unique_lock<std::mutex> locker(ringsSync);
+	ring.name = name;
+}
+
+int exportTrace(const std::string& fileName) {
+	std::shared_ptr<FILE> file(fopen(fileName.c_str(), "w"), [](FILE* file) { if (file) fclose(file); });
+	if (file == nullptr)
+		return VREADER_ERROR;
+	std::vector<std::shared_ptr<TraceRing> > snapshot;
+	{
+		std::unique_lock<std::mutex> locker(ringsSync);
+		snapshot = rings;
+		fprintf(file.get(), "{\"traceEvents\":[\n");
+		for (auto& ring : snapshot) {
+			std::string name = ring->name.empty() ? std::string("thread ") + std::to_string(ring->id) : ring->name;
+			fprintf(file.get(), "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}},\n", ring->id, name.c_str());
+		}
+	}
+	int64_t start = traceStart;
+	bool first = true;
+	for (auto& ring : snapshot) {
+		uint64_t head = ring->head.load(std::memory_order_acquire);
+		uint64_t tail = head > (uint64_t)traceCapacity ? head - traceCapacity : 0;
+		for (uint64_t index = tail; index < head; index++) {
+			TraceSlot& slot = ring->slots[index % traceCapacity];
+			uint64_t sequence = slot.sequence.load(std::memory_order_acquire);
+			if (sequence != 2 * index + 2)
+				continue;
+			TraceEvent event = slot.event;
+			std::atomic_thread_fence(std::memory_order_acquire);
+			if (slot.sequence.load(std::memory_order_relaxed) != sequence || event.start < start)
+				continue;
+			//consumer names come from users, so symbols which need escaping in JSON are replaced
+			for (char* symbol = event.consumer; *symbol; symbol++) {
+				if (*symbol == '"' || *symbol == '\\' || (unsigned char)*symbol < ' ')
+					*symbol = '_';
+			}
+			fprintf(file.get(), "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"consumer\":\"%s\",\"frame\":%d}}",
+				first ? "" : ",\n", event.name, ring->id, event.start / 1000.0, (event.end - event.start) / 1000.0, event.consumer, event.frame);
+			first = false;
+		}
+	}
+	//metadata events end with comma, so the list is closed by empty object if there are no spans
+	fprintf(file.get(), "%s]}\n", first ? "{}" : "");
+	return VREADER_OK;
+}
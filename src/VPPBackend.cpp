@@ -0,0 +1,318 @@
+#include "VPPBackend.h"
+#include "VideoProcessor.h"
+#include "KernelsCPU.h"
+#include "Common.h"
+#include <cstring>
+
+int VPPBackendCUDA::Init() {
+	cudaGetDeviceProperties(&prop, 0);
+	buffers = std::make_shared<BufferPool>([](void** data, size_t size) {
+		return (int)cudaMalloc(data, size);
+	}, [this](void* data) {
+		{
+			std::unique_lock<std::mutex> locker(fenceSync);
+			auto fence = fenceArr.find(data);
+			if (fence != fenceArr.end()) {
+				cudaEventDestroy(fence->second);
+				fenceArr.erase(fence);
+			}
+		}
+		cudaFree(data);
+	});
+	for (int i = 0; i < maxConsumers; i++) {
+		cudaStream_t stream;
+		cudaStreamCreate(&stream);
+		streamArr.push_back(std::make_pair(std::string("empty"), stream));
+		scratchArr.push_back(std::make_pair(std::string("empty"), std::make_shared<DeviceBuffer>(DeviceBuffer{ nullptr, 0 })));
+	}
+	return VREADER_OK;
+}
+
+cudaStream_t VPPBackendCUDA::getStream(std::string consumerName) {
+	std::unique_lock<std::mutex> locker(streamSync);
+	return findFree<cudaStream_t>(consumerName, streamArr);
+}
+
+int VPPBackendCUDA::Allocate(void** data, size_t size) {
+	int sts = buffers->Allocate(data, size);
+	CHECK_STATUS(sts);
+	std::unique_lock<std::mutex> locker(fenceSync);
+	auto fence = fenceArr.find(*data);
+	if (fence != fenceArr.end())
+		sts = cudaEventSynchronize(fence->second);
+	return sts;
+}
+
+int VPPBackendCUDA::Free(void* data) {
+	if (data == nullptr)
+		return VREADER_OK;
+	{
+		//legacy default stream waits for all consumer streams, so event is completed after all work queued before this call
+		std::unique_lock<std::mutex> locker(fenceSync);
+		auto fence = fenceArr.find(data);
+		if (fence == fenceArr.end()) {
+			cudaEvent_t event;
+			int sts = cudaEventCreateWithFlags(&event, cudaEventDisableTiming);
+			CHECK_STATUS(sts);
+			fence = fenceArr.insert(std::make_pair(data, event)).first;
+		}
+		int sts = cudaEventRecord(fence->second, 0);
+		CHECK_STATUS(sts);
+	}
+	return buffers->Free(data);
+}
+
+int VPPBackendCUDA::Copy2D(void* dst, size_t dstPitch, void* src, size_t srcPitch, size_t width, size_t height) {
+	return cudaMemcpy2D(dst, dstPitch, src, srcPitch, width, height, cudaMemcpyDeviceToDevice);
+}
+
+int VPPBackendCUDA::CopyToHost(void* dst, void* src, size_t size) {
+	return cudaMemcpy(dst, src, size, cudaMemcpyDeviceToHost);
+}
+
+int VPPBackendCUDA::NV12ToRGB24(AVFrame* src, AVFrame* dst, const ColorCoefficients& coefficients, std::string consumerName) {
+	cudaStream_t stream = getStream(consumerName);
+	int sts = Allocate(&dst->opaque, dst->channels * src->width * src->height * sizeof(unsigned char));
+	CHECK_STATUS(sts);
+	return ::NV12ToRGB24(src, dst, coefficients, prop.maxThreadsPerBlock, &stream);
+}
+
+int VPPBackendCUDA::NV12ToBGR24(AVFrame* src, AVFrame* dst, const ColorCoefficients& coefficients, std::string consumerName) {
+	cudaStream_t stream = getStream(consumerName);
+	int sts = Allocate(&dst->opaque, dst->channels * src->width * src->height * sizeof(unsigned char));
+	CHECK_STATUS(sts);
+	return ::NV12ToBGR24(src, dst, coefficients, prop.maxThreadsPerBlock, &stream);
+}
+
+//resize output is NV12 frame of dst size, planes are allocated separately
+static int allocateNV12(VPPBackend* backend, AVFrame* dst) {
+	int sts = backend->Allocate((void**)&dst->data[0], dst->width * dst->height * sizeof(unsigned char));
+	CHECK_STATUS(sts);
+	sts = backend->Allocate((void**)&dst->data[1], dst->width * (dst->height / 2) * sizeof(unsigned char));
+	if (sts != VREADER_OK)
+		backend->Free(dst->data[0]);
+	return sts;
+}
+
+int VPPBackendCUDA::resizeNV12Nearest(AVFrame* src, AVFrame* dst, std::string consumerName) {
+	cudaStream_t stream = getStream(consumerName);
+	int sts = allocateNV12(this, dst);
+	CHECK_STATUS(sts);
+	return ::resizeNV12Nearest(src, dst, prop.maxThreadsPerBlock, &stream);
+}
+
+int VPPBackendCUDA::resizeNV12Bilinear(AVFrame* src, AVFrame* dst, std::string consumerName) {
+	cudaStream_t stream = getStream(consumerName);
+	int sts = allocateNV12(this, dst);
+	CHECK_STATUS(sts);
+	return ::resizeNV12Bilinear(src, dst, prop.maxThreadsPerBlock, &stream);
+}
+
+int VPPBackendCUDA::getFilter(std::shared_ptr<const ResizeFilter> filter, DeviceFilter& device) {
+	std::unique_lock<std::mutex> locker(filterSync);
+	for (auto& item : filterArr) {
+		if (item.first == filter) {
+			device = item.second;
+			return VREADER_OK;
+		}
+	}
+	//filters referenced only from here aren't used by pipelines anymore
+	for (auto item = filterArr.begin(); item != filterArr.end();) {
+		if (item->first.use_count() == 1) {
+			freeFilter(item->second);
+			item = filterArr.erase(item);
+		}
+		else
+			item++;
+	}
+	int sts = uploadFilter(*filter, device);
+	CHECK_STATUS(sts);
+	filterArr.push_back(std::make_pair(filter, device));
+	return VREADER_OK;
+}
+
+int VPPBackendCUDA::launchPipeline(AVFrame* src, void* output, size_t pitch, const VPPPipeline& pipeline, cudaStream_t stream,
+	std::string consumerName) {
+	int sts = VREADER_OK;
+	DeviceFilter filter;
+	std::shared_ptr<DeviceBuffer> scratch;
+	if (pipeline.filter) {
+		sts = getFilter(pipeline.filter, filter);
+		CHECK_STATUS(sts);
+		{
+			std::unique_lock<std::mutex> locker(streamSync);
+			scratch = findFree<std::shared_ptr<DeviceBuffer> >(consumerName, scratchArr);
+		}
+		if (scratch == nullptr)
+			return VREADER_ERROR;
+		size_t size = pipeline.getIntermediateSize();
+		if (scratch->size < size) {
+			//previous frame of consumer can still use buffer
+			cudaStreamSynchronize(stream);
+			cudaFree(scratch->data);
+			scratch->size = 0;
+			sts = cudaMalloc(&scratch->data, size);
+			CHECK_STATUS(sts);
+			scratch->size = size;
+		}
+	}
+	return ::processPipeline(src, output, pitch, pipeline, scratch ? &filter : nullptr, scratch ? scratch->data : nullptr,
+		prop.maxThreadsPerBlock, &stream);
+}
+
+int VPPBackendCUDA::Process(AVFrame* src, AVFrame* dst, const VPPPipeline& pipeline, std::string consumerName) {
+	int sts = Allocate(&dst->opaque, pipeline.getOutputSize());
+	CHECK_STATUS(sts);
+	sts = launchPipeline(src, dst->opaque, pipeline.getRowSize(), pipeline, getStream(consumerName), consumerName);
+	if (sts != VREADER_OK)
+		Free(dst->opaque);
+	return sts;
+}
+
+int VPPBackendCUDA::ProcessInto(AVFrame* src, void* dst, size_t pitch, const VPPPipeline& pipeline, std::string consumerName) {
+	cudaStream_t stream = getStream(consumerName);
+	int sts = launchPipeline(src, dst, pitch, pipeline, stream, consumerName);
+	CHECK_STATUS(sts);
+	//caller doesn't know consumer's stream, so memory is handed over only after conversion is finished
+	return cudaStreamSynchronize(stream);
+}
+
+int VPPBackendCUDA::Downscale(AVFrame* src, AVFrame* dst, int elementSize, bool planar, std::string consumerName) {
+	//source level can be converted by other consumer's stream (shared conversion), legacy default stream waits for all of them
+	cudaStream_t stream = 0;
+	int sts = Allocate(&dst->opaque, (size_t)dst->width * dst->height * src->channels);
+	CHECK_STATUS(sts);
+	sts = ::downscaleArea(src, dst, elementSize, planar, prop.maxThreadsPerBlock, &stream);
+	if (sts != VREADER_OK)
+		Free(dst->opaque);
+	return sts;
+}
+
+void VPPBackendCUDA::Close() {
+	buffers->Close();
+	for (auto& item : streamArr)
+		cudaStreamDestroy(item.second);
+	streamArr.clear();
+	for (auto& item : scratchArr)
+		cudaFree(item.second->data);
+	scratchArr.clear();
+	for (auto& item : filterArr)
+		freeFilter(item.second);
+	filterArr.clear();
+}
+
+VPPBackendCPU::VPPBackendCPU(int _threads) : threads(_threads) {
+}
+
+int VPPBackendCPU::Init() {
+	pool = std::make_shared<ThreadPool>(threads);
+	buffers = std::make_shared<BufferPool>([](void** data, size_t size) -> int {
+		*data = av_malloc(size);
+		if (*data == nullptr)
+			return AVERROR(ENOMEM);
+		return VREADER_OK;
+	}, [](void* data) {
+		av_free(data);
+	});
+	return VREADER_OK;
+}
+
+int VPPBackendCPU::Allocate(void** data, size_t size) {
+	return buffers->Allocate(data, size);
+}
+
+int VPPBackendCPU::Free(void* data) {
+	return buffers->Free(data);
+}
+
+int VPPBackendCPU::Copy2D(void* dst, size_t dstPitch, void* src, size_t srcPitch, size_t width, size_t height) {
+	for (size_t i = 0; i < height; i++) {
+		memcpy((uint8_t*)dst + i * dstPitch, (uint8_t*)src + i * srcPitch, width);
+	}
+	return VREADER_OK;
+}
+
+int VPPBackendCPU::CopyToHost(void* dst, void* src, size_t size) {
+	memcpy(dst, src, size);
+	return VREADER_OK;
+}
+
+int VPPBackendCPU::NV12ToRGB24(AVFrame* src, AVFrame* dst, const ColorCoefficients& coefficients, std::string consumerName) {
+	int width = src->width;
+	int height = src->height;
+	uint8_t* RGB = nullptr;
+	int sts = Allocate((void**)&RGB, dst->channels * width * height * sizeof(unsigned char));
+	CHECK_STATUS(sts);
+	int pitchNV12 = src->linesize[0] ? src->linesize[0] : width;
+	NV12ToRGB24CPU(src->data[0], src->data[1], RGB, width, height, pitchNV12, dst->channels * width, coefficients, pool.get());
+	dst->opaque = RGB;
+	return sts;
+}
+
+int VPPBackendCPU::NV12ToBGR24(AVFrame* src, AVFrame* dst, const ColorCoefficients& coefficients, std::string consumerName) {
+	int width = src->width;
+	int height = src->height;
+	uint8_t* BGR = nullptr;
+	int sts = Allocate((void**)&BGR, dst->channels * width * height * sizeof(unsigned char));
+	CHECK_STATUS(sts);
+	int pitchNV12 = src->linesize[0] ? src->linesize[0] : width;
+	NV12ToBGR24CPU(src->data[0], src->data[1], BGR, width, height, pitchNV12, dst->channels * width, coefficients, pool.get());
+	dst->opaque = BGR;
+	return sts;
+}
+
+int VPPBackendCPU::resizeNV12Nearest(AVFrame* src, AVFrame* dst, std::string consumerName) {
+	int sts = allocateNV12(this, dst);
+	CHECK_STATUS(sts);
+	//the same ratios as in CUDA version
+	float xRatio = ((float)(src->width - 1)) / dst->width;
+	float yRatio = ((float)(src->height - 1)) / dst->height;
+	resizeNV12NearestCPU(src->data[0], src->data[1], dst->data[0], dst->data[1], src->width, src->height, src->linesize[0], src->linesize[1],
+		dst->width, dst->height, xRatio, yRatio, pool.get());
+	return sts;
+}
+
+int VPPBackendCPU::resizeNV12Bilinear(AVFrame* src, AVFrame* dst, std::string consumerName) {
+	int sts = allocateNV12(this, dst);
+	CHECK_STATUS(sts);
+	float xRatio = ((float)(src->width - 1)) / dst->width;
+	float yRatio = ((float)(src->height - 1)) / dst->height;
+	resizeNV12BilinearCPU(src->data[0], src->data[1], dst->data[0], dst->data[1], src->width, src->height, src->linesize[0], src->linesize[1],
+		dst->width, dst->height, xRatio, yRatio, pool.get());
+	return sts;
+}
+
+int VPPBackendCPU::Process(AVFrame* src, AVFrame* dst, const VPPPipeline& pipeline, std::string consumerName) {
+	void* output = nullptr;
+	int sts = Allocate(&output, pipeline.getOutputSize());
+	CHECK_STATUS(sts);
+	int pitchY = src->linesize[0] ? src->linesize[0] : src->width;
+	int pitchUV = src->linesize[1] ? src->linesize[1] : src->width;
+	processPipelineCPU(src->data[0], src->data[1], pitchY, pitchUV, src->width, output, pipeline, pool.get());
+	dst->opaque = output;
+	return sts;
+}
+
+int VPPBackendCPU::ProcessInto(AVFrame* src, void* dst, size_t pitch, const VPPPipeline& pipeline, std::string consumerName) {
+	int pitchY = src->linesize[0] ? src->linesize[0] : src->width;
+	int pitchUV = src->linesize[1] ? src->linesize[1] : src->width;
+	processPipelineCPU(src->data[0], src->data[1], pitchY, pitchUV, src->width, dst, pipeline, pool.get(), pitch);
+	return VREADER_OK;
+}
+
+int VPPBackendCPU::Downscale(AVFrame* src, AVFrame* dst, int elementSize, bool planar, std::string consumerName) {
+	void* output = nullptr;
+	int sts = Allocate(&output, (size_t)dst->width * dst->height * src->channels);
+	CHECK_STATUS(sts);
+	downscaleAreaCPU(src->opaque, src->width, src->height, output, dst->width, dst->height, src->channels / elementSize, elementSize,
+		planar, pool.get());
+	dst->opaque = output;
+	dst->channels = src->channels;
+	dst->format = src->format;
+	return sts;
+}
+
+void VPPBackendCPU::Close() {
+	pool = nullptr;
+	buffers->Close();
+}
@@ -0,0 +1,230 @@
+#include "VPPPipeline.h"
+#include <algorithm>
+#include <cstring>
+#include <cmath>
+#include <map>
+#include <mutex>
+
+void VPPPipeline::initTables() {
+	resize = dstWidth != cropWidth || dstHeight != cropHeight;
+	//the same ratios as in resize kernels, crop rectangle is resized instead of the whole frame
+	xRatio = ((float)(cropWidth - 1)) / dstWidth;
+	yRatio = ((float)(cropHeight - 1)) / dstHeight;
+	xIndex.resize(dstWidth);
+	yIndex.resize(dstHeight);
+	//odd output size has chroma for the last pixel too
+	xIndexUV.resize((dstWidth + 1) / 2);
+	yIndexUV.resize((dstHeight + 1) / 2);
+	for (int j = 0; j < dstWidth; j++)
+		xIndex[j] = cropX + (resize ? (int)(xRatio * j) : j);
+	for (int i = 0; i < dstHeight; i++)
+		yIndex[i] = cropY + (resize ? (int)(yRatio * i) : i);
+	//chroma is taken from pair which contains luma coordinate of even pixel
+	for (int j = 0; j < (int)xIndexUV.size(); j++)
+		xIndexUV[j] = xIndex[2 * j] / 2;
+	//resize kernels use luma ratio for chroma rows
+	for (int i = 0; i < (int)yIndexUV.size(); i++)
+		yIndexUV[i] = cropY / 2 + (resize ? (int)(yRatio * i) : i);
+	filter = resize && kernel != FILTER_NEAREST ? getResizeFilter(kernel, cropWidth, cropHeight, dstWidth, dstHeight) : nullptr;
+
+	normalizationTable.clear();
+	halfTable.clear();
+	if (type == PIXEL_FLOAT32 || type == PIXEL_FLOAT16) {
+		normalizationTable.resize(channels * 256);
+		for (int c = 0; c < channels; c++) {
+			for (int value = 0; value < 256; value++)
+				normalizationTable[c * 256 + value] = value * scale[c] + offset[c];
+		}
+	}
+	if (type == PIXEL_FLOAT16) {
+		halfTable.resize(normalizationTable.size());
+		for (int i = 0; i < (int)normalizationTable.size(); i++)
+			halfTable[i] = floatToHalf(normalizationTable[i]);
+	}
+}
+
+int VPPPipeline::getElementSize() const {
+	switch (type) {
+	case PIXEL_FLOAT32:
+		return sizeof(float);
+	case PIXEL_FLOAT16:
+		return sizeof(uint16_t);
+	default:
+		return sizeof(uint8_t);
+	}
+}
+
+size_t VPPPipeline::getRowSize() const {
+	return (size_t)outputWidth * (layout == LAYOUT_CHW ? 1 : channels) * getElementSize();
+}
+
+int VPPPipeline::getPlanes() const {
+	return layout == LAYOUT_CHW ? channels : 1;
+}
+
+size_t VPPPipeline::getOutputSize() const {
+	//YUV 4:2:0 has chroma of half width and half height for every luma plane
+	if (layout == LAYOUT_NV12 || layout == LAYOUT_I420)
+		return getRowSize() * outputHeight * 3 / 2;
+	return getRowSize() * outputHeight * getPlanes();
+}
+
+//Keys' cubic convolution with a = -0.75
+static double cubicWeight(double distance) {
+	const double a = -0.75;
+	distance = std::fabs(distance);
+	if (distance <= 1)
+		return ((a + 2) * distance - (a + 3)) * distance * distance + 1;
+	if (distance < 2)
+		return ((a * distance - 5 * a) * distance + 8 * a) * distance - 4 * a;
+	return 0;
+}
+
+void FilterTable::init(FilterKernel kernel, int srcSize, int dstSize) {
+	double scale = (double)srcSize / dstSize;
+	//for upscale every output pixel is covered by one source pixel, so area is the same as bilinear
+	if (kernel == FILTER_AREA && scale <= 1)
+		kernel = FILTER_BILINEAR;
+	//source positions and weights before border clamping
+	std::vector<std::vector<std::pair<int, double> > > contributions(dstSize);
+	for (int j = 0; j < dstSize; j++) {
+		if (kernel == FILTER_AREA) {
+			//average of source pixels covered by [start, end) with weights proportional to covered part
+			double start = j * scale;
+			double end = start + scale;
+			for (int k = (int)std::floor(start); k < end; k++) {
+				double covered = std::min(end, k + 1.0) - std::max(start, (double)k);
+				if (covered > 1e-9)
+					contributions[j].push_back(std::make_pair(k, covered / scale));
+			}
+			continue;
+		}
+		double center = (j + 0.5) * scale - 0.5;
+		int base = (int)std::floor(center);
+		double fraction = center - base;
+		if (kernel == FILTER_BICUBIC) {
+			for (int t = -1; t <= 2; t++)
+				contributions[j].push_back(std::make_pair(base + t, cubicWeight(fraction - t)));
+		}
+		else {
+			contributions[j].push_back(std::make_pair(base, 1 - fraction));
+			contributions[j].push_back(std::make_pair(base + 1, fraction));
+		}
+	}
+	//positions out of source are replaced by the nearest border pixel
+	taps = 1;
+	for (auto& item : contributions) {
+		for (auto& contribution : item)
+			contribution.first = std::min(std::max(contribution.first, 0), srcSize - 1);
+		taps = std::max(taps, item.back().first - item.front().first + 1);
+	}
+	index.resize(dstSize);
+	weights.assign((size_t)dstSize * taps, 0);
+	for (int j = 0; j < dstSize; j++) {
+		index[j] = std::min(contributions[j].front().first, srcSize - taps);
+		std::vector<double> values(taps, 0);
+		for (auto& contribution : contributions[j])
+			values[contribution.first - index[j]] += contribution.second;
+		//rounding error is added to the biggest weight, so sum of weights is exactly filterOne
+		int16_t* weight = &weights[(size_t)j * taps];
+		int sum = 0, biggest = 0;
+		for (int t = 0; t < taps; t++) {
+			weight[t] = (int16_t)lround(values[t] * filterOne);
+			sum += weight[t];
+			if (std::abs(weight[t]) > std::abs(weight[biggest]))
+				biggest = t;
+		}
+		weight[biggest] += filterOne - sum;
+	}
+}
+
+std::shared_ptr<const ResizeFilter> getResizeFilter(FilterKernel kernel, int srcWidth, int srcHeight, int dstWidth, int dstHeight) {
+	//geometries are changed rarely, so cache is just dropped if it's full, filters which are in use are kept by pipelines
+	const int maxCachedFilters = 64;
+	static std::mutex cacheSync;
+	static std::map<std::vector<int>, std::shared_ptr<const ResizeFilter> > cache;
+	std::vector<int> key = { kernel, srcWidth, srcHeight, dstWidth, dstHeight };
+	std::unique_lock<std::mutex> locker(cacheSync);
+	auto item = cache.find(key);
+	if (item != cache.end())
+		return item->second;
+	std::shared_ptr<ResizeFilter> filter = std::make_shared<ResizeFilter>();
+	filter->x.init(kernel, srcWidth, dstWidth);
+	filter->y.init(kernel, srcHeight, dstHeight);
+	//odd sizes have chroma for the last pixel too
+	filter->xUV.init(kernel, (srcWidth + 1) / 2, (dstWidth + 1) / 2);
+	filter->yUV.init(kernel, (srcHeight + 1) / 2, (dstHeight + 1) / 2);
+	if (cache.size() >= maxCachedFilters)
+		cache.clear();
+	cache[key] = filter;
+	return filter;
+}
+
+size_t VPPPipeline::getIntermediateSize() const {
+	size_t luma = (size_t)cropHeight * dstWidth;
+	size_t chroma = channels == 3 ? (size_t)((cropHeight + 1) / 2) * ((dstWidth + 1) / 2) * 2 : 0;
+	return (luma + chroma) * sizeof(int16_t);
+}
+
+uint16_t floatToHalf(float value) {
+	uint32_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+	uint16_t sign = (bits >> 16) & 0x8000;
+	uint32_t magnitude = bits & 0x7FFFFFFF;
+	//infinity and NaN
+	if (magnitude >= 0x7F800000)
+		return sign | 0x7C00 | (magnitude > 0x7F800000 ? 0x200 : 0);
+	//values rounded to 65520 and more overflow
+	if (magnitude >= 0x477FF000)
+		return sign | 0x7C00;
+	//subnormal half, values less than 2^-25 are rounded to zero
+	if (magnitude < 0x38800000) {
+		if (magnitude < 0x33000000)
+			return sign;
+		uint32_t mantissa = (magnitude & 0x7FFFFF) | 0x800000;
+		int shift = 126 - (int)(magnitude >> 23);
+		uint32_t result = mantissa >> shift;
+		uint32_t remainder = mantissa & ((1u << shift) - 1);
+		uint32_t halfway = 1u << (shift - 1);
+		if (remainder > halfway || (remainder == halfway && (result & 1)))
+			result++;
+		return sign | result;
+	}
+	//rebias exponent from 127 to 15, carry of rounding goes to exponent
+	uint32_t result = (magnitude >> 13) - (112 << 10);
+	uint32_t remainder = magnitude & 0x1FFF;
+	if (remainder > 0x1000 || (remainder == 0x1000 && (result & 1)))
+		result++;
+	return sign | result;
+}
+
+float halfToFloat(uint16_t value) {
+	uint32_t sign = (uint32_t)(value & 0x8000) << 16;
+	uint32_t exponent = (value >> 10) & 0x1F;
+	uint32_t mantissa = value & 0x3FF;
+	uint32_t bits;
+	if (exponent == 0x1F) {
+		//infinity and NaN
+		bits = sign | 0x7F800000 | (mantissa << 13);
+	}
+	else if (exponent == 0) {
+		//zero and subnormal half, every subnormal half is normal float
+		if (mantissa == 0) {
+			bits = sign;
+		}
+		else {
+			exponent = 113;
+			while (!(mantissa & 0x400)) {
+				mantissa <<= 1;
+				exponent--;
+			}
+			bits = sign | (exponent << 23) | ((mantissa & 0x3FF) << 13);
+		}
+	}
+	else {
+		bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+	}
+	float result;
+	memcpy(&result, &bits, sizeof(result));
+	return result;
+}
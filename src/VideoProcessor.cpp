@@ -1,142 +1,712 @@
 #include "VideoProcessor.h"
 #include "Common.h"
+#include <cmath>
+#include <algorithm>
 
-void saveFrame(AVFrame *avFrame, FILE* dump) {
-	
-	uint8_t *frame = avFrame->data[0];
-	for (uint32_t i = 0; i < avFrame->height; i++) {
-		int sts = fwrite(frame, avFrame->width * avFrame->channels, 1, dump);
-		if (avFrame->linesize[0])
-			frame += avFrame->channels * avFrame->linesize[0];
-		else
-			frame += avFrame->channels * avFrame->width;
-	}
-	
-	if (avFrame->format == AV_PIX_FMT_NV12) {
-		uint8_t *frame = avFrame->data[1];
-		for (uint32_t i = 0; i < avFrame->height / 2; i++) {
-			fwrite(frame, avFrame->width * avFrame->channels, 1, dump);
-			if (avFrame->linesize[1])
-				frame += avFrame->channels * avFrame->linesize[1];
-			else
-				frame += avFrame->channels * avFrame->width;
-		}
-	}
-	
-	fflush(dump);
+ColorCoefficients getColorCoefficients(ColorMatrix matrix, ColorRange range) {
+	//Y, RV, GV, GU, BU for BT.601, BT.709, BT.2020
+	const float limited[][5] = { { 1.164f, 1.596f, 0.813f, 0.391f, 2.018f },
+								 { 1.164f, 1.793f, 0.533f, 0.213f, 2.112f },
+								 { 1.164f, 1.679f, 0.650f, 0.187f, 2.142f } };
+	const float full[][5] = { { 1.f, 1.402f, 0.714f, 0.344f, 1.772f },
+							  { 1.f, 1.575f, 0.468f, 0.187f, 1.856f },
+							  { 1.f, 1.475f, 0.571f, 0.165f, 1.881f } };
+	int index = matrix == BT709 ? 1 : (matrix == BT2020 ? 2 : 0);
+	const float* values = range == FULL_RANGE ? full[index] : limited[index];
+	ColorCoefficients coefficients;
+	coefficients.offsetY = range == FULL_RANGE ? 0 : 16;
+	coefficients.Y = (int)lround(values[0] * (1 << colorShift));
+	coefficients.RV = (int)lround(values[1] * (1 << colorShift));
+	coefficients.GV = (int)lround(values[2] * (1 << colorShift));
+	coefficients.GU = (int)lround(values[3] * (1 << colorShift));
+	coefficients.BU = (int)lround(values[4] * (1 << colorShift));
+	return coefficients;
 }
 
 int VideoProcessor::DumpFrame(AVFrame* output, std::shared_ptr<FILE> dumpFile) {
-	//allocate buffers
-	std::shared_ptr<uint8_t> rawData(new uint8_t[output->channels * output->width * output->height], std::default_delete<uint8_t[]>());
-	output->data[0] = rawData.get();
-	cudaError err = cudaMemcpy(output->data[0], output->opaque, output->channels * output->width * output->height * sizeof(unsigned char), cudaMemcpyDeviceToHost);
+	//chroma rows of YUV formats follow luma rows, views of decoded frame have pitch (linesize in pixels) bigger than width
+	int rows = output->format == AV_PIX_FMT_NV12 || output->format == AV_PIX_FMT_YUV420P ? output->height * 3 / 2 : output->height;
+	size_t rowSize = (size_t)output->channels * output->width;
+	size_t pitch = output->linesize[0] ? (size_t)output->channels * output->linesize[0] : rowSize;
+	size_t size = pitch * (rows - 1) + rowSize;
+	std::shared_ptr<uint8_t> rawData(new uint8_t[size], std::default_delete<uint8_t[]>());
+	int err = backend->CopyToHost(rawData.get(), output->opaque, size);
 	CHECK_STATUS(err);
-	saveFrame(output, dumpFile.get());
+	for (int i = 0; i < rows; i++)
+		fwrite(rawData.get() + i * pitch, rowSize, 1, dumpFile.get());
+	fflush(dumpFile.get());
 	return VREADER_OK;
 }
 
-int VideoProcessor::Init(bool _enableDumps) {
+void VideoProcessor::dumpOutput(AVFrame* output, const std::string& consumerName) {
+	TRACE_SPAN_HIGH("dump", consumerName);
+	DumpFormat format;
+	switch (output->format) {
+	case AV_PIX_FMT_GRAY8:
+		format.layout = DUMP_GRAY;
+		break;
+	case AV_PIX_FMT_NV12:
+		format.layout = DUMP_NV12;
+		break;
+	case AV_PIX_FMT_YUV420P:
+		format.layout = DUMP_I420;
+		break;
+	default:
+		format.layout = DUMP_RAW;
+	}
+	format.width = output->width;
+	format.height = output->height;
+	format.rowSize = (size_t)output->channels * output->width;
+	format.rows = format.layout == DUMP_NV12 || format.layout == DUMP_I420 ? output->height * 3 / 2 : output->height;
+	format.pitch = output->linesize[0] ? (size_t)output->channels * output->linesize[0] : format.rowSize;
+	std::vector<uint8_t> buffer = dumps->Acquire(format.pitch * (format.rows - 1) + format.rowSize);
+	if (buffer.empty())
+		return;
+	if (backend->CopyToHost(&buffer[0], output->opaque, buffer.size()) != VREADER_OK) {
+		dumps->Release(std::move(buffer));
+		return;
+	}
+	std::string fileName = std::string("Processed_") + consumerName + (format.layout == DUMP_RAW ? ".yuv" : ".y4m");
+	dumps->Submit(fileName, format, std::move(buffer));
+}
+
+int VideoProcessor::Init(bool _enableDumps, BackendType _backend) {
 	enableDumps = _enableDumps;
+	if (enableDumps)
+		dumps = getDumpWriter();
+	backendType = _backend;
+	if (backendType == CPU_BACKEND)
+		backend = std::make_shared<VPPBackendCPU>();
+	else
+		backend = std::make_shared<VPPBackendCUDA>();
+	int sts = backend->Init();
+	CHECK_STATUS(sts);
+	for (int i = 0; i < maxConsumers; i++)
+		pipelineArr.push_back(std::make_pair(std::string("empty"), std::make_shared<ConsumerPipeline>()));
 
-	cudaGetDeviceProperties(&prop, 0);
-	for (int i = 0; i < maxConsumers; i++) {
-		cudaStream_t stream;
-		cudaStreamCreate(&stream);
-		streamArr.push_back(std::make_pair(std::string("empty"), stream));
-	}
-	
 	isClosed = false;
 	return VREADER_OK;
 }
 
-int VideoProcessor::Convert(AVFrame* input, AVFrame* output, VPPParameters& format, std::string consumerName) {
-	/*
-	Should decide which method call
-	*/
-	cudaStream_t stream;
-	int sts = VREADER_OK;
+int VideoProcessor::Free(void* data) {
 	{
-		std::unique_lock<std::mutex> locker(streamSync);
-		stream = findFree<cudaStream_t>(consumerName, streamArr);
+		//view of decoded frame returns the frame to decoder
+		std::unique_lock<std::mutex> locker(leaseSync);
+		for (auto item = leaseArr.begin(); item != leaseArr.end(); item++) {
+			if (item->first != data)
+				continue;
+			AVFrame* lease = item->second;
+			leaseArr.erase(item);
+			locker.unlock();
+			av_frame_free(&lease);
+			return VREADER_OK;
+		}
 	}
+	{
+		std::unique_lock<std::mutex> locker(cacheSync);
+		for (auto item = cache.begin(); item != cache.end(); item++) {
+			if ((*item)->status != VREADER_OK || (*item)->data != data)
+				continue;
+			//shared output is released only after the last consumer and eviction from cache
+			if (--(*item)->references > 0 || !(*item)->evicted)
+				return VREADER_OK;
+			cache.erase(item);
+			break;
+		}
+	}
+	return backend->Free(data);
+}
+
+BackendType VideoProcessor::getBackendType() {
+	return backendType;
+}
 
-	output->width = format.width;
-	output->height = format.height;
-	bool resize = false;
-	if (output->width && output->height && (input->width != output->width || input->height != output->height)) {
-		resize = true;
-		resizeNV12Nearest(input, output, prop.maxThreadsPerBlock, &stream);
+int getElementSize(FourCC format) {
+	switch (format) {
+	case (Y800):
+	case (RGB24):
+	case (BGR24):
+	case (NV12):
+	case (I420):
+		return 1;
+	case (RGB_PLANAR_F32):
+	case (BGR_PLANAR_F32):
+		return 4;
+	case (RGB_PLANAR_F16):
+	case (BGR_PLANAR_F16):
+		return 2;
+	default:
+		return 0;
+	}
+}
+
+int getChannels(FourCC format) {
+	switch (format) {
+	case (Y800):
+	case (NV12):
+	case (I420):
+		return 1;
+	case (RGB24):
+	case (BGR24):
+	case (RGB_PLANAR_F32):
+	case (BGR_PLANAR_F32):
+	case (RGB_PLANAR_F16):
+	case (BGR_PLANAR_F16):
+		return 3;
+	default:
+		return 0;
 	}
-	else if (output->width == 0 || output->height == 0) {
-		output->width = input->width;
-		output->height = input->height;
+}
+
+/*
+Crop rectangle in source frame and requested output size, left and top of crop are even so chroma pairs aren't split
+*/
+static int resolveGeometry(AVFrame* input, const VPPParameters& format, int& cropX, int& cropY, int& cropWidth, int& cropHeight,
+	int& width, int& height) {
+	//only pixels inside of crop are read
+	if (format.cropX >= (unsigned int)input->width || format.cropY >= (unsigned int)input->height)
+		return VREADER_UNSUPPORTED;
+	cropX = format.cropX & ~1;
+	cropY = format.cropY & ~1;
+	cropWidth = input->width - cropX;
+	cropHeight = input->height - cropY;
+	if (format.cropWidth && format.cropHeight) {
+		cropWidth = std::min(cropWidth, (int)(format.cropX + format.cropWidth) - cropX);
+		cropHeight = std::min(cropHeight, (int)(format.cropY + format.cropHeight) - cropY);
 	}
+	width = format.width && format.height ? format.width : cropWidth;
+	height = format.width && format.height ? format.height : cropHeight;
+	return VREADER_OK;
+}
 
+int compilePipeline(AVFrame* input, const VPPParameters& format, VPPPipeline& pipeline) {
+	pipeline.channels = getChannels(format.dstFourCC);
+	if (pipeline.channels == 0)
+		return VREADER_UNSUPPORTED;
+	bool bgr = format.dstFourCC == BGR24 || format.dstFourCC == BGR_PLANAR_F32 || format.dstFourCC == BGR_PLANAR_F16;
+	pipeline.indexR = bgr ? 2 : 0;
+	pipeline.indexB = bgr ? 0 : 2;
+	switch (getElementSize(format.dstFourCC)) {
+	case 4:
+		pipeline.type = PIXEL_FLOAT32;
+		break;
+	case 2:
+		pipeline.type = PIXEL_FLOAT16;
+		break;
+	default:
+		pipeline.type = PIXEL_UINT8;
+	}
+	//float formats are planar and normalized, 8 bit ones are packed as is
+	pipeline.layout = pipeline.type == PIXEL_UINT8 ? LAYOUT_HWC : LAYOUT_CHW;
+	bool yuv = format.dstFourCC == NV12 || format.dstFourCC == I420;
+	if (yuv)
+		pipeline.layout = format.dstFourCC == NV12 ? LAYOUT_NV12 : LAYOUT_I420;
+	for (int c = 0; c < 3; c++) {
+		if (pipeline.type == PIXEL_UINT8) {
+			pipeline.scale[c] = 1;
+			pipeline.offset[c] = 0;
+		}
+		else {
+			float std = format.std[c] != 0 ? format.std[c] : 1;
+			pipeline.scale[c] = 1 / (255 * std);
+			pipeline.offset[c] = -format.mean[c] / std;
+		}
+	}
+
+	ColorMatrix matrix = format.matrix;
+	if (matrix == MATRIX_AUTO) {
+		if (input->colorspace == AVCOL_SPC_BT709)
+			matrix = BT709;
+		else if (input->colorspace == AVCOL_SPC_BT2020_NCL || input->colorspace == AVCOL_SPC_BT2020_CL)
+			matrix = BT2020;
+		else
+			matrix = BT601;
+	}
+	ColorRange range = format.range;
+	if (range == RANGE_AUTO)
+		range = input->color_range == AVCOL_RANGE_JPEG ? FULL_RANGE : LIMITED_RANGE;
+	pipeline.coefficients = getColorCoefficients(matrix, range);
+
+	int width, height;
+	int sts = resolveGeometry(input, format, pipeline.cropX, pipeline.cropY, pipeline.cropWidth, pipeline.cropHeight, width, height);
+	CHECK_STATUS(sts);
+	pipeline.dstWidth = width;
+	pipeline.dstHeight = height;
+	if (format.letterbox) {
+		float scale = std::min((float)width / pipeline.cropWidth, (float)height / pipeline.cropHeight);
+		pipeline.dstWidth = std::max(1, std::min(width, (int)lround(pipeline.cropWidth * scale)));
+		pipeline.dstHeight = std::max(1, std::min(height, (int)lround(pipeline.cropHeight * scale)));
+	}
+	pipeline.imageX = (width - pipeline.dstWidth) / 2;
+	pipeline.imageY = (height - pipeline.dstHeight) / 2;
+	switch (format.interpolation) {
+	case (BILINEAR):
+		pipeline.kernel = FILTER_BILINEAR;
+		break;
+	case (AREA):
+		pipeline.kernel = FILTER_AREA;
+		break;
+	case (BICUBIC):
+		pipeline.kernel = FILTER_BICUBIC;
+		break;
+	default:
+		pipeline.kernel = FILTER_NEAREST;
+	}
+	int multiple = format.padMultiple > 1 ? format.padMultiple : 1;
+	pipeline.outputWidth = (width + multiple - 1) / multiple * multiple;
+	pipeline.outputHeight = (height + multiple - 1) / multiple * multiple;
+	pipeline.initTables();
+	//letterbox is filled with normalized pad color, padding to multiple without letterbox is filled with zeros
+	for (int c = 0; c < 3; c++) {
+		if (!format.letterbox)
+			pipeline.padValue[c] = 0;
+		else if (pipeline.type == PIXEL_UINT8)
+			pipeline.padValue[c] = format.padColor[c];
+		else
+			pipeline.padValue[c] = pipeline.normalizationTable[(c % pipeline.channels) * 256 + format.padColor[c]];
+	}
+	//YUV output is only cropped and resized with nearest neighbour, chroma can't be subsampled for odd sizes
+	if (yuv && (pipeline.outputWidth != pipeline.dstWidth || pipeline.outputHeight != pipeline.dstHeight || pipeline.dstWidth % 2 ||
+		pipeline.dstHeight % 2 || pipeline.filter))
+		return VREADER_UNSUPPORTED;
+	return VREADER_OK;
+}
+
+FrameTransform getTransform(const VPPPipeline& pipeline) {
+	FrameTransform transform;
+	transform.scaleX = (float)pipeline.dstWidth / pipeline.cropWidth;
+	transform.scaleY = (float)pipeline.dstHeight / pipeline.cropHeight;
+	transform.offsetX = pipeline.imageX - pipeline.cropX * transform.scaleX;
+	transform.offsetY = pipeline.imageY - pipeline.cropY * transform.scaleY;
+	return transform;
+}
+
+static bool sameParameters(const VPPParameters& first, const VPPParameters& second) {
+	for (int c = 0; c < 3; c++) {
+		if (first.mean[c] != second.mean[c] || first.std[c] != second.std[c] || first.padColor[c] != second.padColor[c])
+			return false;
+	}
+	if (first.cropX != second.cropX || first.cropY != second.cropY || first.cropWidth != second.cropWidth ||
+		first.cropHeight != second.cropHeight || first.letterbox != second.letterbox)
+		return false;
+	return first.width == second.width && first.height == second.height && first.dstFourCC == second.dstFourCC &&
+		first.matrix == second.matrix && first.range == second.range && first.padMultiple == second.padMultiple &&
+		first.interpolation == second.interpolation;
+}
+
+/*
+Whether rows x rowSize bytes with pitch bytes between rows fit to capacity, rows of float formats should stay aligned to element
+*/
+static bool fitsBuffer(size_t rowSize, size_t rows, int elementSize, size_t pitch, size_t capacity) {
+	return pitch >= rowSize && pitch % elementSize == 0 && capacity >= pitch * (rows - 1) + rowSize;
+}
+
+int VideoProcessor::ConvertFrame(AVFrame* input, AVFrame* output, VPPParameters& format, std::string consumerName, FrameTransform& transform,
+	void* buffer, size_t pitch, size_t capacity) {
+	TRACE_SPAN_HIGH("process", consumerName, input->display_picture_number);
+	std::shared_ptr<ConsumerPipeline> consumer;
+	{
+		std::unique_lock<std::mutex> locker(pipelineSync);
+		consumer = findFree<std::shared_ptr<ConsumerPipeline> >(consumerName, pipelineArr);
+	}
+	if (consumer == nullptr)
+		return VREADER_ERROR;
+	std::unique_lock<std::mutex> consumerLocker(consumer->sync);
+	//tables are rebuilt only if consumer changed parameters or stream changed geometry or color properties
+	if (!consumer->compiled || !sameParameters(consumer->format, format) || consumer->srcWidth != input->width ||
+		consumer->srcHeight != input->height || consumer->colorspace != input->colorspace || consumer->colorRange != input->color_range) {
+		consumer->compiled = false;
+		int sts = compilePipeline(input, format, consumer->pipeline);
+		CHECK_STATUS(sts);
+		consumer->format = format;
+		consumer->srcWidth = input->width;
+		consumer->srcHeight = input->height;
+		consumer->colorspace = input->colorspace;
+		consumer->colorRange = input->color_range;
+		consumer->compiled = true;
+	}
+	const VPPPipeline& pipeline = consumer->pipeline;
+	transform = getTransform(pipeline);
+
+	output->width = pipeline.outputWidth;
+	output->height = pipeline.outputHeight;
+	//this field is used only for audio so let's write number of bytes per pixel there
+	output->channels = pipeline.channels * pipeline.getElementSize();
 	switch (format.dstFourCC) {
 	case (RGB24):
-		{
-			output->format = AV_PIX_FMT_RGB24;
-			//this field is used only for audio so let's write number of planes there
-			output->channels = 3;
-			if (resize)
-				sts = NV12ToRGB24(output, output, prop.maxThreadsPerBlock, &stream);
-			else
-				sts = NV12ToRGB24(input, output, prop.maxThreadsPerBlock, &stream);
-			CHECK_STATUS(sts);
-			break;
-		}
+		output->format = AV_PIX_FMT_RGB24;
+		break;
 	case (BGR24):
-		{
-			output->format = AV_PIX_FMT_BGR24;
-			//this field is used only for audio so let's write number of planes there
-			output->channels = 3;
-			if (resize)
-				sts = NV12ToBGR24(output, output, prop.maxThreadsPerBlock, &stream);
-			else
-				sts = NV12ToBGR24(input, output, prop.maxThreadsPerBlock, &stream);
-			CHECK_STATUS(sts);
-			break;
-		}
+		output->format = AV_PIX_FMT_BGR24;
+		break;
 	case (Y800):
-		{
-			output->format = AV_PIX_FMT_GRAY8;
-			output->channels = 1;
-			//NV12 has one plane with Y only component, so need just copy first plane
-			cudaError err = cudaMalloc(&output->opaque, output->width * output->height * sizeof(unsigned char));
-			CHECK_STATUS(err);
-			if (resize)
-				err = cudaMemcpy(output->opaque, output->data[0], output->width * output->height, cudaMemcpyDeviceToDevice);
-			else
-				err = cudaMemcpy2D(output->opaque, output->width, input->data[0], input->linesize[0], output->width, output->height, cudaMemcpyDeviceToDevice);
-			CHECK_STATUS(err);
-			break;
-		}
+		output->format = AV_PIX_FMT_GRAY8;
+		break;
+	case (NV12):
+		output->format = AV_PIX_FMT_NV12;
+		break;
+	case (I420):
+		output->format = AV_PIX_FMT_YUV420P;
+		break;
 	default:
+		//planar float formats don't have exact analogue in FFmpeg
+		output->format = AV_PIX_FMT_NONE;
+	}
+	//output is dense
+	output->linesize[0] = 0;
+	if (buffer) {
+		//chroma rows of YUV formats don't have the same size as luma rows, so only dense YUV output is supported
+		bool yuv = pipeline.layout == LAYOUT_NV12 || pipeline.layout == LAYOUT_I420;
+		if (yuv || !fitsBuffer(pipeline.getRowSize(), (size_t)pipeline.outputHeight * pipeline.getPlanes(), pipeline.getElementSize(), pitch, capacity))
+			return VREADER_UNSUPPORTED;
+		output->opaque = buffer;
+		int sts = backend->ProcessInto(input, buffer, pitch, pipeline, consumerName);
+		CHECK_STATUS(sts);
+		return VREADER_OK;
+	}
+	int sts = backend->Process(input, output, pipeline, consumerName);
+	CHECK_STATUS(sts);
+	return VREADER_OK;
+}
+
+void VideoProcessor::evictConversions() {
+	for (auto item = cache.begin(); item != cache.end();) {
+		CachedConversion& entry = **item;
+		//the last reference to source frame means that decoder has reused its slot in buffer
+		if (!entry.evicted && entry.status == VREADER_OK && av_buffer_get_ref_count(entry.source->buf[0]) == 1) {
+			av_frame_free(&entry.source);
+			entry.evicted = true;
+		}
+		if (entry.evicted && entry.references == 0) {
+			backend->Free(entry.data);
+			item = cache.erase(item);
+		}
+		else
+			item++;
+	}
+}
+
+std::shared_ptr<VideoProcessor::CachedConversion> VideoProcessor::findConversion(int frameIndex, const VPPParameters& format) {
+	for (auto& item : cache) {
+		if (!item->evicted && item->frameIndex == frameIndex && sameParameters(item->format, format))
+			return item;
+	}
+	return nullptr;
+}
+
+bool VideoProcessor::createView(AVFrame* input, AVFrame* output, const VPPParameters& format, FrameTransform& transform) {
+	//only reference counted frames can be leased
+	if ((format.dstFourCC != Y800 && format.dstFourCC != NV12) || !input->buf[0])
+		return false;
+	int cropX, cropY, cropWidth, cropHeight, width, height;
+	if (resolveGeometry(input, format, cropX, cropY, cropWidth, cropHeight, width, height) != VREADER_OK)
+		return false;
+	int multiple = format.padMultiple > 1 ? format.padMultiple : 1;
+	if (width != cropWidth || height != cropHeight || width % multiple || height % multiple)
+		return false;
+	int pitch = input->linesize[0];
+	uint8_t* start = input->data[0] + (size_t)cropY * pitch + cropX;
+	if (format.dstFourCC == NV12) {
+		//chroma of view should follow its luma rows with the same pitch
+		uint8_t* chroma = input->data[1] + (size_t)(cropY / 2) * input->linesize[1] + cropX;
+		if (width % 2 || height % 2 || input->linesize[1] != pitch || chroma != start + (size_t)height * pitch)
+			return false;
+	}
+	AVFrame* lease = av_frame_alloc();
+	av_frame_move_ref(lease, input);
+	{
+		std::unique_lock<std::mutex> locker(leaseSync);
+		leaseArr.push_back(std::make_pair((void*)start, lease));
+	}
+	output->opaque = start;
+	output->width = width;
+	output->height = height;
+	output->channels = 1;
+	output->linesize[0] = pitch;
+	output->format = format.dstFourCC == NV12 ? AV_PIX_FMT_NV12 : AV_PIX_FMT_GRAY8;
+	transform = FrameTransform{ 1, 1, (float)-cropX, (float)-cropY };
+	views++;
+	return true;
+}
+
+int VideoProcessor::Convert(AVFrame* input, AVFrame* output, VPPParameters& format, std::string consumerName, FrameTransform* transform) {
+	TRACE_SPAN_MEDIUM("convert", consumerName, input->display_picture_number);
+	FrameTransform frameTransform;
+	//decoded frame is returned as is if only crop is requested, so nothing is converted, cached or prefetched
+	bool view = format.zeroCopy && createView(input, output, format, frameTransform);
+	if (!view) {
+		std::unique_lock<std::mutex> locker(prefetchSync);
+		if (prefetchPool)
+			prefetchArr[consumerName].format = format;
+	}
+	//frames which aren't reference counted can't be tracked by cache
+	std::shared_ptr<CachedConversion> entry;
+	std::unique_lock<std::mutex> entryLocker;
+	bool owner = false;
+	if (!view && input->buf[0]) {
+		std::unique_lock<std::mutex> locker(cacheSync);
+		evictConversions();
+		entry = findConversion(input->display_picture_number, format);
+		if (entry == nullptr) {
+			//the first consumer converts frame, others wait for result
+			entry = std::make_shared<CachedConversion>();
+			entry->frameIndex = input->display_picture_number;
+			entry->format = format;
+			entry->source = av_frame_alloc();
+			av_frame_ref(entry->source, input);
+			entryLocker = std::unique_lock<std::mutex>(entry->sync);
+			cache.push_back(entry);
+			owner = true;
+		}
+	}
+	bool converted = view;
+	if (entry && !owner) {
+		std::unique_lock<std::mutex> waitLocker(entry->sync);
+		//if conversion failed the frame is converted without cache
+		if (entry->status == VREADER_OK) {
+			{
+				std::unique_lock<std::mutex> locker(cacheSync);
+				entry->references++;
+			}
+			output->opaque = entry->data;
+			output->width = entry->width;
+			output->height = entry->height;
+			output->channels = entry->channels;
+			output->format = entry->pixelFormat;
+			output->linesize[0] = 0;
+			frameTransform = entry->transform;
+			converted = true;
+			cacheHits++;
+		}
+	}
+	if (!converted) {
+		int sts = ConvertFrame(input, output, format, consumerName, frameTransform);
+		if (entry)
+			cacheMisses++;
+		if (owner) {
+			std::unique_lock<std::mutex> locker(cacheSync);
+			entry->status = sts;
+			if (sts == VREADER_OK) {
+				entry->data = output->opaque;
+				entry->width = output->width;
+				entry->height = output->height;
+				entry->channels = output->channels;
+				entry->pixelFormat = output->format;
+				entry->transform = frameTransform;
+				entry->references = 1;
+			}
+			else {
+				av_frame_free(&entry->source);
+				cache.erase(std::find(cache.begin(), cache.end(), entry));
+			}
+			entryLocker.unlock();
+		}
+		CHECK_STATUS(sts);
+	}
+	if (transform)
+		*transform = frameTransform;
+
+	if (enableDumps)
+		dumpOutput(output, consumerName);
+	av_frame_unref(input);
+	return VREADER_OK;
+}
+
+int VideoProcessor::ConvertInto(AVFrame* input, void* dst, size_t pitch, size_t capacity, VPPParameters& format, std::string consumerName,
+	FrameTransform* transform) {
+	TRACE_SPAN_MEDIUM("convertInto", consumerName, input->display_picture_number);
+	//chroma rows of YUV formats don't have the same size as luma rows
+	if (format.dstFourCC == NV12 || format.dstFourCC == I420)
 		return VREADER_UNSUPPORTED;
+	{
+		std::unique_lock<std::mutex> locker(prefetchSync);
+		if (prefetchPool)
+			prefetchArr[consumerName].format = format;
 	}
-	if (resize) {
-		//need to free allocated in resize memory for Y and UV
-		cudaError err = cudaFree(output->data[0]);
-		CHECK_STATUS(err);
-		err = cudaFree(output->data[1]);
-		CHECK_STATUS(err);
-	}
-	if (enableDumps) {
-		std::string fileName = std::string("Processed_") + consumerName + std::string(".yuv");
-		std::shared_ptr<FILE> dumpFile(std::shared_ptr<FILE>(fopen(fileName.c_str(), "ab"), std::fclose));
-		{
-			//avoid situations when several threads write to IO (some possible collisions can be observed)
-			std::unique_lock<std::mutex> locker(dumpSync);
-			DumpFrame(output, dumpFile);
+	//caller's memory can't be shared with other consumers, so only existing conversions are used from cache
+	std::shared_ptr<CachedConversion> entry;
+	if (input->buf[0]) {
+		std::unique_lock<std::mutex> locker(cacheSync);
+		evictConversions();
+		entry = findConversion(input->display_picture_number, format);
+	}
+	FrameTransform frameTransform;
+	int sts = VREADER_REPEAT;
+	if (entry) {
+		//input keeps source frame referenced, so entry can't be evicted and its output released during copy
+		std::unique_lock<std::mutex> waitLocker(entry->sync);
+		if (entry->status == VREADER_OK) {
+			int elementSize = getElementSize(format.dstFourCC);
+			//float formats are planar, channels field is number of bytes per pixel
+			bool planar = elementSize != 1;
+			size_t rowSize = (size_t)entry->width * (planar ? elementSize : entry->channels);
+			size_t rows = (size_t)entry->height * (planar ? entry->channels / elementSize : 1);
+			if (!fitsBuffer(rowSize, rows, elementSize, pitch, capacity))
+				return VREADER_UNSUPPORTED;
+			sts = backend->Copy2D(dst, pitch, entry->data, rowSize, rowSize, rows);
+			CHECK_STATUS(sts);
+			frameTransform = entry->transform;
+			cacheHits++;
 		}
 	}
+	if (sts != VREADER_OK) {
+		AVFrame* output = av_frame_alloc();
+		sts = ConvertFrame(input, output, format, consumerName, frameTransform, dst, pitch, capacity);
+		av_frame_free(&output);
+		CHECK_STATUS(sts);
+	}
+	if (transform)
+		*transform = frameTransform;
 	av_frame_unref(input);
-	return sts;
+	return VREADER_OK;
+}
+
+int VideoProcessor::ConvertPyramid(AVFrame* input, std::vector<AVFrame*>& outputs, VPPParameters& format,
+	const std::vector<std::pair<int, int> >& levels, std::string consumerName, std::vector<FrameTransform>* transforms) {
+	if (outputs.size() != levels.size() + 1)
+		return VREADER_ERROR;
+	//levels are downscaled from dense packed or planar output
+	if (levels.size() && (format.dstFourCC == NV12 || format.dstFourCC == I420))
+		return VREADER_UNSUPPORTED;
+	VPPParameters baseFormat = format;
+	baseFormat.zeroCopy = format.zeroCopy && levels.empty();
+	FrameTransform transform;
+	int sts = Convert(input, outputs[0], baseFormat, consumerName, &transform);
+	CHECK_STATUS(sts);
+	if (transforms)
+		transforms->assign(1, transform);
+	int elementSize = getElementSize(format.dstFourCC);
+	for (int i = 1; i < (int)outputs.size(); i++) {
+		AVFrame* previous = outputs[i - 1];
+		AVFrame* level = outputs[i];
+		level->width = levels[i - 1].first;
+		level->height = levels[i - 1].second;
+		if (level->width == 0 || level->height == 0) {
+			level->width = (previous->width + 1) / 2;
+			level->height = (previous->height + 1) / 2;
+		}
+		//levels are only downscaled, already converted levels are released if the next one can't be produced
+		sts = level->width > previous->width || level->height > previous->height ? VREADER_UNSUPPORTED :
+			backend->Downscale(previous, level, elementSize, elementSize != 1, consumerName);
+		if (sts != VREADER_OK) {
+			for (int j = 0; j < i; j++)
+				Free(outputs[j]->opaque);
+		}
+		CHECK_STATUS(sts);
+		if (transforms) {
+			float scaleX = (float)level->width / previous->width;
+			float scaleY = (float)level->height / previous->height;
+			transform = transforms->back();
+			transforms->push_back(FrameTransform{ transform.scaleX * scaleX, transform.scaleY * scaleY, transform.offsetX * scaleX,
+				transform.offsetY * scaleY });
+		}
+	}
+	return VREADER_OK;
+}
+
+uint64_t VideoProcessor::getViews() {
+	return views;
+}
+
+uint64_t VideoProcessor::getCacheHits() {
+	return cacheHits;
+}
+
+uint64_t VideoProcessor::getCacheMisses() {
+	return cacheMisses;
+}
+
+int VideoProcessor::EnablePrefetch(int workers) {
+	//caller thread of pool isn't used by submitted tasks
+	auto pool = std::make_shared<ThreadPool>(std::max(workers, 1) + 1);
+	std::unique_lock<std::mutex> locker(prefetchSync);
+	prefetchPool = pool;
+	return VREADER_OK;
+}
+
+int VideoProcessor::Prefetch(AVFrame* input) {
+	//only reference counted frames can be found in cache later
+	if (!input->buf[0])
+		return VREADER_OK;
+	std::unique_lock<std::mutex> locker(prefetchSync);
+	if (prefetchPool == nullptr)
+		return VREADER_OK;
+	for (auto& item : prefetchArr) {
+		if (item.second.pending)
+			continue;
+		item.second.pending = true;
+		std::string consumerName = item.first;
+		VPPParameters format = item.second.format;
+		std::shared_ptr<AVFrame> frame(av_frame_alloc(), [](AVFrame* frame) { av_frame_free(&frame); });
+		av_frame_ref(frame.get(), input);
+		prefetchPool->submit([this, frame, format, consumerName]() mutable {
+			TRACE_SPAN_MEDIUM("prefetch", consumerName, frame->display_picture_number);
+			bool converted;
+			{
+				//frame can be already requested by consumer or prefetched for other consumer with the same parameters
+				std::unique_lock<std::mutex> locker(cacheSync);
+				converted = findConversion(frame->display_picture_number, format) != nullptr;
+			}
+			if (!converted) {
+				AVFrame* output = av_frame_alloc();
+				//output stays in cache until source frame leaves decoder's buffer
+				if (Convert(frame.get(), output, format, consumerName) == VREADER_OK) {
+					Free(output->opaque);
+					prefetched++;
+				}
+				av_frame_free(&output);
+			}
+			std::unique_lock<std::mutex> locker(prefetchSync);
+			prefetchArr[consumerName].pending = false;
+		});
+	}
+	return VREADER_OK;
+}
+
+uint64_t VideoProcessor::getPrefetched() {
+	return prefetched;
+}
+
+int VideoProcessor::getPrefetchQueue() {
+	std::unique_lock<std::mutex> locker(prefetchSync);
+	return prefetchPool ? prefetchPool->getQueuedJobs() : 0;
+}
+
+BufferPoolStats VideoProcessor::getPoolStats() {
+	return backend->getPoolStats();
+}
+
+void VideoProcessor::setPoolLimit(size_t limit) {
+	backend->setPoolLimit(limit);
 }
 
 void VideoProcessor::Close() {
 	if (isClosed)
 		return;
+	std::shared_ptr<ThreadPool> pool;
+	{
+		std::unique_lock<std::mutex> locker(prefetchSync);
+		pool = std::move(prefetchPool);
+	}
+	//started conversions are finished, queued ones are dropped, workers take prefetchSync at the end of task so it isn't held while they stop
+	pool = nullptr;
+	{
+		std::unique_lock<std::mutex> locker(prefetchSync);
+		prefetchArr.clear();
+	}
+	{
+		//outputs which are still used by consumers are released by Free() directly
+		std::unique_lock<std::mutex> locker(cacheSync);
+		for (auto& entry : cache) {
+			av_frame_free(&entry->source);
+			if (entry->status == VREADER_OK && entry->references == 0)
+				backend->Free(entry->data);
+		}
+		cache.clear();
+	}
+	backend->Close();
+	pipelineArr.clear();
+	//queued frames are written by writer before it's destroyed by the last user
+	dumps = nullptr;
 	isClosed = true;
 }
@@ -1,6 +1,7 @@
 #include <cuda.h>
 #include <cuda_runtime.h>
 #include "WrapperC.h"
+#include "WrapperCABI.h"
 #include <thread>
 #include <time.h>
 #include <chrono>
@@ -19,27 +20,43 @@ void logCallback(void *ptr, int level, const char *fmt, va_list vargs) {
 	}
 }
 
-int TensorStream::initPipeline(std::string inputFile, uint8_t decoderBuffer) {
+int TensorStream::initPipeline(std::string inputFile, uint8_t decoderBuffer, BackendType backend) {
 	int sts = VREADER_OK;
 	shouldWork = true;
 	av_log_set_callback(logCallback);
 	START_LOG_FUNCTION(std::string("Initializing() "));
+	stats.startup.reset(traceClock());
 	parser = std::make_shared<Parser>();
 	decoder = std::make_shared<Decoder>();
 	vpp = std::make_shared<VideoProcessor>();
 	ParserParameters parserArgs = { inputFile, false };
+	parserArgs.lowLatency = lowLatency;
+	parserArgs.rtspTransport = rtspTransport;
+	parserArgs.probeSize = probeSize;
+	parserArgs.analyzeDuration = analyzeDuration;
+	parserArgs.cacheParameters = cacheParameters;
 	START_LOG_BLOCK(std::string("parser->Init"));
 	sts = parser->Init(parserArgs);
 	CHECK_STATUS(sts);
+	stats.start = std::chrono::steady_clock::now();
+	ParserStartup parserStartup = parser->getStartup();
+	stats.startup.open = parserStartup.open;
+	stats.startup.probe = parserStartup.probe;
+	stats.startup.cached = parserStartup.cached;
 	END_LOG_BLOCK(std::string("parser->Init"));
-	DecoderParameters decoderArgs = { parser, false, decoderBuffer };
+	DecoderParameters decoderArgs = { parser, false, decoderBuffer, backend };
+	decoderArgs.lowLatency = lowLatency;
+	int64_t phaseStart = traceClock();
 	START_LOG_BLOCK(std::string("decoder->Init"));
 	sts = decoder->Init(decoderArgs);
 	CHECK_STATUS(sts);
+	stats.startup.decoder = traceClock() - phaseStart;
 	END_LOG_BLOCK(std::string("decoder->Init"));
+	phaseStart = traceClock();
 	START_LOG_BLOCK(std::string("VPP->Init"));
-	sts = vpp->Init(false);
+	sts = vpp->Init(false, backend);
 	CHECK_STATUS(sts);
+	stats.startup.vpp = traceClock() - phaseStart;
 	END_LOG_BLOCK(std::string("VPP->Init"));
 	parsed = new AVPacket();
 	for (int i = 0; i < maxConsumers; i++) {
@@ -69,42 +86,175 @@ std::map<std::string, int> TensorStream::getInitializedParams() {
 	params.insert(std::map<std::string, int>::value_type("framerate_den", codecTmp->framerate.den));
 	params.insert(std::map<std::string, int>::value_type("width", decoder->getDecoderContext()->width));
 	params.insert(std::map<std::string, int>::value_type("height", decoder->getDecoderContext()->height));
+	params.insert(std::map<std::string, int>::value_type("timebase_num", parser->getStreamHandle()->time_base.num));
+	params.insert(std::map<std::string, int>::value_type("timebase_den", parser->getStreamHandle()->time_base.den));
 	return params;
 }
 
+std::map<std::string, uint64_t> TensorStream::getCacheCounters() {
+	std::map<std::string, uint64_t> counters;
+	counters.insert(std::map<std::string, uint64_t>::value_type("hits", vpp->getCacheHits()));
+	counters.insert(std::map<std::string, uint64_t>::value_type("misses", vpp->getCacheMisses()));
+	counters.insert(std::map<std::string, uint64_t>::value_type("prefetched", vpp->getPrefetched()));
+	counters.insert(std::map<std::string, uint64_t>::value_type("views", vpp->getViews()));
+	return counters;
+}
+
+int TensorStream::enablePrefetch(int workers) {
+	int sts = vpp->EnablePrefetch(workers);
+	CHECK_STATUS(sts);
+	prefetch = true;
+	return sts;
+}
+
+std::map<std::string, float> TensorStream::getLatency() {
+	std::map<std::string, float> values;
+	values.insert(std::map<std::string, float>::value_type("p50", latency.percentile(50)));
+	values.insert(std::map<std::string, float>::value_type("p99", latency.percentile(99)));
+	values.insert(std::map<std::string, float>::value_type("samples", (float)latency.getSamplesNumber()));
+	return values;
+}
+
+std::map<std::string, uint64_t> TensorStream::getPoolStats() {
+	BufferPoolStats stats = vpp->getPoolStats();
+	std::map<std::string, uint64_t> values;
+	values.insert(std::map<std::string, uint64_t>::value_type("allocations", stats.allocations));
+	values.insert(std::map<std::string, uint64_t>::value_type("releases", stats.releases));
+	values.insert(std::map<std::string, uint64_t>::value_type("hits", stats.hits));
+	values.insert(std::map<std::string, uint64_t>::value_type("misses", stats.misses));
+	values.insert(std::map<std::string, uint64_t>::value_type("bytes_in_use", stats.bytesInUse));
+	values.insert(std::map<std::string, uint64_t>::value_type("bytes_cached", stats.bytesCached));
+	values.insert(std::map<std::string, uint64_t>::value_type("peak_bytes_in_use", stats.peakBytesInUse));
+	values.insert(std::map<std::string, uint64_t>::value_type("peak_bytes_allocated", stats.peakBytesAllocated));
+	return values;
+}
+
+std::map<std::string, double> TensorStream::getStats() {
+	return stats.getValues(getSnapshot());
+}
+
+std::string TensorStream::getPrometheusStats() {
+	return stats.getPrometheus(getSnapshot());
+}
+
+int TensorStream::startMetricsServer(int port) {
+	if (metricsServer)
+		return VREADER_ERROR;
+	metricsServer = std::make_shared<MetricsServer>([this]() { return getPrometheusStats(); });
+	int sts = metricsServer->Start(port);
+	if (sts != VREADER_OK) {
+		metricsServer = nullptr;
+		CHECK_STATUS(sts);
+	}
+	return metricsServer->getPort();
+}
+
+PipelineSnapshot TensorStream::getSnapshot() {
+	PipelineSnapshot snapshot;
+	snapshot.decodedFrames = decoder->getFrameIndex();
+	snapshot.prefetchQueue = vpp->getPrefetchQueue();
+	snapshot.consumers = decoder->getConsumerStats();
+	snapshot.pool = vpp->getPoolStats();
+	return snapshot;
+}
+
+void TensorStream::setPoolLimit(uint64_t bytes) {
+	vpp->setPoolLimit(bytes);
+}
+
+void TensorStream::setRealTime(bool enabled) {
+	realTime = enabled;
+}
+
+void TensorStream::setLowLatency(bool enabled) {
+	lowLatency = enabled;
+}
+
+void TensorStream::setRTSPTransport(std::string transport) {
+	rtspTransport = transport;
+}
+
+void TensorStream::setProbing(int64_t probeSize, int64_t analyzeDuration) {
+	this->probeSize = probeSize;
+	this->analyzeDuration = analyzeDuration;
+}
+
+void TensorStream::setParametersCache(bool enabled) {
+	cacheParameters = enabled;
+}
+
+int TensorStream::startCapture(std::string fileName) {
+	int sts = parser->EnableCapture(fileName);
+	CHECK_STATUS(sts);
+	return sts;
+}
+
 int TensorStream::processingLoop() {
 	std::unique_lock<std::mutex> locker(closeSync);
+	setTraceThreadName("processing");
 	int sts = VREADER_OK;
+	bool flushing = false;
 	while (shouldWork) {
 		START_LOG_FUNCTION(std::string("Processing() ") + std::to_string(decoder->getFrameIndex() + 1) + std::string(" frame"));
 		std::chrono::high_resolution_clock::time_point waitTime = std::chrono::high_resolution_clock::now();
-		START_LOG_BLOCK(std::string("parser->Read"));
-		sts = parser->Read();
-		END_LOG_BLOCK(std::string("parser->Read"));
-		if (sts == AVERROR(EAGAIN))
-			continue;
-		CHECK_STATUS(sts);
-		START_LOG_BLOCK(std::string("parser->Get"));
-		sts = parser->Get(parsed);
-		CHECK_STATUS(sts);
-		END_LOG_BLOCK(std::string("parser->Get"));
-		START_LOG_BLOCK(std::string("parser->Analyze"));
-		//Parse package to find some syntax issues, don't handle errors returned from this function
-		sts = parser->Analyze(parsed);
-		END_LOG_BLOCK(std::string("parser->Analyze"));
-		START_LOG_BLOCK(std::string("decoder->Decode"));
-		sts = decoder->Decode(parsed);
-		END_LOG_BLOCK(std::string("decoder->Decode"));
-		//Need more data for decoding
-		if (sts == AVERROR(EAGAIN) || sts == AVERROR_EOF)
-			continue;
-		CHECK_STATUS(sts);
+		//log blocks are scopes, so start of stage is declared outside of them
+		int64_t stageStart = traceClock();
+		if (!flushing) {
+			START_LOG_BLOCK(std::string("parser->Read"));
+			sts = parser->Read();
+			stats.read.add(traceClock() - stageStart);
+			END_LOG_BLOCK(std::string("parser->Read"));
+			if (sts == AVERROR(EAGAIN))
+				continue;
+			flushing = sts == AVERROR_EOF;
+		}
+		//frames kept by decoder for reordering are returned one per iteration after the end of stream, so they are paced as decoded ones
+		if (flushing) {
+			START_LOG_BLOCK(std::string("decoder->Flush"));
+			sts = decoder->Flush();
+			END_LOG_BLOCK(std::string("decoder->Flush"));
+			//the last frame has been returned
+			CHECK_STATUS(sts);
+		}
+		else {
+			START_LOG_BLOCK(std::string("parser->Get"));
+			sts = parser->Get(parsed);
+			CHECK_STATUS(sts);
+			stats.packets++;
+			stats.bytes += parsed->size;
+			END_LOG_BLOCK(std::string("parser->Get"));
+			START_LOG_BLOCK(std::string("parser->Analyze"));
+			//Parse package to find some syntax issues, don't handle errors returned from this function
+			stageStart = traceClock();
+			sts = parser->Analyze(parsed);
+			stats.analyze.add(traceClock() - stageStart);
+			END_LOG_BLOCK(std::string("parser->Analyze"));
+			START_LOG_BLOCK(std::string("decoder->Decode"));
+			stageStart = traceClock();
+			sts = decoder->Decode(parsed, parser->getTimestamps());
+			stats.decode.add(traceClock() - stageStart);
+			END_LOG_BLOCK(std::string("decoder->Decode"));
+			//Need more data for decoding
+			if (sts == AVERROR(EAGAIN) || sts == AVERROR_EOF)
+				continue;
+			CHECK_STATUS(sts);
+		}
+		stats.startup.addFrame(traceClock());
+		if (prefetch) {
+			START_LOG_BLOCK(std::string("vpp->Prefetch"));
+			AVFrame* latest = av_frame_alloc();
+			if (decoder->GetLatestFrame(latest) != VREADER_REPEAT)
+				vpp->Prefetch(latest);
+			av_frame_free(&latest);
+			END_LOG_BLOCK(std::string("vpp->Prefetch"));
+		}
 		
 		START_LOG_BLOCK(std::string("sleep"));
 		//wait here
 		int sleepTime = realTimeDelay - std::chrono::duration_cast<std::chrono::milliseconds>(
 											std::chrono::high_resolution_clock::now() - waitTime).count();
-		if (sleepTime > 0) {
+		//replayed capture is paced by parser, live stream in low-latency mode is paced by source, frames flushed at the end aren't paced by them
+		if (realTime && sleepTime > 0 && (flushing || (!lowLatency && !parser->isReplay()))) {
 			std::this_thread::sleep_for(std::chrono::milliseconds(sleepTime));
 		}
 		END_LOG_BLOCK(std::string("sleep"));
@@ -124,11 +274,28 @@ int TensorStream::startProcessing() {
 	return sts;
 }
 
-std::tuple<std::shared_ptr<uint8_t>, int> TensorStream::getFrame(std::string consumerName, int index, FourCC pixelFormat, int dstWidth, int dstHeight) {
+std::tuple<std::shared_ptr<uint8_t>, int> TensorStream::getFrame(std::string consumerName, int index, FourCC pixelFormat, int dstWidth, int dstHeight,
+	ColorMatrix matrix, ColorRange range) {
+	VPPParameters parameters = { dstWidth, dstHeight, pixelFormat, matrix, range };
+	return getFrame(consumerName, index, parameters);
+}
+
+std::tuple<std::shared_ptr<uint8_t>, int> TensorStream::getFrame(std::string consumerName, int index, VPPParameters parameters, FrameTransform* transform,
+	int* pitch) {
+	std::vector<FrameTransform> transforms;
+	auto pyramid = getPyramid(consumerName, index, parameters, {}, transform ? &transforms : nullptr, pitch);
+	if (transform)
+		*transform = transforms[0];
+	return std::make_tuple(std::get<0>(pyramid)[0], std::get<1>(pyramid));
+}
+
+std::tuple<std::vector<std::shared_ptr<uint8_t> >, int> TensorStream::getPyramid(std::string consumerName, int index, VPPParameters parameters,
+	std::vector<std::pair<int, int> > levels, std::vector<FrameTransform>* transforms, int* pitch) {
 	AVFrame* decoded;
 	AVFrame* processedFrame;
-	std::tuple<std::shared_ptr<uint8_t>, int> outputTuple;
-	FourCC format = static_cast<FourCC>(pixelFormat);
+	std::tuple<std::vector<std::shared_ptr<uint8_t> >, int> outputTuple;
+	FrameTimestamps timestamps;
+	TRACE_SPAN_LOW("getFrame", consumerName);
 	START_LOG_FUNCTION(std::string("GetFrame()"));
 	START_LOG_BLOCK(std::string("findFree decoded frame"));
 	{
@@ -144,27 +311,99 @@ std::tuple<std::shared_ptr<uint8_t>, int> TensorStream::getFrame(std::string con
 	END_LOG_BLOCK(std::string("findFree converted frame"));
 	int indexFrame = VREADER_REPEAT;
 	START_LOG_BLOCK(std::string("decoder->GetFrame"));
-	while (indexFrame == VREADER_REPEAT) {
-		indexFrame = decoder->GetFrame(index, consumerName, decoded);
+	{
+		TRACE_SPAN_HIGH("wait", consumerName);
+		while (indexFrame == VREADER_REPEAT) {
+			indexFrame = decoder->GetFrame(index, consumerName, decoded, &timestamps);
+		}
 	}
 	END_LOG_BLOCK(std::string("decoder->GetFrame"));
+	std::chrono::high_resolution_clock::time_point convertTime = std::chrono::high_resolution_clock::now();
+	//pyramid levels are stored to temporary frames, memory is owned by returned pointers
+	std::vector<AVFrame*> outputs = { processedFrame };
+	for (int i = 0; i < (int)levels.size(); i++)
+		outputs.push_back(av_frame_alloc());
+	//caller which doesn't get pitch expects dense output
+	parameters.zeroCopy = parameters.zeroCopy && pitch;
 	START_LOG_BLOCK(std::string("vpp->Convert"));
-	int sts = VREADER_OK;
-	VPPParameters VPPArgs = { dstWidth, dstHeight, format };
-	sts = vpp->Convert(decoded, processedFrame, VPPArgs, consumerName);
+	int64_t convertStart = traceClock();
+	int sts = vpp->ConvertPyramid(decoded, outputs, parameters, levels, consumerName, transforms);
+	stats.convert.add(traceClock() - convertStart);
+	for (int i = 1; i < (int)outputs.size() && sts != VREADER_OK; i++)
+		av_frame_free(&outputs[i]);
 	CHECK_STATUS_THROW(sts);
+	setTimestamps(consumerName, timestamps);
 	END_LOG_BLOCK(std::string("vpp->Convert"));
-	std::shared_ptr<uint8_t> cudaFrame((uint8_t*) processedFrame->opaque, cudaFree);
-	outputTuple = std::make_tuple(cudaFrame, indexFrame);
+	if (pitch)
+		*pitch = processedFrame->linesize[0] * processedFrame->channels;
+	//memory should be released by the same backend which allocated it
+	std::shared_ptr<VideoProcessor> vppHandle = vpp;
+	std::vector<std::shared_ptr<uint8_t> > outputFrames;
+	for (int i = 0; i < (int)outputs.size(); i++) {
+		outputFrames.push_back(std::shared_ptr<uint8_t>((uint8_t*)outputs[i]->opaque, [vppHandle](uint8_t* data) {
+			vppHandle->Free(data);
+		}));
+		if (i > 0)
+			av_frame_free(&outputs[i]);
+	}
+	outputTuple = std::make_tuple(outputFrames, indexFrame);
+	latency.add(std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - convertTime).count());
 	END_LOG_FUNCTION(std::string("GetFrame() ") + std::to_string(indexFrame) + std::string(" frame"));
 	return outputTuple;
 }
 
+int TensorStream::getFrameInto(std::string consumerName, void* dst, size_t pitch, size_t capacity, VPPParameters parameters, int index,
+	FrameTransform* transform) {
+	AVFrame* decoded;
+	int indexFrame = VREADER_REPEAT;
+	FrameTimestamps timestamps;
+	TRACE_SPAN_LOW("getFrameInto", consumerName);
+	START_LOG_FUNCTION(std::string("GetFrameInto()"));
+	START_LOG_BLOCK(std::string("findFree decoded frame"));
+	{
+		std::unique_lock<std::mutex> locker(syncDecoded);
+		decoded = findFree<AVFrame*>(consumerName, decodedArr);
+	}
+	END_LOG_BLOCK(std::string("findFree decoded frame"));
+	START_LOG_BLOCK(std::string("decoder->GetFrame"));
+	{
+		TRACE_SPAN_HIGH("wait", consumerName);
+		while (indexFrame == VREADER_REPEAT) {
+			indexFrame = decoder->GetFrame(index, consumerName, decoded, &timestamps);
+		}
+	}
+	END_LOG_BLOCK(std::string("decoder->GetFrame"));
+	std::chrono::high_resolution_clock::time_point convertTime = std::chrono::high_resolution_clock::now();
+	START_LOG_BLOCK(std::string("vpp->ConvertInto"));
+	int64_t convertStart = traceClock();
+	int sts = vpp->ConvertInto(decoded, dst, pitch, capacity, parameters, consumerName, transform);
+	stats.convert.add(traceClock() - convertStart);
+	CHECK_STATUS_THROW(sts);
+	setTimestamps(consumerName, timestamps);
+	END_LOG_BLOCK(std::string("vpp->ConvertInto"));
+	latency.add(std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - convertTime).count());
+	END_LOG_FUNCTION(std::string("GetFrameInto() ") + std::to_string(indexFrame) + std::string(" frame"));
+	return indexFrame;
+}
+
+void TensorStream::setTimestamps(std::string consumerName, FrameTimestamps timestamps) {
+	timestamps.converted = wallClock();
+	stats.addFrame(timestamps.arrival, timestamps.capture, timestamps.converted);
+	std::unique_lock<std::mutex> locker(timestampsSync);
+	consumerTimestamps[consumerName] = timestamps;
+}
+
+FrameTimestamps TensorStream::getTimestamps(std::string consumerName) {
+	std::unique_lock<std::mutex> locker(timestampsSync);
+	return consumerTimestamps[consumerName];
+}
+
 /*
 Mode 1 - full close, mode 2 - soft close (for reset)
 */
 void TensorStream::endProcessing(int mode) {
 	shouldWork = false;
+	metricsServer = nullptr;
 	LOG_VALUE(std::string("End processing async part"));
 	{
 		std::unique_lock<std::mutex> locker(closeSync);
@@ -181,6 +420,10 @@ void TensorStream::endProcessing(int mode) {
 			av_frame_free(&item.second);
 		decodedArr.clear();
 		processedArr.clear();
+		{
+			std::unique_lock<std::mutex> locker(timestampsSync);
+			consumerTimestamps.clear();
+		}
 		delete parsed;
 		parsed = nullptr;
 		LOG_VALUE(std::string("End processing sync part end"));
@@ -196,12 +439,21 @@ void TensorStream::enableLogs(int level) {
 	}
 }
 
+void TensorStream::enableTracing(int level) {
+	::enableTracing(level);
+}
+
+int TensorStream::dumpTrace(std::string fileName) {
+	return exportTrace(fileName);
+}
+
 int TensorStream::dumpFrame(std::shared_ptr<uint8_t> frame, int width, int height, FourCC format, std::shared_ptr<FILE> dumpFile) {
 	AVFrame* output = av_frame_alloc();
 	output->opaque = frame.get();
-	output->width = output->linesize[0] = width;
-	output->height = output->linesize[1] = height;
-	output->channels = (format == RGB24 || format == BGR24) ? 3 : 1;
+	output->width = width;
+	output->height = height;
+	//bytes per pixel, the same as in frames returned from VPP
+	output->channels = getChannels(format) * getElementSize(format);
 	switch (format) {
 		case RGB24:
 			output->format = AV_PIX_FMT_RGB24;
@@ -212,6 +464,18 @@ int TensorStream::dumpFrame(std::shared_ptr<uint8_t> frame, int width, int heigh
 		case Y800:
 			output->format = AV_PIX_FMT_GRAY8;
 		break;
+		case NV12:
+			output->format = AV_PIX_FMT_NV12;
+		break;
+		case I420:
+			output->format = AV_PIX_FMT_YUV420P;
+		break;
+		case RGB_PLANAR_F32:
+		case BGR_PLANAR_F32:
+		case RGB_PLANAR_F16:
+		case BGR_PLANAR_F16:
+			output->format = AV_PIX_FMT_NONE;
+		break;
 		default:
 			return VREADER_UNSUPPORTED;
 		break;
@@ -223,4 +487,110 @@ int TensorStream::dumpFrame(std::shared_ptr<uint8_t> frame, int width, int heigh
 
 int TensorStream::getDelay() {
 	return realTimeDelay;
-}
\ No newline at end of file
+}
+
+struct TensorStreamSession {
+	TensorStream reader;
+	std::thread pipeline;
+};
+
+/*
+Errors of C++ API are thrown as runtime_error with status in message, exceptions shouldn't cross C boundary
+*/
+static int getStatus(const std::exception& error) {
+	try {
+		return std::stoi(error.what());
+	}
+	catch (...) {
+		return VREADER_ERROR;
+	}
+}
+
+int tensorStreamCreate(TensorStreamSession** session, const char* inputFile, int decoderBuffer, int backend) {
+	if (session == nullptr || inputFile == nullptr)
+		return VREADER_ERROR;
+	*session = nullptr;
+	std::unique_ptr<TensorStreamSession> created(new TensorStreamSession());
+	try {
+		int sts = created->reader.initPipeline(inputFile, (uint8_t)decoderBuffer, static_cast<BackendType>(backend));
+		CHECK_STATUS(sts);
+	}
+	catch (const std::exception& error) {
+		return getStatus(error);
+	}
+	*session = created.release();
+	return VREADER_OK;
+}
+
+int tensorStreamGetParams(TensorStreamSession* session, int* width, int* height, int* frameRateNum, int* frameRateDen) {
+	if (session == nullptr)
+		return VREADER_ERROR;
+	auto params = session->reader.getInitializedParams();
+	if (width)
+		*width = params["width"];
+	if (height)
+		*height = params["height"];
+	if (frameRateNum)
+		*frameRateNum = params["framerate_num"];
+	if (frameRateDen)
+		*frameRateDen = params["framerate_den"];
+	return VREADER_OK;
+}
+
+int tensorStreamStart(TensorStreamSession* session) {
+	if (session == nullptr || session->pipeline.joinable())
+		return VREADER_ERROR;
+	session->pipeline = std::thread(&TensorStream::startProcessing, &session->reader);
+	return VREADER_OK;
+}
+
+int tensorStreamGetFrameInto(TensorStreamSession* session, const char* consumerName, void* dst, size_t pitch, size_t capacity,
+	const TensorStreamParameters* parameters, int index, int* frameIndex) {
+	if (session == nullptr || consumerName == nullptr || dst == nullptr || parameters == nullptr)
+		return VREADER_ERROR;
+	VPPParameters format = { parameters->width, parameters->height, static_cast<FourCC>(parameters->fourCC),
+		static_cast<ColorMatrix>(parameters->matrix), static_cast<ColorRange>(parameters->range) };
+	for (int c = 0; c < 3; c++) {
+		format.mean[c] = parameters->mean[c];
+		format.std[c] = parameters->std[c];
+		format.padColor[c] = parameters->padColor[c];
+	}
+	format.padMultiple = parameters->padMultiple;
+	format.interpolation = static_cast<Interpolation>(parameters->interpolation);
+	format.cropX = parameters->cropX;
+	format.cropY = parameters->cropY;
+	format.cropWidth = parameters->cropWidth;
+	format.cropHeight = parameters->cropHeight;
+	format.letterbox = parameters->letterbox != 0;
+	try {
+		int result = session->reader.getFrameInto(consumerName, dst, pitch, capacity, format, index);
+		if (frameIndex)
+			*frameIndex = result;
+	}
+	catch (const std::exception& error) {
+		return getStatus(error);
+	}
+	return VREADER_OK;
+}
+
+int tensorStreamGetTimestamps(TensorStreamSession* session, const char* consumerName, TensorStreamTimestamps* timestamps) {
+	if (session == nullptr || consumerName == nullptr || timestamps == nullptr)
+		return VREADER_ERROR;
+	FrameTimestamps frame = session->reader.getTimestamps(consumerName);
+	timestamps->pts = frame.pts;
+	timestamps->dts = frame.dts;
+	timestamps->capture = frame.capture;
+	timestamps->arrival = frame.arrival;
+	timestamps->decoded = frame.decoded;
+	timestamps->converted = frame.converted;
+	return VREADER_OK;
+}
+
+void tensorStreamClose(TensorStreamSession* session) {
+	if (session == nullptr)
+		return;
+	session->reader.endProcessing(HARD);
+	if (session->pipeline.joinable())
+		session->pipeline.join();
+	delete session;
+}
@@ -14,31 +14,50 @@ void logCallback(void *ptr, int level, const char *fmt, va_list vargs) {
 	}
 }
 
-int TensorStream::initPipeline(std::string inputFile) {
+int TensorStream::initPipeline(std::string inputFile, BackendType backend) {
 	int sts = VREADER_OK;
 	shouldWork = true;
+	backendType = backend;
 	av_log_set_callback(logCallback);
 	START_LOG_FUNCTION(std::string("Initializing() "));
-	/*avoiding Tensor CUDA lazy initializing for further context attaching*/
-	START_LOG_BLOCK(std::string("Tensor CUDA init"));
-	at::Tensor gt_target = at::empty({ 1 }, at::CUDA(at::kByte));
-	END_LOG_BLOCK(std::string("Tensor CUDA init"));
+	stats.startup.reset(traceClock());
+	if (backendType == CUDA_BACKEND) {
+		/*avoiding Tensor CUDA lazy initializing for further context attaching*/
+		START_LOG_BLOCK(std::string("Tensor CUDA init"));
+		at::Tensor gt_target = at::empty({ 1 }, at::CUDA(at::kByte));
+		END_LOG_BLOCK(std::string("Tensor CUDA init"));
+	}
 	parser = std::make_shared<Parser>();
 	decoder = std::make_shared<Decoder>();
 	vpp = std::make_shared<VideoProcessor>();
 	ParserParameters parserArgs = { inputFile, false };
+	parserArgs.lowLatency = lowLatency;
+	parserArgs.rtspTransport = rtspTransport;
+	parserArgs.probeSize = probeSize;
+	parserArgs.analyzeDuration = analyzeDuration;
+	parserArgs.cacheParameters = cacheParameters;
 	START_LOG_BLOCK(std::string("parser->Init"));
 	sts = parser->Init(parserArgs);
 	CHECK_STATUS(sts);
+	stats.start = std::chrono::steady_clock::now();
+	ParserStartup parserStartup = parser->getStartup();
+	stats.startup.open = parserStartup.open;
+	stats.startup.probe = parserStartup.probe;
+	stats.startup.cached = parserStartup.cached;
 	END_LOG_BLOCK(std::string("parser->Init"));
-	DecoderParameters decoderArgs = { parser, false };
+	DecoderParameters decoderArgs = { parser, false, 10, backendType };
+	decoderArgs.lowLatency = lowLatency;
+	int64_t phaseStart = traceClock();
 	START_LOG_BLOCK(std::string("decoder->Init"));
 	sts = decoder->Init(decoderArgs);
 	CHECK_STATUS(sts);
+	stats.startup.decoder = traceClock() - phaseStart;
 	END_LOG_BLOCK(std::string("decoder->Init"));
+	phaseStart = traceClock();
 	START_LOG_BLOCK(std::string("VPP->Init"));
-	sts = vpp->Init(false);
+	sts = vpp->Init(false, backendType);
 	CHECK_STATUS(sts);
+	stats.startup.vpp = traceClock() - phaseStart;
 	END_LOG_BLOCK(std::string("VPP->Init"));
 	parsed = new AVPacket();
 	for (int i = 0; i < maxConsumers; i++) {
@@ -67,63 +86,167 @@ std::map<std::string, int> TensorStream::getInitializedParams() {
 	params.insert(std::map<std::string, int>::value_type("framerate_den", frameRate.first));
 	params.insert(std::map<std::string, int>::value_type("width", decoder->getDecoderContext()->width));
 	params.insert(std::map<std::string, int>::value_type("height", decoder->getDecoderContext()->height));
+	params.insert(std::map<std::string, int>::value_type("timebase_num", parser->getStreamHandle()->time_base.num));
+	params.insert(std::map<std::string, int>::value_type("timebase_den", parser->getStreamHandle()->time_base.den));
 	return params;
 }
 
+std::map<std::string, uint64_t> TensorStream::getCacheCounters() {
+	std::map<std::string, uint64_t> counters;
+	counters.insert(std::map<std::string, uint64_t>::value_type("hits", vpp->getCacheHits()));
+	counters.insert(std::map<std::string, uint64_t>::value_type("misses", vpp->getCacheMisses()));
+	counters.insert(std::map<std::string, uint64_t>::value_type("prefetched", vpp->getPrefetched()));
+	return counters;
+}
+
+int TensorStream::enablePrefetch(int workers) {
+	int sts = vpp->EnablePrefetch(workers);
+	CHECK_STATUS(sts);
+	prefetch = true;
+	return sts;
+}
+
+void TensorStream::setLowLatency(bool enabled) {
+	lowLatency = enabled;
+}
+
+void TensorStream::setRTSPTransport(std::string transport) {
+	rtspTransport = transport;
+}
+
+void TensorStream::setProbing(int64_t probeSize, int64_t analyzeDuration) {
+	this->probeSize = probeSize;
+	this->analyzeDuration = analyzeDuration;
+}
+
+void TensorStream::setParametersCache(bool enabled) {
+	cacheParameters = enabled;
+}
+
+int TensorStream::startCapture(std::string fileName) {
+	int sts = parser->EnableCapture(fileName);
+	CHECK_STATUS(sts);
+	return sts;
+}
+
+std::map<std::string, float> TensorStream::getLatency() {
+	std::map<std::string, float> values;
+	values.insert(std::map<std::string, float>::value_type("p50", latency.percentile(50)));
+	values.insert(std::map<std::string, float>::value_type("p99", latency.percentile(99)));
+	values.insert(std::map<std::string, float>::value_type("samples", (float)latency.getSamplesNumber()));
+	return values;
+}
+
+std::map<std::string, uint64_t> TensorStream::getPoolStats() {
+	BufferPoolStats stats = vpp->getPoolStats();
+	std::map<std::string, uint64_t> values;
+	values.insert(std::map<std::string, uint64_t>::value_type("allocations", stats.allocations));
+	values.insert(std::map<std::string, uint64_t>::value_type("releases", stats.releases));
+	values.insert(std::map<std::string, uint64_t>::value_type("hits", stats.hits));
+	values.insert(std::map<std::string, uint64_t>::value_type("misses", stats.misses));
+	values.insert(std::map<std::string, uint64_t>::value_type("bytes_in_use", stats.bytesInUse));
+	values.insert(std::map<std::string, uint64_t>::value_type("bytes_cached", stats.bytesCached));
+	values.insert(std::map<std::string, uint64_t>::value_type("peak_bytes_in_use", stats.peakBytesInUse));
+	values.insert(std::map<std::string, uint64_t>::value_type("peak_bytes_allocated", stats.peakBytesAllocated));
+	return values;
+}
+
+std::map<std::string, double> TensorStream::getStats() {
+	return stats.getValues(getSnapshot());
+}
+
+int TensorStream::startMetricsServer(int port) {
+	if (metricsServer)
+		return VREADER_ERROR;
+	metricsServer = std::make_shared<MetricsServer>([this]() { return stats.getPrometheus(getSnapshot()); });
+	int sts = metricsServer->Start(port);
+	if (sts != VREADER_OK) {
+		metricsServer = nullptr;
+		CHECK_STATUS(sts);
+	}
+	return metricsServer->getPort();
+}
+
+PipelineSnapshot TensorStream::getSnapshot() {
+	PipelineSnapshot snapshot;
+	snapshot.decodedFrames = decoder->getFrameIndex();
+	snapshot.prefetchQueue = vpp->getPrefetchQueue();
+	snapshot.consumers = decoder->getConsumerStats();
+	snapshot.pool = vpp->getPoolStats();
+	return snapshot;
+}
+
+void TensorStream::setPoolLimit(uint64_t bytes) {
+	vpp->setPoolLimit(bytes);
+}
+
 int TensorStream::processingLoop() {
 	std::unique_lock<std::mutex> locker(closeSync);
+	setTraceThreadName("processing");
 	int sts = VREADER_OK;
+	bool flushing = false;
 	//change to end of file
 	while (shouldWork) {
 		START_LOG_FUNCTION(std::string("Processing() ") + std::to_string(decoder->getFrameIndex() + 1) + std::string(" frame"));
 		std::chrono::high_resolution_clock::time_point waitTime = std::chrono::high_resolution_clock::now();
-		START_LOG_BLOCK(std::string("parser->Read"));
-		sts = parser->Read();
-		END_LOG_BLOCK(std::string("parser->Read"));
-		if (sts == AVERROR(EAGAIN))
-			continue;
-		CHECK_STATUS(sts);
-		START_LOG_BLOCK(std::string("parser->Get"));
-		sts = parser->Get(parsed);
-		CHECK_STATUS(sts);
-		END_LOG_BLOCK(std::string("parser->Get"));
-		START_LOG_BLOCK(std::string("parser->Analyze"));
-		//Parse package to find some syntax issues
-		sts = parser->Analyze(parsed);
-		END_LOG_BLOCK(std::string("parser->Analyze"));
-		START_LOG_BLOCK(std::string("decoder->Decode"));
-		sts = decoder->Decode(parsed);
-		END_LOG_BLOCK(std::string("decoder->Decode"));
-		//Need more data for decoding
-		if (sts == AVERROR(EAGAIN) || sts == AVERROR_EOF)
-			continue;
-		CHECK_STATUS(sts);
-		START_LOG_BLOCK(std::string("check tensor to free"));
-		std::unique_lock<std::mutex> locker(freeSync);
-		/*
-		Need to check count of references of output Tensor and free if strong_refs = 1
-		*/
-		tensors.erase(
-			std::remove_if(
-				tensors.begin(),
-				tensors.end(),
-				[](at::Tensor & item) {
-			if (item.use_count() == 1) {
-				cudaFree(item.data_ptr());
-				return true;
-			}
-			return false;
+		//log blocks are scopes, so start of stage is declared outside of them
+		int64_t stageStart = traceClock();
+		if (!flushing) {
+			START_LOG_BLOCK(std::string("parser->Read"));
+			sts = parser->Read();
+			stats.read.add(traceClock() - stageStart);
+			END_LOG_BLOCK(std::string("parser->Read"));
+			if (sts == AVERROR(EAGAIN))
+				continue;
+			flushing = sts == AVERROR_EOF;
+		}
+		//frames kept by decoder for reordering are returned one per iteration after the end of stream, so they are paced as decoded ones
+		if (flushing) {
+			START_LOG_BLOCK(std::string("decoder->Flush"));
+			sts = decoder->Flush();
+			END_LOG_BLOCK(std::string("decoder->Flush"));
+			//the last frame has been returned
+			CHECK_STATUS(sts);
+		}
+		else {
+			START_LOG_BLOCK(std::string("parser->Get"));
+			sts = parser->Get(parsed);
+			CHECK_STATUS(sts);
+			stats.packets++;
+			stats.bytes += parsed->size;
+			END_LOG_BLOCK(std::string("parser->Get"));
+			START_LOG_BLOCK(std::string("parser->Analyze"));
+			//Parse package to find some syntax issues
+			stageStart = traceClock();
+			sts = parser->Analyze(parsed);
+			stats.analyze.add(traceClock() - stageStart);
+			END_LOG_BLOCK(std::string("parser->Analyze"));
+			START_LOG_BLOCK(std::string("decoder->Decode"));
+			stageStart = traceClock();
+			sts = decoder->Decode(parsed, parser->getTimestamps());
+			stats.decode.add(traceClock() - stageStart);
+			END_LOG_BLOCK(std::string("decoder->Decode"));
+			//Need more data for decoding
+			if (sts == AVERROR(EAGAIN) || sts == AVERROR_EOF)
+				continue;
+			CHECK_STATUS(sts);
+		}
+		stats.startup.addFrame(traceClock());
+		if (prefetch) {
+			START_LOG_BLOCK(std::string("vpp->Prefetch"));
+			AVFrame* latest = av_frame_alloc();
+			if (decoder->GetLatestFrame(latest) != VREADER_REPEAT)
+				vpp->Prefetch(latest);
+			av_frame_free(&latest);
+			END_LOG_BLOCK(std::string("vpp->Prefetch"));
 		}
-			),
-			tensors.end()
-			);
-		END_LOG_BLOCK(std::string("check tensor to free"));
 
 		START_LOG_BLOCK(std::string("sleep"));
 		//wait here
 		int sleepTime = realTimeDelay - std::chrono::duration_cast<std::chrono::milliseconds>(
 			std::chrono::high_resolution_clock::now() - waitTime).count();
-		if (sleepTime > 0) {
+		//replayed capture is paced by parser, live stream in low-latency mode is paced by source, frames flushed at the end aren't paced by them
+		if (sleepTime > 0 && (flushing || (!lowLatency && !parser->isReplay()))) {
 			std::this_thread::sleep_for(std::chrono::milliseconds(sleepTime));
 		}
 		END_LOG_BLOCK(std::string("sleep"));
@@ -143,12 +266,83 @@ int TensorStream::startProcessing() {
 	return sts;
 }
 
-std::tuple<at::Tensor, int> TensorStream::getFrame(std::string consumerName, int index, int pixelFormat, int dstWidth, int dstHeight) {
+/*
+Owner of exported output, memory is returned to VPP when the last user of tensor calls deleter
+*/
+struct ExportedFrame {
+	std::shared_ptr<VideoProcessor> vpp;
+	std::vector<int64_t> shape;
+	std::vector<int64_t> strides;
+	DLManagedTensor tensor;
+};
+
+static void freeExportedFrame(DLManagedTensor* tensor) {
+	ExportedFrame* frame = static_cast<ExportedFrame*>(tensor->manager_ctx);
+	frame->vpp->Free(tensor->dl_tensor.data);
+	delete frame;
+}
+
+DLManagedTensor* TensorStream::exportOutput(AVFrame* output, FourCC format) {
+	ExportedFrame* frame = new ExportedFrame();
+	frame->vpp = vpp;
+	int elementSize = getElementSize(format);
+	DLDataType type = { kDLUInt, 8, 1 };
+	if (elementSize == 1) {
+		//chroma rows of YUV formats follow luma rows
+		bool yuv = output->format == AV_PIX_FMT_NV12 || output->format == AV_PIX_FMT_YUV420P;
+		frame->shape = { yuv ? output->height * 3 / 2 : output->height, output->width, output->channels };
+	}
+	else {
+		//float formats are planar, VPP stores bytes per pixel in channels field
+		frame->shape = { output->channels / elementSize, output->height, output->width };
+		type = { kDLFloat, (uint8_t)(elementSize * 8), 1 };
+	}
+	//strides are set explicitly because some consumers don't accept NULL strides, views of decoded frame have own row pitch
+	frame->strides = { frame->shape[1] * frame->shape[2], frame->shape[2], 1 };
+	if (output->linesize[0])
+		frame->strides[0] = (int64_t)output->linesize[0] * output->channels;
+	DLContext context = { kDLCPU, 0 };
+	if (backendType == CUDA_BACKEND) {
+		context.device_type = kDLGPU;
+		cudaGetDevice(&context.device_id);
+	}
+	DLTensor& tensor = frame->tensor.dl_tensor;
+	tensor.data = output->opaque;
+	tensor.ctx = context;
+	tensor.ndim = (int)frame->shape.size();
+	tensor.dtype = type;
+	tensor.shape = frame->shape.data();
+	tensor.strides = frame->strides.data();
+	tensor.byte_offset = 0;
+	frame->tensor.manager_ctx = frame;
+	frame->tensor.deleter = freeExportedFrame;
+	return &frame->tensor;
+}
+
+std::tuple<std::vector<at::Tensor>, int, std::vector<std::vector<float> >, std::map<std::string, int64_t> > TensorStream::getFrame(std::string consumerName, int index,
+	int pixelFormat, int dstWidth, int dstHeight, int matrix, int range, std::vector<float> mean, std::vector<float> stdDev, int padMultiple,
+	int interpolation, std::vector<int> crop, bool letterbox, std::vector<int> padColor, std::vector<std::pair<int, int> > levels) {
+	auto exported = exportFrame(consumerName, index, pixelFormat, dstWidth, dstHeight, matrix, range, mean, stdDev, padMultiple,
+		interpolation, crop, letterbox, padColor, levels);
+	//tensors take ownership of exported memory, it's returned to VPP as soon as the last reference to tensor is dropped
+	std::vector<at::Tensor> outputTensors;
+	for (auto& item : std::get<0>(exported))
+		outputTensors.push_back(at::fromDLPack(item));
+	return std::make_tuple(outputTensors, std::get<1>(exported), std::get<2>(exported), std::get<3>(exported));
+}
+
+std::tuple<std::vector<DLManagedTensor*>, int, std::vector<std::vector<float> >, std::map<std::string, int64_t> > TensorStream::exportFrame(std::string consumerName,
+	int index, int pixelFormat, int dstWidth, int dstHeight, int matrix, int range, std::vector<float> mean, std::vector<float> stdDev,
+	int padMultiple, int interpolation, std::vector<int> crop, bool letterbox, std::vector<int> padColor,
+	std::vector<std::pair<int, int> > levels) {
 	AVFrame* decoded;
 	AVFrame* processedFrame;
-	at::Tensor outputTensor;
-	std::tuple<at::Tensor, int> outputTuple;
+	std::vector<DLManagedTensor*> outputTensors;
+	std::vector<std::vector<float> > outputTransforms;
+	std::tuple<std::vector<DLManagedTensor*>, int, std::vector<std::vector<float> >, std::map<std::string, int64_t> > outputTuple;
+	FrameTimestamps timestamps;
 	FourCC format = static_cast<FourCC>(pixelFormat);
+	TRACE_SPAN_LOW("getFrame", consumerName);
 	START_LOG_FUNCTION(std::string("GetFrame()"));
 	START_LOG_BLOCK(std::string("findFree decoded frame"));
 	{
@@ -164,27 +358,66 @@ std::tuple<at::Tensor, int> TensorStream::getFrame(std::string consumerName, int
 	END_LOG_BLOCK(std::string("findFree converted frame"));
 	int indexFrame = VREADER_REPEAT;
 	START_LOG_BLOCK(std::string("decoder->GetFrame"));
-	while (indexFrame == VREADER_REPEAT) {
-		indexFrame = decoder->GetFrame(index, consumerName, decoded);
+	{
+		TRACE_SPAN_HIGH("wait", consumerName);
+		while (indexFrame == VREADER_REPEAT) {
+			indexFrame = decoder->GetFrame(index, consumerName, decoded, &timestamps);
+		}
 	}
 	END_LOG_BLOCK(std::string("decoder->GetFrame"));
+	std::chrono::high_resolution_clock::time_point convertTime = std::chrono::high_resolution_clock::now();
+	//pyramid levels are stored to temporary frames, memory is owned by exported tensors
+	std::vector<AVFrame*> outputs = { processedFrame };
+	for (int i = 0; i < (int)levels.size(); i++)
+		outputs.push_back(av_frame_alloc());
+	std::vector<FrameTransform> transforms;
 	START_LOG_BLOCK(std::string("vpp->Convert"));
 	int sts = VREADER_OK;
-	VPPParameters VPPArgs = { dstWidth, dstHeight, format };
-	sts = vpp->Convert(decoded, processedFrame, VPPArgs, consumerName);
+	VPPParameters VPPArgs = { dstWidth, dstHeight, format, static_cast<ColorMatrix>(matrix), static_cast<ColorRange>(range) };
+	//one value is applied to all channels
+	for (int c = 0; c < 3; c++) {
+		if (mean.size())
+			VPPArgs.mean[c] = mean[mean.size() == 3 ? c : 0];
+		if (stdDev.size())
+			VPPArgs.std[c] = stdDev[stdDev.size() == 3 ? c : 0];
+	}
+	VPPArgs.padMultiple = padMultiple;
+	VPPArgs.interpolation = static_cast<Interpolation>(interpolation);
+	//crop is x, y, width, height
+	if (crop.size() == 4) {
+		VPPArgs.cropX = crop[0];
+		VPPArgs.cropY = crop[1];
+		VPPArgs.cropWidth = crop[2];
+		VPPArgs.cropHeight = crop[3];
+	}
+	VPPArgs.letterbox = letterbox;
+	for (int c = 0; c < 3; c++) {
+		if (padColor.size())
+			VPPArgs.padColor[c] = padColor[padColor.size() == 3 ? c : 0];
+	}
+	//row pitch of views is passed to consumers in tensor strides
+	VPPArgs.zeroCopy = true;
+	int64_t convertStart = traceClock();
+	sts = vpp->ConvertPyramid(decoded, outputs, VPPArgs, levels, consumerName, &transforms);
+	stats.convert.add(traceClock() - convertStart);
+	for (int i = 1; i < (int)outputs.size() && sts != VREADER_OK; i++)
+		av_frame_free(&outputs[i]);
 	CHECK_STATUS_THROW(sts);
+	timestamps.converted = wallClock();
+	stats.addFrame(timestamps.arrival, timestamps.capture, timestamps.converted);
 	END_LOG_BLOCK(std::string("vpp->Convert"));
-	START_LOG_BLOCK(std::string("tensor->ConvertFromBlob"));
-	outputTensor = torch::from_blob(processedFrame->opaque, { processedFrame->height, processedFrame->width, processedFrame->channels }, torch::CUDA(at::kByte));
-	outputTuple = std::make_tuple(outputTensor, indexFrame);
-	END_LOG_BLOCK(std::string("tensor->ConvertFromBlob"));
-	/*
-	Store tensor to be able get count of references for further releasing CUDA memory if strong_refs = 1
-	*/
-	START_LOG_BLOCK(std::string("add tensor"));
-	std::unique_lock<std::mutex> locker(freeSync);
-	tensors.push_back(outputTensor);
-	END_LOG_BLOCK(std::string("add tensor"));
+	START_LOG_BLOCK(std::string("export output"));
+	for (int i = 0; i < (int)outputs.size(); i++) {
+		outputTensors.push_back(exportOutput(outputs[i], format));
+		outputTransforms.push_back({ transforms[i].scaleX, transforms[i].scaleY, transforms[i].offsetX, transforms[i].offsetY });
+		if (i > 0)
+			av_frame_free(&outputs[i]);
+	}
+	std::map<std::string, int64_t> outputTimestamps = { {"pts", timestamps.pts}, {"dts", timestamps.dts}, {"capture", timestamps.capture},
+		{"arrival", timestamps.arrival}, {"decoded", timestamps.decoded}, {"converted", timestamps.converted} };
+	outputTuple = std::make_tuple(outputTensors, indexFrame, outputTransforms, outputTimestamps);
+	latency.add(std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - convertTime).count());
+	END_LOG_BLOCK(std::string("export output"));
 	END_LOG_FUNCTION(std::string("GetFrame() ") + std::to_string(indexFrame) + std::string(" frame"));
 	return outputTuple;
 }
@@ -194,6 +427,7 @@ Mode 1 - full close, mode 2 - soft close (for reset)
 */
 void TensorStream::endProcessing(int mode) {
 	shouldWork = false;
+	metricsServer = nullptr;
 	LOG_VALUE(std::string("End processing async part"));
 	{
 		std::unique_lock<std::mutex> locker(closeSync);
@@ -210,7 +444,6 @@ void TensorStream::endProcessing(int mode) {
 			av_frame_free(&item.second);
 		decodedArr.clear();
 		processedArr.clear();
-		tensors.clear();
 		delete parsed;
 		parsed = nullptr;
 		LOG_VALUE(std::string("End processing sync part end"));
@@ -226,37 +459,130 @@ void TensorStream::enableLogs(int _logsLevel) {
 	}
 }
 
+void TensorStream::enableTracing(int level) {
+	::enableTracing(level);
+}
+
+int TensorStream::dumpTrace(std::string fileName) {
+	return exportTrace(fileName);
+}
+
 int TensorStream::dumpFrame(AVFrame* output, std::shared_ptr<FILE> dumpFile) {
 	return vpp->DumpFrame(output, dumpFile);
 }
 
 static TensorStream reader;
 PYBIND11_MODULE(TORCH_EXTENSION_NAME, m) {
-	m.def("init", [](std::string rtmp) -> int {
-		return reader.initPipeline(rtmp);
+	m.def("init", [](std::string rtmp, int backend) -> int {
+		return reader.initPipeline(rtmp, static_cast<BackendType>(backend));
 	});
 
 	m.def("getPars", []() -> std::map<std::string, int> {
 		return reader.getInitializedParams();
 	});
 
+	m.def("getCacheCounters", []() -> std::map<std::string, uint64_t> {
+		return reader.getCacheCounters();
+	});
+
+	m.def("enablePrefetch", [](int workers) -> int {
+		return reader.enablePrefetch(workers);
+	});
+
+	m.def("setLowLatency", [](bool enabled) {
+		reader.setLowLatency(enabled);
+	});
+
+	m.def("setRTSPTransport", [](std::string transport) {
+		reader.setRTSPTransport(transport);
+	});
+
+	m.def("setProbing", [](int64_t probeSize, int64_t analyzeDuration) {
+		reader.setProbing(probeSize, analyzeDuration);
+	});
+
+	m.def("setParametersCache", [](bool enabled) {
+		reader.setParametersCache(enabled);
+	});
+
+	m.def("startCapture", [](std::string fileName) -> int {
+		return reader.startCapture(fileName);
+	});
+
+	m.def("getLatency", []() -> std::map<std::string, float> {
+		return reader.getLatency();
+	});
+
+	m.def("getPoolStats", []() -> std::map<std::string, uint64_t> {
+		return reader.getPoolStats();
+	});
+
+	m.def("getStats", []() -> std::map<std::string, double> {
+		return reader.getStats();
+	});
+
+	m.def("startMetricsServer", [](int port) -> int {
+		return reader.startMetricsServer(port);
+	});
+
+	m.def("setPoolLimit", [](uint64_t bytes) {
+		reader.setPoolLimit(bytes);
+	});
+
 	m.def("start", [](void) {
 		py::gil_scoped_release release;
 		return reader.startProcessing();
 	});
 
-	m.def("get", [](std::string name, int delay, int pixelFormat, int dstWidth, int dstHeight) {
+	m.def("get", [](std::string name, int delay, int pixelFormat, int dstWidth, int dstHeight,
+	int matrix, int range, std::vector<float> mean, std::vector<float> stdDev, int padMultiple, int interpolation, std::vector<int> crop,
+	bool letterbox, std::vector<int> padColor, std::vector<std::pair<int, int> > levels) {
 		py::gil_scoped_release release;
-		return reader.getFrame(name, delay, pixelFormat, dstWidth, dstHeight);
+		return reader.getFrame(name, delay, pixelFormat, dstWidth, dstHeight, matrix, range, mean, stdDev, padMultiple, interpolation,
+			crop, letterbox, padColor, levels);
+	});
+
+	m.def("getDLPack", [](std::string name, int delay, int pixelFormat, int dstWidth, int dstHeight,
+	int matrix, int range, std::vector<float> mean, std::vector<float> stdDev, int padMultiple, int interpolation, std::vector<int> crop,
+	bool letterbox, std::vector<int> padColor, std::vector<std::pair<int, int> > levels) {
+		std::tuple<std::vector<DLManagedTensor*>, int, std::vector<std::vector<float> >, std::map<std::string, int64_t> > exported;
+		{
+			py::gil_scoped_release release;
+			exported = reader.exportFrame(name, delay, pixelFormat, dstWidth, dstHeight, matrix, range, mean, stdDev, padMultiple,
+				interpolation, crop, letterbox, padColor, levels);
+		}
+		//consumer renames capsule to "used_dltensor" and takes ownership, otherwise tensor is released with capsule
+		std::vector<py::capsule> capsules;
+		for (auto& item : std::get<0>(exported)) {
+			capsules.push_back(py::capsule(item, "dltensor", [](PyObject* capsule) {
+				if (PyCapsule_IsValid(capsule, "dltensor")) {
+					DLManagedTensor* tensor = static_cast<DLManagedTensor*>(PyCapsule_GetPointer(capsule, "dltensor"));
+					tensor->deleter(tensor);
+				}
+			}));
+		}
+		return std::make_tuple(capsules, std::get<1>(exported), std::get<2>(exported), std::get<3>(exported));
 	});
 
 	m.def("dump", [](at::Tensor stream, std::string consumerName) {
 		py::gil_scoped_release release;
+		//views of decoded frame have row pitch bigger than width
+		stream = stream.contiguous();
 		AVFrame output;
 		output.opaque = stream.data_ptr();
-		output.width = output.linesize[0] = stream.size(1);
-		output.height = output.linesize[1] = stream.size(0);
-		output.channels = stream.size(2);
+		output.format = AV_PIX_FMT_NONE;
+		output.linesize[0] = 0;
+		if (stream.dim() == 3 && stream.element_size() == 1) {
+			output.width = stream.size(1);
+			output.height = stream.size(0);
+			output.channels = stream.size(2);
+		}
+		else {
+			//planar float tensors are written as raw values
+			output.width = stream.numel() * stream.element_size();
+			output.height = 1;
+			output.channels = 1;
+		}
 		//Kind of magic, need to concatenate string from Python with std::string to avoid issues in frame dumping (some strange artifacts appeared if create file using consumerName)
 		std::string dumpName = consumerName + std::string("");
 		std::shared_ptr<FILE> dumpFrame = std::shared_ptr<FILE>(fopen(dumpName.c_str(), "ab+"), std::fclose);
@@ -267,6 +593,14 @@ PYBIND11_MODULE(TORCH_EXTENSION_NAME, m) {
 		reader.enableLogs(logsLevel);
 	});
 
+	m.def("enableTracing", [](int level) {
+		reader.enableTracing(level);
+	});
+
+	m.def("dumpTrace", [](std::string fileName) -> int {
+		return reader.dumpTrace(fileName);
+	});
+
 	m.def("close", [](int mode) {
 		reader.endProcessing(mode);
 	});
@@ -3,6 +3,10 @@ from tensor_stream.tensor_stream import TensorStreamConverter,\
     LogsLevel,\
     LogsType,\
     CloseLevel,\
-    FourCC
+    FourCC,\
+    ColorMatrix,\
+    ColorRange,\
+    Interpolation,\
+    Backend
 
 __version__ = '0.1.8'
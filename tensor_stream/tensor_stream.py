@@ -55,12 +55,71 @@ class CloseLevel(Enum):
 ## Class with supported frame output color formats
 # @details Used in @ref TensorStreamConverter.read() function
 class FourCC(Enum):
-    ## Monochrome format, 8 bit for pixel
+    ## Monochrome format, 8 bit for pixel. Frame which doesn't need resize is returned as read-only view of decoded frame
     Y800 = 0
     ## RGB format, 24 bit for pixel, color plane order: R, G, B
     RGB24 = 1
     ## RGB format, 24 bit for pixel, color plane order: B, G, R
     BGR24 = 2
+    ## Planar RGB format, 32 bit float for every channel, tensor has shape [3, height, width], plane order: R, G, B
+    RGB_PLANAR_F32 = 3
+    ## Planar RGB format, 32 bit float for every channel, tensor has shape [3, height, width], plane order: B, G, R
+    BGR_PLANAR_F32 = 4
+    ## Planar RGB format, 16 bit float for every channel, tensor has shape [3, height, width], plane order: R, G, B
+    RGB_PLANAR_F16 = 5
+    ## Planar RGB format, 16 bit float for every channel, tensor has shape [3, height, width], plane order: B, G, R
+    BGR_PLANAR_F16 = 6
+    ## YUV 4:2:0, luma rows are followed by rows of interleaved U, V pairs, tensor has shape [height * 3 / 2, width, 1].
+    # Frame which doesn't need resize is returned as read-only view of decoded frame with row stride of decoder
+    NV12 = 7
+    ## YUV 4:2:0, luma rows are followed by U and V planes of half size, tensor has shape [height * 3 / 2, width, 1]
+    I420 = 8
+
+
+## Class with supported YUV to RGB conversion matrices
+# @details Used in @ref TensorStreamConverter.read() function
+class ColorMatrix(Enum):
+    ## Matrix is taken from decoded frame, BT.601 if frame doesn't specify it
+    AUTO = 0
+    ## ITU-R BT.601, SD content
+    BT601 = 1
+    ## ITU-R BT.709, HD content
+    BT709 = 2
+    ## ITU-R BT.2020, UHD content
+    BT2020 = 3
+
+
+## Class with supported ranges of YUV values
+# @details Used in @ref TensorStreamConverter.read() function
+class ColorRange(Enum):
+    ## Range is taken from decoded frame, limited if frame doesn't specify it
+    AUTO = 0
+    ## Y in [16, 235], UV in [16, 240]
+    LIMITED = 1
+    ## Y, UV in [0, 255]
+    FULL = 2
+
+
+## Class with supported resize algorithms
+# @details Used in @ref TensorStreamConverter.read() function
+class Interpolation(Enum):
+    ## Nearest neighbour, the fastest one
+    NEAREST = 0
+    ## Bilinear interpolation of 2x2 source pixels
+    BILINEAR = 1
+    ## Average of source pixels covered by output pixel, recommended for big downscale
+    AREA = 2
+    ## Bicubic interpolation of 4x4 source pixels
+    BICUBIC = 3
+
+
+## Class with devices which can be used for decoding and post-processing
+# @details Used in @ref TensorStreamConverter constructor
+class Backend(Enum):
+    ## Hardware decoding and post-processing on GPU, output tensors are placed in CUDA memory
+    CUDA = 0
+    ## Software decoding and post-processing on CPU, output tensors are placed in host memory
+    CPU = 1
 
 
 ## Class which allow start decoding process and get Pytorch tensors with post-processed frame data
@@ -69,7 +128,15 @@ class TensorStreamConverter:
     # @param[in] stream_url Path to stream should be decoded
     # @anchor repeat_number
     # @param[in] repeat_number Set how many times @ref initialize() function will try to initialize pipeline in case of any issues
-    def __init__(self, stream_url, repeat_number=1):
+    # @param[in] backend Device used for decoding and post-processing, see @ref Backend for supported values
+    # @param[in] low_latency Low-latency profile for live streams: probed packets aren't buffered, probing is limited to 32 KB,
+    # decoder outputs frames as soon as they are decoded and decoding isn't paced to frame rate. The first frames of stream can be lost
+    # @param[in] rtsp_transport Lower transport of RTSP streams: "tcp", "udp", "udp_multicast" or "http", empty string means FFmpeg default
+    # @param[in] probe_size Maximum number of bytes read while stream parameters are probed, 0 means FFmpeg default (5 MB)
+    # @param[in] analyze_duration Maximum duration of probed stream in microseconds, 0 means FFmpeg default (5 s)
+    # @param[in] cache_parameters Keep stream parameters found by probing in process, so next initializations with the same stream_url skip probing
+    def __init__(self, stream_url, repeat_number=1, backend=Backend.CUDA, low_latency=False, rtsp_transport="tcp", probe_size=0,
+                 analyze_duration=0, cache_parameters=False):
         self.log = logging.getLogger(__name__)
         self.log.info("Create TensorStream")
         self.thread = None
@@ -80,6 +147,12 @@ class TensorStreamConverter:
 
         self.stream_url = stream_url
         self.repeat_number = repeat_number
+        self.backend = backend
+        self.low_latency = low_latency
+        self.rtsp_transport = rtsp_transport
+        self.probe_size = probe_size
+        self.analyze_duration = analyze_duration
+        self.cache_parameters = cache_parameters
 
     ## Initialization of C++ extension
     # @warning if initialization attempts exceeded @ref repeat_number, RuntimeError is being thrown
@@ -87,8 +160,12 @@ class TensorStreamConverter:
         self.log.info("Initialize TensorStream")
         status = StatusLevel.REPEAT.value
         repeat = self.repeat_number
+        TensorStream.setLowLatency(self.low_latency)
+        TensorStream.setRTSPTransport(self.rtsp_transport)
+        TensorStream.setProbing(self.probe_size, self.analyze_duration)
+        TensorStream.setParametersCache(self.cache_parameters)
         while status != StatusLevel.OK.value and repeat > 0:
-            status = TensorStream.init(self.stream_url)
+            status = TensorStream.init(self.stream_url, self.backend.value)
             if status != StatusLevel.OK.value:
                 # Mode 1 - full close, mode 2 - soft close (for reset)
                 self.stop(CloseLevel.SOFT)
@@ -110,6 +187,78 @@ class TensorStreamConverter:
         else:
             TensorStream.enableLogs(-level.value)
 
+    ## Start recording trace spans of reading, decoding and conversions per thread and consumer
+    # @details Spans are stored to lock-free per-thread ring buffers, so tracing can be left enabled in production
+    # @param[in] level Spans up to this level are recorded, see @ref LogsLevel, LogsLevel.NONE stops recording
+    def enable_tracing(self, level=LogsLevel.HIGH):
+        TensorStream.enableTracing(level.value)
+
+    ## Write spans recorded since @ref enable_tracing() call as Chrome trace JSON, can be opened in chrome://tracing or ui.perfetto.dev
+    # @param[in] path Path to output file
+    def dump_trace(self, path):
+        status = TensorStream.dumpTrace(path)
+        if status != StatusLevel.OK.value:
+            raise RuntimeError("Can't write trace to " + path)
+
+    ## Get counters of conversion cache
+    # @details Consumers which read the same frame with the same parameters share one conversion, such tensors should be treated as read-only
+    # @return Dictionary with 'hits' (tensors shared with previous consumers), 'misses' (conversions done by TensorStream),
+    # 'prefetched' (conversions done ahead of requests) and 'views' (tensors which alias decoded frames) values
+    def cache_counters(self):
+        return TensorStream.getCacheCounters()
+
+    ## Convert every decoded frame in background with the last parameters used by every consumer, so @ref read() usually returns already converted frame
+    # @details Should be called after @ref initialize() and before @ref start(). Converted frames are kept while source frame is in decoder's buffer
+    # @param[in] workers Number of background threads used for conversions
+    def enable_prefetch(self, workers=1):
+        status = TensorStream.enablePrefetch(workers)
+        if status != StatusLevel.OK.value:
+            raise RuntimeError("Can't enable prefetch")
+
+    ## Record every packet read from stream with its arrival time to capture file
+    # @details Should be called after @ref initialize() and before @ref start(). Capture can be replayed with recorded timing
+    # by passing 'replay://path?speed=1' as stream URL, speed 0 replays packets as fast as possible
+    # @param[in] path Path to capture file, existing file is overwritten
+    def start_capture(self, path):
+        status = TensorStream.startCapture(path)
+        if status != StatusLevel.OK.value:
+            raise RuntimeError("Can't write capture to " + path)
+
+    ## Get latency of the last 1000 @ref read() calls measured from the moment decoded frame is taken till tensor is ready
+    # @return Dictionary with 'p50' and 'p99' values in milliseconds and 'samples' number
+    def latency(self):
+        return TensorStream.getLatency()
+
+    ## Get statistics of output buffer pool, memory of released tensors is reused by next frames
+    # @return Dictionary with 'allocations' and 'releases' (device memory calls), 'hits' and 'misses' (requests served from pool and by allocation),
+    # 'bytes_in_use', 'bytes_cached', 'peak_bytes_in_use' and 'peak_bytes_allocated' values
+    def pool_stats(self):
+        return TensorStream.getPoolStats()
+
+    ## Get metrics of pipeline since initialization, durations are measured with lock-free HDR-style histograms (about 3% precision)
+    # @return Dictionary with 'count', 'mean_ms', 'p50_ms', 'p90_ms', 'p99_ms', 'p999_ms' and 'max_ms' values of 'read', 'analyze', 'decode' and
+    # 'convert' stages (keys like 'decode.p99_ms'), 'packets', 'bytes' and 'bitrate_kbps' of read stream, 'decoded_frames', 'prefetch_queue',
+    # 'consumer.<name>.delivered', 'consumer.<name>.skipped' (decoded frames consumer didn't take before newer frame was decoded),
+    # 'consumer.<name>.dropped' (requests of frames which aren't in decoder's buffer), 'consumer.<name>.lag', 'pool.<name>' values
+    # with the same names as in @ref pool_stats(), durations of startup phases 'startup.open_ms', 'startup.probe_ms', 'startup.decoder_ms',
+    # 'startup.vpp_ms', 'startup.first_frame_ms' and 'startup.cached' (1 if probing was skipped)
+    def stats(self):
+        return TensorStream.getStats()
+
+    ## Serve metrics from @ref stats() in Prometheus text format over HTTP on 127.0.0.1, server is stopped by @ref stop()
+    # @param[in] port TCP port, 0 means any free port
+    # @return Port number of server
+    def start_metrics_server(self, port=0):
+        port = TensorStream.startMetricsServer(port)
+        if port < 0:
+            raise RuntimeError("Can't start metrics server")
+        return port
+
+    ## Set maximum size of released tensors memory kept for reuse, 512 MB by default
+    # @param[in] limit Limit in bytes
+    def set_pool_limit(self, limit):
+        TensorStream.setPoolLimit(limit)
+
     ## Read the next decoded frame, should be invoked only after @ref start() call
     # @param[in] name The unique ID of consumer. Needed mostly in case of several consumers work in different threads
     # @param[in] delay Specify which frame should be read from decoded buffer. Can take values in range [-10, 0]
@@ -117,19 +266,65 @@ class TensorStreamConverter:
     # @param[in] return_index Specify whether need return index of decoded frame or not
     # @param[in] width Specify the width of decoded frame
     # @param[in] height Specify the height of decoded frame
-    # @return Decoded frame in CUDA memory wrapped to Pytorch tensor and index of decoded frame if @ref return_index option set
+    # @param[in] matrix YUV to RGB conversion matrix, see @ref ColorMatrix for supported values
+    # @param[in] color_range Range of YUV values in decoded frame, see @ref ColorRange for supported values
+    # @param[in] mean Per-channel mean (one value or list of 3 in output plane order) subtracted from values scaled to [0, 1], only for float formats
+    # @param[in] std Per-channel standard deviation values are divided by, only for float formats
+    # @param[in] padding Width and height of output are rounded up to multiple of this value, padded area is filled with zeros
+    # @param[in] interpolation Resize algorithm, see @ref Interpolation for supported values
+    # @param[in] crop Region of source frame (x, y, width, height) which is converted, zero width or height means up to frame edge
+    # @param[in] letterbox Keep aspect ratio of crop: image is fitted to width x height, centered and area around is filled with pad_color
+    # @param[in] pad_color Color of letterbox area (one value or list of 3 in output plane order), 8 bit values normalized as image for float formats
+    # @param[in] return_transform Specify whether need return mapping from source to output coordinates (scale_x, scale_y, offset_x, offset_y):
+    # output = source * scale + offset
+    # @param[in] levels List of (width, height) of pyramid levels, every level is downscaled from the previous one with area averaging,
+    # so source frame is read once. (0, 0) means half of previous level
+    # @param[in] dlpack Return DLPack capsules instead of Pytorch tensors, e.g. for torch.utils.dlpack.from_dlpack or cupy.fromDlpack.
+    # Memory isn't copied and is returned to TensorStream when the consumer of capsule (or capsule itself if it isn't consumed) releases it
+    # @param[in] return_timestamps Specify whether need return timing of frame: dictionary with 'pts' and 'dts' of source packet in stream time base
+    # ('timebase_num' / 'timebase_den' of initialized parameters), 'capture' (time set by producer in H.264 SEI), 'arrival' (packet was read),
+    # 'decoded' and 'converted' times in microseconds since Unix epoch, 0 means unknown. Glass-to-tensor latency is 'converted' - 'capture'
+    # @return Decoded frame in CUDA or host memory (depends on backend) wrapped to Pytorch tensor, index of decoded frame if @ref return_index option set,
+    # transform if return_transform option set and timestamps if return_timestamps option set. If levels are set, list of tensors [frame, level 1, ...]
+    # and list of transforms are returned
     def read(self,
              name="default",
              delay=0,
              pixel_format=FourCC.RGB24,
              return_index=False,
              width=0,
-             height=0):
-        tensor, index = TensorStream.get(name, delay, pixel_format.value, width, height)
+             height=0,
+             matrix=ColorMatrix.AUTO,
+             color_range=ColorRange.AUTO,
+             mean=None,
+             std=None,
+             padding=0,
+             interpolation=Interpolation.NEAREST,
+             crop=None,
+             letterbox=False,
+             pad_color=None,
+             return_transform=False,
+             levels=None,
+             dlpack=False,
+             return_timestamps=False):
+        mean = [] if mean is None else ([mean] if isinstance(mean, (int, float)) else list(mean))
+        std = [] if std is None else ([std] if isinstance(std, (int, float)) else list(std))
+        crop = [] if crop is None else list(crop)
+        pad_color = [] if pad_color is None else ([pad_color] if isinstance(pad_color, int) else list(pad_color))
+        pyramid = [] if levels is None else [tuple(level) for level in levels]
+        get = TensorStream.getDLPack if dlpack else TensorStream.get
+        tensors, index, transforms, timestamps = get(name, delay, pixel_format.value, width, height, matrix.value, color_range.value,
+                                         mean, std, padding, interpolation.value, crop, letterbox, pad_color, pyramid)
+        tensor = tensors if levels is not None else tensors[0]
+        transform = [tuple(item) for item in transforms] if levels is not None else tuple(transforms[0])
+        result = (tensor,)
         if return_index:
-            return tensor, index
-        else:
-            return tensor
+            result += (index,)
+        if return_transform:
+            result += (transform,)
+        if return_timestamps:
+            result += (timestamps,)
+        return result if len(result) > 1 else tensor
 
     ## Dump the tensor to hard driver
     # @param[in] tensor Tensor which should be dumped
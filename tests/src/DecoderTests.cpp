@@ -118,6 +118,37 @@ TEST_F(Decoder_Init, CheckHWPixelFormat) {
 
 }
 
+//Software decoding should produce the same NV12 frame as hardware decoding but in host memory
+TEST_F(Decoder_Init, SoftwareDecoding) {
+	Decoder decoder;
+	DecoderParameters decoderArgs = { parser, false, 1, CPU_BACKEND };
+	int sts = decoder.Init(decoderArgs);
+	EXPECT_EQ(sts, VREADER_OK);
+	sts = parser->Read();
+	sts = parser->Get(&parsed);
+	auto output = av_frame_alloc();
+	int result;
+	std::thread get([&decoder, &output, &result]() {
+		result = decoder.GetFrame(0, "visualize", output);
+	});
+	sts = decoder.Decode(&parsed);
+	get.join();
+	EXPECT_NE(result, VREADER_REPEAT);
+	ASSERT_EQ(output->format, AV_PIX_FMT_NV12);
+	std::vector<uint8_t> outputY(output->width * output->height);
+	std::vector<uint8_t> outputUV(output->width * output->height / 2);
+	for (int i = 0; i < output->height; i++)
+		memcpy(&outputY[i * output->width], output->data[0] + i * output->linesize[0], output->width);
+	for (int i = 0; i < output->height / 2; i++)
+		memcpy(&outputUV[i * output->width], output->data[1] + i * output->linesize[1], output->width);
+	//CRC for zero frame of bbb_1080x608_420_10.h264
+	//CRC32 - 3265466497
+	ASSERT_EQ(av_crc(av_crc_get_table(AV_CRC_32_IEEE), -1, &outputY[0], output->width * output->height), 3265466497);
+	//CRC32 - 2183362287
+	ASSERT_EQ(av_crc(av_crc_get_table(AV_CRC_32_IEEE), -1, &outputUV[0], output->width * output->height / 2), 2183362287);
+	av_frame_free(&output);
+}
+
 TEST(Decoder_Init_YUV444, HWUsupportedPixelFormat) {
 	av_log_set_callback([](void *ptr, int level, const char *fmt, va_list vargs) {
 		return;
@@ -278,3 +309,138 @@ TEST_F(Decoder_Init, SeveralThreads) {
 	ASSERT_EQ(processingFrames[0]->data[0], nullptr);
 	ASSERT_EQ(processingFrames[0]->data[1], nullptr);
 }
+
+//timestamps of packet follow frame decoded from it through B-frames reordering
+TEST(Decoder_Timestamps, Reordering) {
+	auto parser = std::make_shared<Parser>();
+	ParserParameters parserArgs = { "synthetic://320x240?gop=12&bframes=2&frames=10" };
+	ASSERT_EQ(parser->Init(parserArgs), VREADER_OK);
+	Decoder decoder;
+	DecoderParameters decoderArgs = { parser, false, 10, CPU_BACKEND };
+	ASSERT_EQ(decoder.Init(decoderArgs), VREADER_OK);
+	std::vector<FrameTimestamps> received;
+	std::thread get([&decoder, &received]() {
+		try {
+			while (true) {
+				auto output = av_frame_alloc();
+				FrameTimestamps timestamps;
+				if (decoder.GetFrame(0, "visualize", output, &timestamps) != VREADER_REPEAT)
+					received.push_back(timestamps);
+				av_frame_free(&output);
+			}
+		}
+		catch (std::runtime_error) {
+		}
+	});
+	//wait some time to gurantee that GetFrame will be executed before Decode
+	std::this_thread::sleep_for(std::chrono::milliseconds(100));
+	AVPacket parsed;
+	for (int i = 0; i < 10; i++) {
+		ASSERT_EQ(parser->Read(), VREADER_OK);
+		ASSERT_EQ(parser->Get(&parsed), VREADER_OK);
+		FrameTimestamps timestamps;
+		//index of packet in decoding order
+		timestamps.pts = i;
+		timestamps.arrival = wallClock();
+		decoder.Decode(&parsed, timestamps);
+		//consumer should see every frame
+		std::this_thread::sleep_for(std::chrono::milliseconds(50));
+	}
+	decoder.notifyConsumers();
+	get.join();
+	//pictures are I P B B P B B P B B in decoding order
+	std::vector<int64_t> display = { 0, 2, 3, 1, 5, 6, 4, 8, 9, 7 };
+	ASSERT_GT(received.size(), 0);
+	ASSERT_LE(received.size(), display.size());
+	for (int i = 0; i < received.size(); i++) {
+		EXPECT_EQ(received[i].pts, display[i]);
+		EXPECT_GE(received[i].decoded, received[i].arrival);
+	}
+}
+
+//every frame decoder can return is taken after packet, frames kept for reordering are returned by flush one per call
+TEST(Decoder_LowLatency, DrainAndFlush) {
+	auto parser = std::make_shared<Parser>();
+	//every macroblock is I_PCM, so luma of frame is known from its display index, see SyntheticStream::writePCM
+	ParserParameters parserArgs = { "synthetic://320x240?gop=0&bframes=2&complexity=1&frames=10" };
+	ASSERT_EQ(parser->Init(parserArgs), VREADER_OK);
+	Decoder decoder;
+	DecoderParameters decoderArgs = { parser, false, 10, CPU_BACKEND };
+	ASSERT_EQ(decoder.Init(decoderArgs), VREADER_OK);
+	auto checkLuma = [](AVFrame* frame, int display) {
+		for (int y = 0; y < frame->height; y++)
+			for (int x = 0; x < frame->width; x++)
+				if (frame->data[0][y * frame->linesize[0] + x] != 16 + (((x + 2 * display) ^ (y + display + 1)) & 0xFF) * 219 / 255)
+					return false;
+		return true;
+	};
+	std::vector<FrameTimestamps> received;
+	std::vector<bool> contents;
+	std::thread get([&]() {
+		try {
+			while (true) {
+				auto output = av_frame_alloc();
+				FrameTimestamps timestamps;
+				int index = decoder.GetFrame(0, "tail", output, &timestamps);
+				if (index != VREADER_REPEAT) {
+					received.push_back(timestamps);
+					contents.push_back(checkLuma(output, index - 1));
+				}
+				av_frame_free(&output);
+			}
+		}
+		catch (std::runtime_error) {
+		}
+	});
+	std::this_thread::sleep_for(std::chrono::milliseconds(100));
+	AVPacket parsed;
+	for (int i = 0; i < 10; i++) {
+		ASSERT_EQ(parser->Read(), VREADER_OK);
+		ASSERT_EQ(parser->Get(&parsed), VREADER_OK);
+		FrameTimestamps timestamps;
+		timestamps.pts = i;
+		int sts = decoder.Decode(&parsed, timestamps);
+		EXPECT_TRUE(sts == VREADER_OK || sts == AVERROR(EAGAIN));
+		//decoder can't be ahead of input
+		EXPECT_LE(decoder.getFrameIndex(), i + 1);
+		std::this_thread::sleep_for(std::chrono::milliseconds(50));
+	}
+	//the last P-frame is shown after B-frames decoded after it
+	int decoded = decoder.getFrameIndex();
+	EXPECT_LT(decoded, 10);
+	for (int i = decoded; i < 10; i++) {
+		EXPECT_EQ(decoder.Flush(), VREADER_OK);
+		EXPECT_EQ(decoder.getFrameIndex(), i + 1);
+		std::this_thread::sleep_for(std::chrono::milliseconds(50));
+	}
+	EXPECT_EQ(decoder.Flush(), AVERROR_EOF);
+	decoder.notifyConsumers();
+	get.join();
+	//pictures are I P B B P B B P B B in decoding order, the tail is returned by flush
+	std::vector<int64_t> display = { 0, 2, 3, 1, 5, 6, 4, 8, 9, 7 };
+	ASSERT_EQ(received.size(), display.size());
+	for (int i = 0; i < received.size(); i++) {
+		EXPECT_EQ(received[i].pts, display[i]);
+		EXPECT_TRUE(contents[i]);
+	}
+	decoder.Close();
+
+	//without B-frames frame is returned right after its packet
+	parserArgs = { "synthetic://320x240?gop=0&frames=10" };
+	parser = std::make_shared<Parser>();
+	ASSERT_EQ(parser->Init(parserArgs), VREADER_OK);
+	Decoder lowDelay;
+	decoderArgs = { parser, false, 10, CPU_BACKEND };
+	decoderArgs.lowLatency = true;
+	ASSERT_EQ(lowDelay.Init(decoderArgs), VREADER_OK);
+	EXPECT_TRUE(lowDelay.getDecoderContext()->flags & AV_CODEC_FLAG_LOW_DELAY);
+	for (int i = 0; i < 10; i++) {
+		ASSERT_EQ(parser->Read(), VREADER_OK);
+		ASSERT_EQ(parser->Get(&parsed), VREADER_OK);
+		EXPECT_EQ(lowDelay.Decode(&parsed), VREADER_OK);
+		EXPECT_EQ(lowDelay.getFrameIndex(), i + 1);
+	}
+	EXPECT_EQ(lowDelay.Flush(), AVERROR_EOF);
+	EXPECT_EQ(lowDelay.getFrameIndex(), 10);
+	lowDelay.Close();
+}
@@ -0,0 +1,591 @@
+#include <gtest/gtest.h>
+#include <random>
+#include <algorithm>
+#include "KernelsCPU.h"
+#include "ThreadPool.h"
+#include "VPPPipeline.h"
+
+//BT.601 limited range, the same as legacy conversion
+const ColorCoefficients coefficientsBT601 = { 16, 9535, 13074, 6660, 3203, 16531 };
+//BT.709 and BT.2020 full range
+const ColorCoefficients coefficientsFull[] = { { 0, 8192, 12902, 3834, 1532, 15204 }, { 0, 8192, 12083, 4678, 1352, 15409 } };
+
+//Every vectorized version should give exactly the same output as scalar reference, sizes are chosen to have tails in all kernels
+class KernelsCPU_BitExact : public ::testing::TestWithParam<CPUInstructionSet> {
+public:
+	const CPUKernels* reference;
+	const CPUKernels* kernels;
+	std::mt19937 generator;
+	std::vector<int> widths = { 1, 2, 7, 8, 15, 16, 17, 31, 32, 33, 63, 65, 127, 1920, 1921 };
+protected:
+	void SetUp()
+	{
+		reference = getCPUKernels(SCALAR);
+		//instruction set isn't supported by current CPU
+		kernels = getCPUKernels(GetParam());
+	}
+
+	std::vector<uint8_t> random(int size) {
+		std::vector<uint8_t> data(size);
+		for (auto& item : data)
+			item = generator() & 0xFF;
+		return data;
+	}
+
+	//the same tables as in resizeNV12BilinearCPU
+	void resizeTables(int srcWidth, int dstWidth, std::vector<int>& index, std::vector<int>& weight) {
+		float ratio = ((float)(srcWidth - 1)) / dstWidth;
+		index.resize(dstWidth);
+		weight.resize(dstWidth);
+		for (int j = 0; j < dstWidth; j++) {
+			float position = ratio * j;
+			index[j] = (int)position;
+			weight[j] = (int)((position - index[j]) * weightOne);
+			if (index[j] >= srcWidth - 1) {
+				index[j] = srcWidth - 2;
+				weight[j] = weightOne;
+			}
+		}
+	}
+};
+
+TEST_P(KernelsCPU_BitExact, NV12ToRGB24) {
+	if (kernels == nullptr)
+		return;
+	for (int width : widths) {
+		std::vector<uint8_t> Y = random(width);
+		//chroma row contains pair for the last odd pixel too
+		std::vector<uint8_t> UV = random(width + 1);
+		std::vector<uint8_t> expected(3 * width), actual(3 * width);
+		for (const ColorCoefficients& coefficients : { coefficientsBT601, coefficientsFull[0], coefficientsFull[1] }) {
+			reference->NV12ToRGB24Row(&Y[0], &UV[0], &expected[0], width, coefficients);
+			kernels->NV12ToRGB24Row(&Y[0], &UV[0], &actual[0], width, coefficients);
+			EXPECT_EQ(actual, expected) << "width " << width << " offset " << coefficients.offsetY;
+			reference->NV12ToBGR24Row(&Y[0], &UV[0], &expected[0], width, coefficients);
+			kernels->NV12ToBGR24Row(&Y[0], &UV[0], &actual[0], width, coefficients);
+			EXPECT_EQ(actual, expected) << "width " << width << " offset " << coefficients.offsetY;
+		}
+	}
+}
+
+TEST_P(KernelsCPU_BitExact, BlendRows) {
+	if (kernels == nullptr)
+		return;
+	for (int width : widths) {
+		std::vector<uint8_t> top = random(width);
+		std::vector<uint8_t> bottom = random(width);
+		for (int weight = 0; weight <= weightOne; weight += 16) {
+			std::vector<uint8_t> expected(width), actual(width);
+			reference->blendRows(&top[0], &bottom[0], &expected[0], width, weight);
+			kernels->blendRows(&top[0], &bottom[0], &actual[0], width, weight);
+			EXPECT_EQ(actual, expected) << "width " << width << " weight " << weight;
+		}
+	}
+}
+
+TEST_P(KernelsCPU_BitExact, Resize) {
+	if (kernels == nullptr)
+		return;
+	for (int srcWidth : widths) {
+		if (srcWidth < 2)
+			continue;
+		//downscale and upscale
+		for (int dstWidth : { srcWidth / 2 + 1, srcWidth * 2 - 1 }) {
+			std::vector<int> index, weight;
+			resizeTables(srcWidth, dstWidth, index, weight);
+			//buffers have exact size, so reads out of row are caught by sanitizers
+			std::vector<uint8_t> src = random(srcWidth);
+			std::vector<uint8_t> srcUV = random(2 * srcWidth);
+			std::vector<uint8_t> expected(dstWidth), actual(dstWidth);
+			reference->resizeNearestRow(&src[0], &expected[0], &index[0], dstWidth, srcWidth);
+			kernels->resizeNearestRow(&src[0], &actual[0], &index[0], dstWidth, srcWidth);
+			EXPECT_EQ(actual, expected) << "nearest " << srcWidth << "->" << dstWidth;
+			reference->resizeBilinearRow(&src[0], &expected[0], &index[0], &weight[0], dstWidth, srcWidth);
+			kernels->resizeBilinearRow(&src[0], &actual[0], &index[0], &weight[0], dstWidth, srcWidth);
+			EXPECT_EQ(actual, expected) << "bilinear " << srcWidth << "->" << dstWidth;
+
+			std::vector<uint8_t> expectedUV(2 * dstWidth), actualUV(2 * dstWidth);
+			reference->resizeNearestRowUV(&srcUV[0], &expectedUV[0], &index[0], dstWidth, srcWidth);
+			kernels->resizeNearestRowUV(&srcUV[0], &actualUV[0], &index[0], dstWidth, srcWidth);
+			EXPECT_EQ(actualUV, expectedUV) << "nearest UV " << srcWidth << "->" << dstWidth;
+			reference->resizeBilinearRowUV(&srcUV[0], &expectedUV[0], &index[0], &weight[0], dstWidth, srcWidth);
+			kernels->resizeBilinearRowUV(&srcUV[0], &actualUV[0], &index[0], &weight[0], dstWidth, srcWidth);
+			EXPECT_EQ(actualUV, expectedUV) << "bilinear UV " << srcWidth << "->" << dstWidth;
+		}
+	}
+}
+
+TEST_P(KernelsCPU_BitExact, FilterColumns) {
+	if (kernels == nullptr)
+		return;
+	//downscales with many taps and upscales with negative weights
+	for (FilterKernel kernel : { FILTER_BILINEAR, FILTER_AREA, FILTER_BICUBIC }) {
+		for (int srcSize : { 7, 64, 1080 }) {
+			FilterTable table;
+			table.init(kernel, srcSize, kernel == FILTER_AREA ? 5 : 3 * srcSize);
+			for (int width : widths) {
+				//range of horizontal pass result, including overshoot of bicubic filter
+				std::vector<std::vector<int16_t> > rows(table.taps, std::vector<int16_t>(width));
+				std::vector<const int16_t*> pointers;
+				for (auto& row : rows) {
+					for (auto& item : row)
+						item = (int16_t)(generator() % 23000) - 3000;
+					pointers.push_back(&row[0]);
+				}
+				std::vector<uint8_t> expected(width), actual(width);
+				for (int j = 0; j < (int)table.index.size(); j += std::max(1, (int)table.index.size() / 7)) {
+					reference->filterColumns(&pointers[0], &table.weights[j * table.taps], table.taps, &expected[0], width);
+					kernels->filterColumns(&pointers[0], &table.weights[j * table.taps], table.taps, &actual[0], width);
+					EXPECT_EQ(actual, expected) << "kernel " << kernel << " taps " << table.taps << " width " << width;
+				}
+			}
+		}
+	}
+}
+
+INSTANTIATE_TEST_CASE_P(KernelsCPU, KernelsCPU_BitExact, ::testing::Values(SSE41, AVX2, AVX512));
+
+//Fixed-point conversion differs from float math of CUDA kernels by 1 at most
+TEST(KernelsCPU_Scalar, FloatTolerance) {
+	auto clamp = [](float value) { return value < 0 ? 0 : (value > 255 ? 255 : (int)value); };
+	int maxDifference = 0;
+	for (int Y = 0; Y < 256; Y++) {
+		for (int U = 0; U < 256; U++) {
+			for (int V = 0; V < 256; V++) {
+				uint8_t YRow[1] = { (uint8_t)Y };
+				uint8_t UVRow[2] = { (uint8_t)U, (uint8_t)V };
+				uint8_t RGB[3];
+				NV12ToRGB24RowScalar(YRow, UVRow, RGB, 1, coefficientsBT601);
+				int R = clamp(1.164f*(Y - 16) + 1.596f*(V - 128));
+				int G = clamp(1.164f*(Y - 16) - 0.813f*(V - 128) - 0.391f*(U - 128));
+				int B = clamp(1.164f*(Y - 16) + 2.018f*(U - 128));
+				maxDifference = std::max(maxDifference, std::abs(R - RGB[0]));
+				maxDifference = std::max(maxDifference, std::abs(G - RGB[1]));
+				maxDifference = std::max(maxDifference, std::abs(B - RGB[2]));
+			}
+		}
+	}
+	EXPECT_LE(maxDifference, 1);
+}
+
+TEST(KernelsCPU_Dispatch, BestInstructionSet) {
+	const CPUKernels& best = getCPUKernels();
+	EXPECT_EQ(getCPUKernels(best.instructionSet), &best);
+	EXPECT_NE(getCPUKernels(SCALAR), nullptr);
+}
+
+TEST(KernelsCPU_Parallel, BandHeight) {
+	for (int bytesPerRow : { 1, 3, 1000, 3840 * 9 / 2, 1 << 30 }) {
+		int bandHeight = getBandHeight(bytesPerRow);
+		EXPECT_EQ(bandHeight % 2, 0);
+		EXPECT_GE(bandHeight, 2);
+	}
+}
+
+TEST(KernelsCPU_Parallel, ThreadPool) {
+	ThreadPool pool(4);
+	EXPECT_EQ(pool.getThreadsNumber(), 4);
+	std::vector<int> executed(1000);
+	pool.parallelFor(executed.size(), [&](int index) { executed[index]++; });
+	EXPECT_EQ(executed, std::vector<int>(1000, 1));
+}
+
+TEST(KernelsCPU_Parallel, Submit) {
+	ThreadPool pool(3);
+	std::mutex sync;
+	std::condition_variable finished;
+	int executed = 0;
+	std::thread::id caller = std::this_thread::get_id();
+	bool sameThread = false;
+	for (int i = 0; i < 100; i++) {
+		pool.submit([&] {
+			std::unique_lock<std::mutex> locker(sync);
+			sameThread |= std::this_thread::get_id() == caller;
+			if (++executed == 100)
+				finished.notify_all();
+		});
+	}
+	//blocking jobs are executed together with submitted ones
+	std::vector<int> parallel(100);
+	pool.parallelFor(parallel.size(), [&](int index) { parallel[index]++; });
+	EXPECT_EQ(parallel, std::vector<int>(100, 1));
+	std::unique_lock<std::mutex> locker(sync);
+	EXPECT_TRUE(finished.wait_for(locker, std::chrono::seconds(10), [&] { return executed == 100; }));
+	EXPECT_FALSE(sameThread);
+}
+
+//Splitting to bands shouldn't change output, odd height checks the last band with half of chroma row
+TEST(KernelsCPU_Parallel, SameAsSerial) {
+	const int width = 3840;
+	const int height = 2161;
+	std::mt19937 generator;
+	std::vector<uint8_t> NV12(width * (height + height / 2 + 1));
+	for (auto& item : NV12)
+		item = generator() & 0xFF;
+	uint8_t* Y = &NV12[0];
+	uint8_t* UV = &NV12[width * height];
+	ThreadPool pool(4);
+
+	std::vector<uint8_t> serial(width * height * 3), parallel(width * height * 3);
+	NV12ToRGB24CPU(Y, UV, &serial[0], width, height, width, width * 3, coefficientsBT601);
+	NV12ToRGB24CPU(Y, UV, &parallel[0], width, height, width, width * 3, coefficientsBT601, &pool);
+	EXPECT_EQ(parallel, serial);
+
+	const int dstWidth = 1280;
+	const int dstHeight = 721;
+	float xRatio = ((float)(width - 1)) / dstWidth;
+	float yRatio = ((float)(height - 1)) / dstHeight;
+	std::vector<uint8_t> serialY(dstWidth * dstHeight), serialUV(dstWidth * (dstHeight / 2));
+	std::vector<uint8_t> parallelY(dstWidth * dstHeight), parallelUV(dstWidth * (dstHeight / 2));
+	resizeNV12NearestCPU(Y, UV, &serialY[0], &serialUV[0], width, height, width, width, dstWidth, dstHeight, xRatio, yRatio);
+	resizeNV12NearestCPU(Y, UV, &parallelY[0], &parallelUV[0], width, height, width, width, dstWidth, dstHeight, xRatio, yRatio, &pool);
+	EXPECT_EQ(parallelY, serialY);
+	EXPECT_EQ(parallelUV, serialUV);
+	resizeNV12BilinearCPU(Y, UV, &serialY[0], &serialUV[0], width, height, width, width, dstWidth, dstHeight, xRatio, yRatio);
+	resizeNV12BilinearCPU(Y, UV, &parallelY[0], &parallelUV[0], width, height, width, width, dstWidth, dstHeight, xRatio, yRatio, &pool);
+	EXPECT_EQ(parallelY, serialY);
+	EXPECT_EQ(parallelUV, serialUV);
+}
+
+class KernelsCPU_Pipeline : public ::testing::Test {
+public:
+	const int width = 642;
+	const int height = 362;
+	std::vector<uint8_t> NV12;
+	uint8_t* Y;
+	uint8_t* UV;
+	VPPPipeline pipeline;
+protected:
+	void SetUp()
+	{
+		std::mt19937 generator;
+		NV12.resize(width * height * 3 / 2);
+		for (auto& item : NV12)
+			item = generator() & 0xFF;
+		Y = &NV12[0];
+		UV = &NV12[width * height];
+		pipeline.cropX = 0;
+		pipeline.cropY = 0;
+		pipeline.cropWidth = width;
+		pipeline.cropHeight = height;
+		pipeline.dstWidth = pipeline.outputWidth = width;
+		pipeline.dstHeight = pipeline.outputHeight = height;
+		pipeline.channels = 3;
+		pipeline.indexR = 0;
+		pipeline.indexB = 2;
+		pipeline.coefficients = coefficientsBT601;
+		pipeline.type = PIXEL_UINT8;
+		pipeline.layout = LAYOUT_HWC;
+		pipeline.kernel = FILTER_NEAREST;
+		pipeline.imageX = pipeline.imageY = 0;
+		for (int c = 0; c < 3; c++) {
+			pipeline.scale[c] = 1;
+			pipeline.offset[c] = 0;
+			pipeline.padValue[c] = 0;
+		}
+	}
+};
+
+//Fused pass gives the same output as resize to intermediate frame with following conversion
+TEST_F(KernelsCPU_Pipeline, SameAsTwoPasses) {
+	ThreadPool pool(4);
+	for (auto size : { std::make_pair(320, 180), std::make_pair(1280, 720), std::make_pair(width, height) }) {
+		int dstWidth = size.first;
+		int dstHeight = size.second;
+		std::vector<uint8_t> expected(dstWidth * dstHeight * 3);
+		if (dstWidth == width && dstHeight == height) {
+			NV12ToRGB24CPU(Y, UV, &expected[0], width, height, width, width * 3, coefficientsBT601);
+		}
+		else {
+			std::vector<uint8_t> resizedY(dstWidth * dstHeight), resizedUV(dstWidth * dstHeight / 2);
+			float xRatio = ((float)(width - 1)) / dstWidth;
+			float yRatio = ((float)(height - 1)) / dstHeight;
+			resizeNV12NearestCPU(Y, UV, &resizedY[0], &resizedUV[0], width, height, width, width, dstWidth, dstHeight, xRatio, yRatio);
+			NV12ToRGB24CPU(&resizedY[0], &resizedUV[0], &expected[0], dstWidth, dstHeight, dstWidth, dstWidth * 3, coefficientsBT601);
+		}
+		pipeline.dstWidth = pipeline.outputWidth = dstWidth;
+		pipeline.dstHeight = pipeline.outputHeight = dstHeight;
+		pipeline.initTables();
+		std::vector<uint8_t> actual(pipeline.getOutputSize());
+		processPipelineCPU(Y, UV, width, width, width, &actual[0], pipeline, &pool);
+		EXPECT_EQ(actual, expected) << dstWidth << "x" << dstHeight;
+	}
+}
+
+TEST_F(KernelsCPU_Pipeline, Crop) {
+	pipeline.cropX = 100;
+	pipeline.cropY = 50;
+	pipeline.cropWidth = pipeline.dstWidth = pipeline.outputWidth = 200;
+	pipeline.cropHeight = pipeline.dstHeight = pipeline.outputHeight = 100;
+	pipeline.indexR = 2;
+	pipeline.indexB = 0;
+	pipeline.initTables();
+	std::vector<uint8_t> actual(pipeline.getOutputSize()), expected(pipeline.getOutputSize());
+	processPipelineCPU(Y, UV, width, width, width, &actual[0], pipeline);
+	NV12ToBGR24CPU(Y + 50 * width + 100, UV + 25 * width + 100, &expected[0], 200, 100, width, 200 * 3, coefficientsBT601);
+	EXPECT_EQ(actual, expected);
+}
+
+TEST_F(KernelsCPU_Pipeline, NormalizedPlanar) {
+	const float mean[] = { 0.485f, 0.456f, 0.406f };
+	const float std[] = { 0.229f, 0.224f, 0.225f };
+	for (int c = 0; c < 3; c++) {
+		pipeline.scale[c] = 1.f / (255 * std[c]);
+		pipeline.offset[c] = -mean[c] / std[c];
+	}
+	pipeline.dstWidth = pipeline.outputWidth = 301;
+	pipeline.dstHeight = pipeline.outputHeight = 171;
+	pipeline.type = PIXEL_FLOAT32;
+	pipeline.layout = LAYOUT_CHW;
+	pipeline.initTables();
+	std::vector<float> actual(pipeline.getOutputSize() / sizeof(float));
+	processPipelineCPU(Y, UV, width, width, width, &actual[0], pipeline);
+
+	//the same pipeline with 8 bit packed output
+	pipeline.type = PIXEL_UINT8;
+	pipeline.layout = LAYOUT_HWC;
+	pipeline.initTables();
+	std::vector<uint8_t> packed(pipeline.getOutputSize());
+	processPipelineCPU(Y, UV, width, width, width, &packed[0], pipeline);
+	int plane = pipeline.dstWidth * pipeline.dstHeight;
+	for (int c = 0; c < 3; c++) {
+		for (int pixel = 0; pixel < plane; pixel++)
+			ASSERT_NEAR(actual[c * plane + pixel], (packed[pixel * 3 + c] / 255.f - mean[c]) / std[c], 1e-4) << "channel " << c << " pixel " << pixel;
+	}
+}
+
+//Half precision output is rounded from the same normalized values as float one, padding is filled with zeros
+TEST_F(KernelsCPU_Pipeline, HalfPadded) {
+	pipeline.dstWidth = 301;
+	pipeline.dstHeight = 171;
+	pipeline.outputWidth = 320;
+	pipeline.outputHeight = 192;
+	for (int c = 0; c < 3; c++) {
+		pipeline.scale[c] = 1.f / 255;
+		pipeline.offset[c] = -0.5f;
+	}
+	pipeline.type = PIXEL_FLOAT32;
+	pipeline.layout = LAYOUT_CHW;
+	pipeline.initTables();
+	std::vector<float> single(pipeline.getOutputSize() / sizeof(float));
+	processPipelineCPU(Y, UV, width, width, width, &single[0], pipeline);
+	pipeline.type = PIXEL_FLOAT16;
+	pipeline.initTables();
+	//garbage in output buffer shouldn't be visible in padding
+	std::vector<uint16_t> half(pipeline.getOutputSize() / sizeof(uint16_t), 0xFFFF);
+	processPipelineCPU(Y, UV, width, width, width, &half[0], pipeline);
+	int plane = pipeline.outputWidth * pipeline.outputHeight;
+	for (int c = 0; c < 3; c++) {
+		for (int i = 0; i < pipeline.outputHeight; i++) {
+			for (int j = 0; j < pipeline.outputWidth; j++) {
+				int index = c * plane + i * pipeline.outputWidth + j;
+				if (i < pipeline.dstHeight && j < pipeline.dstWidth)
+					ASSERT_EQ(half[index], floatToHalf(single[index]));
+				else
+					ASSERT_EQ(half[index], 0) << i << " " << j;
+			}
+		}
+	}
+	//packed layout with padding
+	pipeline.type = PIXEL_UINT8;
+	pipeline.layout = LAYOUT_HWC;
+	pipeline.initTables();
+	std::vector<uint8_t> packed(pipeline.getOutputSize(), 0xFF);
+	processPipelineCPU(Y, UV, width, width, width, &packed[0], pipeline);
+	EXPECT_EQ(packed[(pipeline.outputWidth * 10 + pipeline.dstWidth) * 3], 0);
+	EXPECT_EQ(packed.back(), 0);
+}
+
+//Crop is placed inside of letterbox, only the image area is taken from source and borders have pad value
+TEST_F(KernelsCPU_Pipeline, Letterbox) {
+	const float pad[] = { 114, 50, 200 };
+	pipeline.cropX = 100;
+	pipeline.cropY = 50;
+	pipeline.cropWidth = pipeline.dstWidth = 200;
+	pipeline.cropHeight = pipeline.dstHeight = 100;
+	pipeline.outputWidth = 210;
+	pipeline.outputHeight = 130;
+	pipeline.imageX = 4;
+	pipeline.imageY = 15;
+	for (int c = 0; c < 3; c++)
+		pipeline.padValue[c] = pad[c];
+	pipeline.initTables();
+	std::vector<uint8_t> expected(200 * 100 * 3);
+	NV12ToRGB24CPU(Y + 50 * width + 100, UV + 25 * width + 100, &expected[0], 200, 100, width, 200 * 3, coefficientsBT601);
+	ThreadPool pool(4);
+	for (PixelLayout layout : { LAYOUT_HWC, LAYOUT_CHW }) {
+		pipeline.layout = layout;
+		std::vector<uint8_t> actual(pipeline.getOutputSize());
+		processPipelineCPU(Y, UV, width, width, width, &actual[0], pipeline, &pool);
+		int plane = pipeline.outputWidth * pipeline.outputHeight;
+		for (int i = 0; i < pipeline.outputHeight; i++) {
+			for (int j = 0; j < pipeline.outputWidth; j++) {
+				for (int c = 0; c < 3; c++) {
+					int index = layout == LAYOUT_CHW ? c * plane + i * pipeline.outputWidth + j : (i * pipeline.outputWidth + j) * 3 + c;
+					int r = i - pipeline.imageY, k = j - pipeline.imageX;
+					if (r >= 0 && r < pipeline.dstHeight && k >= 0 && k < pipeline.dstWidth)
+						ASSERT_EQ(actual[index], expected[(r * pipeline.dstWidth + k) * 3 + c]) << i << " " << j;
+					else
+						ASSERT_EQ(actual[index], pad[c]) << i << " " << j;
+				}
+			}
+		}
+	}
+	//the same placement for filtered resize, filter reads only crop
+	std::fill(Y + 50 * width, Y + 150 * width, 180);
+	std::fill(UV + 25 * width, UV + 75 * width, 90);
+	pipeline.kernel = FILTER_BICUBIC;
+	pipeline.dstWidth = 160;
+	pipeline.dstHeight = 80;
+	pipeline.initTables();
+	std::vector<uint8_t> pixel(3);
+	NV12ToRGB24CPU(Y + 50 * width, UV + 25 * width, &pixel[0], 1, 1, width, 3, coefficientsBT601);
+	std::vector<uint8_t> actual(pipeline.getOutputSize());
+	processPipelineCPU(Y, UV, width, width, width, &actual[0], pipeline, &pool);
+	for (int c = 0; c < 3; c++) {
+		int plane = pipeline.outputWidth * pipeline.outputHeight;
+		EXPECT_EQ(actual[c * plane], pad[c]);
+		EXPECT_EQ(actual[c * plane + 15 * pipeline.outputWidth + 4], pixel[c]);
+		EXPECT_EQ(actual[c * plane + 94 * pipeline.outputWidth + 163], pixel[c]);
+		EXPECT_EQ(actual[c * plane + 95 * pipeline.outputWidth + 163], pad[c]);
+		EXPECT_EQ(actual[c * plane + 94 * pipeline.outputWidth + 164], pad[c]);
+	}
+}
+
+//Sum of weights is one and taps never leave source
+TEST(KernelsCPU_Filter, Tables) {
+	for (FilterKernel kernel : { FILTER_BILINEAR, FILTER_AREA, FILTER_BICUBIC }) {
+		for (int srcSize : { 1, 2, 5, 416, 1080, 3840 }) {
+			for (int dstSize : { 1, 3, 416, 608, 2160 }) {
+				FilterTable table;
+				table.init(kernel, srcSize, dstSize);
+				ASSERT_EQ(table.index.size(), dstSize);
+				for (int j = 0; j < dstSize; j++) {
+					EXPECT_GE(table.index[j], 0);
+					EXPECT_LE(table.index[j] + table.taps, srcSize);
+					int sum = 0;
+					for (int t = 0; t < table.taps; t++)
+						sum += table.weights[j * table.taps + t];
+					EXPECT_EQ(sum, filterOne) << "kernel " << kernel << " " << srcSize << "->" << dstSize;
+				}
+			}
+		}
+	}
+	//tables are built once for the same geometry
+	EXPECT_EQ(getResizeFilter(FILTER_AREA, 3840, 2160, 416, 416), getResizeFilter(FILTER_AREA, 3840, 2160, 416, 416));
+	EXPECT_NE(getResizeFilter(FILTER_AREA, 3840, 2160, 416, 416), getResizeFilter(FILTER_BICUBIC, 3840, 2160, 416, 416));
+}
+
+//Area downscale by 2 is rounded average of 2x2 block
+TEST_F(KernelsCPU_Pipeline, AreaHalf) {
+	pipeline.channels = 1;
+	pipeline.kernel = FILTER_AREA;
+	pipeline.dstWidth = pipeline.outputWidth = width / 2;
+	pipeline.dstHeight = pipeline.outputHeight = height / 2;
+	pipeline.initTables();
+	ASSERT_NE(pipeline.filter, nullptr);
+	std::vector<uint8_t> actual(pipeline.getOutputSize());
+	ThreadPool pool(4);
+	processPipelineCPU(Y, UV, width, width, width, &actual[0], pipeline, &pool);
+	for (int i = 0; i < height / 2; i++) {
+		for (int j = 0; j < width / 2; j++) {
+			const uint8_t* block = Y + 2 * i * width + 2 * j;
+			int expected = (block[0] + block[1] + block[width] + block[width + 1] + 2) / 4;
+			ASSERT_EQ(actual[i * width / 2 + j], expected) << i << " " << j;
+		}
+	}
+}
+
+//Filters keep flat areas and serial and parallel results are the same
+TEST_F(KernelsCPU_Pipeline, Filters) {
+	std::fill(Y, Y + width * height, 180);
+	std::fill(UV, UV + width * height / 2, 90);
+	for (FilterKernel kernel : { FILTER_BILINEAR, FILTER_AREA, FILTER_BICUBIC }) {
+		for (int size : { 123, 1001 }) {
+			pipeline.kernel = kernel;
+			pipeline.cropX = 10;
+			pipeline.cropY = 6;
+			pipeline.cropWidth = 600;
+			pipeline.cropHeight = 300;
+			pipeline.dstWidth = pipeline.outputWidth = size;
+			pipeline.dstHeight = pipeline.outputHeight = size / 2 + 1;
+			pipeline.initTables();
+			std::vector<uint8_t> serial(pipeline.getOutputSize()), parallel(pipeline.getOutputSize());
+			processPipelineCPU(Y, UV, width, width, width, &serial[0], pipeline);
+			ThreadPool pool(4);
+			processPipelineCPU(Y, UV, width, width, width, &parallel[0], pipeline, &pool);
+			EXPECT_EQ(serial, parallel);
+			std::vector<uint8_t> pixel(3);
+			NV12ToRGB24CPU(Y, UV, &pixel[0], 1, 1, width, 3, coefficientsBT601);
+			for (int p = 0; p < (int)serial.size(); p += 3)
+				ASSERT_EQ(std::vector<uint8_t>(serial.begin() + p, serial.begin() + p + 3), pixel) << "kernel " << kernel << " pixel " << p / 3;
+		}
+	}
+}
+
+//Pyramid level with 2x downscale is rounded average of 2x2 block for every type and layout
+TEST(KernelsCPU_Pyramid, DownscaleArea) {
+	const int width = 37, height = 20, channels = 3;
+	std::mt19937 generator;
+	std::vector<uint8_t> packed(width * height * channels);
+	for (auto& item : packed)
+		item = generator() & 0xFF;
+	ThreadPool pool(4);
+	std::vector<uint8_t> level(18 * 10 * channels);
+	downscaleAreaCPU(&packed[0], width, height, &level[0], 18, 10, channels, 1, false, &pool);
+	std::vector<float> planar(width * height * channels), planarLevel(18 * 10 * channels);
+	for (int i = 0; i < height; i++)
+		for (int j = 0; j < width; j++)
+			for (int c = 0; c < channels; c++)
+				planar[c * width * height + i * width + j] = packed[(i * width + j) * channels + c] / 255.f;
+	downscaleAreaCPU(&planar[0], width, height, &planarLevel[0], 18, 10, channels, 4, true);
+	std::vector<uint16_t> half(planar.size()), halfLevel(planarLevel.size());
+	for (int i = 0; i < (int)half.size(); i++)
+		half[i] = floatToHalf(planar[i]);
+	downscaleAreaCPU(&half[0], width, height, &halfLevel[0], 18, 10, channels, 2, true);
+	for (int i = 0; i < 10; i++) {
+		for (int j = 0; j < 18; j++) {
+			for (int c = 0; c < channels; c++) {
+				//the last source column isn't covered, 37 / 18 is a bit more than 2
+				float scaleX = (float)width / 18;
+				int x = (int)(j * scaleX);
+				const uint8_t* block = &packed[(2 * i * width + x) * channels + c];
+				int sum = block[0] + block[channels] + block[width * channels] + block[(width + 1) * channels];
+				if (j * scaleX == x && (j + 1) * scaleX == x + 2)
+					ASSERT_EQ(level[(i * 18 + j) * channels + c], (sum + 2) / 4) << i << " " << j;
+				float value = planarLevel[c * 180 + i * 18 + j];
+				EXPECT_NEAR(value, level[(i * 18 + j) * channels + c] / 255.f, 0.5f / 255 + 1e-6) << i << " " << j;
+				EXPECT_NEAR(halfToFloat(halfLevel[c * 180 + i * 18 + j]), value, 2e-3) << i << " " << j;
+			}
+		}
+	}
+}
+
+TEST(KernelsCPU_Half, ToFloat) {
+	//every half value except NaN is converted back to the same bits
+	for (int bits = 0; bits < 0x10000; bits++) {
+		float value = halfToFloat((uint16_t)bits);
+		if (value != value)
+			EXPECT_EQ(bits & 0x7C00, 0x7C00);
+		else
+			ASSERT_EQ(floatToHalf(value), bits) << bits;
+	}
+	EXPECT_EQ(halfToFloat(0x3C00), 1.f);
+	EXPECT_EQ(halfToFloat(0x0001), 5.9604645e-8f);
+}
+
+TEST(KernelsCPU_Half, KnownValues) {
+	EXPECT_EQ(floatToHalf(0.f), 0x0000);
+	EXPECT_EQ(floatToHalf(-0.f), 0x8000);
+	EXPECT_EQ(floatToHalf(1.f), 0x3C00);
+	EXPECT_EQ(floatToHalf(-2.f), 0xC000);
+	EXPECT_EQ(floatToHalf(0.1f), 0x2E66);
+	EXPECT_EQ(floatToHalf(65504.f), 0x7BFF);
+	EXPECT_EQ(floatToHalf(65520.f), 0x7C00);
+	//the smallest subnormal and halfway to it
+	EXPECT_EQ(floatToHalf(5.9604645e-8f), 0x0001);
+	EXPECT_EQ(floatToHalf(2.9802322e-8f), 0x0000);
+	//1 + 2^-11 is halfway between 1 and the next half, rounded to even
+	EXPECT_EQ(floatToHalf(1.00048828125f), 0x3C00);
+	EXPECT_EQ(floatToHalf(1.00146484375f), 0x3C02);
+}
@@ -65,6 +65,323 @@ TEST(Parser_ReadGet, BitstreamEnd) {
 	EXPECT_EQ(parser.Read(), AVERROR_EOF);
 }
 
+TEST(Parser_Synthetic, Init) {
+	Parser parser;
+	ParserParameters parserArgs = { "synthetic://640x360?fps=30000/1001&gop=10&bframes=2&slices=3&complexity=0.5&frames=25" };
+	ASSERT_EQ(parser.Init(parserArgs), VREADER_OK);
+	EXPECT_EQ(parser.getWidth(), 640);
+	EXPECT_EQ(parser.getHeight(), 360);
+	auto codec = parser.getFormatContext()->streams[parser.getVideoIndex()]->codec;
+	EXPECT_EQ(codec->framerate.num, 30000);
+	EXPECT_EQ(codec->framerate.den, 1001);
+	AVPacket parsed;
+	//every frame is consistent for analyzer, stream ends after the last frame
+	for (int i = 0; i < 25; i++) {
+		ASSERT_EQ(parser.Read(), VREADER_OK);
+		ASSERT_EQ(parser.Get(&parsed), VREADER_OK);
+		EXPECT_EQ(parser.Analyze(&parsed), 0);
+	}
+	EXPECT_EQ(parser.Read(), AVERROR_EOF);
+	parser.Close();
+	parserArgs = { "synthetic://640x360?unknown=1" };
+	EXPECT_NE(parser.Init(parserArgs), VREADER_OK);
+}
+
+TEST(Parser_Synthetic, LowLatency) {
+	Parser parser;
+	ParserParameters parserArgs = { "synthetic://320x240?gop=10&frames=30" };
+	parserArgs.lowLatency = true;
+	parserArgs.rtspTransport = "";
+	ASSERT_EQ(parser.Init(parserArgs), VREADER_OK);
+	EXPECT_EQ(parser.getWidth(), 320);
+	EXPECT_EQ(parser.getFormatContext()->probesize, lowLatencyProbeSize);
+	EXPECT_TRUE(parser.getFormatContext()->flags & AVFMT_FLAG_NOBUFFER);
+	AVPacket parsed;
+	//packets read while stream was probed are dropped
+	int frames = 0;
+	while (parser.Read() == VREADER_OK) {
+		ASSERT_EQ(parser.Get(&parsed), VREADER_OK);
+		av_packet_unref(&parsed);
+		frames++;
+	}
+	EXPECT_GT(frames, 0);
+	EXPECT_LT(frames, 30);
+}
+
+TEST(Parser_Startup, Probing) {
+	Parser parser;
+	ParserParameters parserArgs = { "synthetic://320x240?gop=10&frames=30" };
+	parserArgs.probeSize = 65536;
+	parserArgs.analyzeDuration = 200000;
+	ASSERT_EQ(parser.Init(parserArgs), VREADER_OK);
+	EXPECT_EQ(parser.getFormatContext()->probesize, 65536);
+	EXPECT_EQ(parser.getFormatContext()->max_analyze_duration, 200000);
+	EXPECT_EQ(parser.getWidth(), 320);
+	ParserStartup startup = parser.getStartup();
+	EXPECT_GT(startup.open + startup.probe, 0);
+	EXPECT_FALSE(startup.cached);
+}
+
+TEST(Parser_Startup, CachedParameters) {
+	Parser::ClearParametersCache();
+	std::string input = "synthetic://320x240?fps=25&gop=10&frames=30";
+	//the first open probes stream and fills cache, the next ones take parameters from it
+	for (int i = 0; i < 3; i++) {
+		Parser parser;
+		ParserParameters parserArgs = { input };
+		parserArgs.cacheParameters = true;
+		ASSERT_EQ(parser.Init(parserArgs), VREADER_OK);
+		EXPECT_EQ(parser.getStartup().cached, i > 0);
+		EXPECT_EQ(parser.getWidth(), 320);
+		EXPECT_EQ(parser.getHeight(), 240);
+		AVStream* stream = parser.getStreamHandle();
+		EXPECT_EQ(stream->r_frame_rate.num / stream->r_frame_rate.den, 25);
+		AVPacket parsed;
+		int frames = 0;
+		while (parser.Read() == VREADER_OK) {
+			ASSERT_EQ(parser.Get(&parsed), VREADER_OK);
+			EXPECT_EQ(parser.Analyze(&parsed), VREADER_OK);
+			av_packet_unref(&parsed);
+			frames++;
+		}
+		EXPECT_EQ(frames, 30);
+	}
+	//cache is used only if it's enabled and isn't cleared
+	Parser parser;
+	ParserParameters parserArgs = { input };
+	ASSERT_EQ(parser.Init(parserArgs), VREADER_OK);
+	EXPECT_FALSE(parser.getStartup().cached);
+	parser.Close();
+	Parser::ClearParametersCache();
+	parserArgs.cacheParameters = true;
+	ASSERT_EQ(parser.Init(parserArgs), VREADER_OK);
+	EXPECT_FALSE(parser.getStartup().cached);
+}
+
+TEST(Parser_Synthetic, Stream) {
+	SyntheticParameters parameters;
+	EXPECT_EQ(SyntheticStream::ParseURL("synthetic://100x62?fps=50&gop=7&bframes=1&frames=20&seed=3", parameters), VREADER_OK);
+	EXPECT_EQ(parameters.width, 100);
+	EXPECT_EQ(parameters.height, 62);
+	EXPECT_EQ(parameters.frameRateNum, 50);
+	EXPECT_EQ(parameters.idrInterval, 7);
+	EXPECT_EQ(parameters.bFrames, 1);
+	SyntheticStream first, second;
+	ASSERT_EQ(first.Init(parameters), VREADER_OK);
+	ASSERT_EQ(second.Init(parameters), VREADER_OK);
+	//stream is deterministic and doesn't depend on read sizes
+	std::vector<uint8_t> whole, parts(1 << 20);
+	while (first.Next(whole) == VREADER_OK);
+	EXPECT_EQ(first.getFramesProduced(), 20);
+	int size = 0, read;
+	while ((read = second.Read(&parts[size], 1000)) > 0)
+		size += read;
+	ASSERT_EQ(size, whole.size());
+	EXPECT_EQ(memcmp(&parts[0], &whole[0], size), 0);
+	//Annex B stream starts with SPS
+	EXPECT_EQ(whole[4] & 0x1F, 7);
+	//frames aren't written for endless stream
+	parameters.frames = 0;
+	ASSERT_EQ(first.Init(parameters), VREADER_OK);
+	EXPECT_EQ(first.Write("synthetic.h264"), VREADER_UNSUPPORTED);
+	parameters.width = 101;
+	EXPECT_NE(first.Init(parameters), VREADER_OK);
+}
+
+TEST(Parser_Capture, RecordReplay) {
+	Parser parser;
+	ParserParameters parserArgs = { "../resources/parser_444/bbb_1080x608_10.h264" };
+	ASSERT_EQ(parser.Init(parserArgs), VREADER_OK);
+	ASSERT_EQ(parser.EnableCapture("record.tscap"), VREADER_OK);
+	std::vector<std::string> packets;
+	AVPacket parsed;
+	for (int i = 0; i < 10; i++) {
+		ASSERT_EQ(parser.Read(), VREADER_OK);
+		ASSERT_EQ(parser.Get(&parsed), VREADER_OK);
+		packets.push_back(std::string((char*)parsed.data, parsed.size));
+		av_packet_unref(&parsed);
+	}
+	parser.Close();
+	//the same packets are replayed and stream ends after the last one
+	parserArgs = { "replay://record.tscap?speed=0" };
+	ASSERT_EQ(parser.Init(parserArgs), VREADER_OK);
+	EXPECT_TRUE(parser.isReplay());
+	EXPECT_EQ(parser.getWidth(), 1080);
+	EXPECT_EQ(parser.getHeight(), 608);
+	for (int i = 0; i < 10; i++) {
+		ASSERT_EQ(parser.Read(), VREADER_OK);
+		ASSERT_EQ(parser.Get(&parsed), VREADER_OK);
+		ASSERT_EQ(parsed.size, packets[i].size());
+		EXPECT_EQ(memcmp(parsed.data, packets[i].c_str(), parsed.size), 0);
+		EXPECT_EQ(parser.Analyze(&parsed), 0);
+		av_packet_unref(&parsed);
+	}
+	EXPECT_EQ(parser.Read(), AVERROR_EOF);
+	parser.Close();
+	parserArgs = { "replay://wrong_path.tscap" };
+	EXPECT_NE(parser.Init(parserArgs), VREADER_OK);
+}
+
+TEST(Parser_Capture, Timing) {
+	Parser parser;
+	ParserParameters parserArgs = { "synthetic://320x240?fps=25&frames=5" };
+	ASSERT_EQ(parser.Init(parserArgs), VREADER_OK);
+	CaptureWriter writer;
+	ASSERT_EQ(writer.Open("timing.tscap", parser.getFormatContext()->streams[parser.getVideoIndex()]), VREADER_OK);
+	AVPacket parsed;
+	//packets arrive every 40 ms
+	for (int i = 0; i < 5; i++) {
+		ASSERT_EQ(parser.Read(), VREADER_OK);
+		ASSERT_EQ(parser.Get(&parsed), VREADER_OK);
+		ASSERT_EQ(writer.Write(&parsed, 1000000000LL + i * 40000000LL), VREADER_OK);
+		av_packet_unref(&parsed);
+	}
+	writer.Close();
+	parser.Close();
+	EXPECT_EQ(writer.getPacketsWritten(), 5);
+
+	CaptureReader reader;
+	ASSERT_EQ(reader.Open("timing.tscap"), VREADER_OK);
+	EXPECT_EQ(reader.getHeader().frameRateNum, 25);
+	size_t offset = reader.getFirstRecord();
+	PacketRecord record;
+	const uint8_t* data;
+	for (int i = 0; i < 5; i++) {
+		ASSERT_EQ(reader.Next(offset, record, data), VREADER_OK);
+		EXPECT_EQ(record.arrival, i * 40000000LL);
+	}
+	EXPECT_EQ(reader.Next(offset, record, data), VREADER_REPEAT);
+	reader.Close();
+
+	//160 ms of capture are replayed twice faster
+	parserArgs = { "replay://timing.tscap?speed=2" };
+	ASSERT_EQ(parser.Init(parserArgs), VREADER_OK);
+	ASSERT_EQ(parser.Read(), VREADER_OK);
+	auto start = std::chrono::steady_clock::now();
+	for (int i = 1; i < 5; i++)
+		ASSERT_EQ(parser.Read(), VREADER_OK);
+	int64_t elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+	EXPECT_GE(elapsed, 75);
+	EXPECT_LT(elapsed, 400);
+	EXPECT_EQ(parser.Read(), AVERROR_EOF);
+	std::string fileName;
+	float speed;
+	EXPECT_EQ(CaptureReader::ParseURL("replay://dir/file.tscap?speed=0.5", fileName, speed), VREADER_OK);
+	EXPECT_EQ(fileName, "dir/file.tscap");
+	EXPECT_FLOAT_EQ(speed, 0.5f);
+	EXPECT_NE(CaptureReader::ParseURL("replay://file.tscap?rate=2", fileName, speed), VREADER_OK);
+}
+
+TEST(Parser_Timestamps, CaptureSEI) {
+	Parser parser;
+	ParserParameters parserArgs = { "synthetic://320x240?bframes=2&frames=5&timestamps=1" };
+	int64_t start = wallClock();
+	ASSERT_EQ(parser.Init(parserArgs), VREADER_OK);
+	AVPacket parsed;
+	//every frame carries time it was produced, so it's taken before packet arrived
+	for (int i = 0; i < 5; i++) {
+		ASSERT_EQ(parser.Read(), VREADER_OK);
+		ASSERT_EQ(parser.Get(&parsed), VREADER_OK);
+		EXPECT_EQ(parser.Analyze(&parsed), 0);
+		FrameTimestamps timestamps = parser.getTimestamps();
+		EXPECT_GE(timestamps.capture, start);
+		EXPECT_LE(timestamps.capture, timestamps.arrival);
+		EXPECT_LE(timestamps.arrival, wallClock());
+		av_packet_unref(&parsed);
+	}
+	parser.Close();
+	//no SEI, capture time is unknown
+	parserArgs = { "synthetic://320x240?frames=1" };
+	ASSERT_EQ(parser.Init(parserArgs), VREADER_OK);
+	ASSERT_EQ(parser.Read(), VREADER_OK);
+	ASSERT_EQ(parser.Get(&parsed), VREADER_OK);
+	EXPECT_EQ(parser.Analyze(&parsed), 0);
+	EXPECT_EQ(parser.getTimestamps().capture, 0);
+	EXPECT_GT(parser.getTimestamps().arrival, 0);
+	av_packet_unref(&parsed);
+}
+
+TEST(Parser_Timestamps, PictureTiming) {
+	Parser parser;
+	ParserParameters parserArgs = { "synthetic://320x240?frames=1" };
+	ASSERT_EQ(parser.Init(parserArgs), VREADER_OK);
+	//High profile SPS with scaling list, VUI with 50 ticks per second, NAL HRD and pic_struct_present_flag
+	BitWriter writer;
+	std::vector<uint8_t> stream;
+	writer.PutBits(100, 8);
+	writer.PutBits(30, 16);
+	writer.PutGolomb(0);
+	writer.PutGolomb(1);
+	writer.PutGolomb(0);
+	writer.PutGolomb(0);
+	writer.PutBits(0, 1);
+	writer.PutBits(1, 1);
+	for (int i = 0; i < 8; i++) {
+		writer.PutBits(i == 0, 1);
+		for (int j = 0; j < 16 && i == 0; j++)
+			writer.PutSignedGolomb(j == 0 ? 3 : 1);
+	}
+	writer.PutGolomb(0);
+	writer.PutGolomb(0);
+	writer.PutGolomb(0);
+	writer.PutGolomb(1);
+	writer.PutBits(0, 1);
+	writer.PutGolomb(19);
+	writer.PutGolomb(14);
+	writer.PutBits(0xD, 4);
+	writer.PutBits(1, 1);
+	writer.PutBits(255, 8);
+	writer.PutBits(0x10001, 32);
+	writer.PutBits(0, 3);
+	writer.PutBits(1, 1);
+	writer.PutBits(1, 32);
+	writer.PutBits(50, 32);
+	writer.PutBits(1, 1);
+	writer.PutBits(1, 1);
+	writer.PutGolomb(0);
+	writer.PutBits(0, 8);
+	writer.PutGolomb(100);
+	writer.PutGolomb(100);
+	writer.PutBits(0, 1);
+	//delays are 10 and 7 bits, no time offset
+	writer.PutBits(23, 5);
+	writer.PutBits(9, 5);
+	writer.PutBits(6, 5);
+	writer.PutBits(0, 5);
+	writer.PutBits(0, 2);
+	writer.PutBits(1, 1);
+	writer.PutBits(0, 1);
+	writer.PutTrailingBits();
+	writer.WriteNAL(3, 7, stream);
+	//pic_timing with full clock timestamp 12:15:30 and 10 frames
+	writer.PutBits(1, 8);
+	writer.PutBits(7, 8);
+	writer.PutBits(5, 10);
+	writer.PutBits(2, 7);
+	writer.PutBits(0, 4);
+	writer.PutBits(1, 1);
+	writer.PutBits(0, 8);
+	writer.PutBits(1, 1);
+	writer.PutBits(0, 2);
+	writer.PutBits(10, 8);
+	writer.PutBits(30, 6);
+	writer.PutBits(15, 6);
+	writer.PutBits(12, 5);
+	writer.PutBits(1, 1);
+	writer.Align();
+	writer.PutTrailingBits();
+	writer.WriteNAL(0, 6, stream);
+	AVPacket packet = {};
+	packet.data = stream.data();
+	packet.size = (int)stream.size();
+	//there is no slice in packet
+	EXPECT_EQ(parser.Analyze(&packet), VREADER_REPEAT);
+	const int64_t day = 86400000000LL;
+	int64_t capture = parser.getTimestamps().capture;
+	EXPECT_EQ(capture % day, ((12 * 60 + 15) * 60 + 30) * 1000000LL + 200000);
+	EXPECT_LE(std::abs(capture - wallClock()), day / 2);
+}
+
 //to convert functions bits are sent as they stored in memory, so 
 //vector with bits filled by push_back, so indexes are inverted: 0, 1, 0, 1 = 10 not 5
 //because 2^0 * 0 + 2^1 * 1 + 2^2 * 0 + 2^3 * 1
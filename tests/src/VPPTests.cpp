@@ -2,6 +2,13 @@
 #include "VideoProcessor.h"
 #include "Parser.h"
 #include "Decoder.h"
+#include "MetricsServer.h"
+#ifndef _WIN32
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#endif
 extern "C" {
 	#include "libavutil/crc.h"
 }
@@ -41,6 +48,32 @@ protected:
 		EXPECT_EQ(sts, VREADER_OK);
 		EXPECT_NE(result, VREADER_REPEAT);
 	}
+
+	//CRC of the same conversion done by CPU backend, should be called before CUDA Convert because it unreference output
+	uint32_t referenceCRC(VPPParameters VPPArgs) {
+		int width = output->width;
+		int height = output->height;
+		std::vector<uint8_t> NV12(width * height * 3 / 2);
+		EXPECT_EQ(cudaMemcpy2D(&NV12[0], width, output->data[0], output->linesize[0], width, height, cudaMemcpyDeviceToHost), CUDA_SUCCESS);
+		EXPECT_EQ(cudaMemcpy2D(&NV12[width * height], width, output->data[1], output->linesize[1], width, height / 2, cudaMemcpyDeviceToHost), CUDA_SUCCESS);
+		std::shared_ptr<AVFrame> input(av_frame_alloc(), [](AVFrame* frame) { av_frame_free(&frame); });
+		input->width = width;
+		input->height = height;
+		input->format = AV_PIX_FMT_NV12;
+		input->colorspace = output->colorspace;
+		input->color_range = output->color_range;
+		input->data[0] = &NV12[0];
+		input->data[1] = &NV12[width * height];
+		input->linesize[0] = input->linesize[1] = width;
+
+		VideoProcessor VPP;
+		EXPECT_EQ(VPP.Init(false, CPU_BACKEND), VREADER_OK);
+		std::shared_ptr<AVFrame> converted(av_frame_alloc(), [](AVFrame* frame) { av_frame_free(&frame); });
+		EXPECT_EQ(VPP.Convert(input.get(), converted.get(), VPPArgs, "reference"), VREADER_OK);
+		uint32_t crc = av_crc(av_crc_get_table(AV_CRC_32_IEEE), -1, (uint8_t*)converted->opaque, converted->width * converted->height * converted->channels);
+		VPP.Free(converted->opaque);
+		return crc;
+	}
 };
 
 TEST_F(VPP_Convert, NV12ToRGB) {
@@ -50,14 +83,18 @@ TEST_F(VPP_Convert, NV12ToRGB) {
 	int width = output->width;
 	int height = output->height;
 	VPPParameters VPPArgs = { width, height, RGB24 };
+	uint32_t CPUBackendCRC = referenceCRC(VPPArgs);
 	//Convert function unreference output variable
 	EXPECT_EQ(VPP.Convert(output.get(), converted.get(), VPPArgs, "visualize"), VREADER_OK);
 	std::vector<uint8_t> outputRGBProcessing(width * height * converted->channels);
 	EXPECT_EQ(cudaMemcpy(&outputRGBProcessing[0], converted->opaque, converted->channels * width * height * sizeof(unsigned char), cudaMemcpyDeviceToHost), CUDA_SUCCESS);
 	//CRC for RGB24 zero frame of bbb_1080x608_420_10.h264
-	//CRC32 - 2816643056
+	//CRC32 - 1182625827
 	std::string dumpFileName = "DumpFrameRGB.yuv";
-	ASSERT_EQ(av_crc(av_crc_get_table(AV_CRC_32_IEEE), -1, &outputRGBProcessing[0], width * height * converted->channels), 2816643056);
+	uint32_t outputCRC = av_crc(av_crc_get_table(AV_CRC_32_IEEE), -1, &outputRGBProcessing[0], width * height * converted->channels);
+	ASSERT_EQ(outputCRC, 1182625827);
+	//CUDA and CPU backends use the same fixed-point math
+	EXPECT_EQ(outputCRC, CPUBackendCRC);
 	{
 		std::shared_ptr<FILE> writeFile(fopen(dumpFileName.c_str(), "wb"), fclose);
 		EXPECT_EQ(VPP.DumpFrame(converted.get(), writeFile), VREADER_OK);
@@ -66,7 +103,7 @@ TEST_F(VPP_Convert, NV12ToRGB) {
 		std::shared_ptr<FILE> readFile(fopen(dumpFileName.c_str(), "rb"), fclose);
 		std::vector<uint8_t> fileRGBProcessing(width * height * converted->channels);
 		fread(&fileRGBProcessing[0], fileRGBProcessing.size(), 1, readFile.get());
-		ASSERT_EQ(av_crc(av_crc_get_table(AV_CRC_32_IEEE), -1, &fileRGBProcessing[0], width * height * converted->channels), 2816643056);
+		ASSERT_EQ(av_crc(av_crc_get_table(AV_CRC_32_IEEE), -1, &fileRGBProcessing[0], width * height * converted->channels), 1182625827);
 	}
 
 	ASSERT_EQ(remove(dumpFileName.c_str()), 0);
@@ -79,14 +116,18 @@ TEST_F(VPP_Convert, NV12ToBGR) {
 	int width = output->width;
 	int height = output->height;
 	VPPParameters VPPArgs = { width, height, BGR24 };
+	uint32_t CPUBackendCRC = referenceCRC(VPPArgs);
 	//Convert function unreference output variable
 	EXPECT_EQ(VPP.Convert(output.get(), converted.get(), VPPArgs, "visualize"), VREADER_OK);
 	std::vector<uint8_t> outputBGRProcessing(width * height * converted->channels);
 	EXPECT_EQ(cudaMemcpy(&outputBGRProcessing[0], converted->opaque, converted->channels * width * height * sizeof(unsigned char), cudaMemcpyDeviceToHost), CUDA_SUCCESS);
 	//CRC for BGR24 zero frame of bbb_1080x608_420_10.h264
-	//CRC32 - 3797413135
+	//CRC32 - 4250744657
 	std::string dumpFileName = "DumpFrameBGR.yuv";
-	ASSERT_EQ(av_crc(av_crc_get_table(AV_CRC_32_IEEE), -1, &outputBGRProcessing[0], width * height * converted->channels), 3797413135);
+	uint32_t outputCRC = av_crc(av_crc_get_table(AV_CRC_32_IEEE), -1, &outputBGRProcessing[0], width * height * converted->channels);
+	ASSERT_EQ(outputCRC, 4250744657);
+	//CUDA and CPU backends use the same fixed-point math
+	EXPECT_EQ(outputCRC, CPUBackendCRC);
 	{
 		std::shared_ptr<FILE> writeFile(fopen(dumpFileName.c_str(), "wb"), fclose);
 		EXPECT_EQ(VPP.DumpFrame(converted.get(), writeFile), VREADER_OK);
@@ -95,7 +136,7 @@ TEST_F(VPP_Convert, NV12ToBGR) {
 		std::shared_ptr<FILE> readFile(fopen(dumpFileName.c_str(), "rb"), fclose);
 		std::vector<uint8_t> fileBGRProcessing(width * height * converted->channels);
 		fread(&fileBGRProcessing[0], fileBGRProcessing.size(), 1, readFile.get());
-		ASSERT_EQ(av_crc(av_crc_get_table(AV_CRC_32_IEEE), -1, &fileBGRProcessing[0], width * height * converted->channels), 3797413135);
+		ASSERT_EQ(av_crc(av_crc_get_table(AV_CRC_32_IEEE), -1, &fileBGRProcessing[0], width * height * converted->channels), 4250744657);
 	}
 
 	ASSERT_EQ(remove(dumpFileName.c_str()), 0);
@@ -137,14 +178,18 @@ TEST_F(VPP_Convert, NV12ToRGB24Downscale) {
 	int width = output->width / 2;
 	int height = output->height / 2;
 	VPPParameters VPPArgs = { width, height, RGB24 };
+	uint32_t CPUBackendCRC = referenceCRC(VPPArgs);
 	//Convert function unreference output variable
 	EXPECT_EQ(VPP.Convert(output.get(), converted.get(), VPPArgs, "visualize"), VREADER_OK);
 	std::vector<uint8_t> outputRGBProcessing(width * height * converted->channels);
 	EXPECT_EQ(cudaMemcpy(&outputRGBProcessing[0], converted->opaque, converted->channels * width * height * sizeof(unsigned char), cudaMemcpyDeviceToHost), CUDA_SUCCESS);
 	//CRC for resized RGB24 zero frame of bbb_1080x608_420_10.h264
-	//CRC32 - 863907011
+	//CRC32 - 4078981476
 	std::string dumpFileName = "DumpFrameRGBDownscaled.yuv";
-	ASSERT_EQ(av_crc(av_crc_get_table(AV_CRC_32_IEEE), -1, &outputRGBProcessing[0], width * height * converted->channels), 863907011);
+	uint32_t outputCRC = av_crc(av_crc_get_table(AV_CRC_32_IEEE), -1, &outputRGBProcessing[0], width * height * converted->channels);
+	ASSERT_EQ(outputCRC, 4078981476);
+	//CUDA and CPU backends use the same fixed-point math
+	EXPECT_EQ(outputCRC, CPUBackendCRC);
 	{
 		std::shared_ptr<FILE> writeFile(fopen(dumpFileName.c_str(), "wb"), fclose);
 		EXPECT_EQ(VPP.DumpFrame(converted.get(), writeFile), VREADER_OK);
@@ -153,7 +198,7 @@ TEST_F(VPP_Convert, NV12ToRGB24Downscale) {
 		std::shared_ptr<FILE> readFile(fopen(dumpFileName.c_str(), "rb"), fclose);
 		std::vector<uint8_t> fileRGBProcessing(width * height * converted->channels);
 		fread(&fileRGBProcessing[0], fileRGBProcessing.size(), 1, readFile.get());
-		ASSERT_EQ(av_crc(av_crc_get_table(AV_CRC_32_IEEE), -1, &fileRGBProcessing[0], width * height * converted->channels), 863907011);
+		ASSERT_EQ(av_crc(av_crc_get_table(AV_CRC_32_IEEE), -1, &fileRGBProcessing[0], width * height * converted->channels), 4078981476);
 	}
 
 	ASSERT_EQ(remove(dumpFileName.c_str()), 0);
@@ -166,14 +211,18 @@ TEST_F(VPP_Convert, NV12ToRGB24Upscale) {
 	int width = output->width * 2;
 	int height = output->height * 2;
 	VPPParameters VPPArgs = { width, height, RGB24 };
+	uint32_t CPUBackendCRC = referenceCRC(VPPArgs);
 	//Convert function unreference output variable
 	EXPECT_EQ(VPP.Convert(output.get(), converted.get(), VPPArgs, "visualize"), VREADER_OK);
 	std::vector<uint8_t> outputRGBProcessing(width * height * converted->channels);
 	EXPECT_EQ(cudaMemcpy(&outputRGBProcessing[0], converted->opaque, converted->channels * width * height * sizeof(unsigned char), cudaMemcpyDeviceToHost), CUDA_SUCCESS);
 	//CRC for resized RGB24 zero frame of bbb_1080x608_420_10.h264
-	//CRC32 - 915070179
+	//CRC32 - 1307652822
 	std::string dumpFileName = "DumpFrameRGBUpscaled.yuv";
-	ASSERT_EQ(av_crc(av_crc_get_table(AV_CRC_32_IEEE), -1, &outputRGBProcessing[0], width * height * converted->channels), 915070179);
+	uint32_t outputCRC = av_crc(av_crc_get_table(AV_CRC_32_IEEE), -1, &outputRGBProcessing[0], width * height * converted->channels);
+	ASSERT_EQ(outputCRC, 1307652822);
+	//CUDA and CPU backends use the same fixed-point math
+	EXPECT_EQ(outputCRC, CPUBackendCRC);
 	{
 		std::shared_ptr<FILE> writeFile(fopen(dumpFileName.c_str(), "wb"), fclose);
 		EXPECT_EQ(VPP.DumpFrame(converted.get(), writeFile), VREADER_OK);
@@ -182,8 +231,884 @@ TEST_F(VPP_Convert, NV12ToRGB24Upscale) {
 		std::shared_ptr<FILE> readFile(fopen(dumpFileName.c_str(), "rb"), fclose);
 		std::vector<uint8_t> fileRGBProcessing(width * height * converted->channels);
 		fread(&fileRGBProcessing[0], fileRGBProcessing.size(), 1, readFile.get());
-		ASSERT_EQ(av_crc(av_crc_get_table(AV_CRC_32_IEEE), -1, &fileRGBProcessing[0], width * height * converted->channels), 915070179);
+		ASSERT_EQ(av_crc(av_crc_get_table(AV_CRC_32_IEEE), -1, &fileRGBProcessing[0], width * height * converted->channels), 1307652822);
 	}
 
 	ASSERT_EQ(remove(dumpFileName.c_str()), 0);
-}
\ No newline at end of file
+}
+
+//Expected values are obtained from math of CUDA kernels, fixed-point CPU kernels give the same output for these pixels
+class VPP_CPU : public ::testing::Test {
+public:
+	std::vector<uint8_t> Y;
+	std::vector<uint8_t> UV;
+	std::shared_ptr<AVFrame> input;
+protected:
+	void SetUp()
+	{
+		//NV12 4x2 frame with pitch = 6
+		Y = { 16, 235, 81, 41, 0, 0,
+			 255, 128, 145, 210, 0, 0 };
+		UV = { 128, 128, 90, 240, 0, 0 };
+		input = std::shared_ptr<AVFrame>(av_frame_alloc(), [](AVFrame* frame) { av_frame_free(&frame); });
+		input->width = 4;
+		input->height = 2;
+		input->format = AV_PIX_FMT_NV12;
+		input->data[0] = &Y[0];
+		input->data[1] = &UV[0];
+		input->linesize[0] = input->linesize[1] = 6;
+	}
+};
+
+TEST_F(VPP_CPU, NV12ToRGB) {
+	VideoProcessor VPP;
+	EXPECT_EQ(VPP.Init(false, CPU_BACKEND), VREADER_OK);
+	std::shared_ptr<AVFrame> converted = std::shared_ptr<AVFrame>(av_frame_alloc(), av_frame_unref);
+	VPPParameters VPPArgs = { 0, 0, RGB24 };
+	EXPECT_EQ(VPP.Convert(input.get(), converted.get(), VPPArgs, "visualize"), VREADER_OK);
+	//first pixels pair shares neutral chroma, second pair shares red chroma
+	std::vector<uint8_t> expected = { 0, 0, 0,        254, 254, 254,  254, 0, 0,      207, 0, 0,
+									  255, 255, 255,  130, 130, 130,  255, 73, 73,    255, 149, 149 };
+	uint8_t* output = (uint8_t*)converted->opaque;
+	EXPECT_EQ(std::vector<uint8_t>(output, output + expected.size()), expected);
+	EXPECT_EQ(VPP.Free(converted->opaque), VREADER_OK);
+}
+
+TEST_F(VPP_CPU, NV12ToBGR) {
+	VideoProcessor VPP;
+	EXPECT_EQ(VPP.Init(false, CPU_BACKEND), VREADER_OK);
+	std::shared_ptr<AVFrame> converted = std::shared_ptr<AVFrame>(av_frame_alloc(), av_frame_unref);
+	VPPParameters VPPArgs = { 0, 0, BGR24 };
+	EXPECT_EQ(VPP.Convert(input.get(), converted.get(), VPPArgs, "visualize"), VREADER_OK);
+	std::vector<uint8_t> expected = { 0, 0, 0,        254, 254, 254,  0, 0, 254,      0, 0, 207,
+									  255, 255, 255,  130, 130, 130,  73, 73, 255,    149, 149, 255 };
+	uint8_t* output = (uint8_t*)converted->opaque;
+	EXPECT_EQ(std::vector<uint8_t>(output, output + expected.size()), expected);
+	EXPECT_EQ(VPP.Free(converted->opaque), VREADER_OK);
+}
+
+TEST_F(VPP_CPU, NV12ToY800) {
+	VideoProcessor VPP;
+	EXPECT_EQ(VPP.Init(false, CPU_BACKEND), VREADER_OK);
+	std::shared_ptr<AVFrame> converted = std::shared_ptr<AVFrame>(av_frame_alloc(), av_frame_unref);
+	VPPParameters VPPArgs = { 0, 0, Y800 };
+	EXPECT_EQ(VPP.Convert(input.get(), converted.get(), VPPArgs, "visualize"), VREADER_OK);
+	//pitch should be removed
+	std::vector<uint8_t> expected = { 16, 235, 81, 41, 255, 128, 145, 210 };
+	uint8_t* output = (uint8_t*)converted->opaque;
+	EXPECT_EQ(converted->channels, 1);
+	EXPECT_EQ(std::vector<uint8_t>(output, output + expected.size()), expected);
+	EXPECT_EQ(VPP.Free(converted->opaque), VREADER_OK);
+}
+
+//pixels with neutral chroma keep Y value in full range
+TEST_F(VPP_CPU, FullRange) {
+	VideoProcessor VPP;
+	EXPECT_EQ(VPP.Init(false, CPU_BACKEND), VREADER_OK);
+	std::shared_ptr<AVFrame> converted = std::shared_ptr<AVFrame>(av_frame_alloc(), av_frame_unref);
+	VPPParameters VPPArgs = { 0, 0, RGB24, BT601, FULL_RANGE };
+	EXPECT_EQ(VPP.Convert(input.get(), converted.get(), VPPArgs, "visualize"), VREADER_OK);
+	uint8_t* output = (uint8_t*)converted->opaque;
+	std::vector<uint8_t> expected = { 16, 16, 16, 235, 235, 235 };
+	EXPECT_EQ(std::vector<uint8_t>(output, output + 6), expected);
+	expected = { 255, 255, 255, 128, 128, 128 };
+	EXPECT_EQ(std::vector<uint8_t>(output + 12, output + 18), expected);
+	EXPECT_EQ(VPP.Free(converted->opaque), VREADER_OK);
+}
+
+//Matrix and range are taken from frame if they aren't set
+TEST_F(VPP_CPU, AutoColorProperties) {
+	VideoProcessor VPP;
+	EXPECT_EQ(VPP.Init(false, CPU_BACKEND), VREADER_OK);
+	std::vector<std::vector<uint8_t> > results;
+	std::vector<VPPParameters> parameters = { { 0, 0, RGB24 }, { 0, 0, RGB24, BT709, FULL_RANGE }, { 0, 0, RGB24, BT601, LIMITED_RANGE } };
+	for (auto& VPPArgs : parameters) {
+		//Convert function unreference input frame
+		SetUp();
+		input->colorspace = AVCOL_SPC_BT709;
+		input->color_range = AVCOL_RANGE_JPEG;
+		std::shared_ptr<AVFrame> converted = std::shared_ptr<AVFrame>(av_frame_alloc(), av_frame_unref);
+		EXPECT_EQ(VPP.Convert(input.get(), converted.get(), VPPArgs, "visualize"), VREADER_OK);
+		uint8_t* output = (uint8_t*)converted->opaque;
+		results.push_back(std::vector<uint8_t>(output, output + 24));
+		EXPECT_EQ(VPP.Free(converted->opaque), VREADER_OK);
+	}
+	EXPECT_EQ(results[0], results[1]);
+	EXPECT_NE(results[0], results[2]);
+}
+
+//Float planes are normalized RGB24 values, padded area is filled with zeros
+TEST_F(VPP_CPU, PlanarNormalized) {
+	VideoProcessor VPP;
+	EXPECT_EQ(VPP.Init(false, CPU_BACKEND), VREADER_OK);
+	std::shared_ptr<AVFrame> converted = std::shared_ptr<AVFrame>(av_frame_alloc(), av_frame_unref);
+	VPPParameters VPPArgs = { 0, 0, RGB24 };
+	EXPECT_EQ(VPP.Convert(input.get(), converted.get(), VPPArgs, "visualize"), VREADER_OK);
+	uint8_t* packed = (uint8_t*)converted->opaque;
+	std::vector<uint8_t> reference(packed, packed + 4 * 2 * 3);
+	EXPECT_EQ(VPP.Free(converted->opaque), VREADER_OK);
+
+	SetUp();
+	VPPArgs = { 0, 0, BGR_PLANAR_F32, MATRIX_AUTO, RANGE_AUTO, { 0.485f, 0.456f, 0.406f }, { 0.229f, 0.224f, 0.225f }, 8 };
+	EXPECT_EQ(VPP.Convert(input.get(), converted.get(), VPPArgs, "visualize"), VREADER_OK);
+	EXPECT_EQ(converted->width, 8);
+	EXPECT_EQ(converted->height, 8);
+	EXPECT_EQ(converted->channels, 3 * sizeof(float));
+	float* planes = (float*)converted->opaque;
+	for (int c = 0; c < 3; c++) {
+		//B, G, R planes
+		int source = 2 - c;
+		for (int i = 0; i < 8; i++) {
+			for (int j = 0; j < 8; j++) {
+				float value = planes[c * 64 + i * 8 + j];
+				if (i >= 2 || j >= 4)
+					EXPECT_EQ(value, 0);
+				else
+					EXPECT_NEAR(value, (reference[(i * 4 + j) * 3 + source] / 255.f - VPPArgs.mean[c]) / VPPArgs.std[c], 1e-5);
+			}
+		}
+	}
+	EXPECT_EQ(VPP.Free(converted->opaque), VREADER_OK);
+}
+
+//Area downscale of 4x2 frame to 2x1 averages luma of 2x2 blocks, chroma pair is the same
+TEST_F(VPP_CPU, AreaDownscale) {
+	VideoProcessor VPP;
+	EXPECT_EQ(VPP.Init(false, CPU_BACKEND), VREADER_OK);
+	std::shared_ptr<AVFrame> converted = std::shared_ptr<AVFrame>(av_frame_alloc(), av_frame_unref);
+	VPPParameters VPPArgs = { 2, 1, Y800 };
+	VPPArgs.interpolation = AREA;
+	EXPECT_EQ(VPP.Convert(input.get(), converted.get(), VPPArgs, "visualize"), VREADER_OK);
+	uint8_t* output = (uint8_t*)converted->opaque;
+	std::vector<uint8_t> expected = { (16 + 235 + 255 + 128 + 2) / 4, (81 + 41 + 145 + 210 + 2) / 4 };
+	EXPECT_EQ(std::vector<uint8_t>(output, output + 2), expected);
+	EXPECT_EQ(VPP.Free(converted->opaque), VREADER_OK);
+}
+
+//Right half of frame is centered in letterbox, odd left edge of crop is rounded down to even
+TEST_F(VPP_CPU, CropLetterbox) {
+	VideoProcessor VPP;
+	EXPECT_EQ(VPP.Init(false, CPU_BACKEND), VREADER_OK);
+	std::shared_ptr<AVFrame> converted = std::shared_ptr<AVFrame>(av_frame_alloc(), av_frame_unref);
+	VPPParameters VPPArgs = { 4, 2, Y800 };
+	VPPArgs.cropX = 3;
+	VPPArgs.cropWidth = 1;
+	VPPArgs.cropHeight = 2;
+	VPPArgs.letterbox = true;
+	VPPArgs.padColor[0] = 7;
+	FrameTransform transform;
+	EXPECT_EQ(VPP.Convert(input.get(), converted.get(), VPPArgs, "visualize", &transform), VREADER_OK);
+	EXPECT_EQ(converted->width, 4);
+	EXPECT_EQ(converted->height, 2);
+	uint8_t* output = (uint8_t*)converted->opaque;
+	std::vector<uint8_t> expected = { 7, 81, 41, 7,
+									  7, 145, 210, 7 };
+	EXPECT_EQ(std::vector<uint8_t>(output, output + 8), expected);
+	EXPECT_EQ(transform.scaleX, 1);
+	EXPECT_EQ(transform.scaleY, 1);
+	EXPECT_EQ(transform.offsetX, -1);
+	EXPECT_EQ(transform.offsetY, 0);
+	EXPECT_EQ(VPP.Free(converted->opaque), VREADER_OK);
+	//crop out of frame
+	VPPArgs.cropX = 4;
+	EXPECT_EQ(VPP.Convert(input.get(), converted.get(), VPPArgs, "visualize"), VREADER_UNSUPPORTED);
+}
+
+//Consumers which request the same decoded frame with the same parameters share one conversion
+TEST_F(VPP_CPU, SharedConversion) {
+	VideoProcessor VPP;
+	EXPECT_EQ(VPP.Init(false, CPU_BACKEND), VREADER_OK);
+	//reference counted frame in decoder's buffer
+	AVFrame* decoded = av_frame_alloc();
+	decoded->format = AV_PIX_FMT_NV12;
+	decoded->width = 4;
+	decoded->height = 2;
+	ASSERT_EQ(av_frame_get_buffer(decoded, 0), 0);
+	for (int i = 0; i < 2; i++)
+		memcpy(decoded->data[0] + i * decoded->linesize[0], &Y[i * 6], 4);
+	memcpy(decoded->data[1], &UV[0], 4);
+	decoded->display_picture_number = 5;
+	VPPParameters VPPArgs = { 0, 0, RGB24 };
+	std::vector<std::shared_ptr<AVFrame> > converted;
+	for (std::string consumer : { "first", "second", "third" }) {
+		//the third consumer requests another size
+		if (consumer == "third")
+			VPPArgs.width = VPPArgs.height = 2;
+		AVFrame* input = av_frame_alloc();
+		av_frame_ref(input, decoded);
+		converted.push_back(std::shared_ptr<AVFrame>(av_frame_alloc(), [](AVFrame* frame) { av_frame_free(&frame); }));
+		EXPECT_EQ(VPP.Convert(input, converted.back().get(), VPPArgs, consumer), VREADER_OK);
+		av_frame_free(&input);
+	}
+	EXPECT_EQ(converted[0]->opaque, converted[1]->opaque);
+	EXPECT_NE(converted[0]->opaque, converted[2]->opaque);
+	EXPECT_EQ(converted[1]->width, 4);
+	EXPECT_EQ(converted[1]->channels, 3);
+	EXPECT_EQ(VPP.getCacheHits(), 1);
+	EXPECT_EQ(VPP.getCacheMisses(), 2);
+	//shared output is still valid after the first consumer released it
+	EXPECT_EQ(VPP.Free(converted[0]->opaque), VREADER_OK);
+	std::vector<uint8_t> expected = { 0, 0, 0,        254, 254, 254,  254, 0, 0,      207, 0, 0,
+									  255, 255, 255,  130, 130, 130,  255, 73, 73,    255, 149, 149 };
+	uint8_t* output = (uint8_t*)converted[1]->opaque;
+	EXPECT_EQ(std::vector<uint8_t>(output, output + expected.size()), expected);
+	EXPECT_EQ(VPP.Free(converted[1]->opaque), VREADER_OK);
+	EXPECT_EQ(VPP.Free(converted[2]->opaque), VREADER_OK);
+	//the next frame replaces this one in decoder's buffer, so cached outputs are released
+	AVFrame* next = av_frame_alloc();
+	next->format = AV_PIX_FMT_NV12;
+	next->width = 4;
+	next->height = 2;
+	ASSERT_EQ(av_frame_get_buffer(next, 0), 0);
+	next->display_picture_number = 6;
+	av_frame_free(&decoded);
+	EXPECT_EQ(VPP.Convert(next, converted[0].get(), VPPArgs, "first"), VREADER_OK);
+	EXPECT_EQ(VPP.getCacheMisses(), 3);
+	EXPECT_EQ(VPP.Free(converted[0]->opaque), VREADER_OK);
+	av_frame_free(&next);
+	VPP.Close();
+}
+
+TEST_F(VPP_CPU, Pyramid) {
+	VideoProcessor VPP;
+	EXPECT_EQ(VPP.Init(false, CPU_BACKEND), VREADER_OK);
+	AVFrame* decoded = av_frame_alloc();
+	decoded->format = AV_PIX_FMT_NV12;
+	decoded->width = 4;
+	decoded->height = 2;
+	ASSERT_EQ(av_frame_get_buffer(decoded, 0), 0);
+	for (int i = 0; i < 2; i++)
+		memcpy(decoded->data[0] + i * decoded->linesize[0], &Y[i * 6], 4);
+	memcpy(decoded->data[1], &UV[0], 4);
+	VPPParameters VPPArgs = { 0, 0, RGB24 };
+	std::vector<AVFrame*> outputs = { av_frame_alloc(), av_frame_alloc(), av_frame_alloc() };
+	std::vector<FrameTransform> transforms;
+	//upscale isn't allowed, input is released in any case
+	AVFrame* input = av_frame_alloc();
+	av_frame_ref(input, decoded);
+	EXPECT_EQ(VPP.ConvertPyramid(input, outputs, VPPArgs, { { 0, 0 }, { 4, 2 } }, "first", &transforms), VREADER_UNSUPPORTED);
+	av_frame_ref(input, decoded);
+	//half of previous level by default
+	EXPECT_EQ(VPP.ConvertPyramid(input, outputs, VPPArgs, { { 0, 0 }, { 1, 1 } }, "first", &transforms), VREADER_OK);
+	av_frame_free(&input);
+	ASSERT_EQ(transforms.size(), 3);
+	EXPECT_EQ(outputs[1]->width, 2);
+	EXPECT_EQ(outputs[1]->height, 1);
+	EXPECT_EQ(outputs[2]->width, 1);
+	EXPECT_EQ(transforms[1].scaleX, 0.5f);
+	EXPECT_EQ(transforms[1].scaleY, 0.5f);
+	EXPECT_EQ(transforms[2].scaleX, 0.25f);
+	EXPECT_EQ(transforms[2].scaleY, 0.5f);
+	//every pixel of level is rounded average of 2x2 block of previous level
+	uint8_t* base = (uint8_t*)outputs[0]->opaque;
+	uint8_t* level = (uint8_t*)outputs[1]->opaque;
+	for (int j = 0; j < 2; j++) {
+		for (int c = 0; c < 3; c++) {
+			int sum = base[(2 * j) * 3 + c] + base[(2 * j + 1) * 3 + c] + base[(4 + 2 * j) * 3 + c] + base[(5 + 2 * j) * 3 + c];
+			EXPECT_EQ(level[j * 3 + c], (sum + 2) / 4);
+		}
+	}
+	uint8_t* top = (uint8_t*)outputs[2]->opaque;
+	for (int c = 0; c < 3; c++)
+		EXPECT_EQ(top[c], (level[c] + level[3 + c] + 1) / 2);
+	for (auto output : outputs) {
+		EXPECT_EQ(VPP.Free(output->opaque), VREADER_OK);
+		av_frame_free(&output);
+	}
+	av_frame_free(&decoded);
+	VPP.Close();
+}
+
+TEST_F(VPP_CPU, Prefetch) {
+	VideoProcessor VPP;
+	EXPECT_EQ(VPP.Init(false, CPU_BACKEND), VREADER_OK);
+	EXPECT_EQ(VPP.EnablePrefetch(1), VREADER_OK);
+	std::vector<AVFrame*> decoded;
+	for (int index = 0; index < 2; index++) {
+		decoded.push_back(av_frame_alloc());
+		decoded[index]->format = AV_PIX_FMT_NV12;
+		decoded[index]->width = 4;
+		decoded[index]->height = 2;
+		ASSERT_EQ(av_frame_get_buffer(decoded[index], 0), 0);
+		for (int i = 0; i < 2; i++)
+			memcpy(decoded[index]->data[0] + i * decoded[index]->linesize[0], &Y[i * 6], 4);
+		memcpy(decoded[index]->data[1], &UV[0], 4);
+		decoded[index]->display_picture_number = index;
+	}
+	VPPParameters VPPArgs = { 0, 0, RGB24 };
+	AVFrame* output = av_frame_alloc();
+	AVFrame* input = av_frame_alloc();
+	//parameters of consumer are known after the first request
+	av_frame_ref(input, decoded[0]);
+	EXPECT_EQ(VPP.Convert(input, output, VPPArgs, "first"), VREADER_OK);
+	EXPECT_EQ(VPP.Free(output->opaque), VREADER_OK);
+	EXPECT_EQ(VPP.Prefetch(decoded[1]), VREADER_OK);
+	for (int i = 0; i < 1000 && VPP.getPrefetched() == 0; i++)
+		std::this_thread::sleep_for(std::chrono::milliseconds(5));
+	ASSERT_EQ(VPP.getPrefetched(), 1);
+	EXPECT_EQ(VPP.getCacheMisses(), 2);
+	av_frame_ref(input, decoded[1]);
+	EXPECT_EQ(VPP.Convert(input, output, VPPArgs, "first"), VREADER_OK);
+	EXPECT_EQ(VPP.getCacheHits(), 1);
+	std::vector<uint8_t> expected = { 0, 0, 0,        254, 254, 254,  254, 0, 0,      207, 0, 0,
+									  255, 255, 255,  130, 130, 130,  255, 73, 73,    255, 149, 149 };
+	uint8_t* data = (uint8_t*)output->opaque;
+	EXPECT_EQ(std::vector<uint8_t>(data, data + expected.size()), expected);
+	EXPECT_EQ(VPP.Free(output->opaque), VREADER_OK);
+	av_frame_free(&output);
+	av_frame_free(&input);
+	for (auto& frame : decoded)
+		av_frame_free(&frame);
+	VPP.Close();
+}
+
+TEST(VPP_BufferPool, Buckets) {
+	EXPECT_EQ(BufferPool::getBucketSize(1), 256);
+	EXPECT_EQ(BufferPool::getBucketSize(512), 512);
+	EXPECT_EQ(BufferPool::getBucketSize(513), 640);
+	EXPECT_EQ(BufferPool::getBucketSize(1920 * 1080 * 3), 6291456);
+	//waste is less than quarter of requested size
+	for (size_t size = 257; size < 100000; size += 97) {
+		EXPECT_GE(BufferPool::getBucketSize(size), size);
+		EXPECT_LT(BufferPool::getBucketSize(size), size + size / 4 + 1);
+	}
+}
+
+TEST(VPP_BufferPool, ReuseAndLimit) {
+	int allocated = 0;
+	BufferPool pool([&allocated](void** data, size_t size) -> int {
+		*data = malloc(size);
+		allocated++;
+		return VREADER_OK;
+	}, [&allocated](void* data) {
+		free(data);
+		allocated--;
+	}, 2048);
+	void* first;
+	void* second;
+	EXPECT_EQ(pool.Allocate(&first, 1000), VREADER_OK);
+	EXPECT_EQ(pool.Free(first), VREADER_OK);
+	//the same bucket is served by cached buffer
+	EXPECT_EQ(pool.Allocate(&second, 900), VREADER_OK);
+	EXPECT_EQ(second, first);
+	EXPECT_EQ(pool.Allocate(&first, 1000), VREADER_OK);
+	EXPECT_NE(second, first);
+	BufferPoolStats stats = pool.getStats();
+	EXPECT_EQ(stats.allocations, 2);
+	EXPECT_EQ(stats.hits, 1);
+	EXPECT_EQ(stats.misses, 2);
+	EXPECT_EQ(stats.bytesInUse, 2048);
+	EXPECT_EQ(stats.peakBytesInUse, 2048);
+	//buffers above limit are released
+	void* big;
+	EXPECT_EQ(pool.Allocate(&big, 4096), VREADER_OK);
+	EXPECT_EQ(pool.Free(big), VREADER_OK);
+	EXPECT_EQ(pool.Free(first), VREADER_OK);
+	EXPECT_EQ(pool.Free(second), VREADER_OK);
+	stats = pool.getStats();
+	EXPECT_EQ(stats.bytesCached, 2048);
+	EXPECT_EQ(stats.releases, 1);
+	EXPECT_EQ(stats.peakBytesAllocated, 2048 + 4096);
+	EXPECT_EQ(allocated, 2);
+	pool.setLimit(1024);
+	EXPECT_EQ(allocated, 1);
+	pool.Close();
+	EXPECT_EQ(allocated, 0);
+}
+
+//converted frames of the same size don't allocate memory after the first one is freed
+TEST_F(VPP_CPU, PooledOutput) {
+	VideoProcessor VPP;
+	EXPECT_EQ(VPP.Init(false, CPU_BACKEND), VREADER_OK);
+	VPPParameters VPPArgs = { 0, 0, RGB24 };
+	std::shared_ptr<AVFrame> output = std::shared_ptr<AVFrame>(av_frame_alloc(), [](AVFrame* frame) { av_frame_free(&frame); });
+	for (int i = 0; i < 10; i++) {
+		//input is released by Convert
+		AVFrame* frame = av_frame_alloc();
+		frame->width = input->width;
+		frame->height = input->height;
+		frame->format = input->format;
+		frame->data[0] = input->data[0];
+		frame->data[1] = input->data[1];
+		frame->linesize[0] = frame->linesize[1] = input->linesize[0];
+		EXPECT_EQ(VPP.Convert(frame, output.get(), VPPArgs, "first"), VREADER_OK);
+		EXPECT_EQ(VPP.Free(output->opaque), VREADER_OK);
+		av_frame_free(&frame);
+	}
+	BufferPoolStats stats = VPP.getPoolStats();
+	EXPECT_EQ(stats.allocations, 1);
+	EXPECT_EQ(stats.hits, 9);
+	EXPECT_EQ(stats.bytesInUse, 0);
+	VPP.Close();
+}
+
+//output written to caller's memory with row pitch is the same as dense output, bytes between rows aren't touched
+TEST_F(VPP_CPU, ConvertInto) {
+	VideoProcessor VPP;
+	EXPECT_EQ(VPP.Init(false, CPU_BACKEND), VREADER_OK);
+	auto makeFrame = [this]() {
+		AVFrame* frame = av_frame_alloc();
+		frame->width = input->width;
+		frame->height = input->height;
+		frame->format = input->format;
+		frame->data[0] = input->data[0];
+		frame->data[1] = input->data[1];
+		frame->linesize[0] = frame->linesize[1] = input->linesize[0];
+		return frame;
+	};
+	for (FourCC format : { RGB24, Y800, RGB_PLANAR_F32 }) {
+		//resize with letterbox, so padded rows and columns are written too
+		VPPParameters VPPArgs = { 6, 4, format };
+		VPPArgs.letterbox = true;
+		VPPArgs.padColor[0] = 7;
+		AVFrame* frame = makeFrame();
+		std::shared_ptr<AVFrame> output = std::shared_ptr<AVFrame>(av_frame_alloc(), [](AVFrame* frame) { av_frame_free(&frame); });
+		FrameTransform expectedTransform;
+		EXPECT_EQ(VPP.Convert(frame, output.get(), VPPArgs, "dense", &expectedTransform), VREADER_OK);
+		av_frame_free(&frame);
+		int elementSize = getElementSize(format);
+		size_t rowSize = elementSize == 1 ? output->width * output->channels : output->width * elementSize;
+		size_t rows = elementSize == 1 ? output->height : output->height * output->channels / elementSize;
+		size_t pitch = rowSize + 2 * elementSize;
+		std::vector<uint8_t> dst(pitch * rows, 0xAB);
+		//the last row doesn't need padding after it
+		frame = makeFrame();
+		EXPECT_EQ(VPP.ConvertInto(frame, &dst[0], pitch, pitch * (rows - 1) + rowSize - 1, VPPArgs, "pitched"), VREADER_UNSUPPORTED);
+		EXPECT_EQ(VPP.ConvertInto(frame, &dst[0], rowSize - 1, dst.size(), VPPArgs, "pitched"), VREADER_UNSUPPORTED);
+		FrameTransform transform;
+		EXPECT_EQ(VPP.ConvertInto(frame, &dst[0], pitch, pitch * (rows - 1) + rowSize, VPPArgs, "pitched", &transform), VREADER_OK);
+		av_frame_free(&frame);
+		EXPECT_EQ(transform.scaleX, expectedTransform.scaleX);
+		EXPECT_EQ(transform.offsetY, expectedTransform.offsetY);
+		uint8_t* dense = (uint8_t*)output->opaque;
+		for (size_t i = 0; i < rows; i++) {
+			EXPECT_EQ(std::vector<uint8_t>(&dst[i * pitch], &dst[i * pitch] + rowSize), std::vector<uint8_t>(dense + i * rowSize, dense + (i + 1) * rowSize));
+			EXPECT_EQ(std::vector<uint8_t>(&dst[i * pitch] + rowSize, &dst[(i + 1) * pitch]), std::vector<uint8_t>(pitch - rowSize, 0xAB));
+		}
+		EXPECT_EQ(VPP.Free(output->opaque), VREADER_OK);
+	}
+	//caller's memory isn't taken from pool
+	EXPECT_EQ(VPP.getPoolStats().bytesInUse, 0);
+	VPP.Close();
+}
+
+TEST_F(VPP_CPU, YUVOutput) {
+	VideoProcessor VPP;
+	EXPECT_EQ(VPP.Init(false, CPU_BACKEND), VREADER_OK);
+	std::shared_ptr<AVFrame> output = std::shared_ptr<AVFrame>(av_frame_alloc(), [](AVFrame* frame) { av_frame_free(&frame); });
+	//source layout is kept, U and V pairs are split to own planes
+	VPPParameters VPPArgs = { 0, 0, I420 };
+	EXPECT_EQ(VPP.Convert(input.get(), output.get(), VPPArgs, "i420"), VREADER_OK);
+	EXPECT_EQ(output->format, AV_PIX_FMT_YUV420P);
+	EXPECT_EQ(output->linesize[0], 0);
+	std::vector<uint8_t> expected = { 16, 235, 81, 41, 255, 128, 145, 210, 128, 90, 128, 240 };
+	uint8_t* data = (uint8_t*)output->opaque;
+	EXPECT_EQ(std::vector<uint8_t>(data, data + expected.size()), expected);
+	EXPECT_EQ(VPP.Free(output->opaque), VREADER_OK);
+	//nearest resize takes the same source pixels as for RGB output
+	VPPArgs = { 2, 2, NV12 };
+	EXPECT_EQ(VPP.Convert(input.get(), output.get(), VPPArgs, "nv12"), VREADER_OK);
+	EXPECT_EQ(output->format, AV_PIX_FMT_NV12);
+	expected = { 16, 235, 16, 235, 128, 128 };
+	data = (uint8_t*)output->opaque;
+	EXPECT_EQ(std::vector<uint8_t>(data, data + expected.size()), expected);
+	EXPECT_EQ(VPP.Free(output->opaque), VREADER_OK);
+	//filtered resize, padding and caller's pitch aren't supported for YUV
+	VPPArgs.interpolation = BILINEAR;
+	EXPECT_EQ(VPP.Convert(input.get(), output.get(), VPPArgs, "nv12"), VREADER_UNSUPPORTED);
+	VPPArgs = { 4, 4, NV12 };
+	VPPArgs.letterbox = true;
+	EXPECT_EQ(VPP.Convert(input.get(), output.get(), VPPArgs, "nv12"), VREADER_UNSUPPORTED);
+	std::vector<uint8_t> dst(12);
+	VPPArgs = { 0, 0, NV12 };
+	EXPECT_EQ(VPP.ConvertInto(input.get(), &dst[0], 4, dst.size(), VPPArgs, "nv12"), VREADER_UNSUPPORTED);
+	VPP.Close();
+}
+
+TEST_F(VPP_CPU, ZeroCopyView) {
+	VideoProcessor VPP;
+	EXPECT_EQ(VPP.Init(false, CPU_BACKEND), VREADER_OK);
+	//reference counted 4x4 frame, chroma plane follows luma plane
+	AVFrame* decoded = av_frame_alloc();
+	decoded->format = AV_PIX_FMT_NV12;
+	decoded->width = 4;
+	decoded->height = 4;
+	ASSERT_EQ(av_frame_get_buffer(decoded, 0), 0);
+	for (int i = 0; i < 24; i++)
+		decoded->data[0][i] = i;
+	auto convert = [&](VPPParameters VPPArgs, AVFrame* output, FrameTransform* transform) {
+		AVFrame* frame = av_frame_alloc();
+		av_frame_ref(frame, decoded);
+		VPPArgs.zeroCopy = true;
+		int sts = VPP.Convert(frame, output, VPPArgs, "view", transform);
+		av_frame_free(&frame);
+		return sts;
+	};
+	std::shared_ptr<AVFrame> gray = std::shared_ptr<AVFrame>(av_frame_alloc(), [](AVFrame* frame) { av_frame_free(&frame); });
+	VPPParameters VPPArgs = { 0, 0, Y800 };
+	VPPArgs.cropX = VPPArgs.cropY = 2;
+	VPPArgs.cropWidth = VPPArgs.cropHeight = 2;
+	FrameTransform transform;
+	EXPECT_EQ(convert(VPPArgs, gray.get(), &transform), VREADER_OK);
+	EXPECT_EQ(gray->opaque, decoded->data[0] + 2 * decoded->linesize[0] + 2);
+	EXPECT_EQ(gray->linesize[0], decoded->linesize[0]);
+	EXPECT_EQ(gray->width, 2);
+	EXPECT_EQ(gray->format, AV_PIX_FMT_GRAY8);
+	EXPECT_EQ(transform.offsetX, -2);
+	std::shared_ptr<AVFrame> nv12 = std::shared_ptr<AVFrame>(av_frame_alloc(), [](AVFrame* frame) { av_frame_free(&frame); });
+	VPPArgs = { 0, 0, NV12 };
+	EXPECT_EQ(convert(VPPArgs, nv12.get(), nullptr), VREADER_OK);
+	EXPECT_EQ(nv12->opaque, decoded->data[0]);
+	EXPECT_EQ(VPP.getViews(), 2);
+	EXPECT_EQ(VPP.getCacheMisses(), 0);
+	//views keep decoded frame referenced
+	EXPECT_EQ(av_buffer_get_ref_count(decoded->buf[0]), 3);
+	//chroma of cropped NV12 doesn't follow its luma rows, so it's converted
+	std::shared_ptr<AVFrame> cropped = std::shared_ptr<AVFrame>(av_frame_alloc(), [](AVFrame* frame) { av_frame_free(&frame); });
+	VPPArgs.cropY = 2;
+	EXPECT_EQ(convert(VPPArgs, cropped.get(), nullptr), VREADER_OK);
+	EXPECT_EQ(cropped->linesize[0], 0);
+	std::vector<uint8_t> expected = { 8, 9, 10, 11, 12, 13, 14, 15, 20, 21, 22, 23 };
+	uint8_t* data = (uint8_t*)cropped->opaque;
+	EXPECT_EQ(std::vector<uint8_t>(data, data + expected.size()), expected);
+	EXPECT_EQ(VPP.getViews(), 2);
+	EXPECT_EQ(VPP.Free(cropped->opaque), VREADER_OK);
+	EXPECT_EQ(VPP.Free(gray->opaque), VREADER_OK);
+	EXPECT_EQ(VPP.Free(nv12->opaque), VREADER_OK);
+	EXPECT_EQ(av_buffer_get_ref_count(decoded->buf[0]), 2);
+	av_frame_free(&decoded);
+	VPP.Close();
+}
+
+static std::string readDump(std::string fileName) {
+	std::string content;
+	std::shared_ptr<FILE> readFile(fopen(fileName.c_str(), "rb"), fclose);
+	char buffer[256];
+	size_t size;
+	while ((size = fread(buffer, 1, sizeof(buffer), readFile.get())) > 0)
+		content.append(buffer, size);
+	return content;
+}
+
+TEST(VPP_DumpWriter, Y4M) {
+	std::string fileName = "DumpWriter.y4m";
+	{
+		DumpWriter writer;
+		//NV12 2x2 frame with pitch = 4
+		DumpFormat format;
+		format.layout = DUMP_NV12;
+		format.width = format.height = 2;
+		format.rowSize = 2;
+		format.rows = 3;
+		format.pitch = 4;
+		std::vector<uint8_t> frame = { 1, 2, 0, 0, 3, 4, 0, 0, 5, 6, 0, 0 };
+		std::vector<uint8_t> buffer = writer.Acquire(frame.size());
+		ASSERT_EQ(buffer.size(), frame.size());
+		memcpy(&buffer[0], &frame[0], frame.size());
+		writer.Submit(fileName, format, std::move(buffer));
+		//Y4M file keeps geometry of the first frame
+		format.width = 4;
+		writer.Submit(fileName, format, writer.Acquire(24));
+		writer.Flush();
+		EXPECT_EQ(writer.getWritten(), 1);
+		EXPECT_EQ(writer.getDropped(), 1);
+	}
+	EXPECT_EQ(readDump(fileName), std::string("YUV4MPEG2 W2 H2 F25:1 Ip A1:1 C420mpeg2\nFRAME\n\x01\x02\x03\x04\x05\x06"));
+	ASSERT_EQ(remove(fileName.c_str()), 0);
+}
+
+TEST(VPP_DumpWriter, Limit) {
+	DumpWriter writer(16);
+	//frame which doesn't fit to queue is skipped instead of blocking caller
+	EXPECT_TRUE(writer.Acquire(17).empty());
+	EXPECT_EQ(writer.getDropped(), 1);
+	std::vector<uint8_t> buffer = writer.Acquire(16);
+	EXPECT_EQ(buffer.size(), 16);
+	//acquired buffer is counted before it's submitted, so the second caller doesn't exceed limit
+	EXPECT_TRUE(writer.Acquire(1).empty());
+	EXPECT_EQ(writer.getDropped(), 2);
+	writer.Release(std::move(buffer));
+	EXPECT_EQ(writer.Acquire(16).size(), 16);
+}
+
+TEST(VPP_Statistics, Histogram) {
+	//buckets are exact below 64 and have 1/32 relative width above
+	for (uint64_t value : std::vector<uint64_t>{ 0, 1, 63, 64, 65, 1000, 123456789, 68000000000 }) {
+		int bucket = LatencyHistogram::getBucket(value);
+		uint64_t upper = LatencyHistogram::getUpperBound(bucket);
+		EXPECT_GE(upper, value);
+		EXPECT_LE(upper - value, std::max(value / 32, (uint64_t)1));
+		if (bucket > 0)
+			EXPECT_LT(LatencyHistogram::getUpperBound(bucket - 1), value);
+	}
+	LatencyHistogram histogram;
+	EXPECT_EQ(histogram.percentile(50), 0);
+	for (int i = 1; i <= 1000; i++)
+		histogram.add(i * 1000);
+	EXPECT_EQ(histogram.getCount(), 1000);
+	EXPECT_EQ(histogram.getSum(), 500500000);
+	EXPECT_EQ(histogram.getMax(), 1000000);
+	EXPECT_NEAR((double)histogram.percentile(50), 500000, 500000 / 32);
+	EXPECT_NEAR((double)histogram.percentile(99), 990000, 990000 / 32);
+	EXPECT_EQ(histogram.percentile(100), 1000000);
+	EXPECT_NEAR((double)histogram.countBelow(100000), 100, 4);
+	//negative durations of unsynchronized clocks are counted as zero
+	histogram.add(-5);
+	EXPECT_EQ(histogram.countBelow(0), 1);
+}
+
+TEST(VPP_Statistics, Prometheus) {
+	PipelineStats stats;
+	stats.decode.add(2000000);
+	stats.packets = 3;
+	PipelineSnapshot snapshot;
+	snapshot.decodedFrames = 7;
+	snapshot.consumers["first"].delivered = 5;
+	snapshot.consumers["se\\\"c\nnd"].skipped = 2;
+	snapshot.pool.hits = 4;
+	auto values = stats.getValues(snapshot);
+	EXPECT_EQ(values["decode.count"], 1);
+	EXPECT_NEAR(values["decode.p50_ms"], 2, 2. / 32);
+	EXPECT_EQ(values["read.count"], 0);
+	EXPECT_EQ(values["packets"], 3);
+	EXPECT_EQ(values["decoded_frames"], 7);
+	EXPECT_EQ(values["consumer.first.delivered"], 5);
+	EXPECT_EQ(values["pool.hits"], 4);
+	//frames without capture time are counted only in frame age
+	stats.addFrame(1000, 0, 4000);
+	stats.addFrame(1000, 500, 5000);
+	values = stats.getValues(snapshot);
+	EXPECT_EQ(values["frame_age.count"], 2);
+	EXPECT_NEAR(values["frame_age.max_ms"], 4, 4. / 32);
+	EXPECT_EQ(values["glass_to_tensor.count"], 1);
+	EXPECT_NEAR(values["glass_to_tensor.p50_ms"], 4.5, 4.5 / 32);
+	//unfinished startup phases aren't reported, only the first decoded frame is counted
+	stats.startup.reset(1000);
+	stats.startup.open = 2000000;
+	stats.startup.addFrame(5001000);
+	stats.startup.addFrame(9001000);
+	values = stats.getValues(snapshot);
+	EXPECT_EQ(values.count("startup.probe_ms"), 0);
+	EXPECT_EQ(values["startup.open_ms"], 2);
+	EXPECT_EQ(values["startup.first_frame_ms"], 5);
+	EXPECT_EQ(values["startup.cached"], 0);
+	std::string text = stats.getPrometheus(snapshot);
+	EXPECT_NE(text.find("# TYPE tensorstream_stage_duration_seconds histogram\n"), std::string::npos);
+	//2 ms sample is below 2.5 ms bound and above 1 ms bound
+	EXPECT_NE(text.find("tensorstream_stage_duration_seconds_bucket{stage=\"decode\",le=\"0.001\"} 0\n"), std::string::npos);
+	EXPECT_NE(text.find("tensorstream_stage_duration_seconds_bucket{stage=\"decode\",le=\"0.0025\"} 1\n"), std::string::npos);
+	EXPECT_NE(text.find("tensorstream_stage_duration_seconds_bucket{stage=\"decode\",le=\"+Inf\"} 1\n"), std::string::npos);
+	EXPECT_NE(text.find("tensorstream_packets_total 3\n"), std::string::npos);
+	EXPECT_NE(text.find("tensorstream_consumer_frames_total{consumer=\"first\"} 5\n"), std::string::npos);
+	EXPECT_NE(text.find("tensorstream_consumer_skipped_frames_total{consumer=\"se\\\\\\\"c\\nnd\"} 2\n"), std::string::npos);
+	EXPECT_NE(text.find("tensorstream_pool_hits_total 4\n"), std::string::npos);
+	EXPECT_NE(text.find("tensorstream_glass_to_tensor_seconds_count 1\n"), std::string::npos);
+	EXPECT_NE(text.find("tensorstream_startup_seconds{phase=\"first_frame\"} 0.005\n"), std::string::npos);
+	EXPECT_EQ(text.find("tensorstream_startup_seconds{phase=\"probe\"}"), std::string::npos);
+	//every metric is described once
+	EXPECT_EQ(text.find("# TYPE tensorstream_stage_duration_seconds", text.find("stage=\"read\"")), std::string::npos);
+}
+
+#ifndef _WIN32
+TEST(VPP_Statistics, MetricsServer) {
+	MetricsServer server([]() { return std::string("metric 1\n"); });
+	ASSERT_EQ(server.Start(0), VREADER_OK);
+	EXPECT_EQ(server.Start(0), VREADER_ERROR);
+	for (int i = 0; i < 2; i++) {
+		int client = socket(AF_INET, SOCK_STREAM, 0);
+		sockaddr_in address = {};
+		address.sin_family = AF_INET;
+		address.sin_port = htons(server.getPort());
+		address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		ASSERT_EQ(connect(client, (sockaddr*)&address, sizeof(address)), 0);
+		std::string request = "GET /metrics HTTP/1.1\r\nHost: localhost\r\n\r\n";
+		ASSERT_EQ(send(client, request.data(), request.size(), 0), (int)request.size());
+		std::string response;
+		char buffer[256];
+		for (int size; (size = recv(client, buffer, sizeof(buffer), 0)) > 0;)
+			response.append(buffer, size);
+		close(client);
+		EXPECT_EQ(response.find("HTTP/1.0 200 OK\r\n"), 0);
+		EXPECT_NE(response.find("Content-Type: text/plain; version=0.0.4\r\n"), std::string::npos);
+		EXPECT_EQ(response.substr(response.size() - 13), "\r\n\r\nmetric 1\n");
+	}
+	server.Stop();
+}
+
+//client which doesn't read response can't block server thread, so Stop returns after send timeout
+TEST(VPP_Statistics, MetricsServerStalledClient) {
+	std::atomic<bool> rendered(false);
+	MetricsServer server([&rendered]() { rendered = true; return std::string(64 * 1024 * 1024, '#'); });
+	ASSERT_EQ(server.Start(0), VREADER_OK);
+	int client = socket(AF_INET, SOCK_STREAM, 0);
+	int bufferSize = 4096;
+	setsockopt(client, SOL_SOCKET, SO_RCVBUF, &bufferSize, sizeof(bufferSize));
+	sockaddr_in address = {};
+	address.sin_family = AF_INET;
+	address.sin_port = htons(server.getPort());
+	address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	ASSERT_EQ(connect(client, (sockaddr*)&address, sizeof(address)), 0);
+	std::string request = "GET /metrics HTTP/1.1\r\n\r\n";
+	ASSERT_EQ(send(client, request.data(), request.size(), 0), (int)request.size());
+	while (!rendered)
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+	server.Stop();
+	EXPECT_LT(std::chrono::duration_cast<std::chrono::seconds>(std::chrono::high_resolution_clock::now() - start).count(), 10);
+	close(client);
+}
+#endif
+
+TEST_F(VPP_CPU, Dumps) {
+	{
+		VideoProcessor VPP;
+		EXPECT_EQ(VPP.Init(true, CPU_BACKEND), VREADER_OK);
+		std::shared_ptr<AVFrame> output = std::shared_ptr<AVFrame>(av_frame_alloc(), [](AVFrame* frame) { av_frame_free(&frame); });
+		VPPParameters VPPArgs = { 0, 0, Y800 };
+		EXPECT_EQ(VPP.Convert(input.get(), output.get(), VPPArgs, "dump"), VREADER_OK);
+		EXPECT_EQ(VPP.Free(output->opaque), VREADER_OK);
+		//queued frames are written when the last user releases writer
+		VPP.Close();
+	}
+	std::string expected = std::string("YUV4MPEG2 W4 H2 F25:1 Ip A1:1 Cmono\nFRAME\n") + std::string(Y.begin(), Y.begin() + 4) +
+		std::string(Y.begin() + 6, Y.begin() + 10);
+	EXPECT_EQ(readDump("Processed_dump.y4m"), expected);
+	ASSERT_EQ(remove("Processed_dump.y4m"), 0);
+}
+
+TEST_F(VPP_CPU, Trace) {
+	VideoProcessor VPP;
+	EXPECT_EQ(VPP.Init(false, CPU_BACKEND), VREADER_OK);
+	{
+		TraceSpan before(1, "before");
+	}
+	//spans above runtime level aren't recorded
+	enableTracing(2);
+	std::thread worker([this, &VPP]() {
+		setTraceThreadName("worker");
+		std::shared_ptr<AVFrame> output = std::shared_ptr<AVFrame>(av_frame_alloc(), [](AVFrame* frame) { av_frame_free(&frame); });
+		VPPParameters VPPArgs = { 0, 0, Y800 };
+		EXPECT_EQ(VPP.Convert(input.get(), output.get(), VPPArgs, "tracer\"1"), VREADER_OK);
+		EXPECT_EQ(VPP.Free(output->opaque), VREADER_OK);
+	});
+	worker.join();
+	{
+		TraceSpan span(1, "main", "consumer", 5);
+		TraceSpan skipped(3, "skipped");
+	}
+	EXPECT_EQ(exportTrace("trace.json"), VREADER_OK);
+	enableTracing(0);
+	std::string trace = readDump("trace.json");
+	EXPECT_NE(trace.find("{\"traceEvents\":["), std::string::npos);
+	EXPECT_NE(trace.find("\"args\":{\"name\":\"worker\"}"), std::string::npos);
+	EXPECT_NE(trace.find("\"name\":\"convert\""), std::string::npos);
+	//quote in consumer name is replaced, so JSON stays valid
+	EXPECT_NE(trace.find("\"consumer\":\"tracer_1\""), std::string::npos);
+	EXPECT_NE(trace.find("\"name\":\"main\""), std::string::npos);
+	EXPECT_NE(trace.find("\"consumer\":\"consumer\",\"frame\":5"), std::string::npos);
+	EXPECT_EQ(trace.find("\"name\":\"process\""), std::string::npos);
+	EXPECT_EQ(trace.find("\"name\":\"skipped\""), std::string::npos);
+	EXPECT_EQ(trace.find("\"name\":\"before\""), std::string::npos);
+	EXPECT_EQ(trace.substr(trace.size() - 3), "]}\n");
+	ASSERT_EQ(remove("trace.json"), 0);
+}
+
+TEST(VPP_ColorCoefficients, Legacy) {
+	ColorCoefficients coefficients = getColorCoefficients(BT601, LIMITED_RANGE);
+	EXPECT_EQ(coefficients.offsetY, 16);
+	EXPECT_EQ(coefficients.Y, 9535);
+	EXPECT_EQ(coefficients.RV, 13074);
+	EXPECT_EQ(coefficients.GV, 6660);
+	EXPECT_EQ(coefficients.GU, 3203);
+	EXPECT_EQ(coefficients.BU, 16531);
+	coefficients = getColorCoefficients(BT709, FULL_RANGE);
+	EXPECT_EQ(coefficients.offsetY, 0);
+	EXPECT_EQ(coefficients.Y, 1 << colorShift);
+}
+
+class VPP_CPU_Resize : public ::testing::Test {
+public:
+	std::vector<uint8_t> Y;
+	std::vector<uint8_t> UV;
+	std::shared_ptr<AVFrame> input;
+	std::shared_ptr<AVFrame> output;
+	VPPBackendCPU backend;
+protected:
+	void SetUp()
+	{
+		//NV12 8x4 frame, every Y is equal to its index, UV = 100 + index
+		Y.resize(8 * 4);
+		UV.resize(8 * 2);
+		for (int i = 0; i < Y.size(); i++)
+			Y[i] = i;
+		for (int i = 0; i < UV.size(); i++)
+			UV[i] = 100 + i;
+		input = std::shared_ptr<AVFrame>(av_frame_alloc(), [](AVFrame* frame) { av_frame_free(&frame); });
+		input->width = 8;
+		input->height = 4;
+		input->format = AV_PIX_FMT_NV12;
+		input->data[0] = &Y[0];
+		input->data[1] = &UV[0];
+		input->linesize[0] = input->linesize[1] = 8;
+		output = std::shared_ptr<AVFrame>(av_frame_alloc(), [](AVFrame* frame) { av_frame_free(&frame); });
+		output->width = 4;
+		output->height = 2;
+		EXPECT_EQ(backend.Init(), VREADER_OK);
+	}
+};
+
+//xRatio = (8 - 1) / 4, yRatio = (4 - 1) / 2, so columns 0, 1, 3, 5 and rows 0, 1 are taken
+TEST_F(VPP_CPU_Resize, Nearest) {
+	EXPECT_EQ(backend.resizeNV12Nearest(input.get(), output.get(), "visualize"), VREADER_OK);
+	std::vector<uint8_t> expectedY = { 0, 1, 3, 5, 8, 9, 11, 13 };
+	//for odd index in UV plane pair is started from previous element
+	std::vector<uint8_t> expectedUV = { 100, 101, 102, 103 };
+	EXPECT_EQ(std::vector<uint8_t>(output->data[0], output->data[0] + expectedY.size()), expectedY);
+	EXPECT_EQ(std::vector<uint8_t>(output->data[1], output->data[1] + expectedUV.size()), expectedUV);
+	backend.Free(output->data[0]);
+	backend.Free(output->data[1]);
+}
+
+//source positions are 0, 1.75, 3.5, 5.25 for columns and 0, 1.5 for rows, chroma positions are 0, 1.75 in UV pairs
+TEST_F(VPP_CPU_Resize, Bilinear) {
+	EXPECT_EQ(backend.resizeNV12Bilinear(input.get(), output.get(), "visualize"), VREADER_OK);
+	std::vector<uint8_t> expectedY = { 0, 2, 4, 5, 12, 14, 16, 17 };
+	std::vector<uint8_t> expectedUV = { 100, 101, 104, 105 };
+	EXPECT_EQ(std::vector<uint8_t>(output->data[0], output->data[0] + expectedY.size()), expectedY);
+	EXPECT_EQ(std::vector<uint8_t>(output->data[1], output->data[1] + expectedUV.size()), expectedUV);
+	backend.Free(output->data[0]);
+	backend.Free(output->data[1]);
+}
+
+//The whole pipeline without GPU: software decoding + CPU post-processing
+TEST(VPP_Convert_CPU, NV12ToY800) {
+	ParserParameters parserArgs = { "../resources/bbb_1080x608_420_10.h264" };
+	std::shared_ptr<Parser> parser = std::make_shared<Parser>();
+	parser->Init(parserArgs);
+	Decoder decoder;
+	DecoderParameters decoderArgs = { parser, false, 4, CPU_BACKEND };
+	EXPECT_EQ(decoder.Init(decoderArgs), VREADER_OK);
+	AVPacket parsed;
+	std::shared_ptr<AVFrame> output = std::shared_ptr<AVFrame>(av_frame_alloc(), av_frame_unref);
+	EXPECT_EQ(parser->Read(), VREADER_OK);
+	EXPECT_EQ(parser->Get(&parsed), VREADER_OK);
+	int result;
+	std::thread get([&decoder, &output, &result]() {
+		result = decoder.GetFrame(0, "visualize", output.get());
+	});
+	EXPECT_EQ(decoder.Decode(&parsed), VREADER_OK);
+	get.join();
+	EXPECT_NE(result, VREADER_REPEAT);
+
+	VideoProcessor VPP;
+	EXPECT_EQ(VPP.Init(false, CPU_BACKEND), VREADER_OK);
+	std::shared_ptr<AVFrame> converted = std::shared_ptr<AVFrame>(av_frame_alloc(), av_frame_unref);
+	int width = output->width;
+	int height = output->height;
+	VPPParameters VPPArgs = { width, height, Y800 };
+	EXPECT_EQ(VPP.Convert(output.get(), converted.get(), VPPArgs, "visualize"), VREADER_OK);
+	//CRC is the same as for Y800 from CUDA backend
+	//CRC32 - 3265466497
+	ASSERT_EQ(av_crc(av_crc_get_table(AV_CRC_32_IEEE), -1, (uint8_t*)converted->opaque, width * height), 3265466497);
+	EXPECT_EQ(VPP.Free(converted->opaque), VREADER_OK);
+}
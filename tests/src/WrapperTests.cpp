@@ -1,6 +1,7 @@
 #include <gtest/gtest.h>
 
 #include "WrapperC.h"
+#include "WrapperCABI.h"
 extern "C" {
 #include "libavutil/crc.h"
 }
@@ -46,6 +47,31 @@ void checkCRC(std::map<std::string, std::string> parameters, uint64_t crc) {
 	ASSERT_EQ(remove(parameters["dumpName"].c_str()), 0);
 }
 
+//CRC of the same frames from CPU backend, decoding is bit-exact and both backends use the same fixed-point conversion
+uint64_t referenceCRC(std::map<std::string, std::string> parameters) {
+	TensorStream reader;
+	EXPECT_EQ(reader.initPipeline("../resources/bbb_1080x608_420_10.h264", 5, CPU_BACKEND), VREADER_OK);
+	parameters["dumpName"] = std::string("reference_") + parameters["dumpName"];
+	remove(parameters["dumpName"].c_str());
+	std::thread pipeline(&TensorStream::startProcessing, &reader);
+	std::thread get(getCycle, parameters, std::ref(reader));
+	get.join();
+	reader.endProcessing(HARD);
+	pipeline.join();
+
+	int width = std::atoi(parameters["width"].c_str());
+	int height = std::atoi(parameters["height"].c_str());
+	int channels = (FourCC)std::atoi(parameters["format"].c_str()) == Y800 ? 1 : 3;
+	int frames = std::atoi(parameters["frames"].c_str());
+	std::vector<uint8_t> fileProcessing(width * height * channels * frames);
+	{
+		std::shared_ptr<FILE> readFile(fopen(parameters["dumpName"].c_str(), "rb"), fclose);
+		fread(&fileProcessing[0], fileProcessing.size(), 1, readFile.get());
+	}
+	remove(parameters["dumpName"].c_str());
+	return av_crc(av_crc_get_table(AV_CRC_32_IEEE), -1, &fileProcessing[0], fileProcessing.size());
+}
+
 TEST(Wrapper_Init, OneThread) {
 	TensorStream reader;
 	reader.enableLogs(MEDIUM);
@@ -61,7 +87,8 @@ TEST(Wrapper_Init, OneThread) {
 	pipeline.join();
 	//let's compare output
 
-	checkCRC(parameters, 734055672);
+	checkCRC(parameters, 607124128);
+	EXPECT_EQ(referenceCRC(parameters), 607124128);
 }
 
 //several threads
@@ -84,8 +111,9 @@ TEST(Wrapper_Init, MultipleThreads) {
 	pipeline.join();
 	//let's compare output
 
-	checkCRC(parametersFirst, 734055672);
+	checkCRC(parametersFirst, 607124128);
 	checkCRC(parametersSecond, 2107993070);
+	EXPECT_EQ(referenceCRC(parametersFirst), 607124128);
 
 }
 
@@ -130,6 +158,173 @@ TEST(Wrapper_Init, CheckPerformance) {
 	pipeline.join();
 }
 
+//frames converted in background should be the same as converted on request
+TEST(Wrapper_Init, Prefetch) {
+	TensorStream reader;
+	ASSERT_EQ(reader.initPipeline("../resources/bbb_1080x608_420_10.h264", 5, CPU_BACKEND), VREADER_OK);
+	ASSERT_EQ(reader.enablePrefetch(2), VREADER_OK);
+	std::thread pipeline(&TensorStream::startProcessing, &reader);
+	std::map<std::string, std::string> parameters = { {"name", "first"}, {"delay", "0"}, {"format", std::to_string(RGB24)}, {"width", "720"}, {"height", "480"},
+													  {"frames", "10"}, {"dumpName", "bbb_dumpPrefetch.yuv"} };
+	remove(parameters["dumpName"].c_str());
+	std::thread get(getCycle, parameters, std::ref(reader));
+	get.join();
+	auto counters = reader.getCacheCounters();
+	EXPECT_GT(counters["prefetched"], 0);
+	EXPECT_GT(counters["hits"], 0);
+	auto latency = reader.getLatency();
+	EXPECT_EQ(latency["samples"], 10);
+	EXPECT_LE(latency["p50"], latency["p99"]);
+	reader.endProcessing(HARD);
+	pipeline.join();
+
+	checkCRC(parameters, 607124128);
+}
+
+//frames converted by C API to caller's buffer with row pitch are the same as frames returned by getFrame
+TEST(Wrapper_Init, GetFrameInto) {
+	TensorStreamSession* session;
+	ASSERT_EQ(tensorStreamCreate(&session, "../resources/bbb_1080x608_420_10.h264", 5, CPU_BACKEND), VREADER_OK);
+	ASSERT_EQ(tensorStreamStart(session), VREADER_OK);
+	std::map<std::string, std::string> parameters = { {"name", "first"}, {"delay", "0"}, {"format", std::to_string(RGB24)}, {"width", "720"}, {"height", "480"},
+													  {"frames", "10"}, {"dumpName", "bbb_dumpInto.yuv"} };
+	remove(parameters["dumpName"].c_str());
+	TensorStreamParameters format = {};
+	format.width = 720;
+	format.height = 480;
+	format.fourCC = RGB24;
+	size_t rowSize = 720 * 3;
+	size_t pitch = rowSize + 64;
+	std::vector<uint8_t> buffer(pitch * 480);
+	{
+		std::shared_ptr<FILE> dumpFile(fopen(parameters["dumpName"].c_str(), "ab"), std::fclose);
+		for (int i = 0; i < 10; i++) {
+			int frameIndex = -1;
+			ASSERT_EQ(tensorStreamGetFrameInto(session, "first", &buffer[0], pitch, buffer.size(), &format, 0, &frameIndex), VREADER_OK);
+			EXPECT_GE(frameIndex, 0);
+			for (int row = 0; row < 480; row++)
+				fwrite(&buffer[row * pitch], rowSize, 1, dumpFile.get());
+		}
+		//buffer without space for the last row is rejected
+		EXPECT_EQ(tensorStreamGetFrameInto(session, "first", &buffer[0], pitch, pitch * 479, &format, 0, nullptr), VREADER_UNSUPPORTED);
+	}
+	tensorStreamClose(session);
+
+	checkCRC(parameters, 607124128);
+}
+
+TEST(Wrapper_Init, Stats) {
+	TensorStream reader;
+	ASSERT_EQ(reader.initPipeline("../resources/bbb_1080x608_420_10.h264", 5, CPU_BACKEND), VREADER_OK);
+	int port = reader.startMetricsServer(0);
+	EXPECT_GT(port, 0);
+	std::thread pipeline(&TensorStream::startProcessing, &reader);
+	std::map<std::string, std::string> parameters = { {"name", "first"}, {"delay", "0"}, {"format", std::to_string(RGB24)}, {"width", "720"}, {"height", "480"},
+													  {"frames", "10"}, {"dumpName", "bbb_dumpStats.yuv"} };
+	std::thread get(getCycle, parameters, std::ref(reader));
+	get.join();
+	auto stats = reader.getStats();
+	EXPECT_EQ(stats["convert.count"], 10);
+	EXPECT_GT(stats["decode.count"], 0);
+	EXPECT_GE(stats["read.count"], stats["packets"]);
+	EXPECT_LE(stats["decode.p50_ms"], stats["decode.p99_ms"]);
+	EXPECT_LE(stats["decode.p99_ms"], stats["decode.max_ms"]);
+	EXPECT_GT(stats["bytes"], 0);
+	EXPECT_GE(stats["decoded_frames"], 10);
+	EXPECT_EQ(stats["consumer.first.delivered"], 10);
+	//the latest frame is always in decoder's buffer
+	EXPECT_EQ(stats["consumer.first.dropped"], 0);
+	EXPECT_GT(stats["pool.misses"], 0);
+	//file has no capture time, so only age of frames since arrival is known
+	EXPECT_EQ(stats["frame_age.count"], 10);
+	EXPECT_EQ(stats["glass_to_tensor.count"], 0);
+	FrameTimestamps timestamps = reader.getTimestamps("first");
+	EXPECT_GT(timestamps.arrival, 0);
+	EXPECT_LE(timestamps.arrival, timestamps.decoded);
+	EXPECT_LE(timestamps.decoded, timestamps.converted);
+	//the first frame is decoded after all initialization phases
+	EXPECT_GT(stats["startup.first_frame_ms"], 0);
+	EXPECT_GE(stats["startup.first_frame_ms"], stats["startup.open_ms"] + stats["startup.probe_ms"] + stats["startup.decoder_ms"]);
+	EXPECT_EQ(stats["startup.cached"], 0);
+	std::string text = reader.getPrometheusStats();
+	EXPECT_NE(text.find("tensorstream_consumer_frames_total{consumer=\"first\"} 10\n"), std::string::npos);
+	reader.endProcessing(HARD);
+	pipeline.join();
+	remove(parameters["dumpName"].c_str());
+}
+
+TEST(Wrapper_Init, LowLatency) {
+	TensorStream reader;
+	reader.setLowLatency(true);
+	reader.setRTSPTransport("udp");
+	ASSERT_EQ(reader.initPipeline("synthetic://320x240?fps=1&timestamps=1", 5, CPU_BACKEND), VREADER_OK);
+	std::thread pipeline(&TensorStream::startProcessing, &reader);
+	//decoding isn't paced to frame rate, otherwise 10 frames of 1 fps stream would take 10 seconds
+	auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < 10; i++)
+		reader.getFrame("first", 0, Y800);
+	EXPECT_LT(std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count(), 5000);
+	auto stats = reader.getStats();
+	EXPECT_EQ(stats["glass_to_tensor.count"], 10);
+	reader.endProcessing(HARD);
+	pipeline.join();
+}
+
+TEST(Wrapper_Init, FlushedFrames) {
+	TensorStream reader;
+	//every macroblock is I_PCM, so luma of frame is known from its index, the last frames are kept by decoder for reordering till the end
+	ASSERT_EQ(reader.initPipeline("synthetic://320x240?fps=25&gop=0&bframes=2&complexity=1&frames=10", 5, CPU_BACKEND), VREADER_OK);
+	std::thread pipeline(&TensorStream::startProcessing, &reader);
+	std::vector<int> indexes;
+	try {
+		while (true) {
+			auto result = reader.getFrame("tail", 0, Y800);
+			int display = std::get<1>(result) - 1;
+			uint8_t* luma = std::get<0>(result).get();
+			EXPECT_NE(luma, nullptr);
+			if (!luma)
+				break;
+			bool same = true;
+			for (int y = 0; y < 240; y++)
+				for (int x = 0; x < 320; x++)
+					same &= luma[y * 320 + x] == 16 + (((x + 2 * display) ^ (y + display + 1)) & 0xFF) * 219 / 255;
+			EXPECT_TRUE(same) << "frame " << display;
+			indexes.push_back(std::get<1>(result));
+		}
+	}
+	catch (std::runtime_error) {
+	}
+	pipeline.join();
+	//flushed frames are paced as decoded ones, so consumer faster than frame rate doesn't skip any of them
+	ASSERT_FALSE(indexes.empty());
+	EXPECT_EQ(indexes.back(), 10);
+	for (int i = 1; i < indexes.size(); i++)
+		EXPECT_EQ(indexes[i], indexes[i - 1] + 1);
+	reader.endProcessing(HARD);
+}
+
+TEST(Wrapper_Init, CachedParameters) {
+	Parser::ClearParametersCache();
+	//reconnect to the same source takes stream parameters from cache instead of probing
+	for (int i = 0; i < 2; i++) {
+		TensorStream reader;
+		reader.setProbing(65536, 500000);
+		reader.setParametersCache(true);
+		ASSERT_EQ(reader.initPipeline("synthetic://320x240?fps=25&frames=100", 5, CPU_BACKEND), VREADER_OK);
+		auto params = reader.getInitializedParams();
+		EXPECT_EQ(params["width"], 320);
+		EXPECT_EQ(params["height"], 240);
+		EXPECT_EQ(params["framerate_num"] / params["framerate_den"], 25);
+		auto stats = reader.getStats();
+		EXPECT_EQ(stats["startup.cached"], i);
+		EXPECT_GE(stats["startup.probe_ms"], 0);
+		std::thread pipeline(&TensorStream::startProcessing, &reader);
+		reader.getFrame("first", 0, Y800);
+		reader.endProcessing(HARD);
+		pipeline.join();
+	}
+}
+
 //this test should be at the end
 TEST(Wrapper_Init, OneThreadHang) {
 	bool ended = false;